@@ -0,0 +1,159 @@
+/**
+ * @file bench_aio.c
+ * @brief Completion loop throughput over many ptys, io_uring versus epoll
+ *
+ * Same workload as bench_reactor: every port runs a stop-and-wait command
+ * loop against a pty echo device that answers each command byte with
+ * "OK\r\n". Host ports and device ends are all driven by one serial_aio loop,
+ * once on each backend. Besides the command rate the run reports the CPU
+ * time the thread spent per command, user and kernel, which is where the
+ * saved readiness round trips show up.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include "bench_common.h"
+#include "../include/serial_aio.h"
+
+#define MAX_PORTS 256
+#define RUN_TIME_NS 500000000ull
+#define MAX_REPLIES 64
+
+struct bench_port_s {
+    serial_handle_t host;
+    int device;
+    uint64_t completed;
+};
+
+static int running;
+static char replies[MAX_REPLIES * 4];
+
+static void send_command(serial_aio_t *aio, struct bench_port_s *port) {
+    serial_aio_write(aio, port->host, "1", 1, NULL, NULL);
+}
+
+static void on_host_read(serial_aio_t *aio, serial_handle_t handle, const void *data, size_t size, int status,
+                         void *user_data) {
+    struct bench_port_s *port = user_data;
+    const char *bytes = data;
+    (void)handle;
+    if (status != SERIAL_SUCCESS) {
+        return;
+    }
+    for (size_t i = 0; i < size; i++) {
+        if (bytes[i] == '\n') {
+            port->completed++;
+            if (running) {
+                send_command(aio, port);
+            }
+        }
+    }
+}
+
+static void on_device_read(serial_aio_t *aio, serial_handle_t handle, const void *data, size_t size, int status,
+                           void *user_data) {
+    (void)data;
+    (void)user_data;
+    if (status != SERIAL_SUCCESS) {
+        return;
+    }
+    while (size > 0) {
+        size_t count = size < MAX_REPLIES ? size : MAX_REPLIES;
+        serial_aio_write(aio, handle, replies, count * 4, NULL, NULL);
+        size -= count;
+    }
+}
+
+static uint64_t thread_cpu_ns(uint64_t *system_ns) {
+    struct rusage usage;
+    getrusage(RUSAGE_THREAD, &usage);
+    *system_ns = (uint64_t)usage.ru_stime.tv_sec * 1000000000u + (uint64_t)usage.ru_stime.tv_usec * 1000u;
+    return (uint64_t)usage.ru_utime.tv_sec * 1000000000u + (uint64_t)usage.ru_utime.tv_usec * 1000u;
+}
+
+static int run_bench(uint8_t backend, size_t port_count) {
+    static struct bench_port_s ports[MAX_PORTS];
+    struct serial_aio_config_s config = { .backend = backend };
+    serial_aio_t *aio = serial_aio_create(&config);
+    if (!aio) {
+        return -1;
+    }
+    if (serial_aio_backend(aio) != backend) {
+        printf("  io_uring: not built in or not supported by this kernel\n");
+        serial_aio_destroy(aio);
+        return 1;
+    }
+
+    for (size_t i = 0; i < port_count; i++) {
+        char slave_path[64];
+        memset(&ports[i], 0, sizeof(ports[i]));
+        ports[i].device = bench_open_pty(slave_path, sizeof(slave_path));
+        ports[i].host = serial_open(slave_path, NULL);
+        if (ports[i].device < 0 || ports[i].host == SERIAL_INVALID_HANDLE) {
+            fprintf(stderr, "Failed to open pty pair %zu\n", i);
+            return -1;
+        }
+        serial_aio_add(aio, ports[i].host, on_host_read, &ports[i]);
+        serial_aio_add(aio, ports[i].device, on_device_read, NULL);
+    }
+
+    running = 1;
+    for (size_t i = 0; i < port_count; i++) {
+        send_command(aio, &ports[i]);
+    }
+
+    uint64_t system_start;
+    uint64_t user_start = thread_cpu_ns(&system_start);
+    uint64_t start = bench_now_ns();
+    while (bench_now_ns() - start < RUN_TIME_NS) {
+        serial_aio_run_once(aio, 10);
+    }
+    running = 0;
+    uint64_t elapsed = bench_now_ns() - start;
+    uint64_t system_end;
+    uint64_t user_end = thread_cpu_ns(&system_end);
+
+    /* Drain replies still in flight */
+    for (int i = 0; i < 10; i++) {
+        serial_aio_run_once(aio, 1);
+    }
+
+    uint64_t completed = 0;
+    for (size_t i = 0; i < port_count; i++) {
+        completed += ports[i].completed;
+    }
+    serial_aio_destroy(aio);
+    for (size_t i = 0; i < port_count; i++) {
+        serial_close(ports[i].host);
+        close(ports[i].device);
+    }
+
+    double rate = (double)completed * 1e9 / (double)elapsed;
+    double per_command = completed ? 1.0 / (double)completed / 1e3 : 0;
+    printf("  %-8s %5zu ports: %9.0f commands/s, CPU per command %6.2f us user + %6.2f us kernel\n",
+           backend == SERIAL_AIO_IO_URING ? "io_uring" : "epoll", port_count, rate,
+           (double)(user_end - user_start) * per_command, (double)(system_end - system_start) * per_command);
+    return 0;
+}
+
+int main(void) {
+    static const size_t PORT_COUNTS[] = {1, 4, 16, 64, 256};
+
+    for (size_t i = 0; i < MAX_REPLIES; i++) {
+        memcpy(replies + i * 4, "OK\r\n", 4);
+    }
+
+    printf("Completion loop throughput, one thread, stop-and-wait per port:\n");
+    for (size_t i = 0; i < sizeof(PORT_COUNTS) / sizeof(PORT_COUNTS[0]); i++) {
+        if (run_bench(SERIAL_AIO_EPOLL, PORT_COUNTS[i]) != 0) {
+            return EXIT_FAILURE;
+        }
+        int result = run_bench(SERIAL_AIO_IO_URING, PORT_COUNTS[i]);
+        if (result < 0) {
+            return EXIT_FAILURE;
+        }
+    }
+    return EXIT_SUCCESS;
+}
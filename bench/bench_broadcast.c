@@ -0,0 +1,169 @@
+/**
+ * @file bench_broadcast.c
+ * @brief Fan-out time and send skew of one command to 1 to 256 ports
+ *
+ * Each port is a pty whose device side is drained between rounds. One
+ * LED_SET frame goes to every port, either with serial_write_all() on each
+ * port in turn or with serial_broadcast(). Fan-out time runs from the start
+ * until the last port has taken the frame; skew is the spread between the
+ * first and the last port completing. Medians of ROUNDS rounds are shown.
+ *
+ * A second run stalls one port, as a board that stopped reading would, and
+ * gives each port STALL_TIMEOUT_MS. The loop cannot reach the ports after
+ * the stalled one until it gives up on it; the broadcast is done with them
+ * before the stalled port times out.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "bench_common.h"
+#include "../include/serial_broadcast.h"
+#include "../include/serial_frame.h"
+
+#define MAX_PORTS 256
+#define ROUNDS 200
+#define STALL_PORTS 64
+#define STALL_ROUNDS 5
+#define STALL_TIMEOUT_MS 20
+
+static int masters[MAX_PORTS];
+static serial_handle_t ports[MAX_PORTS];
+static struct serial_broadcast_result_s results[MAX_PORTS];
+
+static int compare_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+static void drain_masters(size_t count) {
+    char buffer[4096];
+    for (size_t i = 0; i < count; i++) {
+        while (read(masters[i], buffer, sizeof(buffer)) > 0) {
+        }
+    }
+}
+
+/* serial_write_all() on each port in turn, filling results like serial_broadcast() */
+static void write_in_turn(size_t count, const uint8_t *frame, size_t length, int timeout_ms,
+                          struct serial_broadcast_report_s *report) {
+    uint64_t start = bench_now_ns();
+    uint64_t first = UINT64_MAX, last = 0;
+    memset(report, 0, sizeof(*report));
+    for (size_t i = 0; i < count; i++) {
+        size_t written;
+        results[i].status = serial_write_all(ports[i], frame, length, timeout_ms, &written);
+        results[i].complete_ns = bench_now_ns() - start;
+        if (results[i].status == SERIAL_SUCCESS) {
+            report->completed++;
+            first = results[i].complete_ns < first ? results[i].complete_ns : first;
+            last = results[i].complete_ns > last ? results[i].complete_ns : last;
+        } else {
+            report->failed++;
+        }
+    }
+    report->complete_skew_ns = last > first ? last - first : 0;
+    report->elapsed_ns = bench_now_ns() - start;
+}
+
+/* Time until the last healthy port completed, skipping port 0 when it is stalled */
+static uint64_t fan_out_ns(size_t count, size_t from) {
+    uint64_t last = 0;
+    for (size_t i = from; i < count; i++) {
+        last = results[i].complete_ns > last ? results[i].complete_ns : last;
+    }
+    return last;
+}
+
+int main(void) {
+    size_t opened = 0;
+    char slave_path[64];
+    for (; opened < MAX_PORTS; opened++) {
+        masters[opened] = bench_open_pty(slave_path, sizeof(slave_path));
+        ports[opened] = masters[opened] >= 0 ? serial_open(slave_path, NULL) : SERIAL_INVALID_HANDLE;
+        if (ports[opened] == SERIAL_INVALID_HANDLE) {
+            break;
+        }
+    }
+    if (opened < STALL_PORTS) {
+        fprintf(stderr, "Unable to open %d ptys\n", STALL_PORTS);
+        return EXIT_FAILURE;
+    }
+
+    uint8_t frame[16];
+    size_t length;
+    uint8_t mask = SERIAL_LED_RED | SERIAL_LED_BLUE;
+    serial_frame_encode(1, SERIAL_CMD_LED_SET, &mask, 1, frame, sizeof(frame), &length);
+
+    static const size_t COUNTS[] = {1, 16, 64, 256};
+    static uint64_t fan_out[2][ROUNDS];
+    static uint64_t skew[2][ROUNDS];
+    printf("One %zu-byte frame to N ptys, median of %d rounds:\n", length, ROUNDS);
+    printf("  %5s  %14s %14s  %14s %14s\n", "ports", "loop fan-out", "loop skew", "bcast fan-out", "bcast skew");
+    for (size_t c = 0; c < sizeof(COUNTS) / sizeof(COUNTS[0]) && COUNTS[c] <= opened; c++) {
+        size_t count = COUNTS[c];
+        for (int round = 0; round < ROUNDS; round++) {
+            struct serial_broadcast_report_s report;
+            write_in_turn(count, frame, length, 1000, &report);
+            fan_out[0][round] = fan_out_ns(count, 0);
+            skew[0][round] = report.complete_skew_ns;
+            drain_masters(count);
+            if (serial_broadcast(ports, count, frame, length, 1000, results, &report) != SERIAL_SUCCESS) {
+                fprintf(stderr, "Broadcast failed\n");
+                return EXIT_FAILURE;
+            }
+            fan_out[1][round] = fan_out_ns(count, 0);
+            skew[1][round] = report.complete_skew_ns;
+            drain_masters(count);
+        }
+        for (int m = 0; m < 2; m++) {
+            qsort(fan_out[m], ROUNDS, sizeof(uint64_t), compare_u64);
+            qsort(skew[m], ROUNDS, sizeof(uint64_t), compare_u64);
+        }
+        printf("  %5zu  %11.1f us %11.1f us  %11.1f us %11.1f us\n", count, (double)fan_out[0][ROUNDS / 2] / 1e3,
+               (double)skew[0][ROUNDS / 2] / 1e3, (double)fan_out[1][ROUNDS / 2] / 1e3,
+               (double)skew[1][ROUNDS / 2] / 1e3);
+    }
+
+    /* Stall port 0: fill its output queue and stop draining it */
+    char filler[4096];
+    size_t count;
+    memset(filler, 'x', sizeof(filler));
+    for (int pass = 0; pass < 3; pass++) {
+        while (serial_write(ports[0], filler, sizeof(filler), &count) == SERIAL_SUCCESS && count > 0) {
+        }
+        usleep(10000);
+        while (serial_write(ports[0], filler, 1, &count) == SERIAL_SUCCESS && count > 0) {
+        }
+    }
+    uint64_t stalled[2] = {UINT64_MAX, UINT64_MAX};
+    for (int round = 0; round < STALL_ROUNDS; round++) {
+        struct serial_broadcast_report_s report;
+        write_in_turn(STALL_PORTS, frame, length, STALL_TIMEOUT_MS, &report);
+        uint64_t loop_ns = fan_out_ns(STALL_PORTS, 1);
+        int loop_ok = report.failed == 1;
+        serial_broadcast(ports, STALL_PORTS, frame, length, STALL_TIMEOUT_MS, results, &report);
+        uint64_t broadcast_ns = fan_out_ns(STALL_PORTS, 1);
+        if (!loop_ok || report.failed != 1 || results[0].status != SERIAL_ERROR_TIMEOUT) {
+            fprintf(stderr, "Port 0 did not stall\n");
+            return EXIT_FAILURE;
+        }
+        stalled[0] = loop_ns < stalled[0] ? loop_ns : stalled[0];
+        stalled[1] = broadcast_ns < stalled[1] ? broadcast_ns : stalled[1];
+        for (size_t i = 1; i < STALL_PORTS; i++) {
+            char buffer[64];
+            while (read(masters[i], buffer, sizeof(buffer)) > 0) {
+            }
+        }
+    }
+    printf("%d ports, port 0 stalled, %d ms timeout; the other ports done after (best of %d):\n", STALL_PORTS,
+           STALL_TIMEOUT_MS, STALL_ROUNDS);
+    printf("  loop:      %10.1f us\n", (double)stalled[0] / 1e3);
+    printf("  broadcast: %10.1f us\n", (double)stalled[1] / 1e3);
+
+    for (size_t i = 0; i < opened; i++) {
+        serial_close(ports[i]);
+        close(masters[i]);
+    }
+    return EXIT_SUCCESS;
+}
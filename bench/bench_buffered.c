@@ -0,0 +1,187 @@
+/**
+ * @file bench_buffered.c
+ * @brief Direct-syscall versus buffered-mode serial_read/serial_write
+ *
+ * Streams small messages through a pty in each direction and reports the
+ * application-side operations per second with and without buffered mode,
+ * plus raw ring throughput for reference.
+ */
+
+#include <pthread.h>
+#include <sched.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bench_common.h"
+#include "../include/serial_functions.h"
+#include "../include/serial_ring.h"
+
+#define MESSAGE_SIZE 16
+#define MESSAGE_COUNT 200000
+#define TOTAL_BYTES ((size_t)MESSAGE_SIZE * MESSAGE_COUNT)
+
+struct device_s {
+    int fd;
+    size_t bytes;
+};
+
+/* Device side sink: reads until every message has arrived */
+static void *device_sink(void *arg) {
+    struct device_s *device = arg;
+    char buffer[4096];
+    while (device->bytes < TOTAL_BYTES) {
+        struct pollfd pfd = { .fd = device->fd, .events = POLLIN };
+        poll(&pfd, 1, 100);
+        ssize_t count = read(device->fd, buffer, sizeof(buffer));
+        if (count > 0) {
+            device->bytes += (size_t)count;
+        }
+    }
+    return NULL;
+}
+
+/* Device side source: keeps the host's input queue topped up */
+static void *device_source(void *arg) {
+    struct device_s *device = arg;
+    char buffer[4096];
+    memset(buffer, 'x', sizeof(buffer));
+    while (device->bytes < TOTAL_BYTES) {
+        struct pollfd pfd = { .fd = device->fd, .events = POLLOUT };
+        poll(&pfd, 1, 100);
+        size_t size = TOTAL_BYTES - device->bytes;
+        ssize_t count = write(device->fd, buffer, size < sizeof(buffer) ? size : sizeof(buffer));
+        if (count > 0) {
+            device->bytes += (size_t)count;
+        }
+    }
+    return NULL;
+}
+
+static int open_pair(int *master, serial_handle_t *port, int buffered) {
+    char slave_path[64];
+    *master = bench_open_pty(slave_path, sizeof(slave_path));
+    *port = serial_open(slave_path, NULL);
+    if (*master < 0 || *port == SERIAL_INVALID_HANDLE) {
+        return -1;
+    }
+    if (buffered) {
+        struct serial_buffer_config_s config = { .rx_size = 1 << 16, .tx_size = 1 << 16 };
+        return serial_enable_buffering(*port, &config);
+    }
+    return 0;
+}
+
+static int bench_write(int buffered) {
+    int master;
+    serial_handle_t port;
+    if (open_pair(&master, &port, buffered) != 0) {
+        return -1;
+    }
+
+    struct device_s device = { .fd = master };
+    pthread_t thread;
+    pthread_create(&thread, NULL, device_sink, &device);
+
+    char message[MESSAGE_SIZE];
+    memset(message, 'm', sizeof(message));
+    uint64_t in_write = 0;
+    uint64_t start = bench_now_ns();
+    for (size_t i = 0; i < MESSAGE_COUNT; i++) {
+        size_t sent = 0;
+        while (sent < MESSAGE_SIZE) {
+            size_t written = 0;
+            uint64_t before = bench_now_ns();
+            int result = serial_write(port, message + sent, MESSAGE_SIZE - sent, &written);
+            uint64_t after = bench_now_ns();
+            if (result != SERIAL_SUCCESS) {
+                return -1;
+            }
+            if (written == 0) {
+                /* Link is the bottleneck: wait for room, not counted as call cost */
+                struct pollfd pfd = { .fd = port, .events = POLLOUT };
+                if (buffered) {
+                    sched_yield();
+                } else {
+                    poll(&pfd, 1, 100);
+                }
+                continue;
+            }
+            in_write += after - before;
+            sent += written;
+        }
+    }
+    pthread_join(thread, NULL);
+    uint64_t delivered = bench_now_ns() - start;
+
+    printf("  write %-8s: %10.0f ops/s in serial_write, %7.1f MB/s delivered\n",
+           buffered ? "buffered" : "direct", MESSAGE_COUNT * 1e9 / (double)in_write,
+           TOTAL_BYTES * 1e3 / (double)delivered);
+
+    serial_close(port);
+    close(master);
+    return 0;
+}
+
+static int bench_read(int buffered) {
+    int master;
+    serial_handle_t port;
+    if (open_pair(&master, &port, buffered) != 0) {
+        return -1;
+    }
+
+    struct device_s device = { .fd = master };
+    pthread_t thread;
+    pthread_create(&thread, NULL, device_source, &device);
+
+    char buffer[MESSAGE_SIZE];
+    size_t received = 0;
+    uint64_t calls = 0;
+    uint64_t start = bench_now_ns();
+    while (received < TOTAL_BYTES) {
+        size_t count;
+        if (serial_read(port, buffer, sizeof(buffer), &count) != SERIAL_SUCCESS) {
+            return -1;
+        }
+        if (count == 0) {
+            serial_wait_readable(port, 100);
+            continue;
+        }
+        received += count;
+        calls++;
+    }
+    uint64_t elapsed = bench_now_ns() - start;
+    pthread_join(thread, NULL);
+
+    printf("  read  %-8s: %10.0f ops/s, %7.1f MB/s\n", buffered ? "buffered" : "direct",
+           (double)calls * 1e9 / (double)elapsed, TOTAL_BYTES * 1e3 / (double)elapsed);
+
+    serial_close(port);
+    close(master);
+    return 0;
+}
+
+static void bench_ring(void) {
+    serial_ring_t *ring = serial_ring_create(1 << 16);
+    char message[MESSAGE_SIZE] = {0};
+    uint64_t start = bench_now_ns();
+    for (size_t i = 0; i < 10 * MESSAGE_COUNT; i++) {
+        serial_ring_write(ring, message, sizeof(message));
+        serial_ring_read(ring, message, sizeof(message));
+    }
+    uint64_t elapsed = bench_now_ns() - start;
+    printf("  ring write+read : %10.0f ops/s (%d-byte messages, one thread)\n",
+           10.0 * MESSAGE_COUNT * 1e9 / (double)elapsed, MESSAGE_SIZE);
+    serial_ring_destroy(ring);
+}
+
+int main(void) {
+    printf("Buffered mode vs direct syscalls, %d x %d-byte messages over a pty:\n",
+           MESSAGE_COUNT, MESSAGE_SIZE);
+    bench_ring();
+    if (bench_write(0) != 0 || bench_write(1) != 0 || bench_read(0) != 0 || bench_read(1) != 0) {
+        fprintf(stderr, "Benchmark failed\n");
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
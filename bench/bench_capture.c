@@ -0,0 +1,122 @@
+/**
+ * @file bench_capture.c
+ * @brief Cost of traffic capture on a direct-mode pty round trip, and replay speed
+ *
+ * Same round trip as bench_stats: one byte out through serial_write(), echoed
+ * by the device side and picked up by serial_read(), so each round trip adds
+ * two records to the capture. Rounds with capture off and on alternate and
+ * the best of each is kept. The last capture is then replayed at full speed
+ * into a pty to measure how fast a recorded session can be re-driven.
+ */
+
+#include <poll.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "bench_common.h"
+#include "../include/serial_capture.h"
+
+#define ROUND_TRIPS 100000
+#define ROUNDS 5
+
+/* Returns the time per round trip in nanoseconds, or 0 on failure */
+static double run_round(serial_handle_t port, int master) {
+    uint8_t byte = 0x31;
+    size_t count;
+    uint64_t start = bench_now_ns();
+    for (int i = 0; i < ROUND_TRIPS; i++) {
+        uint8_t echo;
+        if (serial_write(port, &byte, 1, &count) != SERIAL_SUCCESS || count != 1) {
+            return 0;
+        }
+        while (read(master, &echo, 1) != 1) {
+        }
+        if (write(master, &echo, 1) != 1) {
+            return 0;
+        }
+        do {
+            if (serial_read(port, &echo, 1, &count) != SERIAL_SUCCESS) {
+                return 0;
+            }
+        } while (count == 0);
+    }
+    return (double)(bench_now_ns() - start) / ROUND_TRIPS;
+}
+
+struct drain_s {
+    int master;
+    atomic_int stop;
+};
+
+/* Reads the device side of the pty so the replay never waits for buffer space */
+static void *drain_main(void *arg) {
+    struct drain_s *drain = arg;
+    char buffer[4096];
+    while (!atomic_load(&drain->stop)) {
+        struct pollfd pfd = { .fd = drain->master, .events = POLLIN };
+        if (poll(&pfd, 1, 10) > 0) {
+            while (read(drain->master, buffer, sizeof(buffer)) > 0) {
+            }
+        }
+    }
+    return NULL;
+}
+
+/* Replays the sent side into the pty at full speed; returns records per second */
+static double replay_rate(const char *path, serial_handle_t port, int master) {
+    serial_disable_capture(port);
+    serial_replay_t *replay = serial_replay_open(path);
+    struct drain_s drain = { .master = master };
+    pthread_t thread;
+    if (!replay || pthread_create(&thread, NULL, drain_main, &drain) != 0) {
+        serial_replay_close(replay);
+        return 0;
+    }
+    uint64_t start = bench_now_ns();
+    int result = serial_replay_run(replay, port, SERIAL_CAPTURE_TX, 0);
+    double elapsed = (double)(bench_now_ns() - start);
+    atomic_store(&drain.stop, 1);
+    pthread_join(thread, NULL);
+    serial_replay_close(replay);
+    return result == SERIAL_SUCCESS ? ROUND_TRIPS * 1e9 / elapsed : 0;
+}
+
+int main(void) {
+    char slave_path[64];
+    char capture_path[] = "/tmp/bench_capture_XXXXXX";
+    int capture_fd = mkstemp(capture_path);
+    int master = bench_open_pty(slave_path, sizeof(slave_path));
+    serial_handle_t port = master >= 0 ? serial_open(slave_path, NULL) : SERIAL_INVALID_HANDLE;
+    if (port == SERIAL_INVALID_HANDLE || capture_fd < 0) {
+        fprintf(stderr, "Unable to open a pty or a capture file\n");
+        return EXIT_FAILURE;
+    }
+    close(capture_fd);
+
+    double best_off = 0, best_on = 0;
+    for (int round = 0; round < ROUNDS; round++) {
+        serial_disable_capture(port);
+        double off = run_round(port, master);
+        serial_enable_capture(port, capture_path);
+        double on = run_round(port, master);
+        if (off == 0 || on == 0) {
+            fprintf(stderr, "Benchmark failed\n");
+            unlink(capture_path);
+            return EXIT_FAILURE;
+        }
+        best_off = (round == 0 || off < best_off) ? off : best_off;
+        best_on = (round == 0 || on < best_on) ? on : best_on;
+    }
+    double replayed = replay_rate(capture_path, port, master);
+
+    printf("Direct-mode 1-byte round trips over a pty, best of %d x %d:\n", ROUNDS, ROUND_TRIPS);
+    printf("  capture off: %8.1f ns/round trip\n", best_off);
+    printf("  capture on:  %8.1f ns/round trip (%+.1f%%)\n", best_on, (best_on - best_off) * 100.0 / best_off);
+    printf("  replay at full speed: %.0f records/s\n", replayed);
+
+    serial_close(port);
+    close(master);
+    unlink(capture_path);
+    return replayed > 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
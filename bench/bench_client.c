@@ -0,0 +1,103 @@
+/**
+ * @file bench_client.c
+ * @brief Command throughput of the pipelined client versus window size
+ *
+ * The emulated device paces both directions to 115200 baud (10 bit times per
+ * byte) so the numbers reflect a real UART link rather than pty memory
+ * copies. Window 1 is stop-and-wait; larger windows keep the link busy while
+ * replies are in transit. Past what the device's 64-byte receive buffer
+ * holds, commands are lost unless RTS/CTS flow control holds the host off.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "bench_common.h"
+#include "../include/serial_client.h"
+#include "../include/serial_emulator.h"
+
+#define LINK_BAUD 115200u
+#define BYTE_NS (10000000000ull / LINK_BAUD)
+#define RUN_NS 1000000000ull
+
+struct totals_s {
+    uint64_t completed;
+    uint64_t failed;
+    uint64_t latency_ns;
+};
+
+static void on_complete(serial_client_t *client, int status, const struct serial_frame_s *reply,
+                        uint64_t latency_ns, void *user_data) {
+    struct totals_s *totals = user_data;
+    (void)client;
+    (void)reply;
+    if (status == SERIAL_SUCCESS) {
+        totals->completed++;
+        totals->latency_ns += latency_ns;
+    } else {
+        totals->failed++;
+    }
+}
+
+static int run_window(unsigned window, uint8_t flow_control) {
+    struct serial_emulator_config_s device = { .baud_rate = LINK_BAUD, .flow_control = flow_control };
+    struct serial_config_s link = {
+        .baud_rate = LINK_BAUD, .data_bits = 8, .stop_bits = 1, .parity = 0, .flow_control = flow_control
+    };
+    serial_emulator_t *emulator = serial_emulator_create(&device);
+    if (!emulator) {
+        return -1;
+    }
+    serial_handle_t port = serial_open(serial_emulator_path(emulator), &link);
+    struct serial_client_config_s config = { .window = window, .timeout_ms = 1000 };
+    serial_client_t *client = serial_client_create(port, &config);
+    if (!client) {
+        return -1;
+    }
+
+    struct totals_s totals = {0};
+    uint8_t mask = SERIAL_LED_RED;
+    uint64_t start = bench_now_ns();
+    while (bench_now_ns() - start < RUN_NS) {
+        if (serial_client_submit(client, SERIAL_CMD_LED_SET, &mask, 1, on_complete, &totals) != SERIAL_SUCCESS) {
+            return -1;
+        }
+        mask = mask == SERIAL_LED_BLUE ? SERIAL_LED_RED : (uint8_t)(mask << 1);
+    }
+    serial_client_drain(client);
+    double elapsed = (double)(bench_now_ns() - start);
+
+    /* The ACK is longer than the command, so the device-to-host direction saturates first */
+    uint8_t encoded[SERIAL_FRAME_MAX_ENCODED];
+    uint8_t ack[2] = {SERIAL_STATUS_OK, mask};
+    size_t frame_bytes;
+    serial_frame_encode(0, SERIAL_CMD_ACK, ack, sizeof(ack), encoded, sizeof(encoded), &frame_bytes);
+    double rate = (double)totals.completed * 1e9 / elapsed;
+    struct serial_emulator_stats_s stats;
+    serial_emulator_get_stats(emulator, &stats);
+    printf("  window %3u: %7.0f cmds/s, link %5.1f%% busy, mean latency %7.2f ms, %llu timeouts, %llu overruns\n",
+           window, rate, 100.0 * rate * (double)(frame_bytes * BYTE_NS) / 1e9,
+           totals.completed ? (double)totals.latency_ns / (double)totals.completed / 1e6 : 0.0,
+           (unsigned long long)totals.failed, (unsigned long long)stats.overruns);
+
+    serial_client_destroy(client);
+    serial_close(port);
+    serial_emulator_destroy(emulator);
+    return 0;
+}
+
+int main(void) {
+    static const unsigned WINDOWS[] = {1, 2, 4, 8, 16, 32};
+    static const struct { uint8_t flow_control; const char *name; } FLOWS[] = {
+        {SERIAL_FLOW_NONE, "no flow control"}, {SERIAL_FLOW_RTSCTS, "RTS/CTS"}
+    };
+    for (size_t f = 0; f < sizeof(FLOWS) / sizeof(FLOWS[0]); f++) {
+        printf("LED_SET commands over a pty paced to %u baud, %s:\n", LINK_BAUD, FLOWS[f].name);
+        for (size_t i = 0; i < sizeof(WINDOWS) / sizeof(WINDOWS[0]); i++) {
+            if (run_window(WINDOWS[i], FLOWS[f].flow_control) != 0) {
+                fprintf(stderr, "Benchmark failed\n");
+                return EXIT_FAILURE;
+            }
+        }
+    }
+    return EXIT_SUCCESS;
+}
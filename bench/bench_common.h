@@ -0,0 +1,72 @@
+/**
+ * @file bench_common.h
+ * @brief Shared helpers for the benchmark programs
+ */
+
+#ifndef BENCH_COMMON_H_
+#define BENCH_COMMON_H_
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/* Monotonic clock in nanoseconds */
+static inline uint64_t bench_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+/* Opens a non-blocking pty master and stores the slave path */
+static inline int bench_open_pty(char *slave_path, size_t size) {
+    int master = posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if (master < 0) {
+        return -1;
+    }
+    if (grantpt(master) != 0 || unlockpt(master) != 0 || ptsname_r(master, slave_path, size) != 0) {
+        close(master);
+        return -1;
+    }
+    return master;
+}
+
+/* Reads the syscr/syscw counters from a /proc I/O accounting file */
+static inline int bench_read_io_counts(const char *path, uint64_t *reads, uint64_t *writes) {
+    FILE *file = fopen(path, "r");
+    if (!file) {
+        return -1;
+    }
+    char name[32];
+    unsigned long long value;
+    int found = 0;
+    while (fscanf(file, "%31[^:]: %llu ", name, &value) == 2) {
+        if (strcmp(name, "syscr") == 0) {
+            *reads = value;
+            found++;
+        } else if (strcmp(name, "syscw") == 0) {
+            *writes = value;
+            found++;
+        }
+    }
+    fclose(file);
+    return found == 2 ? 0 : -1;
+}
+
+/*
+ * Reads the process-wide read and write system call counters from
+ * /proc/self/io. Returns -1 when task I/O accounting is unavailable.
+ */
+static inline int bench_syscall_counts(uint64_t *reads, uint64_t *writes) {
+    return bench_read_io_counts("/proc/self/io", reads, writes);
+}
+
+/* Same as bench_syscall_counts() but for the calling thread only */
+static inline int bench_thread_syscall_counts(uint64_t *reads, uint64_t *writes) {
+    return bench_read_io_counts("/proc/thread-self/io", reads, writes);
+}
+
+#endif /* BENCH_COMMON_H_ */
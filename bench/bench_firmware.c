@@ -0,0 +1,90 @@
+/**
+ * @file bench_firmware.c
+ * @brief Device-side command throughput of the sketch's firmware core, run on the host
+ *
+ * Feeds a pre-encoded stream of framed commands (LED_SET, GET_STATE and
+ * four-step BATCH in turn) and a stream of menu characters to
+ * led_firmware.c, taking the replies out as they are queued. Input is
+ * handed over one byte per call, as the sketch does from Serial.read(), and
+ * in 64-byte chunks, the size of the AVR receive buffer. The host numbers
+ * do not transfer to a 16 MHz AVR, but they show where the firmware spends
+ * its time and make changes to it measurable. For scale, the sketch used to
+ * wait 100 ms after every menu command, capping it at 10 commands/s, and a
+ * 115200 baud link carries about 1400 framed commands/s.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "bench_common.h"
+#include "../include/serial_frame.h"
+#include "../sketch_mar2a/led_firmware.h"
+
+#define STREAM_COMMANDS 30000
+#define ROUNDS 20
+
+/* Runs the stream through the firmware ROUNDS times; returns ns per command, negative on failure */
+static double run_stream(const uint8_t *stream, size_t length, size_t commands, uint16_t chunk) {
+    static struct led_firmware_s firmware;
+    uint8_t out[LED_FIRMWARE_TX_QUEUE];
+    uint64_t replied = 0;
+    led_firmware_init(&firmware);
+
+    uint64_t start = bench_now_ns();
+    for (int round = 0; round < ROUNDS; round++) {
+        size_t offset = 0;
+        while (offset < length) {
+            uint16_t count = (uint16_t)(length - offset < chunk ? length - offset : chunk);
+            offset += led_firmware_receive(&firmware, stream + offset, count);
+            replied += led_firmware_transmit(&firmware, out, sizeof(out));
+        }
+    }
+    double elapsed = (double)(bench_now_ns() - start);
+    replied += led_firmware_transmit(&firmware, out, sizeof(out));
+    if (firmware.bad_frames != 0 || replied == 0) {
+        return -1.0;
+    }
+    return elapsed / (double)(commands * ROUNDS);
+}
+
+int main(void) {
+    uint8_t *frames = malloc(STREAM_COMMANDS * 16u);
+    uint8_t *ascii = malloc(STREAM_COMMANDS);
+    if (!frames || !ascii) {
+        fprintf(stderr, "Out of memory\n");
+        return EXIT_FAILURE;
+    }
+
+    size_t frames_length = 0;
+    for (size_t i = 0; i < STREAM_COMMANDS; i++) {
+        uint8_t mask = (uint8_t)(1u << (i % 3));
+        uint8_t batch[] = {SERIAL_CMD_LED_ON, mask, SERIAL_CMD_LED_OFF, (uint8_t)(mask << 1),
+                           SERIAL_CMD_LED_SET, mask, SERIAL_CMD_LED_ON, SERIAL_LED_ALL};
+        size_t encoded;
+        int kind = (int)(i % 3);
+        serial_frame_encode((uint8_t)i, kind == 0 ? SERIAL_CMD_LED_SET : kind == 1 ? SERIAL_CMD_GET_STATE
+                                                                                   : SERIAL_CMD_BATCH,
+                            kind == 0 ? &mask : batch, kind == 0 ? 1 : kind == 1 ? 0 : sizeof(batch),
+                            frames + frames_length, 16, &encoded);
+        frames_length += encoded;
+        ascii[i] = (uint8_t)('1' + i % 4);
+    }
+
+    static const uint16_t CHUNKS[] = {1, 64};
+    printf("Firmware core on the host, %d commands x %d rounds:\n", STREAM_COMMANDS, ROUNDS);
+    for (size_t c = 0; c < sizeof(CHUNKS) / sizeof(CHUNKS[0]); c++) {
+        double frame_ns = run_stream(frames, frames_length, STREAM_COMMANDS, CHUNKS[c]);
+        double ascii_ns = run_stream(ascii, STREAM_COMMANDS, STREAM_COMMANDS, CHUNKS[c]);
+        if (frame_ns < 0 || ascii_ns < 0) {
+            fprintf(stderr, "Benchmark failed\n");
+            return EXIT_FAILURE;
+        }
+        printf("  %2u byte(s) per call: frames %6.1f ns/cmd (%5.1f M cmds/s, %.1f bytes/cmd), "
+               "menu %5.1f ns/cmd (%5.1f M cmds/s)\n",
+               (unsigned)CHUNKS[c], frame_ns, 1e3 / frame_ns, (double)frames_length / STREAM_COMMANDS, ascii_ns,
+               1e3 / ascii_ns);
+    }
+
+    free(frames);
+    free(ascii);
+    return EXIT_SUCCESS;
+}
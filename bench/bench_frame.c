@@ -0,0 +1,136 @@
+/**
+ * @file bench_frame.c
+ * @brief Frame encode/decode throughput and batched LED updates over a pty
+ *
+ * The device is the sketch emulator without pacing, so both protocols are
+ * measured on equal terms.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bench_common.h"
+#include "../include/serial_emulator.h"
+#include "../include/serial_frame.h"
+
+#define CODEC_FRAMES 200000
+#define LINK_RUN_NS 500000000ull
+#define BATCH_OPS (SERIAL_FRAME_MAX_PAYLOAD / 2)
+#define REPLY_TIMEOUT_MS 1000
+
+static void bench_codec(void) {
+    uint8_t payload[SERIAL_FRAME_MAX_PAYLOAD];
+    for (size_t i = 0; i < sizeof(payload); i++) {
+        payload[i] = (uint8_t)(i * 31u);
+    }
+
+    size_t frame_size = 0;
+    uint8_t *stream = malloc((size_t)CODEC_FRAMES * SERIAL_FRAME_MAX_ENCODED);
+    uint64_t start = bench_now_ns();
+    for (size_t i = 0; i < CODEC_FRAMES; i++) {
+        serial_frame_encode((uint8_t)i, SERIAL_CMD_BATCH, payload, sizeof(payload),
+                            stream + i * frame_size, SERIAL_FRAME_MAX_ENCODED, &frame_size);
+    }
+    uint64_t encode_ns = bench_now_ns() - start;
+
+    struct serial_frame_decoder_s decoder;
+    struct serial_frame_s frame;
+    serial_frame_decoder_init(&decoder);
+    size_t total = (size_t)CODEC_FRAMES * frame_size;
+    size_t offset = 0;
+    start = bench_now_ns();
+    while (offset < total) {
+        int ready;
+        offset += serial_frame_decode(&decoder, stream + offset, total - offset, &frame, &ready);
+    }
+    uint64_t decode_ns = bench_now_ns() - start;
+
+    printf("  encode: %7.1f MB/s payload (%zu-byte frames)\n",
+           (double)CODEC_FRAMES * sizeof(payload) * 1e3 / (double)encode_ns, frame_size);
+    printf("  decode: %7.1f MB/s payload, %u frames, %u errors\n",
+           (double)CODEC_FRAMES * sizeof(payload) * 1e3 / (double)decode_ns,
+           (unsigned)decoder.frames, (unsigned)decoder.errors);
+    free(stream);
+}
+
+/* Reads until one frame is decoded */
+static int read_frame(serial_handle_t port, struct serial_frame_decoder_s *decoder, struct serial_frame_s *frame) {
+    uint8_t byte;
+    for (;;) {
+        size_t count;
+        if (serial_wait_readable(port, REPLY_TIMEOUT_MS) != SERIAL_SUCCESS ||
+            serial_read(port, &byte, 1, &count) != SERIAL_SUCCESS) {
+            return -1;
+        }
+        int ready;
+        if (count == 1 && serial_frame_decode(decoder, &byte, 1, frame, &ready) && ready) {
+            return 0;
+        }
+    }
+}
+
+static int bench_link(void) {
+    serial_emulator_t *emulator = serial_emulator_create(NULL);
+    serial_handle_t port = emulator ? serial_open(serial_emulator_path(emulator), NULL) : SERIAL_INVALID_HANDLE;
+    if (port == SERIAL_INVALID_HANDLE) {
+        return -1;
+    }
+
+    /* Legacy: one ASCII command, one text reply */
+    uint64_t ops = 0;
+    uint64_t start = bench_now_ns();
+    while (bench_now_ns() - start < LINK_RUN_NS) {
+        char reply[64];
+        size_t count;
+        if (serial_write_all(port, "1", 1, REPLY_TIMEOUT_MS, &count) != SERIAL_SUCCESS ||
+            serial_read_until(port, reply, sizeof(reply), "\r\n", serial_monotonic_ms() + REPLY_TIMEOUT_MS,
+                              &count) != SERIAL_SUCCESS) {
+            return -1;
+        }
+        ops++;
+    }
+    double ascii_rate = (double)ops * 1e9 / (double)(bench_now_ns() - start);
+
+    /* Framed: BATCH_OPS LED operations per frame, one ACK */
+    uint8_t payload[BATCH_OPS * 2];
+    for (size_t i = 0; i < BATCH_OPS; i++) {
+        payload[2 * i] = (i % 2) ? SERIAL_CMD_LED_OFF : SERIAL_CMD_LED_ON;
+        payload[2 * i + 1] = (uint8_t)(1u << (i % 3));
+    }
+    struct serial_frame_decoder_s decoder;
+    struct serial_frame_s frame;
+    serial_frame_decoder_init(&decoder);
+    ops = 0;
+    uint8_t seq = 0;
+    start = bench_now_ns();
+    while (bench_now_ns() - start < LINK_RUN_NS) {
+        uint8_t encoded[SERIAL_FRAME_MAX_ENCODED];
+        size_t length, count;
+        serial_frame_encode(seq, SERIAL_CMD_BATCH, payload, sizeof(payload), encoded, sizeof(encoded), &length);
+        if (serial_write_all(port, encoded, length, REPLY_TIMEOUT_MS, &count) != SERIAL_SUCCESS ||
+            read_frame(port, &decoder, &frame) != 0 || frame.seq != seq || frame.cmd != SERIAL_CMD_ACK) {
+            return -1;
+        }
+        seq++;
+        ops += BATCH_OPS;
+    }
+    double batch_rate = (double)ops * 1e9 / (double)(bench_now_ns() - start);
+
+    printf("  ASCII stop-and-wait : %10.0f LED ops/s\n", ascii_rate);
+    printf("  framed batch of %3d: %10.0f LED ops/s (%.1fx)\n", BATCH_OPS, batch_rate, batch_rate / ascii_rate);
+
+    serial_close(port);
+    serial_emulator_destroy(emulator);
+    return 0;
+}
+
+int main(void) {
+    printf("Frame codec, in memory:\n");
+    bench_codec();
+    printf("LED updates over a pty:\n");
+    if (bench_link() != 0) {
+        fprintf(stderr, "Benchmark failed\n");
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
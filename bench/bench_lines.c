@@ -0,0 +1,130 @@
+/**
+ * @file bench_lines.c
+ * @brief Line splitting speed on large synthetic captures
+ *
+ * A capture of newline-terminated records is split once per delimiter
+ * search implementation, with libc memchr() as the reference, for three
+ * record lengths: short sketch responses, telemetry rows and long dumps.
+ * The last column feeds the same capture through a serial_lines_t in
+ * 4 KiB reads, the way it arrives from a port.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bench_common.h"
+#include "../include/serial_lines.h"
+
+#define CAPTURE_SIZE (64u << 20)
+#define PASSES 3
+#define READ_SIZE 4096
+
+/* Records of random length around the mean, each ending in "\r\n" */
+static void fill_capture(char *capture, size_t size, unsigned mean_length) {
+    uint32_t state = 12345;
+    size_t position = 0;
+    while (position < size) {
+        state = state * 1664525u + 1013904223u;
+        size_t length = mean_length / 2 + (state >> 8) % (mean_length + 1);
+        for (size_t i = 0; i + 2 < length && position < size; i++) {
+            capture[position++] = (char)(' ' + (state >> (i % 24)) % 90);
+        }
+        if (position < size) {
+            capture[position++] = '\r';
+        }
+        if (position < size) {
+            capture[position++] = '\n';
+        }
+    }
+}
+
+/* Returns GB/s for splitting the capture in place with serial_find_byte() or memchr() */
+static double split_in_place(const char *capture, size_t size, int use_memchr, size_t *line_count) {
+    double best = 0;
+    for (int pass = 0; pass < PASSES; pass++) {
+        size_t lines = 0;
+        const char *data = capture;
+        const char *end = capture + size;
+        uint64_t start = bench_now_ns();
+        for (;;) {
+            const char *found = use_memchr ? memchr(data, '\n', (size_t)(end - data))
+                                           : serial_find_byte(data, (size_t)(end - data), '\n');
+            if (!found) {
+                break;
+            }
+            lines++;
+            data = found + 1;
+        }
+        double rate = (double)size / (double)(bench_now_ns() - start);
+        best = rate > best ? rate : best;
+        *line_count = lines;
+    }
+    return best;
+}
+
+/* Returns GB/s for streaming the capture through a splitter in READ_SIZE pieces */
+static double split_streaming(const char *capture, size_t size, size_t *line_count) {
+    serial_lines_t *lines = serial_lines_create(READ_SIZE * 2, '\n');
+    double best = 0;
+    for (int pass = 0; pass < PASSES && lines; pass++) {
+        size_t count = 0;
+        size_t length_sum = 0;
+        struct serial_line_s line;
+        serial_lines_reset(lines);
+        uint64_t start = bench_now_ns();
+        for (size_t offset = 0; offset < size;) {
+            size_t chunk = size - offset < READ_SIZE ? size - offset : READ_SIZE;
+            offset += serial_lines_feed(lines, capture + offset, chunk);
+            while (serial_lines_next(lines, &line)) {
+                count++;
+                length_sum += line.length;
+            }
+        }
+        double rate = (double)size / (double)(bench_now_ns() - start);
+        best = rate > best ? rate : best;
+        *line_count = count + (length_sum == 0);
+    }
+    serial_lines_destroy(lines);
+    return best;
+}
+
+int main(void) {
+    static const unsigned MEAN_LENGTHS[] = {16, 100, 4096};
+    char *capture = malloc(CAPTURE_SIZE);
+    if (!capture) {
+        fprintf(stderr, "Out of memory\n");
+        return EXIT_FAILURE;
+    }
+
+    printf("Splitting a %u MiB capture at '\\n', GB/s, best of %d:\n", CAPTURE_SIZE >> 20, PASSES);
+    printf("  %-14s %8s %8s %8s %8s %10s\n", "record length", "scalar", "SSE2", "AVX2", "memchr", "streaming");
+    for (size_t i = 0; i < sizeof(MEAN_LENGTHS) / sizeof(MEAN_LENGTHS[0]); i++) {
+        fill_capture(capture, CAPTURE_SIZE, MEAN_LENGTHS[i]);
+
+        double rates[SERIAL_SCAN_AVX2 + 1] = {0};
+        size_t expected = 0, lines = 0;
+        split_in_place(capture, CAPTURE_SIZE, 1, &expected);
+        for (int scan = SERIAL_SCAN_SCALAR; scan <= SERIAL_SCAN_AVX2; scan++) {
+            if (serial_find_byte_select(scan) == scan) {
+                rates[scan] = split_in_place(capture, CAPTURE_SIZE, 0, &lines);
+                if (lines != expected) {
+                    fprintf(stderr, "Line count mismatch: %zu instead of %zu\n", lines, expected);
+                    return EXIT_FAILURE;
+                }
+            }
+        }
+        serial_find_byte_select(SERIAL_SCAN_AUTO);
+        double reference = split_in_place(capture, CAPTURE_SIZE, 1, &lines);
+        double streaming = split_streaming(capture, CAPTURE_SIZE, &lines);
+        if (lines != expected) {
+            fprintf(stderr, "Streaming line count mismatch: %zu instead of %zu\n", lines, expected);
+            return EXIT_FAILURE;
+        }
+
+        printf("  ~%-5u bytes   %8.2f %8.2f %8.2f %8.2f %10.2f\n", MEAN_LENGTHS[i], rates[SERIAL_SCAN_SCALAR],
+               rates[SERIAL_SCAN_SSE2], rates[SERIAL_SCAN_AVX2], reference, streaming);
+    }
+
+    free(capture);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,161 @@
+/**
+ * @file bench_mux.c
+ * @brief Load test of the link multiplexer with many clients and an emulated device
+ *
+ * For each client count a fresh multiplexer serves the emulated device from
+ * its own thread. A load
+ * thread drives every client from one reactor: each client is a
+ * serial_client with one command in flight that submits the next command
+ * from its completion callback, alternating LED_SET with the GET_STATE a
+ * dashboard would poll. The report shows throughput, latency across all
+ * clients, how evenly the link was shared (fewest versus most commands
+ * completed by one client), and how many client commands each link write
+ * and each link command carried.
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bench_common.h"
+#include "../include/serial_client.h"
+#include "../include/serial_emulator.h"
+#include "../include/serial_mux.h"
+#include "../include/serial_reactor.h"
+#include "../include/serial_stats.h"
+
+#define RUN_NS 1000000000ull
+#define MAX_CLIENTS 256
+
+struct load_client_s {
+    serial_handle_t handle;
+    serial_client_t *client;
+    uint64_t completed;
+    uint64_t failed;
+    unsigned next;
+    struct serial_histogram_s *latency;
+};
+
+static int submit_next(struct load_client_s *load);
+
+static void on_complete(serial_client_t *client, int status, const struct serial_frame_s *reply,
+                        uint64_t latency_ns, void *user_data) {
+    struct load_client_s *load = user_data;
+    (void)client;
+    if (status == SERIAL_SUCCESS && reply->cmd == SERIAL_CMD_ACK) {
+        load->completed++;
+        serial_histogram_record(load->latency, latency_ns);
+    } else {
+        load->failed++;
+    }
+    submit_next(load);
+}
+
+static int submit_next(struct load_client_s *load) {
+    uint8_t mask = (uint8_t)(1u << (load->next % 3));
+    int get = load->next++ % 2;
+    return serial_client_submit(load->client, get ? SERIAL_CMD_GET_STATE : SERIAL_CMD_LED_SET, &mask, get ? 0 : 1,
+                                on_complete, load);
+}
+
+static void on_readable(serial_reactor_t *reactor, serial_handle_t handle, void *user_data) {
+    struct load_client_s *load = user_data;
+    if (serial_client_poll(load->client, 0) < 0) {
+        serial_reactor_remove(reactor, handle);
+    }
+}
+
+static void *mux_main(void *arg) {
+    serial_mux_run(arg);
+    return NULL;
+}
+
+/* Drives count clients for RUN_NS; returns the number of commands completed, 0 on failure */
+static uint64_t run_clients(const char *path, unsigned count, struct serial_histogram_s *latency) {
+    static struct load_client_s loads[MAX_CLIENTS];
+    static const struct serial_reactor_ops_s OPS = { .on_readable = on_readable };
+    struct serial_client_config_s config = { .window = 1, .timeout_ms = 2000 };
+    serial_reactor_t *reactor = serial_reactor_create();
+
+    int ok = reactor != NULL;
+    for (unsigned i = 0; ok && i < count; i++) {
+        loads[i] = (struct load_client_s){ .handle = serial_mux_connect(path), .next = i, .latency = latency };
+        loads[i].client = serial_client_create(loads[i].handle, &config);
+        ok = loads[i].client && serial_reactor_add(reactor, loads[i].handle, SERIAL_REACTOR_READ, &OPS,
+                                                   &loads[i]) == SERIAL_SUCCESS;
+    }
+    uint64_t start = bench_now_ns();
+    for (unsigned i = 0; ok && i < count; i++) {
+        ok = submit_next(&loads[i]) == SERIAL_SUCCESS;
+    }
+    while (ok && bench_now_ns() - start < RUN_NS) {
+        ok = serial_reactor_run_once(reactor, 100) >= 0;
+    }
+    double elapsed = (double)(bench_now_ns() - start);
+
+    uint64_t total = 0, failed = 0, fewest = UINT64_MAX, most = 0;
+    for (unsigned i = 0; i < count; i++) {
+        total += loads[i].completed;
+        failed += loads[i].failed;
+        fewest = loads[i].completed < fewest ? loads[i].completed : fewest;
+        most = loads[i].completed > most ? loads[i].completed : most;
+        serial_client_destroy(loads[i].client);
+        serial_close(loads[i].handle);
+    }
+    serial_reactor_destroy(reactor);
+    if (!ok) {
+        return 0;
+    }
+    printf("  %3u clients: %7.0f cmds/s, p50 %6.3f ms, p99 %6.3f ms, per client %llu-%llu, %llu failed",
+           count, (double)total * 1e9 / elapsed, (double)serial_histogram_quantile(latency, 0.5) / 1e6,
+           (double)serial_histogram_quantile(latency, 0.99) / 1e6, (unsigned long long)fewest,
+           (unsigned long long)most, (unsigned long long)failed);
+    return total;
+}
+
+static int run_load(const char *path, unsigned count) {
+    static struct serial_histogram_s latency;
+    serial_emulator_t *emulator = serial_emulator_create(NULL);
+    serial_handle_t device = emulator ? serial_open(serial_emulator_path(emulator), NULL) : SERIAL_INVALID_HANDLE;
+    serial_mux_t *mux = device != SERIAL_INVALID_HANDLE ? serial_mux_create(device, path, NULL) : NULL;
+    pthread_t thread;
+    if (!mux || pthread_create(&thread, NULL, mux_main, mux) != 0) {
+        serial_mux_destroy(mux);
+        serial_close(device);
+        serial_emulator_destroy(emulator);
+        return -1;
+    }
+
+    memset(&latency, 0, sizeof(latency));
+    uint64_t completed = run_clients(path, count, &latency);
+    serial_mux_stop(mux);
+    pthread_join(thread, NULL);
+
+    /* Counters are read once the multiplexer thread has returned */
+    struct serial_mux_stats_s stats;
+    serial_mux_get_stats(mux, &stats);
+    if (completed > 0) {
+        printf(", %.2f cmds/link cmd, %.2f link cmds/write\n",
+               stats.link_commands ? (double)stats.commands / (double)stats.link_commands : 0.0,
+               stats.link_writes ? (double)stats.link_commands / (double)stats.link_writes : 0.0);
+    }
+    serial_mux_destroy(mux);
+    serial_close(device);
+    serial_emulator_destroy(emulator);
+    return completed > 0 ? 0 : -1;
+}
+
+int main(void) {
+    static const unsigned CLIENTS[] = {1, 16, 64, MAX_CLIENTS};
+    char path[64];
+    snprintf(path, sizeof(path), "/tmp/bench_mux_%d.sock", (int)getpid());
+
+    printf("Clients with one command in flight each, sharing an unpaced emulated device:\n");
+    for (size_t i = 0; i < sizeof(CLIENTS) / sizeof(CLIENTS[0]); i++) {
+        if (run_load(path, CLIENTS[i]) != 0) {
+            fprintf(stderr, "Benchmark failed\n");
+            return EXIT_FAILURE;
+        }
+    }
+    return EXIT_SUCCESS;
+}
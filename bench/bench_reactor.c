@@ -0,0 +1,153 @@
+/**
+ * @file bench_reactor.c
+ * @brief Aggregate command throughput of one reactor thread over many ptys
+ *
+ * Every port runs a stop-and-wait command loop against a pty echo device that
+ * answers each command byte with "OK\r\n". Both the host ports and the device
+ * ends are serviced by the same single-threaded reactor.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bench_common.h"
+#include "../include/serial_reactor.h"
+
+#define MAX_PORTS 256
+#define RUN_TIME_NS 500000000ull
+#define RESPONSE_TIMEOUT_MS 1000
+
+struct bench_port_s {
+    serial_handle_t host;
+    int device;
+    uint64_t completed;
+    uint64_t timeouts;
+};
+
+static int running;
+
+static void send_command(serial_reactor_t *reactor, struct bench_port_s *port) {
+    size_t written;
+    serial_write(port->host, "1", 1, &written);
+    serial_reactor_set_timer(reactor, port->host, RESPONSE_TIMEOUT_MS);
+}
+
+static void on_host_readable(serial_reactor_t *reactor, serial_handle_t handle, void *user_data) {
+    struct bench_port_s *port = user_data;
+    char buffer[256];
+    size_t count;
+
+    if (serial_read(handle, buffer, sizeof(buffer), &count) != SERIAL_SUCCESS) {
+        serial_reactor_remove(reactor, handle);
+        return;
+    }
+    for (size_t i = 0; i < count; i++) {
+        if (buffer[i] == '\n') {
+            port->completed++;
+            if (running) {
+                send_command(reactor, port);
+            } else {
+                serial_reactor_set_timer(reactor, handle, -1);
+            }
+        }
+    }
+}
+
+static void on_host_timeout(serial_reactor_t *reactor, serial_handle_t handle, void *user_data) {
+    struct bench_port_s *port = user_data;
+    (void)handle;
+    port->timeouts++;
+    if (running) {
+        send_command(reactor, port);
+    }
+}
+
+static void on_device_readable(serial_reactor_t *reactor, serial_handle_t handle, void *user_data) {
+    char commands[64];
+    char replies[sizeof(commands) * 4];
+    (void)user_data;
+
+    ssize_t count = read(handle, commands, sizeof(commands));
+    if (count <= 0) {
+        serial_reactor_remove(reactor, handle);
+        return;
+    }
+    for (ssize_t i = 0; i < count; i++) {
+        memcpy(replies + i * 4, "OK\r\n", 4);
+    }
+    if (write(handle, replies, (size_t)count * 4) < 0) {
+        serial_reactor_remove(reactor, handle);
+    }
+}
+
+static int run_bench(size_t port_count) {
+    static struct bench_port_s ports[MAX_PORTS];
+    static const struct serial_reactor_ops_s host_ops = {
+        .on_readable = on_host_readable,
+        .on_timeout = on_host_timeout,
+    };
+    static const struct serial_reactor_ops_s device_ops = {
+        .on_readable = on_device_readable,
+    };
+
+    serial_reactor_t *reactor = serial_reactor_create();
+    if (!reactor) {
+        return -1;
+    }
+
+    for (size_t i = 0; i < port_count; i++) {
+        char slave_path[64];
+        memset(&ports[i], 0, sizeof(ports[i]));
+        ports[i].device = bench_open_pty(slave_path, sizeof(slave_path));
+        ports[i].host = serial_open(slave_path, NULL);
+        if (ports[i].device < 0 || ports[i].host == SERIAL_INVALID_HANDLE) {
+            fprintf(stderr, "Failed to open pty pair %zu\n", i);
+            return -1;
+        }
+        serial_reactor_add(reactor, ports[i].host, SERIAL_REACTOR_READ, &host_ops, &ports[i]);
+        serial_reactor_add(reactor, ports[i].device, SERIAL_REACTOR_READ, &device_ops, NULL);
+    }
+
+    running = 1;
+    for (size_t i = 0; i < port_count; i++) {
+        send_command(reactor, &ports[i]);
+    }
+
+    uint64_t start = bench_now_ns();
+    while (bench_now_ns() - start < RUN_TIME_NS) {
+        serial_reactor_run_once(reactor, 10);
+    }
+    running = 0;
+    uint64_t elapsed = bench_now_ns() - start;
+
+    /* Drain replies still in flight */
+    for (int i = 0; i < 10; i++) {
+        serial_reactor_run_once(reactor, 1);
+    }
+
+    uint64_t completed = 0, timeouts = 0;
+    for (size_t i = 0; i < port_count; i++) {
+        completed += ports[i].completed;
+        timeouts += ports[i].timeouts;
+        serial_close(ports[i].host);
+        close(ports[i].device);
+    }
+    serial_reactor_destroy(reactor);
+
+    double rate = (double)completed * 1e9 / (double)elapsed;
+    printf("%5zu ports: %10.0f commands/s aggregate, %8.0f per port, %llu timeouts\n",
+           port_count, rate, rate / (double)port_count, (unsigned long long)timeouts);
+    return 0;
+}
+
+int main(void) {
+    static const size_t PORT_COUNTS[] = {1, 4, 16, 64, 256};
+
+    printf("Reactor throughput, one thread, stop-and-wait per port:\n");
+    for (size_t i = 0; i < sizeof(PORT_COUNTS) / sizeof(PORT_COUNTS[0]); i++) {
+        if (run_bench(PORT_COUNTS[i]) != 0) {
+            return EXIT_FAILURE;
+        }
+    }
+    return EXIT_SUCCESS;
+}
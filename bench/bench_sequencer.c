@@ -0,0 +1,135 @@
+/**
+ * @file bench_sequencer.c
+ * @brief Timing accuracy of a 500 frames/s LED animation: usleep() loop against the sequencer
+ *
+ * The animation is FRAMES LED_SET frames 2 ms apart, written to a pty whose
+ * device side is drained by a thread. The baseline is the obvious loop:
+ * write a frame, then usleep() for the period. Each of its waits starts
+ * after the write and ends a scheduler wake-up late, so the delays add up
+ * and the animation falls further behind with every frame. The sequencer
+ * waits for the absolute due time of each frame instead, with a timerfd,
+ * clock_nanosleep(TIMER_ABSTIME), and a timerfd with a 100 us spin before
+ * the deadline. For each, the lateness of the frames (achieved minus
+ * planned start of the write) is reported together with the drift of the
+ * last frame.
+ */
+
+#include <poll.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "bench_common.h"
+#include "../include/serial_frame.h"
+#include "../include/serial_sequencer.h"
+
+#define FRAMES 1000
+#define PERIOD_NS 2000000u          /* 500 frames/s */
+#define SPIN_NS 100000u
+
+struct drain_s {
+    int master;
+    atomic_int stop;
+};
+
+/* Reads the device side of the pty so writes never wait for buffer space */
+static void *drain_main(void *arg) {
+    struct drain_s *drain = arg;
+    char buffer[4096];
+    while (!atomic_load(&drain->stop)) {
+        struct pollfd pfd = { .fd = drain->master, .events = POLLIN };
+        if (poll(&pfd, 1, 10) > 0) {
+            while (read(drain->master, buffer, sizeof(buffer)) > 0) {
+            }
+        }
+    }
+    return NULL;
+}
+
+/* Writes each frame, then sleeps for the period; fills the report like the sequencer does */
+static int run_usleep(serial_handle_t port, const struct serial_sequence_step_s *steps,
+                      struct serial_sequencer_report_s *report) {
+    memset(report, 0, sizeof(*report));
+    uint64_t start = bench_now_ns();
+    for (size_t i = 0; i < FRAMES; i++) {
+        uint64_t now = bench_now_ns();
+        size_t written;
+        if (serial_write_all(port, steps[i].data, steps[i].length, 1000, &written) != SERIAL_SUCCESS) {
+            return SERIAL_ERROR_WRITE;
+        }
+        serial_histogram_record(&report->dispatch_lateness, now - start - steps[i].due_ns);
+        report->sent++;
+        if (i + 1 < FRAMES) {
+            usleep(PERIOD_NS / 1000);
+        }
+    }
+    report->elapsed_ns = bench_now_ns() - start;
+    return SERIAL_SUCCESS;
+}
+
+static void print_report(const char *name, const struct serial_sequencer_report_s *report) {
+    const struct serial_histogram_s *lateness = &report->dispatch_lateness;
+    printf("  %-26s p50 %7.1f us  p99 %7.1f us  max %8.1f us  last frame %+8.2f ms\n", name,
+           (double)serial_histogram_quantile(lateness, 0.5) / 1e3,
+           (double)serial_histogram_quantile(lateness, 0.99) / 1e3, (double)lateness->max_ns / 1e3,
+           ((double)report->elapsed_ns - (double)(FRAMES - 1) * PERIOD_NS) / 1e6);
+}
+
+int main(void) {
+    char slave_path[64];
+    int master = bench_open_pty(slave_path, sizeof(slave_path));
+    serial_handle_t port = master >= 0 ? serial_open(slave_path, NULL) : SERIAL_INVALID_HANDLE;
+    if (port == SERIAL_INVALID_HANDLE) {
+        fprintf(stderr, "Unable to open a pty\n");
+        return EXIT_FAILURE;
+    }
+
+    static uint8_t frames[FRAMES][16];
+    static struct serial_sequence_step_s steps[FRAMES];
+    for (size_t i = 0; i < FRAMES; i++) {
+        uint8_t mask = (uint8_t)(1u << (i % 3));
+        serial_frame_encode((uint8_t)i, SERIAL_CMD_LED_SET, &mask, 1, frames[i], sizeof(frames[i]),
+                            &steps[i].length);
+        steps[i].data = frames[i];
+        steps[i].due_ns = (uint64_t)i * PERIOD_NS;
+    }
+
+    struct drain_s drain = { .master = master };
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, drain_main, &drain) != 0) {
+        fprintf(stderr, "Unable to start the drain thread\n");
+        return EXIT_FAILURE;
+    }
+
+    static struct serial_sequencer_report_s report;
+    static const struct {
+        const char *name;
+        struct serial_sequencer_config_s config;
+    } MODES[] = {
+        {"timerfd", { .wait = SERIAL_SEQUENCER_TIMERFD }},
+        {"clock_nanosleep", { .wait = SERIAL_SEQUENCER_NANOSLEEP }},
+        {"timerfd + 100 us spin", { .wait = SERIAL_SEQUENCER_TIMERFD, .spin_ns = SPIN_NS }},
+    };
+    int failed = run_usleep(port, steps, &report) != SERIAL_SUCCESS;
+    printf("%d LED_SET frames at 500 frames/s over a pty, lateness of each write:\n", FRAMES);
+    if (!failed) {
+        print_report("usleep() after each write", &report);
+    }
+    for (size_t m = 0; m < sizeof(MODES) / sizeof(MODES[0]) && !failed; m++) {
+        failed = serial_sequencer_run(port, steps, FRAMES, &MODES[m].config, &report) != SERIAL_SUCCESS ||
+                 report.sent != FRAMES;
+        if (!failed) {
+            print_report(MODES[m].name, &report);
+        }
+    }
+
+    atomic_store(&drain.stop, 1);
+    pthread_join(thread, NULL);
+    serial_close(port);
+    close(master);
+    if (failed) {
+        fprintf(stderr, "Benchmark failed\n");
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,575 @@
+/**
+ * @file bench_serial.c
+ * @brief Benchmark suite with JSON results and regression gating
+ *
+ * Measures, against the sketch emulator and plain pty loopback:
+ *   - round-trip latency percentiles for ASCII and framed commands, the
+ *     latter with both latency profiles of serial_open()
+ *   - host read/write system calls per command
+ *   - cost of serial_open() + serial_close()
+ *   - bulk bytes/sec through serial_write() and serial_read()
+ *   - sustained pipelined command rate at each baud rate, paced by the emulator
+ *   - framed round-trip latency while busy threads load every core, with
+ *     the host thread left alone and with serial_rt settings applied
+ *
+ * Usage: bench_serial [--output FILE] [--baseline FILE] [--threshold PERCENT] [--device PATH]
+ *
+ * With --baseline every metric is compared against the stored value and the
+ * program exits with status 1 if any metric is worse by more than the
+ * threshold (default 50%). p999 latencies from a few thousand samples are
+ * dominated by scheduler noise, so they are reported but do not fail a run.
+ * Latencies under load depend on the machine's scheduler more than on this
+ * code and never fail a run either.
+ *
+ * A pty has no adapter latency timer, so the two profiles measure about the
+ * same against the emulator. --device adds framed round trips against the
+ * sketch on real hardware (at 9600 baud), where the low-latency profile
+ * removes up to 16 ms per reply on FTDI adapters.
+ */
+
+#include <poll.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include "bench_common.h"
+#include "../include/serial_client.h"
+#include "../include/serial_emulator.h"
+#include "../include/serial_rt.h"
+
+#define RTT_SAMPLES 5000
+#define OPEN_SAMPLES 1000
+#define LATENCY_ROUNDS 3
+#define BULK_BYTES (32u * 1024u * 1024u)
+#define BAUD_RUN_NS 300000000ull
+#define BAUD_WINDOW 16
+#define REPLY_TIMEOUT_MS 1000
+#define DEFAULT_THRESHOLD_PERCENT 50.0
+#define MAX_METRICS 64
+#define DEVICE_BAUD 9600
+#define DEVICE_SAMPLES 200
+#define DEVICE_RESET_US 2000000     /* opening the port resets the Arduino */
+#define HOGS_PER_CPU 2
+#define MAX_HOGS 64
+#define HOST_RT_PRIORITY 50
+#define DEVICE_RT_PRIORITY 60
+
+static const uint32_t BAUD_RATES[] = {9600, 19200, 38400, 57600, 115200, 230400, 460800, 921600};
+
+struct metric_s {
+    char name[48];
+    double value;
+    int higher_is_better;
+    int gated;              /* 0: compared against the baseline but never fails the run */
+};
+
+static struct metric_s metrics[MAX_METRICS];
+static size_t metric_count;
+
+static void add_metric_gated(const char *name, double value, int higher_is_better, int gated) {
+    if (metric_count < MAX_METRICS) {
+        struct metric_s *metric = &metrics[metric_count++];
+        snprintf(metric->name, sizeof(metric->name), "%s", name);
+        metric->value = value;
+        metric->higher_is_better = higher_is_better;
+        metric->gated = gated;
+        printf("  %-38s %14.2f\n", name, value);
+    }
+}
+
+static void add_metric(const char *name, double value, int higher_is_better) {
+    add_metric_gated(name, value, higher_is_better, 1);
+}
+
+static int compare_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+/*
+ * Latency measurement: fills count samples (nanoseconds) and optionally
+ * reports host read/write system calls per sample (negative if unknown).
+ */
+typedef int (*latency_fn_t)(void *context, uint64_t *samples, size_t count, double *syscalls);
+
+/*
+ * Runs a latency measurement LATENCY_ROUNDS times and records the best
+ * p50/p99/p999 across rounds in microseconds. Taking the best round keeps a
+ * single preemption on a shared machine from failing the regression gate.
+ * With gated 0 none of the metrics can fail the run.
+ */
+static int add_latency(const char *prefix, latency_fn_t measure, void *context, size_t count, int gated) {
+    static const struct { const char *suffix; double quantile; int gated; } QUANTILES[] = {
+        {"p50_us", 0.50, 1}, {"p99_us", 0.99, 1}, {"p999_us", 0.999, 0}
+    };
+    static uint64_t samples[RTT_SAMPLES];
+    double best[sizeof(QUANTILES) / sizeof(QUANTILES[0])];
+    double syscalls = -1.0;
+
+    for (int round = 0; round < LATENCY_ROUNDS; round++) {
+        if (measure(context, samples, count, &syscalls) != 0) {
+            return -1;
+        }
+        qsort(samples, count, sizeof(samples[0]), compare_u64);
+        for (size_t i = 0; i < sizeof(QUANTILES) / sizeof(QUANTILES[0]); i++) {
+            double value = (double)samples[(size_t)(QUANTILES[i].quantile * (double)(count - 1))] / 1e3;
+            best[i] = round == 0 || value < best[i] ? value : best[i];
+        }
+    }
+
+    char name[48];
+    for (size_t i = 0; i < sizeof(QUANTILES) / sizeof(QUANTILES[0]); i++) {
+        snprintf(name, sizeof(name), "%s_%s", prefix, QUANTILES[i].suffix);
+        add_metric_gated(name, best[i], 0, gated && QUANTILES[i].gated);
+    }
+    if (syscalls >= 0.0) {
+        snprintf(name, sizeof(name), "%s_rw_syscalls_per_cmd", prefix);
+        add_metric_gated(name, syscalls, 0, gated);
+    }
+    return 0;
+}
+
+static int measure_ascii_rtt(void *context, uint64_t *samples, size_t count, double *syscalls) {
+    serial_handle_t port = *(serial_handle_t *)context;
+    uint64_t reads_before = 0, writes_before = 0, reads_after = 0, writes_after = 0;
+    int counted = bench_thread_syscall_counts(&reads_before, &writes_before) == 0;
+
+    for (size_t i = 0; i < count; i++) {
+        char reply[64];
+        size_t length;
+        uint64_t start = bench_now_ns();
+        if (serial_write_all(port, "1", 1, REPLY_TIMEOUT_MS, &length) != SERIAL_SUCCESS ||
+            serial_read_until(port, reply, sizeof(reply), "\r\n", serial_monotonic_ms() + REPLY_TIMEOUT_MS,
+                              &length) != SERIAL_SUCCESS) {
+            return -1;
+        }
+        samples[i] = bench_now_ns() - start;
+    }
+
+    if (counted && bench_thread_syscall_counts(&reads_after, &writes_after) == 0) {
+        *syscalls = (double)(reads_after - reads_before + writes_after - writes_before) / (double)count;
+    }
+    return 0;
+}
+
+static void on_frame_reply(serial_client_t *client, int status, const struct serial_frame_s *reply,
+                           uint64_t latency_ns, void *user_data) {
+    (void)client;
+    (void)reply;
+    *(uint64_t *)user_data = status == SERIAL_SUCCESS ? latency_ns : 0;
+}
+
+static int measure_frame_rtt(void *context, uint64_t *samples, size_t count, double *syscalls) {
+    struct serial_client_config_s config = { .window = 1, .timeout_ms = REPLY_TIMEOUT_MS };
+    serial_client_t *client = serial_client_create(*(serial_handle_t *)context, &config);
+    if (!client) {
+        return -1;
+    }
+
+    uint64_t reads_before = 0, writes_before = 0, reads_after = 0, writes_after = 0;
+    int counted = bench_thread_syscall_counts(&reads_before, &writes_before) == 0;
+    uint8_t mask = SERIAL_LED_RED;
+    for (size_t i = 0; i < count; i++) {
+        if (serial_client_submit(client, SERIAL_CMD_LED_SET, &mask, 1, on_frame_reply, &samples[i]) != SERIAL_SUCCESS ||
+            serial_client_drain(client) != SERIAL_SUCCESS || samples[i] == 0) {
+            serial_client_destroy(client);
+            return -1;
+        }
+    }
+    if (counted && bench_thread_syscall_counts(&reads_after, &writes_after) == 0) {
+        *syscalls = (double)(reads_after - reads_before + writes_after - writes_before) / (double)count;
+    }
+    serial_client_destroy(client);
+    return 0;
+}
+
+static int measure_open(void *context, uint64_t *samples, size_t count, double *syscalls) {
+    const char *path = context;
+    (void)syscalls;
+    for (size_t i = 0; i < count; i++) {
+        uint64_t start = bench_now_ns();
+        serial_handle_t port = serial_open(path, NULL);
+        if (port == SERIAL_INVALID_HANDLE) {
+            return -1;
+        }
+        serial_close(port);
+        samples[i] = bench_now_ns() - start;
+    }
+    return 0;
+}
+
+/* Device side of the bulk tests: drains or produces BULK_BYTES on the pty master */
+struct bulk_peer_s {
+    int fd;
+    int produce;
+};
+
+static void *bulk_peer_main(void *arg) {
+    struct bulk_peer_s *peer = arg;
+    static char buffer[65536];
+    size_t done = 0;
+    memset(buffer, 'x', sizeof(buffer));
+    while (done < BULK_BYTES) {
+        struct pollfd pfd = { .fd = peer->fd, .events = peer->produce ? POLLOUT : POLLIN };
+        poll(&pfd, 1, 100);
+        size_t chunk = BULK_BYTES - done < sizeof(buffer) ? BULK_BYTES - done : sizeof(buffer);
+        ssize_t count = peer->produce ? write(peer->fd, buffer, chunk) : read(peer->fd, buffer, chunk);
+        if (count > 0) {
+            done += (size_t)count;
+        }
+    }
+    return NULL;
+}
+
+static int bench_bulk(int host_writes) {
+    char slave_path[64];
+    struct bulk_peer_s peer = { .produce = !host_writes };
+    peer.fd = bench_open_pty(slave_path, sizeof(slave_path));
+    serial_handle_t port = peer.fd >= 0 ? serial_open(slave_path, NULL) : SERIAL_INVALID_HANDLE;
+    if (port == SERIAL_INVALID_HANDLE) {
+        return -1;
+    }
+    pthread_t thread;
+    pthread_create(&thread, NULL, bulk_peer_main, &peer);
+
+    static char buffer[65536];
+    size_t done = 0;
+    int result = SERIAL_SUCCESS;
+    uint64_t start = bench_now_ns();
+    while (done < BULK_BYTES && result == SERIAL_SUCCESS) {
+        size_t chunk = BULK_BYTES - done < sizeof(buffer) ? BULK_BYTES - done : sizeof(buffer);
+        size_t count = 0;
+        if (host_writes) {
+            result = serial_write_all(port, buffer, chunk, REPLY_TIMEOUT_MS, &count);
+        } else {
+            result = serial_wait_readable(port, REPLY_TIMEOUT_MS);
+            if (result == SERIAL_SUCCESS) {
+                result = serial_read(port, buffer, chunk, &count);
+            }
+        }
+        done += count;
+    }
+    double elapsed = (double)(bench_now_ns() - start);
+    pthread_join(thread, NULL);
+    serial_close(port);
+    close(peer.fd);
+
+    if (result != SERIAL_SUCCESS) {
+        return -1;
+    }
+    add_metric(host_writes ? "serial_write_mb_per_s" : "serial_read_mb_per_s",
+               (double)BULK_BYTES / (1024.0 * 1024.0) * 1e9 / elapsed, 1);
+    return 0;
+}
+
+static void on_paced_reply(serial_client_t *client, int status, const struct serial_frame_s *reply,
+                           uint64_t latency_ns, void *user_data) {
+    (void)client;
+    (void)reply;
+    (void)latency_ns;
+    if (status == SERIAL_SUCCESS) {
+        (*(uint64_t *)user_data)++;
+    }
+}
+
+static int bench_baud(uint32_t baud_rate) {
+    struct serial_emulator_config_s device = { .baud_rate = baud_rate };
+    struct serial_config_s config = { .baud_rate = baud_rate, .data_bits = 8, .stop_bits = 1, .parity = 0 };
+    struct serial_client_config_s client_config = { .window = BAUD_WINDOW, .timeout_ms = REPLY_TIMEOUT_MS };
+    serial_emulator_t *emulator = serial_emulator_create(&device);
+    serial_handle_t port = emulator ? serial_open(serial_emulator_path(emulator), &config) : SERIAL_INVALID_HANDLE;
+    serial_client_t *client = serial_client_create(port, &client_config);
+    int result = client ? SERIAL_SUCCESS : SERIAL_ERROR_OPEN;
+
+    uint64_t completed = 0;
+    uint8_t mask = SERIAL_LED_RED;
+    uint64_t start = bench_now_ns();
+    while (result == SERIAL_SUCCESS && bench_now_ns() - start < BAUD_RUN_NS) {
+        result = serial_client_submit(client, SERIAL_CMD_LED_SET, &mask, 1, on_paced_reply, &completed);
+    }
+    if (result == SERIAL_SUCCESS) {
+        result = serial_client_drain(client);
+    }
+    double elapsed = (double)(bench_now_ns() - start);
+
+    serial_client_destroy(client);
+    if (port != SERIAL_INVALID_HANDLE) {
+        serial_close(port);
+    }
+    serial_emulator_destroy(emulator);
+    if (result != SERIAL_SUCCESS) {
+        return -1;
+    }
+
+    char name[48];
+    snprintf(name, sizeof(name), "cmds_per_s_at_%u", (unsigned)baud_rate);
+    add_metric(name, (double)completed * 1e9 / elapsed, 1);
+    return 0;
+}
+
+/* Busy threads at normal priority, enough to keep every core loaded */
+struct hogs_s {
+    pthread_t threads[MAX_HOGS];
+    int count;
+    atomic_int stop;
+};
+
+static void *hog_main(void *arg) {
+    atomic_int *stop = arg;
+    volatile uint64_t spins = 0;
+    while (!atomic_load_explicit(stop, memory_order_relaxed)) {
+        spins++;
+    }
+    return NULL;
+}
+
+static void start_hogs(struct hogs_s *hogs) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    int wanted = (int)(cpus > 0 ? cpus : 1) * HOGS_PER_CPU;
+    atomic_init(&hogs->stop, 0);
+    for (hogs->count = 0; hogs->count < wanted && hogs->count < MAX_HOGS; hogs->count++) {
+        if (pthread_create(&hogs->threads[hogs->count], NULL, hog_main, &hogs->stop) != 0) {
+            break;
+        }
+    }
+}
+
+static void stop_hogs(struct hogs_s *hogs) {
+    atomic_store(&hogs->stop, 1);
+    for (int i = 0; i < hogs->count; i++) {
+        pthread_join(hogs->threads[i], NULL);
+    }
+}
+
+/* Framed round trips from a thread of their own, optionally with real-time settings */
+struct loaded_rtt_s {
+    serial_handle_t port;
+    const struct serial_rt_config_s *rt;
+    unsigned applied;
+    uint64_t *samples;
+    size_t count;
+    int result;
+};
+
+static void *loaded_rtt_main(void *arg) {
+    struct loaded_rtt_s *loaded = arg;
+    double syscalls;
+    if (loaded->rt) {
+        serial_rt_apply(loaded->rt, &loaded->applied);
+    }
+    loaded->result = measure_frame_rtt(&loaded->port, loaded->samples, loaded->count, &syscalls);
+    return NULL;
+}
+
+static int measure_loaded_rtt(void *context, uint64_t *samples, size_t count, double *syscalls) {
+    struct loaded_rtt_s *loaded = context;
+    pthread_t thread;
+    (void)syscalls;
+    loaded->samples = samples;
+    loaded->count = count;
+    loaded->result = -1;
+    if (pthread_create(&thread, NULL, loaded_rtt_main, loaded) != 0) {
+        return -1;
+    }
+    pthread_join(thread, NULL);
+    return loaded->result;
+}
+
+/*
+ * Framed round trips while hog threads load every core. The emulator thread
+ * runs at SCHED_FIFO (where permitted) in both runs, since a real device
+ * does not slow down with the host; only the host thread differs.
+ */
+static int bench_loaded(void) {
+    struct serial_rt_config_s device_rt = { .cpu = -1, .priority = DEVICE_RT_PRIORITY };
+    struct serial_rt_config_s host_rt = { .cpu = 0, .priority = HOST_RT_PRIORITY, .lock_memory = 1 };
+    struct serial_emulator_config_s device = { .rt = &device_rt };
+    serial_emulator_t *emulator = serial_emulator_create(&device);
+    serial_handle_t port = emulator ? serial_open(serial_emulator_path(emulator), NULL) : SERIAL_INVALID_HANDLE;
+    if (port == SERIAL_INVALID_HANDLE) {
+        serial_emulator_destroy(emulator);
+        return -1;
+    }
+
+    struct hogs_s hogs;
+    start_hogs(&hogs);
+    struct loaded_rtt_s plain = { .port = port };
+    struct loaded_rtt_s rt = { .port = port, .rt = &host_rt };
+    int result = add_latency("rtt_frame_loaded", measure_loaded_rtt, &plain, RTT_SAMPLES, 0) != 0 ||
+                 add_latency("rtt_frame_loaded_rt", measure_loaded_rtt, &rt, RTT_SAMPLES, 0) != 0 ? -1 : 0;
+    stop_hogs(&hogs);
+    if (rt.applied & SERIAL_RT_LOCKED) {
+        munlockall();
+    }
+    printf("  (%d busy threads; host thread pinned: %s, SCHED_FIFO: %s, memory locked: %s)\n", hogs.count,
+           (rt.applied & SERIAL_RT_PINNED) ? "yes" : "no", (rt.applied & SERIAL_RT_FIFO) ? "yes" : "no",
+           (rt.applied & SERIAL_RT_LOCKED) ? "yes" : "no");
+
+    serial_close(port);
+    serial_emulator_destroy(emulator);
+    return result;
+}
+
+/* Framed round trips on a real device with each latency profile */
+static int bench_device(const char *path) {
+    static const struct { const char *prefix; uint8_t mode; } PROFILES[] = {
+        {"device_rtt_frame", SERIAL_LATENCY_THROUGHPUT}, {"device_rtt_frame_lowlat", SERIAL_LATENCY_LOW}
+    };
+    for (size_t i = 0; i < sizeof(PROFILES) / sizeof(PROFILES[0]); i++) {
+        struct serial_config_s config = {
+            .baud_rate = DEVICE_BAUD, .data_bits = 8, .stop_bits = 1, .parity = 0,
+            .latency_mode = PROFILES[i].mode
+        };
+        serial_handle_t port = serial_open(path, &config);
+        if (port == SERIAL_INVALID_HANDLE) {
+            fprintf(stderr, "Cannot open %s\n", path);
+            return -1;
+        }
+        usleep(DEVICE_RESET_US);
+        tcflush(port, TCIFLUSH);
+        int result = add_latency(PROFILES[i].prefix, measure_frame_rtt, &port, DEVICE_SAMPLES, 1);
+        serial_close(port);
+        if (result != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static int write_json(const char *path) {
+    FILE *file = fopen(path, "w");
+    if (!file) {
+        return -1;
+    }
+    fprintf(file, "{\n  \"metrics\": {\n");
+    for (size_t i = 0; i < metric_count; i++) {
+        fprintf(file, "    \"%s\": %.3f%s\n", metrics[i].name, metrics[i].value, i + 1 < metric_count ? "," : "");
+    }
+    fprintf(file, "  }\n}\n");
+    return fclose(file) == 0 ? 0 : -1;
+}
+
+/* Finds "name": value in a file written by write_json() */
+static int find_baseline(const char *json, const char *name, double *value) {
+    char key[64];
+    snprintf(key, sizeof(key), "\"%s\":", name);
+    const char *hit = strstr(json, key);
+    if (!hit) {
+        return -1;
+    }
+    *value = strtod(hit + strlen(key), NULL);
+    return 0;
+}
+
+/* Returns the number of metrics that regressed past threshold_percent */
+static int compare_baseline(const char *path, double threshold_percent) {
+    FILE *file = fopen(path, "r");
+    if (!file) {
+        fprintf(stderr, "Cannot read baseline %s\n", path);
+        return -1;
+    }
+    static char json[16384];
+    size_t length = fread(json, 1, sizeof(json) - 1, file);
+    json[length] = '\0';
+    fclose(file);
+
+    int regressions = 0;
+    printf("\nAgainst baseline %s (threshold %.0f%%):\n", path, threshold_percent);
+    for (size_t i = 0; i < metric_count; i++) {
+        double baseline;
+        if (find_baseline(json, metrics[i].name, &baseline) != 0 || baseline <= 0.0) {
+            printf("  %-38s   no baseline\n", metrics[i].name);
+            continue;
+        }
+        double change = (metrics[i].value - baseline) / baseline * 100.0;
+        double worse = metrics[i].higher_is_better ? -change : change;
+        int regressed = metrics[i].gated && worse > threshold_percent;
+        regressions += regressed;
+        printf("  %-38s %+7.1f%% %s\n", metrics[i].name, change,
+               regressed ? "REGRESSED" : (metrics[i].gated ? "ok" : "info"));
+    }
+    return regressions;
+}
+
+int main(int argc, char *argv[]) {
+    const char *output = NULL;
+    const char *baseline = NULL;
+    const char *device = NULL;
+    double threshold = DEFAULT_THRESHOLD_PERCENT;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--output") == 0 && i + 1 < argc) {
+            output = argv[++i];
+        } else if (strcmp(argv[i], "--baseline") == 0 && i + 1 < argc) {
+            baseline = argv[++i];
+        } else if (strcmp(argv[i], "--threshold") == 0 && i + 1 < argc) {
+            threshold = strtod(argv[++i], NULL);
+        } else if (strcmp(argv[i], "--device") == 0 && i + 1 < argc) {
+            device = argv[++i];
+        } else {
+            fprintf(stderr, "Usage: %s [--output FILE] [--baseline FILE] [--threshold PERCENT] [--device PATH]\n",
+                    argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    serial_emulator_t *emulator = serial_emulator_create(NULL);
+    serial_handle_t port = emulator ? serial_open(serial_emulator_path(emulator), NULL) : SERIAL_INVALID_HANDLE;
+    if (port == SERIAL_INVALID_HANDLE) {
+        fprintf(stderr, "Cannot start the emulator\n");
+        return EXIT_FAILURE;
+    }
+    printf("Latency against the unpaced emulator (best of %d rounds):\n", LATENCY_ROUNDS);
+    int failed = add_latency("rtt_ascii", measure_ascii_rtt, &port, RTT_SAMPLES, 1) != 0 ||
+                 add_latency("rtt_frame", measure_frame_rtt, &port, RTT_SAMPLES, 1) != 0;
+    serial_close(port);
+    struct serial_config_s low_latency = {
+        .baud_rate = 9600, .data_bits = 8, .stop_bits = 1, .parity = 0, .latency_mode = SERIAL_LATENCY_LOW
+    };
+    port = serial_open(serial_emulator_path(emulator), &low_latency);
+    failed = failed || port == SERIAL_INVALID_HANDLE ||
+             add_latency("rtt_frame_lowlat", measure_frame_rtt, &port, RTT_SAMPLES, 1) != 0;
+    if (port != SERIAL_INVALID_HANDLE) {
+        serial_close(port);
+    }
+    printf("Open/configure cost:\n");
+    failed = failed || add_latency("open_close", measure_open, (void *)serial_emulator_path(emulator),
+                                   OPEN_SAMPLES, 1) != 0;
+    serial_emulator_destroy(emulator);
+
+    printf("Bulk transfer over pty loopback:\n");
+    failed = failed || bench_bulk(1) != 0 || bench_bulk(0) != 0;
+
+    printf("Pipelined commands (window %d) against the paced emulator:\n", BAUD_WINDOW);
+    for (size_t i = 0; !failed && i < sizeof(BAUD_RATES) / sizeof(BAUD_RATES[0]); i++) {
+        failed = bench_baud(BAUD_RATES[i]) != 0;
+    }
+    if (!failed) {
+        printf("Latency with every core loaded (best of %d rounds):\n", LATENCY_ROUNDS);
+        failed = bench_loaded() != 0;
+    }
+    if (!failed && device) {
+        printf("Framed commands against %s at %d baud (best of %d rounds):\n", device, DEVICE_BAUD, LATENCY_ROUNDS);
+        failed = bench_device(device) != 0;
+    }
+    if (failed) {
+        fprintf(stderr, "Benchmark failed\n");
+        return EXIT_FAILURE;
+    }
+
+    if (output && write_json(output) != 0) {
+        fprintf(stderr, "Cannot write %s\n", output);
+        return EXIT_FAILURE;
+    }
+    if (baseline) {
+        int regressions = compare_baseline(baseline, threshold);
+        if (regressions != 0) {
+            fprintf(stderr, regressions > 0 ? "%d metric(s) regressed\n" : "Baseline comparison failed\n",
+                    regressions);
+            return EXIT_FAILURE;
+        }
+    }
+    return EXIT_SUCCESS;
+}
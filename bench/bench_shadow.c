@@ -0,0 +1,153 @@
+/**
+ * @file bench_shadow.c
+ * @brief Link traffic and run time of a status-panel workload with and without the state cache
+ *
+ * The workload models a program that drives the LEDs as a status panel from
+ * a polling loop, the way dashboards and control scripts tend to: it reads
+ * the state on most ticks, re-asserts the current status pattern with
+ * LED_SET whether or not it changed (it changes on about one tick in three),
+ * switches the blue attention LED on or off as its condition flips, and now
+ * and then re-sends the whole pattern as a BATCH. The same seeded command
+ * sequence runs once straight through serial_client and once through
+ * serial_shadow, over the emulated device paced to 115200 baud. The report
+ * shows the commands that reached the device, the bytes on the link in both
+ * directions, and the run time.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "bench_common.h"
+#include "../include/serial_emulator.h"
+#include "../include/serial_shadow.h"
+#include "../include/serial_stats.h"
+
+#define LINK_BAUD 115200u
+#define COMMANDS 2000
+#define WINDOW 4
+
+struct workload_s {
+    uint32_t random;
+    uint8_t pattern;            /* status shown on red and yellow */
+    uint8_t attention;          /* blue on or off */
+};
+
+struct totals_s {
+    uint64_t completed;
+    uint64_t failed;
+    struct serial_histogram_s latency;
+};
+
+static uint32_t next_random(struct workload_s *workload) {
+    workload->random ^= workload->random << 13;
+    workload->random ^= workload->random >> 17;
+    workload->random ^= workload->random << 5;
+    return workload->random;
+}
+
+/* Produces the next command of the status-panel loop; returns its payload length */
+static size_t next_command(struct workload_s *workload, uint8_t *cmd, uint8_t *payload) {
+    uint32_t roll = next_random(workload) % 100;
+    if (roll < 40) {
+        *cmd = SERIAL_CMD_GET_STATE;
+        return 0;
+    }
+    if (roll < 75) {
+        if (next_random(workload) % 3 == 0) {
+            workload->pattern = (uint8_t)(next_random(workload) % 4);
+        }
+        *cmd = SERIAL_CMD_LED_SET;
+        payload[0] = (uint8_t)(workload->pattern | workload->attention);
+        return 1;
+    }
+    if (roll < 92) {
+        if (next_random(workload) % 2 == 0) {
+            workload->attention ^= SERIAL_LED_BLUE;
+        }
+        *cmd = workload->attention ? SERIAL_CMD_LED_ON : SERIAL_CMD_LED_OFF;
+        payload[0] = SERIAL_LED_BLUE;
+        return 1;
+    }
+    *cmd = SERIAL_CMD_BATCH;
+    payload[0] = SERIAL_CMD_LED_ON;
+    payload[1] = workload->pattern;
+    payload[2] = SERIAL_CMD_LED_OFF;
+    payload[3] = (uint8_t)(SERIAL_LED_ALL & ~(workload->pattern | workload->attention));
+    return 4;
+}
+
+static void on_complete(serial_client_t *client, int status, const struct serial_frame_s *reply,
+                        uint64_t latency_ns, void *user_data) {
+    struct totals_s *totals = user_data;
+    (void)client;
+    if (status == SERIAL_SUCCESS && reply->cmd == SERIAL_CMD_ACK) {
+        totals->completed++;
+        serial_histogram_record(&totals->latency, latency_ns);
+    } else {
+        totals->failed++;
+    }
+}
+
+/* Runs the workload; returns the device counters through stats, -1 on failure */
+static int run_workload(int cached, struct serial_emulator_stats_s *stats) {
+    static struct totals_s totals;
+    struct serial_emulator_config_s device = { .baud_rate = LINK_BAUD };
+    struct serial_config_s link = { .baud_rate = LINK_BAUD, .data_bits = 8, .stop_bits = 1, .parity = 0 };
+    struct serial_client_config_s config = { .window = WINDOW, .timeout_ms = 1000 };
+    serial_emulator_t *emulator = serial_emulator_create(&device);
+    serial_handle_t port = emulator ? serial_open(serial_emulator_path(emulator), &link) : SERIAL_INVALID_HANDLE;
+    serial_client_t *client = serial_client_create(port, &config);
+    serial_shadow_t *shadow = cached ? serial_shadow_create(client, NULL) : NULL;
+    int ok = client && (!cached || shadow);
+
+    struct workload_s workload = { .random = 2463534242u };
+    memset(&totals, 0, sizeof(totals));
+    uint64_t start = bench_now_ns();
+    for (int i = 0; ok && i < COMMANDS; i++) {
+        uint8_t cmd, payload[4];
+        size_t length = next_command(&workload, &cmd, payload);
+        ok = (cached ? serial_shadow_submit(shadow, cmd, payload, length, on_complete, &totals)
+                     : serial_client_submit(client, cmd, payload, length, on_complete, &totals)) == SERIAL_SUCCESS;
+    }
+    ok = ok && serial_client_drain(client) == SERIAL_SUCCESS;
+    double elapsed = (double)(bench_now_ns() - start);
+
+    struct serial_shadow_stats_s cache = {0};
+    serial_shadow_get_stats(shadow, &cache);
+    serial_emulator_get_stats(emulator, stats);
+    if (ok) {
+        /* Completions from the cache report no latency; the percentiles cover every command */
+        printf("  %-13s %5llu of %d sent, %6llu link bytes, %6.0f ms, %7.0f cmds/s, p50 %.2f ms, p99 %.2f ms\n",
+               cached ? "with cache:" : "without cache:", (unsigned long long)stats->frames, COMMANDS,
+               (unsigned long long)(stats->rx_bytes + stats->tx_bytes), elapsed / 1e6,
+               (double)COMMANDS * 1e9 / elapsed, (double)serial_histogram_quantile(&totals.latency, 0.5) / 1e6,
+               (double)serial_histogram_quantile(&totals.latency, 0.99) / 1e6);
+        if (cached) {
+            printf("                 %llu elided, %llu answered locally, %llu mismatches\n",
+                   (unsigned long long)cache.elided, (unsigned long long)cache.local_queries,
+                   (unsigned long long)cache.mismatches);
+        }
+    }
+
+    serial_shadow_destroy(shadow);
+    serial_client_destroy(client);
+    if (port != SERIAL_INVALID_HANDLE) {
+        serial_close(port);
+    }
+    serial_emulator_destroy(emulator);
+    return ok && totals.failed == 0 ? 0 : -1;
+}
+
+int main(void) {
+    struct serial_emulator_stats_s direct, cached;
+    printf("Status-panel workload, %d commands, window %d, %u baud:\n", COMMANDS, WINDOW, LINK_BAUD);
+    if (run_workload(0, &direct) != 0 || run_workload(1, &cached) != 0) {
+        fprintf(stderr, "Benchmark failed\n");
+        return EXIT_FAILURE;
+    }
+    uint64_t direct_bytes = direct.rx_bytes + direct.tx_bytes;
+    uint64_t cached_bytes = cached.rx_bytes + cached.tx_bytes;
+    printf("  The cache saved %.1f%% of link commands and %.1f%% of link bytes\n",
+           direct.frames ? 100.0 * (double)(direct.frames - cached.frames) / (double)direct.frames : 0.0,
+           direct_bytes ? 100.0 * (double)(direct_bytes - cached_bytes) / (double)direct_bytes : 0.0);
+    return EXIT_SUCCESS;
+}
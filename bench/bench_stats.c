@@ -0,0 +1,82 @@
+/**
+ * @file bench_stats.c
+ * @brief Cost of per-handle statistics on a direct-mode pty round trip
+ *
+ * One byte goes out through serial_write(), the device side echoes it and
+ * serial_read() picks it up, all from one thread so the only difference
+ * between the runs is the counting. Rounds with stats off and on alternate
+ * and the best of each is kept, which filters scheduler noise out of a
+ * difference of a few nanoseconds.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "bench_common.h"
+#include "../include/serial_stats.h"
+
+#define ROUND_TRIPS 100000
+#define ROUNDS 5
+
+/* Returns the time per round trip in nanoseconds, or 0 on failure */
+static double run_round(serial_handle_t port, int master) {
+    uint8_t byte = 0x31;
+    size_t count;
+    uint64_t start = bench_now_ns();
+    for (int i = 0; i < ROUND_TRIPS; i++) {
+        uint8_t echo;
+        if (serial_write(port, &byte, 1, &count) != SERIAL_SUCCESS || count != 1) {
+            return 0;
+        }
+        while (read(master, &echo, 1) != 1) {
+        }
+        if (write(master, &echo, 1) != 1) {
+            return 0;
+        }
+        do {
+            if (serial_read(port, &echo, 1, &count) != SERIAL_SUCCESS) {
+                return 0;
+            }
+        } while (count == 0);
+    }
+    return (double)(bench_now_ns() - start) / ROUND_TRIPS;
+}
+
+int main(void) {
+    char slave_path[64];
+    int master = bench_open_pty(slave_path, sizeof(slave_path));
+    serial_handle_t port = master >= 0 ? serial_open(slave_path, NULL) : SERIAL_INVALID_HANDLE;
+    struct serial_stats_s *stats = calloc(1, sizeof(*stats));
+    if (port == SERIAL_INVALID_HANDLE || !stats) {
+        fprintf(stderr, "Unable to open a pty\n");
+        return EXIT_FAILURE;
+    }
+
+    double best_off = 0, best_on = 0;
+    for (int round = 0; round < ROUNDS; round++) {
+        serial_disable_stats(port);
+        double off = run_round(port, master);
+        serial_enable_stats(port);
+        double on = run_round(port, master);
+        if (off == 0 || on == 0) {
+            fprintf(stderr, "Benchmark failed\n");
+            return EXIT_FAILURE;
+        }
+        best_off = (round == 0 || off < best_off) ? off : best_off;
+        best_on = (round == 0 || on < best_on) ? on : best_on;
+    }
+    serial_get_stats(port, stats);
+
+    printf("Direct-mode 1-byte round trips over a pty, best of %d x %d:\n", ROUNDS, ROUND_TRIPS);
+    printf("  stats off: %8.1f ns/round trip\n", best_off);
+    printf("  stats on:  %8.1f ns/round trip (%+.1f%%)\n", best_on, (best_on - best_off) * 100.0 / best_off);
+    printf("  last round: %llu reads (%llu EAGAIN), %llu writes, first byte p50 %.1f us, p99 %.1f us\n",
+           (unsigned long long)stats->read_syscalls, (unsigned long long)stats->read_eagain,
+           (unsigned long long)stats->write_syscalls,
+           serial_histogram_quantile(&stats->first_byte_latency, 0.5) / 1e3,
+           serial_histogram_quantile(&stats->first_byte_latency, 0.99) / 1e3);
+
+    free(stats);
+    serial_close(port);
+    close(master);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,275 @@
+/**
+ * @file bench_telemetry.c
+ * @brief Sample ingestion throughput from 1 to 64 ports against the 2 Mbaud line rate
+ *
+ * Each port is a pty. A feeder thread writes SAMPLES frames of 8 channels to
+ * every pty master as fast as the ptys take them, so the rate reached is
+ * set by the host side. Two hosts drain the ports until every sample has
+ * been decoded:
+ *
+ * - loop: one thread polls the ports, reads each into a 256-byte stack
+ *   buffer, decodes the frames and prints one CSV line per sample to a
+ *   stdio file, the obvious extension of the command loop;
+ * - pipeline: serial_telemetry with one columnar log per port, synced every
+ *   100 ms.
+ *
+ * Throughput is shown in samples per second and as the number of ports
+ * running flat out at 2 Mbaud (200000 bytes/s with 8N1 framing) that rate
+ * would keep up with. The feeder shares the CPU with the host being
+ * measured, so these are lower bounds. The CPU time the host spent per
+ * sample (process CPU time minus the feeder's) gives the number of such
+ * ports one core could serve.
+ */
+
+#include <poll.h>
+#include <pthread.h>
+#include <sys/resource.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bench_common.h"
+#include "../include/serial_telemetry.h"
+
+#define MAX_PORTS 64
+#define CHANNELS 8
+#define SAMPLES_PER_PORT 20000
+#define LINE_BYTES_PER_SECOND 200000.0
+#define FEED_CHUNK 4096
+
+static int masters[MAX_PORTS];
+static serial_handle_t ports[MAX_PORTS];
+static uint8_t stream[(size_t)SAMPLES_PER_PORT * 32];
+static size_t stream_size;
+
+struct feeder_s {
+    size_t count;
+    size_t offsets[MAX_PORTS];
+    uint64_t cpu_ns;            /* CPU time of the feeder thread */
+};
+
+static uint64_t process_cpu_ns(void) {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return ((uint64_t)usage.ru_utime.tv_sec + (uint64_t)usage.ru_stime.tv_sec) * 1000000000u +
+           ((uint64_t)usage.ru_utime.tv_usec + (uint64_t)usage.ru_stime.tv_usec) * 1000u;
+}
+
+/* Writes the sample stream to every master, blocking in poll() only when all ptys are full */
+static void *feeder_main(void *arg) {
+    struct feeder_s *feeder = arg;
+    size_t done = 0;
+    while (done < feeder->count) {
+        int progress = 0;
+        done = 0;
+        for (size_t i = 0; i < feeder->count; i++) {
+            size_t left = stream_size - feeder->offsets[i];
+            if (left == 0) {
+                done++;
+                continue;
+            }
+            ssize_t written = write(masters[i], stream + feeder->offsets[i], left < FEED_CHUNK ? left : FEED_CHUNK);
+            if (written > 0) {
+                feeder->offsets[i] += (size_t)written;
+                progress = 1;
+            }
+        }
+        if (!progress && done < feeder->count) {
+            struct pollfd pfds[MAX_PORTS];
+            for (size_t i = 0; i < feeder->count; i++) {
+                pfds[i] = (struct pollfd){ .fd = masters[i], .events = POLLOUT };
+            }
+            poll(pfds, (nfds_t)feeder->count, 10);
+        }
+    }
+    struct timespec cpu;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu);
+    feeder->cpu_ns = (uint64_t)cpu.tv_sec * 1000000000u + (uint64_t)cpu.tv_nsec;
+    return NULL;
+}
+
+/* The baseline: 256-byte reads, frame decoding and one fprintf() per sample */
+static uint64_t run_loop(size_t count, FILE *csv) {
+    struct serial_frame_decoder_s decoders[MAX_PORTS];
+    struct pollfd pfds[MAX_PORTS];
+    for (size_t i = 0; i < count; i++) {
+        serial_frame_decoder_init(&decoders[i]);
+        pfds[i] = (struct pollfd){ .fd = ports[i], .events = POLLIN };
+    }
+    uint64_t samples = 0;
+    while (samples < (uint64_t)count * SAMPLES_PER_PORT) {
+        if (poll(pfds, (nfds_t)count, 1000) <= 0) {
+            break;
+        }
+        for (size_t i = 0; i < count; i++) {
+            if (!(pfds[i].revents & POLLIN)) {
+                continue;
+            }
+            uint8_t buffer[256];
+            size_t length = 0;
+            serial_read(ports[i], buffer, sizeof(buffer), &length);
+            for (size_t offset = 0; offset < length;) {
+                struct serial_frame_s frame;
+                int ready;
+                offset += serial_frame_decode(&decoders[i], buffer + offset, length - offset, &frame, &ready);
+                if (!ready || frame.cmd != SERIAL_CMD_SAMPLES) {
+                    continue;
+                }
+                const uint8_t *p = frame.payload;
+                fprintf(csv, "%zu,%u", i, (unsigned)(p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24));
+                for (int c = 0; c < CHANNELS; c++) {
+                    fprintf(csv, ",%d", (int16_t)(uint16_t)(p[4 + 2 * c] | p[5 + 2 * c] << 8));
+                }
+                fputc('\n', csv);
+                samples++;
+            }
+        }
+    }
+    fflush(csv);
+    return samples;
+}
+
+/* The pipeline: returns samples logged, waiting until all are in or progress stops */
+static uint64_t run_pipeline(size_t count, serial_telemetry_t *telemetry, struct serial_telemetry_stats_s *stats) {
+    uint64_t last = 0;
+    uint64_t stalled_since = bench_now_ns();
+    for (;;) {
+        serial_telemetry_stats(telemetry, stats);
+        if (stats->samples >= (uint64_t)count * SAMPLES_PER_PORT) {
+            break;
+        }
+        if (stats->samples != last) {
+            last = stats->samples;
+            stalled_since = bench_now_ns();
+        } else if (bench_now_ns() - stalled_since > 1000000000ull) {
+            break;
+        }
+        struct timespec pause = { .tv_sec = 0, .tv_nsec = 1000000L };
+        nanosleep(&pause, NULL);
+    }
+    serial_telemetry_stop(telemetry);
+    serial_telemetry_stats(telemetry, stats);
+    return stats->samples;
+}
+
+static void drain_masters(size_t count) {
+    uint8_t buffer[4096];
+    for (size_t i = 0; i < count; i++) {
+        while (read(masters[i], buffer, sizeof(buffer)) > 0) {
+        }
+    }
+}
+
+static void report(const char *name, size_t count, uint64_t samples, uint64_t elapsed_ns, uint64_t cpu_ns,
+                   size_t frame_size) {
+    double seconds = (double)elapsed_ns / 1e9;
+    double bytes_per_second = (double)samples * (double)frame_size / seconds;
+    double cpu_per_sample_ns = samples > 0 ? (double)cpu_ns / (double)samples : 0;
+    double samples_per_port = LINE_BYTES_PER_SECOND / (double)frame_size;
+    printf("  %-9s %3zu ports: %9.0f samples/s = %6.1f ports at 2 Mbaud; "
+           "%6.0f ns CPU/sample = %6.1f ports per core%s\n",
+           name, count, (double)samples / seconds, bytes_per_second / LINE_BYTES_PER_SECOND, cpu_per_sample_ns,
+           cpu_per_sample_ns > 0 ? 1e9 / (cpu_per_sample_ns * samples_per_port) : 0,
+           samples < (uint64_t)count * SAMPLES_PER_PORT ? "  (incomplete)" : "");
+}
+
+int main(void) {
+    size_t opened = 0;
+    char slave_path[64];
+    for (; opened < MAX_PORTS; opened++) {
+        masters[opened] = bench_open_pty(slave_path, sizeof(slave_path));
+        ports[opened] = masters[opened] >= 0 ? serial_open(slave_path, NULL) : SERIAL_INVALID_HANDLE;
+        if (ports[opened] == SERIAL_INVALID_HANDLE) {
+            break;
+        }
+    }
+    if (opened == 0) {
+        fprintf(stderr, "Unable to open a pty\n");
+        return EXIT_FAILURE;
+    }
+
+    /* One port's stream: a sawtooth per channel with a 200 us sample period */
+    size_t frame_size = 0;
+    for (uint32_t i = 0; i < SAMPLES_PER_PORT; i++) {
+        int16_t values[CHANNELS];
+        for (int c = 0; c < CHANNELS; c++) {
+            values[c] = (int16_t)((int)((i * (c + 1)) % 2000) - 1000);
+        }
+        serial_telemetry_encode((uint8_t)i, i * 200, values, CHANNELS, stream + stream_size,
+                                sizeof(stream) - stream_size, &frame_size);
+        stream_size += frame_size;
+    }
+    frame_size = stream_size / SAMPLES_PER_PORT;
+    printf("%d samples of %d channels per port, %zu bytes per frame; 2 Mbaud carries %.0f samples/s per port\n",
+           SAMPLES_PER_PORT, CHANNELS, frame_size, LINE_BYTES_PER_SECOND / (double)frame_size);
+
+    char csv_path[] = "/tmp/bench_telemetry_csv_XXXXXX";
+    int csv_fd = mkstemp(csv_path);
+    FILE *csv = csv_fd >= 0 ? fdopen(csv_fd, "w") : NULL;
+    if (!csv) {
+        fprintf(stderr, "Unable to create a scratch file\n");
+        return EXIT_FAILURE;
+    }
+
+    static const size_t COUNTS[] = {1, 16, 64};
+    for (size_t c = 0; c < sizeof(COUNTS) / sizeof(COUNTS[0]) && COUNTS[c] <= opened; c++) {
+        size_t count = COUNTS[c];
+        pthread_t feeder_thread;
+
+        /* Loop */
+        struct feeder_s feeder = { .count = count };
+        rewind(csv);
+        uint64_t start = bench_now_ns();
+        uint64_t cpu_start = process_cpu_ns();
+        pthread_create(&feeder_thread, NULL, feeder_main, &feeder);
+        uint64_t samples = run_loop(count, csv);
+        uint64_t elapsed = bench_now_ns() - start;
+        pthread_join(feeder_thread, NULL);
+        uint64_t cpu = process_cpu_ns() - cpu_start - feeder.cpu_ns;
+        drain_masters(count);
+        report("loop", count, samples, elapsed, cpu, frame_size);
+
+        /* Pipeline */
+        char paths[MAX_PORTS][48];
+        serial_telemetry_log_t *logs[MAX_PORTS];
+        struct serial_telemetry_config_s config = { .sync_ms = 100 };
+        struct serial_telemetry_log_config_s log_config = { .channels = CHANNELS, .capacity = SAMPLES_PER_PORT };
+        serial_telemetry_t *telemetry = serial_telemetry_create(&config);
+        int ready = telemetry != NULL;
+        for (size_t i = 0; i < count; i++) {
+            snprintf(paths[i], sizeof(paths[i]), "/tmp/bench_telemetry_%d_%zu.log", (int)getpid(), i);
+            logs[i] = serial_telemetry_log_create(paths[i], &log_config);
+            ready = ready && logs[i] && serial_telemetry_add(telemetry, ports[i], logs[i]) == SERIAL_SUCCESS;
+        }
+        struct serial_telemetry_stats_s stats = {0};
+        feeder = (struct feeder_s){ .count = count };
+        start = bench_now_ns();
+        cpu_start = process_cpu_ns();
+        if (ready && serial_telemetry_start(telemetry) == SERIAL_SUCCESS) {
+            pthread_create(&feeder_thread, NULL, feeder_main, &feeder);
+            samples = run_pipeline(count, telemetry, &stats);
+            elapsed = bench_now_ns() - start;
+            pthread_join(feeder_thread, NULL);
+            cpu = process_cpu_ns() - cpu_start - feeder.cpu_ns;
+            report("pipeline", count, samples, elapsed, cpu, frame_size);
+            printf("            %llu port pauses for a full ring, %llu syncs, %llu bad frames\n",
+                   (unsigned long long)stats.pauses, (unsigned long long)stats.syncs,
+                   (unsigned long long)stats.bad_frames);
+        } else {
+            fprintf(stderr, "Unable to start the pipeline\n");
+        }
+        serial_telemetry_destroy(telemetry);
+        drain_masters(count);
+        for (size_t i = 0; i < count; i++) {
+            serial_telemetry_log_close(logs[i]);
+            unlink(paths[i]);
+        }
+    }
+
+    fclose(csv);
+    unlink(csv_path);
+    for (size_t i = 0; i < opened; i++) {
+        serial_close(ports[i]);
+        close(masters[i]);
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,129 @@
+/**
+ * @file bench_trace.c
+ * @brief Cost of span tracing, per span and per command round trip
+ *
+ * First the bare cost of serial_trace_span() with recording off and on,
+ * over SPANS calls on a thread of its own, whose buffer holds them all. Then
+ * stop-and-wait LED_SET round trips to an unpaced emulated device with
+ * recording off and on, alternating ROUNDS times and keeping each side's
+ * best round so that scheduling noise does not land on one side only. A
+ * traced command records its seven stage spans plus the spans of the read
+ * and write system calls it made.
+ *
+ * For the compiled-out case, build with make TRACE=0 and run again; only
+ * the untraced numbers are printed then.
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "bench_common.h"
+#include "../include/serial_client.h"
+#include "../include/serial_emulator.h"
+#include "../include/serial_trace.h"
+
+#define SPANS 1000000
+#define ROUNDS 10
+#define COMMANDS 2000
+#define TRACE_CAPACITY (1u << 18)
+
+static void on_complete(serial_client_t *client, int status, const struct serial_frame_s *reply,
+                        uint64_t latency_ns, void *user_data) {
+    (void)client;
+    (void)reply;
+    (void)latency_ns;
+    if (status != SERIAL_SUCCESS) {
+        (*(uint64_t *)user_data)++;
+    }
+}
+
+static void *span_main(void *arg) {
+    uint64_t start = bench_now_ns();
+    for (int i = 0; i < SPANS; i++) {
+        serial_trace_span("bench", (uint64_t)i, (uint64_t)i + 1, "i", i);
+    }
+    *(double *)arg = (double)(bench_now_ns() - start) / SPANS;
+    return NULL;
+}
+
+/* Mean cost of one call, on a new thread so that the spans get a buffer of their own */
+static double span_ns(void) {
+    double ns = 0;
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, span_main, &ns) == 0) {
+        pthread_join(thread, NULL);
+    }
+    return ns;
+}
+
+/* One round of COMMANDS round trips; returns the mean time per command in nanoseconds, or 0 on error */
+static double round_trip_ns(serial_client_t *client) {
+    uint64_t failed = 0;
+    uint8_t mask = SERIAL_LED_RED;
+    uint64_t start = bench_now_ns();
+    for (int i = 0; i < COMMANDS; i++) {
+        if (serial_client_submit(client, SERIAL_CMD_LED_SET, &mask, 1, on_complete, &failed) != SERIAL_SUCCESS ||
+            serial_client_drain(client) != SERIAL_SUCCESS) {
+            return 0;
+        }
+    }
+    uint64_t elapsed = bench_now_ns() - start;
+    return failed == 0 ? (double)elapsed / COMMANDS : 0;
+}
+
+int main(void) {
+    int traced = serial_trace_start(SPANS) == SERIAL_SUCCESS;
+    serial_trace_stop();
+    printf("serial_trace_span(), %d calls:\n", SPANS);
+    printf("  off:      %6.1f ns\n", span_ns());
+    if (traced) {
+        serial_trace_start(SPANS);
+        double on = span_ns();
+        serial_trace_stop();
+        printf("  on:       %6.1f ns\n", on);
+    } else {
+        printf("  on:       tracing is compiled out (TRACE=0)\n");
+    }
+
+    serial_trace_start(TRACE_CAPACITY);
+    serial_trace_stop();
+    struct serial_emulator_config_s device = {0};
+    serial_emulator_t *emulator = serial_emulator_create(&device);
+    serial_handle_t port = emulator ? serial_open(serial_emulator_path(emulator), NULL) : SERIAL_INVALID_HANDLE;
+    struct serial_client_config_s config = { .window = 1, .timeout_ms = 1000 };
+    serial_client_t *client = serial_client_create(port, &config);
+    if (!client) {
+        fprintf(stderr, "Unable to start the emulated device\n");
+        return EXIT_FAILURE;
+    }
+
+    double best[2] = {0, 0};
+    for (int round = 0; round < ROUNDS; round++) {
+        for (int on = 0; on < 1 + traced; on++) {
+            if (on) {
+                serial_trace_start(TRACE_CAPACITY);
+            }
+            double ns = round_trip_ns(client);
+            serial_trace_stop();
+            if (ns == 0) {
+                fprintf(stderr, "Round trips failed\n");
+                return EXIT_FAILURE;
+            }
+            best[on] = best[on] == 0 || ns < best[on] ? ns : best[on];
+        }
+    }
+    printf("LED_SET round trips to an unpaced emulated device, best of %d rounds of %d:\n", ROUNDS, COMMANDS);
+    printf("  off:      %8.2f us per command\n", best[0] / 1e3);
+    if (traced) {
+        struct serial_trace_stats_s stats;
+        serial_trace_stats(&stats);
+        printf("  on:       %8.2f us per command (%+.2f us), %llu command spans kept, %llu dropped\n",
+               best[1] / 1e3, (best[1] - best[0]) / 1e3, (unsigned long long)(stats.spans - SPANS),
+               (unsigned long long)stats.dropped);
+    }
+
+    serial_client_destroy(client);
+    serial_close(port);
+    serial_emulator_destroy(emulator);
+    return EXIT_SUCCESS;
+}
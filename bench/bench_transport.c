@@ -0,0 +1,135 @@
+/**
+ * @file bench_transport.c
+ * @brief Pipelined client commands over a pty versus the in-memory loopback
+ *
+ * One thread plays both sides: it fills the client's window, lets the device
+ * side decode the commands and answer each with an ACK, then polls the
+ * client for the replies. Over a pty every step is a system call and a trip
+ * through the tty layer; over the loopback the same protocol code runs on
+ * memory copies, so the difference is the kernel's share of each command.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "bench_common.h"
+#include "../include/serial_client.h"
+#include "../include/serial_transport.h"
+
+#define COMMANDS 100000
+#define ROUNDS 3
+
+static void on_complete(serial_client_t *client, int status, const struct serial_frame_s *reply,
+                        uint64_t latency_ns, void *user_data) {
+    uint64_t *completed = user_data;
+    (void)client;
+    (void)latency_ns;
+    if (status == SERIAL_SUCCESS && reply->cmd == SERIAL_CMD_ACK) {
+        (*completed)++;
+    }
+}
+
+/* Decodes whatever commands have arrived and answers each one; returns the number answered or -1 */
+static int device_step(serial_handle_t device, struct serial_frame_decoder_s *decoder) {
+    int answered = 0;
+    uint8_t buffer[4096];
+    size_t count;
+    if (serial_wait_readable(device, 1000) != SERIAL_SUCCESS ||
+        serial_read(device, buffer, sizeof(buffer), &count) != SERIAL_SUCCESS) {
+        return -1;
+    }
+    for (size_t offset = 0; offset < count;) {
+        struct serial_frame_s frame;
+        int ready;
+        offset += serial_frame_decode(decoder, buffer + offset, count - offset, &frame, &ready);
+        if (ready) {
+            uint8_t ack[2] = {SERIAL_STATUS_OK, frame.payload[0]};
+            uint8_t encoded[SERIAL_FRAME_MAX_ENCODED];
+            size_t length, written;
+            serial_frame_encode(frame.seq, SERIAL_CMD_ACK, ack, sizeof(ack), encoded, sizeof(encoded), &length);
+            if (serial_write_all(device, encoded, length, 1000, &written) != SERIAL_SUCCESS) {
+                return -1;
+            }
+            answered++;
+        }
+    }
+    return answered;
+}
+
+/* Returns the time per command in nanoseconds, or 0 on failure */
+static double run_round(serial_handle_t host, serial_handle_t device, unsigned window) {
+    struct serial_client_config_s config = { .window = window, .timeout_ms = 1000 };
+    serial_client_t *client = serial_client_create(host, &config);
+    struct serial_frame_decoder_s decoder;
+    serial_frame_decoder_init(&decoder);
+    if (!client) {
+        return 0;
+    }
+
+    uint64_t submitted = 0, answered = 0, completed = 0;
+    uint8_t mask = SERIAL_LED_RED;
+    uint64_t start = bench_now_ns();
+    while (completed < COMMANDS) {
+        while (submitted < COMMANDS && serial_client_in_flight(client) < window) {
+            if (serial_client_submit(client, SERIAL_CMD_LED_SET, &mask, 1, on_complete, &completed) !=
+                SERIAL_SUCCESS) {
+                serial_client_destroy(client);
+                return 0;
+            }
+            submitted++;
+        }
+        uint64_t before = completed;
+        while (answered < submitted) {
+            int count = device_step(device, &decoder);
+            if (count < 0) {
+                serial_client_destroy(client);
+                return 0;
+            }
+            answered += (uint64_t)count;
+        }
+        while (completed == before && serial_client_in_flight(client) > 0) {
+            if (serial_client_poll(client, 1000) < 0) {
+                serial_client_destroy(client);
+                return 0;
+            }
+        }
+    }
+    double elapsed = (double)(bench_now_ns() - start);
+    serial_client_destroy(client);
+    return elapsed / COMMANDS;
+}
+
+int main(void) {
+    static const unsigned WINDOWS[] = {1, 16};
+    char peer_path[64];
+    serial_handle_t loop[2];
+    serial_handle_t pty_device = serial_open_pty(peer_path, sizeof(peer_path));
+    serial_handle_t pty_host = pty_device != SERIAL_INVALID_HANDLE ? serial_open(peer_path, NULL)
+                                                                   : SERIAL_INVALID_HANDLE;
+    if (pty_host == SERIAL_INVALID_HANDLE || serial_loopback_create(loop, 0) != SERIAL_SUCCESS) {
+        fprintf(stderr, "Unable to open a pty or a loopback\n");
+        return EXIT_FAILURE;
+    }
+
+    printf("LED_SET commands through serial_client, device answered inline, best of %d x %d:\n", ROUNDS, COMMANDS);
+    for (size_t i = 0; i < sizeof(WINDOWS) / sizeof(WINDOWS[0]); i++) {
+        double best_pty = 0, best_loop = 0;
+        for (int round = 0; round < ROUNDS; round++) {
+            double pty = run_round(pty_host, pty_device, WINDOWS[i]);
+            double loopback = run_round(loop[0], loop[1], WINDOWS[i]);
+            if (pty == 0 || loopback == 0) {
+                fprintf(stderr, "Benchmark failed\n");
+                return EXIT_FAILURE;
+            }
+            best_pty = (round == 0 || pty < best_pty) ? pty : best_pty;
+            best_loop = (round == 0 || loopback < best_loop) ? loopback : best_loop;
+        }
+        printf("  window %2u: pty %8.1f ns/cmd, loopback %8.1f ns/cmd (%.1fx)\n", WINDOWS[i], best_pty, best_loop,
+               best_pty / best_loop);
+    }
+
+    serial_close(loop[0]);
+    serial_close(loop[1]);
+    serial_close(pty_host);
+    serial_close(pty_device);
+    return EXIT_SUCCESS;
+}
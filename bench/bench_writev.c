@@ -0,0 +1,135 @@
+/**
+ * @file bench_writev.c
+ * @brief System calls and time per framed message: write, copy+write, writev
+ *
+ * Each message is a 4-byte header, a 32-byte payload and a 2-byte CRC sent
+ * through a pty. Write system calls are counted from /proc/self/io, which
+ * covers write() and writev() alike.
+ */
+
+#include <pthread.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bench_common.h"
+#include "../include/serial_functions.h"
+
+#define MESSAGE_COUNT 100000
+#define HEADER_SIZE 4
+#define PAYLOAD_SIZE 32
+#define CRC_SIZE 2
+#define MESSAGE_SIZE (HEADER_SIZE + PAYLOAD_SIZE + CRC_SIZE)
+#define WRITE_TIMEOUT_MS 5000
+
+struct sink_s {
+    int fd;
+    size_t expected;
+    size_t received;
+};
+
+static void *device_sink(void *arg) {
+    struct sink_s *sink = arg;
+    char buffer[8192];
+    while (sink->received < sink->expected) {
+        struct pollfd pfd = { .fd = sink->fd, .events = POLLIN };
+        poll(&pfd, 1, 100);
+        ssize_t count = read(sink->fd, buffer, sizeof(buffer));
+        if (count > 0) {
+            sink->received += (size_t)count;
+        }
+    }
+    return NULL;
+}
+
+enum method_e {
+    METHOD_THREE_WRITES,
+    METHOD_COPY_WRITE,
+    METHOD_WRITEV
+};
+
+static const char *const METHOD_NAMES[] = {
+    "3 x write_all", "copy + write_all", "writev_all"
+};
+
+static int send_message(serial_handle_t port, enum method_e method, char *header, char *payload, char *crc) {
+    size_t written;
+    switch (method) {
+    case METHOD_THREE_WRITES:
+        if (serial_write_all(port, header, HEADER_SIZE, WRITE_TIMEOUT_MS, &written) != SERIAL_SUCCESS ||
+            serial_write_all(port, payload, PAYLOAD_SIZE, WRITE_TIMEOUT_MS, &written) != SERIAL_SUCCESS ||
+            serial_write_all(port, crc, CRC_SIZE, WRITE_TIMEOUT_MS, &written) != SERIAL_SUCCESS) {
+            return -1;
+        }
+        return 0;
+    case METHOD_COPY_WRITE: {
+        char frame[MESSAGE_SIZE];
+        memcpy(frame, header, HEADER_SIZE);
+        memcpy(frame + HEADER_SIZE, payload, PAYLOAD_SIZE);
+        memcpy(frame + HEADER_SIZE + PAYLOAD_SIZE, crc, CRC_SIZE);
+        return serial_write_all(port, frame, MESSAGE_SIZE, WRITE_TIMEOUT_MS, &written) == SERIAL_SUCCESS ? 0 : -1;
+    }
+    case METHOD_WRITEV: {
+        struct iovec iov[] = {
+            { .iov_base = header, .iov_len = HEADER_SIZE },
+            { .iov_base = payload, .iov_len = PAYLOAD_SIZE },
+            { .iov_base = crc, .iov_len = CRC_SIZE },
+        };
+        return serial_writev_all(port, iov, 3, WRITE_TIMEOUT_MS, &written) == SERIAL_SUCCESS ? 0 : -1;
+    }
+    }
+    return -1;
+}
+
+static int run_bench(enum method_e method) {
+    char slave_path[64];
+    int master = bench_open_pty(slave_path, sizeof(slave_path));
+    serial_handle_t port = serial_open(slave_path, NULL);
+    if (master < 0 || port == SERIAL_INVALID_HANDLE) {
+        return -1;
+    }
+
+    struct sink_s sink = { .fd = master, .expected = (size_t)MESSAGE_COUNT * MESSAGE_SIZE };
+    pthread_t thread;
+    pthread_create(&thread, NULL, device_sink, &sink);
+
+    char header[HEADER_SIZE] = {'H', 'D', 'R', 0};
+    char payload[PAYLOAD_SIZE];
+    char crc[CRC_SIZE] = {0x12, 0x34};
+    memset(payload, 'p', sizeof(payload));
+
+    uint64_t reads_before = 0, writes_before = 0, reads_after = 0, writes_after = 0;
+    int counted = bench_syscall_counts(&reads_before, &writes_before) == 0;
+    uint64_t start = bench_now_ns();
+    for (int i = 0; i < MESSAGE_COUNT; i++) {
+        if (send_message(port, method, header, payload, crc) != 0) {
+            return -1;
+        }
+    }
+    uint64_t elapsed = bench_now_ns() - start;
+    counted = counted && bench_syscall_counts(&reads_after, &writes_after) == 0;
+    pthread_join(thread, NULL);
+
+    if (counted) {
+        printf("  %-16s: %6.2f write syscalls/msg, %8.0f msgs/s\n", METHOD_NAMES[method],
+               (double)(writes_after - writes_before) / MESSAGE_COUNT, MESSAGE_COUNT * 1e9 / (double)elapsed);
+    } else {
+        printf("  %-16s:    n/a write syscalls/msg, %8.0f msgs/s\n", METHOD_NAMES[method],
+               MESSAGE_COUNT * 1e9 / (double)elapsed);
+    }
+
+    serial_close(port);
+    close(master);
+    return 0;
+}
+
+int main(void) {
+    printf("Framed messages (%d-byte header, %d-byte payload, %d-byte CRC) over a pty:\n",
+           HEADER_SIZE, PAYLOAD_SIZE, CRC_SIZE);
+    if (run_bench(METHOD_THREE_WRITES) != 0 || run_bench(METHOD_COPY_WRITE) != 0 ||
+        run_bench(METHOD_WRITEV) != 0) {
+        fprintf(stderr, "Benchmark failed\n");
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
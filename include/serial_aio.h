@@ -0,0 +1,149 @@
+/**
+ * @file serial_aio.h
+ * @brief Completion-driven reads and writes for many serial ports
+ *
+ * Instead of waiting for readiness and then calling serial_read(), ports
+ * registered here deliver data to a callback, and writes are queued and
+ * reported when complete. Queued writes for all ports go to the kernel
+ * together in the next serial_aio_run_once().
+ *
+ * Built with SERIAL_USE_IO_URING (the Makefile default when the kernel
+ * headers have io_uring), the io_uring backend posts one multishot read per
+ * port that fills buffers from a shared provided-buffer ring. Submitting the
+ * batched writes and waiting for completions is a single io_uring_enter(),
+ * and none at all when completions are already waiting. Without it, or when
+ * the running kernel lacks io_uring or provided buffer rings, the same calls
+ * run on epoll with read() and write(). A kernel without multishot reads
+ * re-arms a single read per completion instead.
+ *
+ * The synchronous serial_read()/serial_write() calls stay available, but
+ * must not be mixed with this API on the same handle.
+ *
+ * Only available on Linux.
+ */
+
+#ifndef SERIAL_AIO_H_
+#define SERIAL_AIO_H_
+
+#include "serial_functions.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(__linux__)
+
+/* Backend selection and reporting */
+enum serial_aio_backend_e {
+    SERIAL_AIO_AUTO = 0,        /* io_uring when built in and supported, else epoll */
+    SERIAL_AIO_EPOLL = 1,
+    SERIAL_AIO_IO_URING = 2
+};
+
+typedef struct serial_aio_s serial_aio_t;
+
+/*
+ * Receives data read from a port. The data is only valid during the call.
+ * A negative status reports end of file or a read error; the port has been
+ * removed by the time the callback returns.
+ */
+typedef void (*serial_aio_read_callback_t)(serial_aio_t *aio, serial_handle_t handle, const void *data,
+                                           size_t size, int status, void *user_data);
+
+/* Reports a queued write as complete (status SERIAL_SUCCESS) or failed after written bytes */
+typedef void (*serial_aio_write_callback_t)(serial_aio_t *aio, serial_handle_t handle, size_t written,
+                                            int status, void *user_data);
+
+/* Settings; pass NULL to serial_aio_create() for the defaults */
+struct serial_aio_config_s {
+    uint8_t backend;            /* SERIAL_AIO_* to request */
+    unsigned queue_depth;       /* io_uring submission queue size, 0 for 256 */
+    unsigned buffer_count;      /* shared receive buffers, a power of two, 0 for 256 */
+    unsigned buffer_size;       /* bytes per receive buffer, 0 for 256 */
+};
+
+/**
+ * @brief Creates an empty completion loop
+ *
+ * A requested io_uring backend that is not built in or not supported by the
+ * kernel falls back to epoll; serial_aio_backend() reports the one in use.
+ * @param config Settings, or NULL for the defaults
+ * @return New loop or NULL on error
+ */
+serial_aio_t *serial_aio_create(const struct serial_aio_config_s *config);
+
+/**
+ * @brief Destroys a loop; registered handles are not closed
+ *
+ * Writes that have not completed are dropped without their callbacks.
+ * @param aio Loop to destroy (may be NULL)
+ */
+void serial_aio_destroy(serial_aio_t *aio);
+
+/**
+ * @brief Returns the backend in use
+ * @param aio Loop instance
+ * @return SERIAL_AIO_EPOLL or SERIAL_AIO_IO_URING
+ */
+int serial_aio_backend(const serial_aio_t *aio);
+
+/**
+ * @brief Registers a port and starts reading from it
+ * @param aio Loop instance
+ * @param handle Open serial handle (not already registered)
+ * @param on_read Receives the incoming data
+ * @param user_data Pointer passed back to the port's callbacks
+ * @return SERIAL_SUCCESS or error code
+ */
+int serial_aio_add(serial_aio_t *aio, serial_handle_t handle, serial_aio_read_callback_t on_read,
+                   void *user_data);
+
+/**
+ * @brief Unregisters a port; safe to call from inside a callback
+ *
+ * Its queued writes are dropped without their callbacks.
+ * @param aio Loop instance
+ * @param handle Registered serial handle
+ * @return SERIAL_SUCCESS or error code
+ */
+int serial_aio_remove(serial_aio_t *aio, serial_handle_t handle);
+
+/**
+ * @brief Queues data to be written to a port
+ *
+ * Writes to one port complete in order. The data is not copied and must stay
+ * valid until on_written has been called, the port is removed or the loop is
+ * destroyed.
+ * @param aio Loop instance
+ * @param handle Registered serial handle
+ * @param data Bytes to write
+ * @param size Number of bytes
+ * @param on_written Completion callback (may be NULL)
+ * @param user_data Pointer passed to on_written
+ * @return SERIAL_SUCCESS or error code
+ */
+int serial_aio_write(serial_aio_t *aio, serial_handle_t handle, const void *data, size_t size,
+                     serial_aio_write_callback_t on_written, void *user_data);
+
+/**
+ * @brief Submits queued writes, then waits for and dispatches one batch of completions
+ * @param aio Loop instance
+ * @param timeout_ms Maximum time to block (negative waits for the next completion)
+ * @return Number of callbacks dispatched or error code
+ */
+int serial_aio_run_once(serial_aio_t *aio, int timeout_ms);
+
+/**
+ * @brief Returns the number of registered ports
+ * @param aio Loop instance
+ * @return Port count
+ */
+size_t serial_aio_count(const serial_aio_t *aio);
+
+#endif /* __linux__ */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SERIAL_AIO_H_ */
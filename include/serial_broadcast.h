@@ -0,0 +1,71 @@
+/**
+ * @file serial_broadcast.h
+ * @brief The same bytes to many ports at once, with send skew measurement (Linux only)
+ *
+ * Writing a command to N boards with serial_write_all() in a loop makes
+ * every board wait for the ones before it, and a single port whose device
+ * has stopped reading holds up all the others for the whole timeout.
+ * serial_broadcast() first gives every port one non-blocking write attempt
+ * back to back, which is all a short command needs. Descriptor handles that
+ * took only part of it are then serviced together from one poll() loop, and
+ * buffered or transport handles, whose readiness poll() cannot see, finish
+ * on a small pool of worker threads that wait on them with
+ * serial_wait_writable(). No port waits for another.
+ *
+ * Each port reports when the driver took its first byte and its last byte,
+ * as offsets from the start of the call. The report holds the spread of both
+ * across ports: send skew is how far apart the boards started receiving,
+ * completion skew how far apart they had everything.
+ */
+
+#ifndef SERIAL_BROADCAST_H_
+#define SERIAL_BROADCAST_H_
+
+#include "serial_functions.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(__linux__)
+
+#define SERIAL_BROADCAST_MAX_WORKERS 8
+
+/* Outcome for one port */
+struct serial_broadcast_result_s {
+    int status;                 /* SERIAL_SUCCESS, SERIAL_ERROR_TIMEOUT or the write error */
+    size_t written;             /* bytes the port took */
+    uint64_t first_ns;          /* from the start of the call to the first byte taken, 0 if none */
+    uint64_t complete_ns;       /* from the start of the call to the last byte taken, 0 unless complete */
+};
+
+/* Summary of a broadcast */
+struct serial_broadcast_report_s {
+    size_t completed;           /* ports that took every byte */
+    size_t failed;              /* ports that timed out or failed */
+    uint64_t send_skew_ns;      /* latest minus earliest first_ns among ports that took any bytes */
+    uint64_t complete_skew_ns;  /* latest minus earliest complete_ns among completed ports */
+    uint64_t elapsed_ns;        /* until every port completed or failed */
+};
+
+/**
+ * @brief Writes the same data to several ports in parallel
+ * @param handles Open serial handles, each at most once
+ * @param count Number of handles
+ * @param data Bytes to send to every port
+ * @param size Number of bytes
+ * @param timeout_ms Time a port may take to accept everything, 0 for a single attempt
+ * @param results Receives one result per handle, in handle order (may be NULL)
+ * @param report Receives the skew summary (may be NULL)
+ * @return SERIAL_SUCCESS if every port took every byte, otherwise the first failing port's status
+ */
+int serial_broadcast(const serial_handle_t *handles, size_t count, const void *data, size_t size, int timeout_ms,
+                     struct serial_broadcast_result_s *results, struct serial_broadcast_report_s *report);
+
+#endif /* __linux__ */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SERIAL_BROADCAST_H_ */
@@ -0,0 +1,129 @@
+/**
+ * @file serial_capture.h
+ * @brief Opt-in traffic capture to a binary file, and replay of captures (Linux only)
+ *
+ * A capture records every chunk the application writes to or reads from a
+ * handle, with a monotonic timestamp, exactly as serial_read() and
+ * serial_write() and their vector forms saw it. Records are copied into a
+ * memory buffer under a short lock and a background thread appends full
+ * buffers to the file (and a partial one every SERIAL_CAPTURE_FLUSH_MS), so
+ * the I/O path never waits for the disk unless the writer falls a whole
+ * buffer behind.
+ *
+ * File layout, native byte order: a serial_capture_header_s, then records
+ * of a serial_capture_record_s followed by the payload, padded to 8 bytes.
+ * A record cut short by a crash ends the capture.
+ */
+
+#ifndef SERIAL_CAPTURE_H_
+#define SERIAL_CAPTURE_H_
+
+#include "serial_functions.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(__linux__)
+
+#define SERIAL_CAPTURE_MAGIC "SERCAP\r\n"
+#define SERIAL_CAPTURE_VERSION 1
+#define SERIAL_CAPTURE_BUFFER_SIZE (256u << 10)
+#define SERIAL_CAPTURE_FLUSH_MS 100
+
+/* Record directions */
+enum serial_capture_direction_e {
+    SERIAL_CAPTURE_RX = 0,      /* read from the device */
+    SERIAL_CAPTURE_TX = 1       /* written to the device */
+};
+
+/* File header */
+struct serial_capture_header_s {
+    char magic[8];              /* SERIAL_CAPTURE_MAGIC */
+    uint32_t version;           /* SERIAL_CAPTURE_VERSION */
+    uint32_t record_header_size;
+    uint64_t start_ns;          /* serial_monotonic_ns() when the capture began */
+};
+
+/* Record header; the payload follows */
+struct serial_capture_record_s {
+    uint64_t time_ns;           /* since start_ns */
+    uint32_t length;            /* payload bytes */
+    uint8_t direction;          /* SERIAL_CAPTURE_RX or SERIAL_CAPTURE_TX */
+    uint8_t reserved[3];
+};
+
+/**
+ * @brief Starts capturing the traffic of a handle into a new file
+ *
+ * An existing file is truncated. A capture already running on the handle
+ * is closed first; if that fails, its error is returned and no new capture
+ * is started. Enable and disable capture while no other thread uses the
+ * handle.
+ * @param handle Open serial handle
+ * @param path File to write
+ * @return SERIAL_SUCCESS, SERIAL_ERROR_OPEN if the file cannot be created, SERIAL_ERROR_WRITE if
+ *         the previous capture could not be written, or error code
+ */
+int serial_enable_capture(serial_handle_t handle, const char *path);
+
+/**
+ * @brief Flushes and closes the capture of a handle; also done by serial_close()
+ * @param handle Serial handle
+ * @return SERIAL_SUCCESS, SERIAL_ERROR_WRITE if part of the capture could not be written, or error code
+ */
+int serial_disable_capture(serial_handle_t handle);
+
+/* Opaque replay handle */
+typedef struct serial_replay_s serial_replay_t;
+
+/**
+ * @brief Maps a capture file for reading
+ * @param path Capture file
+ * @return Replay handle, or NULL if the file is missing or not a capture
+ */
+serial_replay_t *serial_replay_open(const char *path);
+
+/**
+ * @brief Unmaps a capture
+ * @param replay Replay handle (NULL is ignored)
+ */
+void serial_replay_close(serial_replay_t *replay);
+
+/**
+ * @brief Returns the next record of a capture
+ * @param replay Replay handle
+ * @param record Receives the record header
+ * @param payload Receives a pointer to the payload inside the mapping
+ * @return 1 if a record was returned, 0 at the end of the capture
+ */
+int serial_replay_next(serial_replay_t *replay, struct serial_capture_record_s *record, const void **payload);
+
+/**
+ * @brief Starts reading a capture from its first record again
+ * @param replay Replay handle
+ */
+void serial_replay_rewind(serial_replay_t *replay);
+
+/**
+ * @brief Writes the payloads of one direction of a capture to a handle
+ *
+ * The first record goes out at once and each later one at its original
+ * offset from it, divided by speed, on an absolute CLOCK_MONOTONIC
+ * schedule so delays do not accumulate. A speed of 0 writes everything as
+ * fast as the handle takes it.
+ * @param replay Replay handle, read from its first record
+ * @param handle Handle or descriptor to write to, e.g. a pty master
+ * @param direction SERIAL_CAPTURE_RX to play the device's side, SERIAL_CAPTURE_TX for the host's
+ * @param speed Playback speed factor, e.g. 1.0 for real time, or 0
+ * @return SERIAL_SUCCESS or error code
+ */
+int serial_replay_run(serial_replay_t *replay, serial_handle_t handle, uint8_t direction, double speed);
+
+#endif /* __linux__ */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SERIAL_CAPTURE_H_ */
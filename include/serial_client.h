@@ -0,0 +1,107 @@
+/**
+ * @file serial_client.h
+ * @brief Pipelined command client on top of the framed protocol
+ *
+ * Keeps up to a configurable number of commands in flight on one handle
+ * instead of waiting for each reply before sending the next command. Every
+ * command is tagged with the frame sequence number, so replies are matched
+ * to their commands even when they arrive out of order. Each command
+ * completes exactly once through its callback, either with the device reply
+ * or with SERIAL_ERROR_TIMEOUT.
+ *
+ * The client is driven by the calling thread: submitting into a full window
+ * and serial_client_poll() both read and dispatch replies. Callbacks run on
+ * that thread and may submit further commands.
+ */
+
+#ifndef SERIAL_CLIENT_H_
+#define SERIAL_CLIENT_H_
+
+#include "serial_frame.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SERIAL_CLIENT_MAX_WINDOW 128
+#define SERIAL_CLIENT_DEFAULT_WINDOW 16
+#define SERIAL_CLIENT_DEFAULT_TIMEOUT_MS 1000
+
+typedef struct serial_client_s serial_client_t;
+
+/* Client settings; pass NULL to serial_client_create() for the defaults */
+struct serial_client_config_s {
+    unsigned window;    /* commands in flight, 1 to SERIAL_CLIENT_MAX_WINDOW */
+    int timeout_ms;     /* per-command response timeout */
+};
+
+/**
+ * @brief Command completion callback
+ * @param client Client the command was submitted on
+ * @param status SERIAL_SUCCESS when a reply arrived, otherwise SERIAL_ERROR_TIMEOUT
+ * @param reply ACK or NAK frame from the device, NULL unless status is SERIAL_SUCCESS
+ * @param latency_ns Time from submission to completion
+ * @param user_data Pointer given to serial_client_submit()
+ */
+typedef void (*serial_client_callback_t)(serial_client_t *client, int status, const struct serial_frame_s *reply,
+                                         uint64_t latency_ns, void *user_data);
+
+/**
+ * @brief Creates a client for an open serial handle
+ * @param handle Open serial handle; the client does not take ownership
+ * @param config Settings, or NULL for the defaults
+ * @return New client or NULL on error
+ */
+serial_client_t *serial_client_create(serial_handle_t handle, const struct serial_client_config_s *config);
+
+/**
+ * @brief Destroys a client; callbacks of commands still in flight are not called
+ * @param client Client to destroy (may be NULL)
+ */
+void serial_client_destroy(serial_client_t *client);
+
+/**
+ * @brief Sends one command without waiting for its reply
+ *
+ * When the window is full this processes replies and timeouts until a slot
+ * frees up, which takes at most the configured timeout.
+ * @param client Client instance
+ * @param cmd Command identifier (see serial_frame_cmd_e)
+ * @param payload Command payload (may be NULL when length is 0)
+ * @param length Payload size, at most SERIAL_FRAME_MAX_PAYLOAD
+ * @param callback Completion callback (may be NULL)
+ * @param user_data Pointer passed back to the callback
+ * @return SERIAL_SUCCESS or error code
+ */
+int serial_client_submit(serial_client_t *client, uint8_t cmd, const void *payload, size_t length,
+                         serial_client_callback_t callback, void *user_data);
+
+/**
+ * @brief Waits for replies and dispatches completions
+ *
+ * Returns early once at least one command has completed.
+ * @param client Client instance
+ * @param timeout_ms Maximum time to wait (0 only processes what is ready)
+ * @return Number of commands completed, or error code
+ */
+int serial_client_poll(serial_client_t *client, int timeout_ms);
+
+/**
+ * @brief Waits until no command is in flight
+ * @param client Client instance
+ * @return SERIAL_SUCCESS or error code
+ */
+int serial_client_drain(serial_client_t *client);
+
+/**
+ * @brief Returns the number of commands awaiting a reply
+ * @param client Client instance
+ * @return Commands in flight
+ */
+unsigned serial_client_in_flight(const serial_client_t *client);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SERIAL_CLIENT_H_ */
@@ -0,0 +1,99 @@
+/**
+ * @file serial_emulator.h
+ * @brief Host-side stand-in for the Arduino sketch on a pseudo-terminal
+ *
+ * The emulator allocates a pty pair and runs the sketch's firmware core,
+ * sketch_mar2a/led_firmware.c, on the master side in a background thread:
+ * the legacy single-character ASCII commands as well as binary frames. The
+ * slave path is opened with serial_open() exactly like a USB serial device,
+ * so the real I/O path can be tested and benchmarked without hardware.
+ *
+ * Optionally the emulator paces both directions to a baud rate (10 bit
+ * times per byte) and models the delay() earlier sketches made after ASCII
+ * commands. Like the AVR core it has 64-byte receive and transmit buffers: a
+ * command whose reply does not fit waits for the transmit buffer, and bytes
+ * that arrive while the receive buffer is full are dropped and counted as
+ * overruns. A device configured for flow control holds the host off before
+ * that happens, once the host has enabled the same flow control on its end.
+ *
+ * Real-time settings for the device thread keep a loaded host from slowing
+ * the emulated device down, as it would not slow real hardware down.
+ *
+ * Only available on Linux.
+ */
+
+#ifndef SERIAL_EMULATOR_H_
+#define SERIAL_EMULATOR_H_
+
+#include "serial_functions.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(__linux__)
+
+/* delay() after each ASCII command in sketches before led_firmware.c */
+#define SERIAL_EMULATOR_SKETCH_DELAY_MS 100
+
+typedef struct serial_emulator_s serial_emulator_t;
+
+/* Emulator settings; pass NULL to serial_emulator_create() for an unpaced device without delays */
+struct serial_emulator_config_s {
+    uint32_t baud_rate;         /* link speed to model, 0 for no pacing */
+    unsigned ascii_delay_ms;    /* busy time after each ASCII command, 0 for none */
+    uint8_t flow_control;       /* SERIAL_FLOW_* the device implements */
+    const struct serial_rt_config_s *rt;    /* applied to the device thread (serial_rt.h), NULL for none */
+};
+
+/* Counters, updated by the emulator thread */
+struct serial_emulator_stats_s {
+    uint64_t rx_bytes;          /* bytes received from the host */
+    uint64_t tx_bytes;          /* bytes sent to the host */
+    uint64_t ascii_commands;    /* recognised ASCII commands */
+    uint64_t frames;            /* valid frames handled */
+    uint64_t bad_frames;        /* frames dropped for bad COBS, CRC or size */
+    uint64_t overruns;          /* bytes dropped because the receive buffer was full */
+};
+
+/**
+ * @brief Creates a pty pair and starts the emulated device
+ * @param config Settings, or NULL for the defaults
+ * @return New emulator or NULL on error
+ */
+serial_emulator_t *serial_emulator_create(const struct serial_emulator_config_s *config);
+
+/**
+ * @brief Stops the device thread and releases the pty pair
+ * @param emulator Emulator to destroy (may be NULL)
+ */
+void serial_emulator_destroy(serial_emulator_t *emulator);
+
+/**
+ * @brief Returns the slave device path to pass to serial_open()
+ * @param emulator Emulator instance
+ * @return Path such as "/dev/pts/3", valid until the emulator is destroyed
+ */
+const char *serial_emulator_path(const serial_emulator_t *emulator);
+
+/**
+ * @brief Returns the current LED mask (SERIAL_LED_* bits)
+ * @param emulator Emulator instance
+ * @return LED state
+ */
+uint8_t serial_emulator_led_state(const serial_emulator_t *emulator);
+
+/**
+ * @brief Copies the emulator counters
+ * @param emulator Emulator instance
+ * @param stats Receives the counters
+ */
+void serial_emulator_get_stats(const serial_emulator_t *emulator, struct serial_emulator_stats_s *stats);
+
+#endif /* __linux__ */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SERIAL_EMULATOR_H_ */
@@ -0,0 +1,122 @@
+/**
+ * @file serial_frame.h
+ * @brief Binary framed protocol: COBS framing with sequence number and CRC16
+ *
+ * Wire format of one frame:
+ *
+ *     0x00 | COBS( seq | cmd | payload[0..250] | crc16_lo | crc16_hi ) | 0x00
+ *
+ * The CRC is CRC-16/CCITT-FALSE over seq, cmd and payload. COBS removes every
+ * zero byte from the body, so 0x00 only ever appears as a frame delimiter and
+ * a receiver can resynchronise after corruption at the next delimiter. The
+ * leading delimiter also lets the device tell frames apart from the legacy
+ * single-character ASCII commands.
+ */
+
+#ifndef SERIAL_FRAME_H_
+#define SERIAL_FRAME_H_
+
+#include "serial_functions.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SERIAL_FRAME_DELIMITER 0x00
+#define SERIAL_FRAME_MAX_PAYLOAD 250
+/* seq + cmd + payload + crc, before COBS */
+#define SERIAL_FRAME_MAX_RAW (SERIAL_FRAME_MAX_PAYLOAD + 4)
+/* COBS adds at most one byte per 254 plus one, then both delimiters */
+#define SERIAL_FRAME_MAX_ENCODED (SERIAL_FRAME_MAX_RAW + SERIAL_FRAME_MAX_RAW / 254 + 1 + 2)
+
+/* Command identifiers */
+enum serial_frame_cmd_e {
+    SERIAL_CMD_LED_ON = 0x01,    /* payload: LED mask to turn on */
+    SERIAL_CMD_LED_OFF = 0x02,   /* payload: LED mask to turn off */
+    SERIAL_CMD_LED_SET = 0x03,   /* payload: LED mask; LEDs outside it are turned off */
+    SERIAL_CMD_GET_STATE = 0x04, /* no payload */
+    SERIAL_CMD_BATCH = 0x10,     /* payload: (cmd, mask) pairs applied in order */
+    SERIAL_CMD_SAMPLES = 0x20,   /* device to host, not acknowledged: u32 time in us, i16 per channel */
+    SERIAL_CMD_ACK = 0x80,       /* payload: status, LED state */
+    SERIAL_CMD_NAK = 0x81        /* payload: status */
+};
+
+/* Status codes carried in ACK/NAK payloads */
+enum serial_frame_status_e {
+    SERIAL_STATUS_OK = 0,
+    SERIAL_STATUS_BAD_COMMAND = 1,
+    SERIAL_STATUS_BAD_PAYLOAD = 2
+};
+
+/* LED mask bits */
+#define SERIAL_LED_RED    0x01u
+#define SERIAL_LED_YELLOW 0x02u
+#define SERIAL_LED_BLUE   0x04u
+#define SERIAL_LED_ALL    (SERIAL_LED_RED | SERIAL_LED_YELLOW | SERIAL_LED_BLUE)
+
+/* A decoded frame */
+struct serial_frame_s {
+    uint8_t seq;
+    uint8_t cmd;
+    uint8_t length;
+    uint8_t payload[SERIAL_FRAME_MAX_PAYLOAD];
+};
+
+/* Incremental decoder state; initialise with serial_frame_decoder_init() */
+struct serial_frame_decoder_s {
+    uint8_t buffer[SERIAL_FRAME_MAX_ENCODED];
+    size_t length;
+    int overflow;
+    uint32_t frames;    /* frames decoded successfully */
+    uint32_t errors;    /* frames dropped for bad COBS, CRC or size */
+};
+
+/**
+ * @brief Computes CRC-16/CCITT-FALSE (poly 0x1021, init 0xFFFF)
+ * @param data Data to checksum
+ * @param size Number of bytes
+ * @return CRC value
+ */
+uint16_t serial_crc16(const uint8_t *data, size_t size);
+
+/**
+ * @brief Encodes one frame including both delimiters
+ * @param seq Sequence number
+ * @param cmd Command identifier
+ * @param payload Payload bytes (may be NULL when length is 0)
+ * @param length Payload size, at most SERIAL_FRAME_MAX_PAYLOAD
+ * @param out Output buffer, SERIAL_FRAME_MAX_ENCODED bytes is always enough
+ * @param out_size Size of the output buffer
+ * @param out_length Pointer to store the encoded size
+ * @return SERIAL_SUCCESS or SERIAL_ERROR_OVERFLOW
+ */
+int serial_frame_encode(uint8_t seq, uint8_t cmd, const void *payload, size_t length,
+                        uint8_t *out, size_t out_size, size_t *out_length);
+
+/**
+ * @brief Resets a decoder
+ * @param decoder Decoder to initialise
+ */
+void serial_frame_decoder_init(struct serial_frame_decoder_s *decoder);
+
+/**
+ * @brief Feeds received bytes to the decoder
+ *
+ * Consumes input up to and including the delimiter that completes a frame,
+ * so call it in a loop until all input is consumed. Corrupt frames are
+ * dropped and counted in decoder->errors.
+ * @param decoder Decoder state
+ * @param data Received bytes
+ * @param size Number of received bytes
+ * @param frame Receives the frame when one completes
+ * @param ready Set to 1 when frame holds a new frame, otherwise 0
+ * @return Number of bytes consumed
+ */
+size_t serial_frame_decode(struct serial_frame_decoder_s *decoder, const uint8_t *data, size_t size,
+                           struct serial_frame_s *frame, int *ready);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SERIAL_FRAME_H_ */
@@ -21,6 +21,7 @@ extern "C" {
     #include <termios.h>
     #include <unistd.h>
     #include <fcntl.h>
+    #include <sys/uio.h>
     typedef int serial_handle_t;
     #define SERIAL_INVALID_HANDLE (-1)
 #elif defined(_WIN32)
@@ -28,6 +29,12 @@ extern "C" {
     #include <windows.h>
     typedef HANDLE serial_handle_t;
     #define SERIAL_INVALID_HANDLE INVALID_HANDLE_VALUE
+
+    /* Scatter-gather element, layout-compatible with POSIX */
+    struct iovec {
+        void *iov_base;
+        size_t iov_len;
+    };
 #else
     #error "Unsupported platform"
 #endif
@@ -39,25 +46,83 @@ enum serial_error_e {
     SERIAL_ERROR_CONFIG = -2,
     SERIAL_ERROR_READ = -3,
     SERIAL_ERROR_WRITE = -4,
-    SERIAL_ERROR_INVALID_HANDLE = -5
+    SERIAL_ERROR_INVALID_HANDLE = -5,
+    SERIAL_ERROR_TIMEOUT = -6,
+    SERIAL_ERROR_OVERFLOW = -7
+};
+
+/* Port tuning profiles selected by serial_config_s.latency_mode */
+enum serial_latency_mode_e {
+    /* VMIN=1, VTIME=1, driver buffering untouched; USB adapters may hold small replies (FTDI: 16 ms) */
+    SERIAL_LATENCY_THROUGHPUT = 0,
+    /* VMIN=1, VTIME=0, ASYNC_LOW_LATENCY where supported, stale input flushed on open */
+    SERIAL_LATENCY_LOW = 1
+};
+
+/* Flow control selected by serial_config_s.flow_control */
+enum serial_flow_control_e {
+    SERIAL_FLOW_NONE = 0,
+    /* Hardware handshake on the RTS/CTS lines */
+    SERIAL_FLOW_RTSCTS = 1,
+    /* In-band XON/XOFF characters; only for text, binary frames may contain them */
+    SERIAL_FLOW_XONXOFF = 2
 };
 
+/* Characters used by SERIAL_FLOW_XONXOFF */
+#define SERIAL_XON 0x11
+#define SERIAL_XOFF 0x13
+
 /* Serial port configuration structure */
 struct serial_config_s {
     uint32_t baud_rate;
     uint8_t data_bits;
     uint8_t stop_bits;
     uint8_t parity;
+    uint8_t latency_mode;   /* enum serial_latency_mode_e */
+    uint8_t flow_control;   /* enum serial_flow_control_e */
+};
+
+struct serial_rt_config_s;
+
+/* Ring sizes for buffered handle mode (0 selects the default of 4 KiB) */
+struct serial_buffer_config_s {
+    size_t rx_size;
+    size_t tx_size;
+    const struct serial_rt_config_s *rt;    /* applied to the I/O thread (serial_rt.h), NULL for none */
 };
 
 /**
  * @brief Opens and configures a serial port
+ *
+ * Both latency profiles put the port in raw mode with VMIN=1, so poll()
+ * wakes on the first byte. SERIAL_LATENCY_THROUGHPUT keeps VTIME=1 for
+ * blocking readers and leaves the driver's buffering alone.
+ * SERIAL_LATENCY_LOW sets VTIME=0, asks the driver for ASYNC_LOW_LATENCY
+ * through TIOCSSERIAL (which takes the FTDI latency timer from 16 ms to
+ * 1 ms; ignored by drivers without it, such as ptys and CDC-ACM) and
+ * discards input that was queued before the port was opened.
+ *
+ * Flow control is applied by the driver: while the device holds the host
+ * off, writes return no data and serial_write_all() sleeps in poll() until
+ * it may send again, so a slow receiver costs no CPU and drops no bytes.
  * @param port_name Path to the serial port (e.g., "/dev/ttyUSB0" or "COM1")
  * @param config Pointer to configuration structure (NULL for default 9600-8N1)
  * @return Handle to the serial port or SERIAL_INVALID_HANDLE on error
  */
 serial_handle_t serial_open(const char *port_name, const struct serial_config_s *config);
 
+/**
+ * @brief Reads back the baud rate currently applied to a port
+ *
+ * serial_open() accepts any rate: standard ones map to Bxxx constants (up to
+ * 4000000 on Linux), others are set through termios2/BOTHER. Opening fails if
+ * the driver does not apply the requested rate within 2%.
+ * @param handle Valid serial port handle
+ * @param baud_rate Pointer to store the applied rate in bits per second
+ * @return SERIAL_SUCCESS or error code
+ */
+int serial_get_baud(serial_handle_t handle, uint32_t *baud_rate);
+
 /**
  * @brief Closes a serial port
  * @param handle Valid serial port handle
@@ -67,6 +132,10 @@ int serial_close(serial_handle_t handle);
 
 /**
  * @brief Writes data to a serial port
+ *
+ * Performs a single attempt and may write less than requested; a full kernel
+ * queue (or transmit ring on a buffered handle) is reported as success with
+ * 0 bytes written. serial_write_all() waits for room instead.
  * @param handle Valid serial port handle
  * @param data Pointer to data buffer
  * @param size Size of data to write
@@ -77,6 +146,9 @@ int serial_write(serial_handle_t handle, const void *data, size_t size, size_t *
 
 /**
  * @brief Reads data from a serial port
+ *
+ * Performs a single attempt; when nothing is waiting it returns success with
+ * 0 bytes read.
  * @param handle Valid serial port handle
  * @param buffer Pointer to receive buffer
  * @param size Maximum size to read
@@ -85,6 +157,132 @@ int serial_write(serial_handle_t handle, const void *data, size_t size, size_t *
  */
 int serial_read(serial_handle_t handle, void *buffer, size_t size, size_t *bytes_read);
 
+/**
+ * @brief Writes several buffers to a serial port with one system call
+ *
+ * Like serial_write() this performs a single attempt and may write less than
+ * requested, and a full kernel queue is likewise success with 0 bytes written.
+ * @param handle Valid serial port handle
+ * @param iov Array of buffers to send in order
+ * @param iovcnt Number of entries in iov
+ * @param bytes_written Pointer to store number of bytes written
+ * @return SERIAL_SUCCESS or error code
+ */
+int serial_writev(serial_handle_t handle, const struct iovec *iov, int iovcnt, size_t *bytes_written);
+
+/**
+ * @brief Reads from a serial port into several buffers with one system call
+ * @param handle Valid serial port handle
+ * @param iov Array of buffers to fill in order
+ * @param iovcnt Number of entries in iov
+ * @param bytes_read Pointer to store number of bytes read
+ * @return SERIAL_SUCCESS or error code
+ */
+int serial_readv(serial_handle_t handle, const struct iovec *iov, int iovcnt, size_t *bytes_read);
+
+/**
+ * @brief Writes a whole buffer, waiting for the port to drain as needed
+ * @param handle Valid serial port handle
+ * @param data Pointer to data buffer
+ * @param size Size of data to write
+ * @param timeout_ms Maximum total time to wait (negative waits forever)
+ * @param bytes_written Pointer to store number of bytes written, also on error
+ * @return SERIAL_SUCCESS, SERIAL_ERROR_TIMEOUT or error code
+ */
+int serial_write_all(serial_handle_t handle, const void *data, size_t size, int timeout_ms,
+                     size_t *bytes_written);
+
+/**
+ * @brief Writes several buffers completely, resuming after partial writes
+ *
+ * Short writes and EAGAIN are handled by waiting for the port to become
+ * writable, never by spinning.
+ * @param handle Valid serial port handle
+ * @param iov Array of buffers to send in order
+ * @param iovcnt Number of entries in iov
+ * @param timeout_ms Maximum total time to wait (negative waits forever)
+ * @param bytes_written Pointer to store number of bytes written, also on error
+ * @return SERIAL_SUCCESS, SERIAL_ERROR_TIMEOUT or error code
+ */
+int serial_writev_all(serial_handle_t handle, const struct iovec *iov, int iovcnt, int timeout_ms,
+                      size_t *bytes_written);
+
+/**
+ * @brief Returns a monotonic timestamp in milliseconds
+ *
+ * Used as the time base for the deadline passed to serial_read_until().
+ * @return Milliseconds since an unspecified starting point
+ */
+uint64_t serial_monotonic_ms(void);
+
+/**
+ * @brief Returns a monotonic timestamp in nanoseconds, for latency measurement
+ * @return Nanoseconds since an unspecified starting point
+ */
+uint64_t serial_monotonic_ns(void);
+
+/**
+ * @brief Waits until a serial port has data available to read
+ * @param handle Valid serial port handle
+ * @param timeout_ms Maximum time to wait in milliseconds (negative waits forever)
+ * @return SERIAL_SUCCESS when readable, SERIAL_ERROR_TIMEOUT or error code
+ */
+int serial_wait_readable(serial_handle_t handle, int timeout_ms);
+
+/**
+ * @brief Waits until a serial port can accept more data
+ * @param handle Valid serial port handle
+ * @param timeout_ms Maximum time to wait in milliseconds (negative waits forever)
+ * @return SERIAL_SUCCESS when writable, SERIAL_ERROR_TIMEOUT or error code
+ */
+int serial_wait_writable(serial_handle_t handle, int timeout_ms);
+
+/**
+ * @brief Reads from a serial port until a delimiter is received
+ *
+ * Returns as soon as the delimiter has been seen instead of sleeping for a
+ * fixed interval. Bytes that arrived in the same read after the delimiter
+ * are left in the buffer behind it and are included in bytes_read.
+ * @param handle Valid serial port handle
+ * @param buffer Pointer to receive buffer
+ * @param size Size of the receive buffer
+ * @param delim NUL-terminated delimiter (e.g. "\r\n")
+ * @param deadline_ms Absolute deadline on the serial_monotonic_ms() clock
+ * @param bytes_read Pointer to store number of bytes read
+ * @return SERIAL_SUCCESS, SERIAL_ERROR_TIMEOUT, SERIAL_ERROR_OVERFLOW or error code
+ */
+int serial_read_until(serial_handle_t handle, void *buffer, size_t size, const char *delim,
+                      uint64_t deadline_ms, size_t *bytes_read);
+
+/**
+ * @brief Switches a handle to buffered mode (Linux only)
+ *
+ * A background I/O thread fills an RX ring from the port and drains a TX ring
+ * into it, so serial_read() and serial_write() become memory copies with no
+ * system calls. Writes accept at most the free TX ring space, reads return
+ * whatever is buffered. serial_close() disables buffering automatically.
+ *
+ * With config->rt the I/O thread applies the real-time settings when it
+ * starts, and the rings are pre-faulted and locked in memory where the
+ * process is allowed to, so replies are picked up promptly on a loaded host.
+ * @param handle Valid serial port handle
+ * @param config Ring sizes and thread settings, or NULL for the defaults
+ * @return SERIAL_SUCCESS or error code
+ */
+int serial_enable_buffering(serial_handle_t handle, const struct serial_buffer_config_s *config);
+
+/**
+ * @brief Stops the I/O thread of a buffered handle
+ *
+ * Pending TX data is flushed for a short while; unread RX data is dropped.
+ * The rings are freed before this returns, so no other thread may be
+ * reading, writing or waiting on the handle during the call; the same holds
+ * for serial_enable_buffering() and serial_close(). Stop those threads first.
+ * @param handle Buffered serial port handle
+ * @return SERIAL_SUCCESS or error code
+ */
+int serial_disable_buffering(serial_handle_t handle);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,140 @@
+/**
+ * @file serial_lines.h
+ * @brief Incremental line splitter for text responses from the device
+ *
+ * The sketch answers with Serial.println(), and one read can end in the middle
+ * of a line or hold several lines. The splitter keeps received bytes in its
+ * own buffer and carries a partial line over to the next read. Complete lines
+ * are handed out as views into that buffer, without copying.
+ *
+ * The delimiter search is memchr-like. On x86 it uses AVX2 when the CPU has
+ * it, otherwise SSE2. Other targets scan a machine word at a time. The same
+ * search is exported as serial_find_byte() for splitting large captures and
+ * telemetry dumps in place.
+ */
+
+#ifndef SERIAL_LINES_H_
+#define SERIAL_LINES_H_
+
+#include "serial_functions.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Delimiter search implementations */
+enum serial_scan_e {
+    SERIAL_SCAN_AUTO = 0,       /* best one the CPU supports */
+    SERIAL_SCAN_SCALAR = 1,     /* word at a time */
+    SERIAL_SCAN_SSE2 = 2,
+    SERIAL_SCAN_AVX2 = 3
+};
+
+typedef struct serial_lines_s serial_lines_t;
+
+/* A line handed out by the splitter */
+struct serial_line_s {
+    const char *data;   /* points into the splitter's buffer */
+    size_t length;      /* without the delimiter, or a "\r\n" pair when splitting at '\n' */
+    int truncated;      /* 1 when the line filled the whole buffer and was cut */
+};
+
+/**
+ * @brief Finds the first occurrence of a byte
+ * @param data Bytes to search
+ * @param size Number of bytes
+ * @param byte Byte to look for
+ * @return Pointer to the first match or NULL
+ */
+const void *serial_find_byte(const void *data, size_t size, uint8_t byte);
+
+/**
+ * @brief Selects the implementation behind serial_find_byte(), for benchmarks and tests
+ *
+ * An implementation the CPU does not support falls back to the next best one.
+ * @param scan SERIAL_SCAN_* to use
+ * @return SERIAL_SCAN_* now in use
+ */
+int serial_find_byte_select(int scan);
+
+/**
+ * @brief Creates a splitter
+ * @param capacity Buffer size, the longest line that is returned whole
+ * @param delimiter Byte that ends a line, usually '\n'
+ * @return New splitter or NULL on error
+ */
+serial_lines_t *serial_lines_create(size_t capacity, char delimiter);
+
+/**
+ * @brief Destroys a splitter
+ * @param lines Splitter to destroy (may be NULL)
+ */
+void serial_lines_destroy(serial_lines_t *lines);
+
+/**
+ * @brief Discards buffered data, including a partial line
+ * @param lines Splitter instance
+ */
+void serial_lines_reset(serial_lines_t *lines);
+
+/**
+ * @brief Returns the number of buffered bytes not yet handed out as lines
+ * @param lines Splitter instance
+ * @return Byte count
+ */
+size_t serial_lines_pending(const serial_lines_t *lines);
+
+/**
+ * @brief Copies received bytes into the splitter
+ *
+ * Invalidates lines handed out before. Takes only what fits, so drain
+ * the complete lines with serial_lines_next() and feed the rest again.
+ * @param lines Splitter instance
+ * @param data Received bytes
+ * @param size Number of bytes
+ * @return Number of bytes taken
+ */
+size_t serial_lines_feed(serial_lines_t *lines, const void *data, size_t size);
+
+/**
+ * @brief Reads from a port straight into the splitter's buffer
+ *
+ * Invalidates lines handed out before. Does not block on a port opened with
+ * serial_open().
+ * @param lines Splitter instance
+ * @param handle Valid serial port handle
+ * @param bytes_read Pointer to store number of bytes read
+ * @return SERIAL_SUCCESS, SERIAL_ERROR_OVERFLOW when the buffer is full, or error code
+ */
+int serial_lines_read(serial_lines_t *lines, serial_handle_t handle, size_t *bytes_read);
+
+/**
+ * @brief Hands out the next complete line
+ *
+ * A line longer than the buffer is handed out in buffer-sized pieces marked
+ * truncated. The view stays valid until the next feed, read or reset.
+ * @param lines Splitter instance
+ * @param line Receives the line
+ * @return 1 when line holds a line, 0 when no complete line is buffered
+ */
+int serial_lines_next(serial_lines_t *lines, struct serial_line_s *line);
+
+/**
+ * @brief Reads from a port until a complete line is available
+ *
+ * Lines already buffered are returned without reading. Bytes after the line
+ * stay buffered for the next call.
+ * @param lines Splitter instance
+ * @param handle Valid serial port handle
+ * @param deadline_ms Absolute deadline on the serial_monotonic_ms() clock
+ * @param line Receives the line
+ * @return SERIAL_SUCCESS, SERIAL_ERROR_TIMEOUT or error code
+ */
+int serial_lines_wait(serial_lines_t *lines, serial_handle_t handle, uint64_t deadline_ms,
+                      struct serial_line_s *line);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SERIAL_LINES_H_ */
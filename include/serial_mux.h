@@ -0,0 +1,129 @@
+/**
+ * @file serial_mux.h
+ * @brief Daemon sharing one serial link among many local clients (Linux only)
+ *
+ * The multiplexer owns an open serial handle and listens on a Unix domain
+ * stream socket. Clients speak the framed protocol of serial_frame.h over
+ * the socket exactly as they would over the port, so a handle from
+ * serial_mux_connect() works with serial_client and led_script unchanged.
+ *
+ * Each client numbers its own commands. The multiplexer queues them per
+ * client, takes one command from each client with work in turn (round
+ * robin, so a client with a deep pipeline cannot starve the others), gives
+ * it a link sequence number and sends it once fewer than `window` commands
+ * are in flight. All frames scheduled in one pass go out in one write. A
+ * GET_STATE that would follow another GET_STATE with nothing sent in
+ * between is not sent again: it shares the earlier reply. Replies are
+ * renumbered and routed back to the client that asked; frames the device
+ * sends on its own are copied to every client.
+ *
+ * A command the device does not answer within the timeout is dropped, and
+ * the client's own timeout reports it. A client that stops reading its
+ * replies is disconnected once SERIAL_MUX_CLIENT_BUFFER bytes are pending.
+ * Legacy single-character ASCII commands are not multiplexed.
+ */
+
+#ifndef SERIAL_MUX_H_
+#define SERIAL_MUX_H_
+
+#include "serial_functions.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(__linux__)
+
+#define SERIAL_MUX_DEFAULT_MAX_CLIENTS 1024
+#define SERIAL_MUX_CLIENT_QUEUE 64          /* commands queued per client before it is not read */
+#define SERIAL_MUX_CLIENT_BUFFER 4096       /* reply bytes pending per client */
+
+typedef struct serial_mux_s serial_mux_t;
+
+/* Multiplexer settings; pass NULL to serial_mux_create() for the defaults */
+struct serial_mux_config_s {
+    unsigned window;            /* link commands in flight, 1 to SERIAL_CLIENT_MAX_WINDOW */
+    int timeout_ms;             /* time the device has to answer a command */
+    unsigned max_clients;       /* connections beyond this are closed at once */
+};
+
+/* Counters; read them from the thread running the multiplexer or once it has returned */
+struct serial_mux_stats_s {
+    uint64_t accepted;          /* connections accepted */
+    uint64_t rejected;          /* connections refused for max_clients */
+    uint64_t disconnected;      /* clients dropped for not reading their replies */
+    uint64_t commands;          /* commands received from clients */
+    uint64_t link_commands;     /* commands sent to the device */
+    uint64_t coalesced;         /* commands answered by another command's reply */
+    uint64_t link_writes;       /* write calls on the link */
+    uint64_t timeouts;          /* link commands the device did not answer */
+    uint64_t unsolicited;       /* device frames copied to every client */
+    unsigned clients;           /* clients connected now */
+};
+
+/**
+ * @brief Starts listening for clients of a serial link
+ *
+ * A stale socket file at socket_path is replaced.
+ * @param device Open serial handle; the multiplexer does not take ownership
+ * @param socket_path Path of the Unix domain socket to create
+ * @param config Settings, or NULL for the defaults
+ * @return New multiplexer or NULL on error
+ */
+serial_mux_t *serial_mux_create(serial_handle_t device, const char *socket_path,
+                                const struct serial_mux_config_s *config);
+
+/**
+ * @brief Disconnects every client and removes the socket file
+ * @param mux Multiplexer to destroy (may be NULL)
+ */
+void serial_mux_destroy(serial_mux_t *mux);
+
+/**
+ * @brief Serves clients until serial_mux_stop() is called or the device hangs up
+ * @param mux Multiplexer instance
+ * @return SERIAL_SUCCESS after a stop, or error code
+ */
+int serial_mux_run(serial_mux_t *mux);
+
+/**
+ * @brief Waits for and handles one batch of events, for programs with their own loop
+ * @param mux Multiplexer instance
+ * @param timeout_ms Maximum time to block (negative waits for the next event)
+ * @return Number of events handled, or error code once the device has failed
+ */
+int serial_mux_run_once(serial_mux_t *mux, int timeout_ms);
+
+/**
+ * @brief Makes serial_mux_run() return
+ *
+ * Safe to call from another thread or a signal handler.
+ * @param mux Multiplexer instance
+ */
+void serial_mux_stop(serial_mux_t *mux);
+
+/**
+ * @brief Copies the counters
+ * @param mux Multiplexer instance
+ * @param stats Receives the counters
+ */
+void serial_mux_get_stats(const serial_mux_t *mux, struct serial_mux_stats_s *stats);
+
+/**
+ * @brief Connects to a multiplexer
+ *
+ * The handle works with serial_read(), serial_write(), the wait functions
+ * and serial_close(). Writing after the multiplexer has gone raises SIGPIPE
+ * unless the program ignores it.
+ * @param socket_path Path given to serial_mux_create()
+ * @return Handle or SERIAL_INVALID_HANDLE on error
+ */
+serial_handle_t serial_mux_connect(const char *socket_path);
+
+#endif /* __linux__ */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SERIAL_MUX_H_ */
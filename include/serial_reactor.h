@@ -0,0 +1,126 @@
+/**
+ * @file serial_reactor.h
+ * @brief Single-threaded event loop driving many serial ports
+ *
+ * The reactor registers any number of serial handles with one epoll instance
+ * and dispatches per-port readiness callbacks, so hundreds of devices can be
+ * serviced from a single thread. Each port also owns a one-shot timer that is
+ * typically armed as a response deadline.
+ *
+ * Only available on Linux.
+ */
+
+#ifndef SERIAL_REACTOR_H_
+#define SERIAL_REACTOR_H_
+
+#include "serial_functions.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(__linux__)
+
+/* Event interest flags */
+#define SERIAL_REACTOR_READ  0x01u
+#define SERIAL_REACTOR_WRITE 0x02u
+
+typedef struct serial_reactor_s serial_reactor_t;
+
+/* Per-port callbacks; any member may be NULL */
+struct serial_reactor_ops_s {
+    void (*on_readable)(serial_reactor_t *reactor, serial_handle_t handle, void *user_data);
+    void (*on_writable)(serial_reactor_t *reactor, serial_handle_t handle, void *user_data);
+    void (*on_timeout)(serial_reactor_t *reactor, serial_handle_t handle, void *user_data);
+    void (*on_error)(serial_reactor_t *reactor, serial_handle_t handle, void *user_data);
+};
+
+/**
+ * @brief Creates an empty reactor
+ * @return New reactor or NULL on error
+ */
+serial_reactor_t *serial_reactor_create(void);
+
+/**
+ * @brief Destroys a reactor; registered handles are not closed
+ * @param reactor Reactor to destroy (may be NULL)
+ */
+void serial_reactor_destroy(serial_reactor_t *reactor);
+
+/**
+ * @brief Registers a serial port with the reactor
+ *
+ * A hang-up or error is reported once the input queued before it has been
+ * read. If the port has no on_error callback it is removed instead, so the
+ * loop never spins on it.
+ * @param reactor Reactor instance
+ * @param handle Open serial handle (not already registered)
+ * @param events Combination of SERIAL_REACTOR_READ and SERIAL_REACTOR_WRITE
+ * @param ops Callback table, copied into the reactor
+ * @param user_data Pointer passed back to every callback
+ * @return SERIAL_SUCCESS or error code
+ */
+int serial_reactor_add(serial_reactor_t *reactor, serial_handle_t handle, unsigned events,
+                       const struct serial_reactor_ops_s *ops, void *user_data);
+
+/**
+ * @brief Changes the events a registered port is interested in
+ * @param reactor Reactor instance
+ * @param handle Registered serial handle
+ * @param events Combination of SERIAL_REACTOR_READ and SERIAL_REACTOR_WRITE
+ * @return SERIAL_SUCCESS or error code
+ */
+int serial_reactor_set_events(serial_reactor_t *reactor, serial_handle_t handle, unsigned events);
+
+/**
+ * @brief Unregisters a port; safe to call from inside a callback
+ * @param reactor Reactor instance
+ * @param handle Registered serial handle
+ * @return SERIAL_SUCCESS or error code
+ */
+int serial_reactor_remove(serial_reactor_t *reactor, serial_handle_t handle);
+
+/**
+ * @brief Arms or cancels the one-shot timer of a port
+ * @param reactor Reactor instance
+ * @param handle Registered serial handle
+ * @param timeout_ms Delay before on_timeout fires; negative cancels the timer
+ * @return SERIAL_SUCCESS or error code
+ */
+int serial_reactor_set_timer(serial_reactor_t *reactor, serial_handle_t handle, int timeout_ms);
+
+/**
+ * @brief Waits for and dispatches one batch of events and expired timers
+ * @param reactor Reactor instance
+ * @param timeout_ms Maximum time to block (negative waits for the next event or timer)
+ * @return Number of callbacks dispatched or error code
+ */
+int serial_reactor_run_once(serial_reactor_t *reactor, int timeout_ms);
+
+/**
+ * @brief Runs the loop until serial_reactor_stop() is called or no ports remain
+ * @param reactor Reactor instance
+ * @return SERIAL_SUCCESS or error code
+ */
+int serial_reactor_run(serial_reactor_t *reactor);
+
+/**
+ * @brief Makes serial_reactor_run() return after the current batch
+ * @param reactor Reactor instance
+ */
+void serial_reactor_stop(serial_reactor_t *reactor);
+
+/**
+ * @brief Returns the number of registered ports
+ * @param reactor Reactor instance
+ * @return Port count
+ */
+size_t serial_reactor_count(const serial_reactor_t *reactor);
+
+#endif /* __linux__ */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SERIAL_REACTOR_H_ */
@@ -0,0 +1,113 @@
+/**
+ * @file serial_ring.h
+ * @brief Lock-free single-producer/single-consumer byte ring
+ *
+ * Exactly one thread may call the producer functions (write, reserve, commit)
+ * and exactly one thread the consumer functions (read, peek, consume) at any
+ * time. The head and tail indices live on separate cache lines so producer
+ * and consumer never false-share.
+ */
+
+#ifndef SERIAL_RING_H_
+#define SERIAL_RING_H_
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct serial_ring_s serial_ring_t;
+
+/**
+ * @brief Creates a ring buffer
+ * @param capacity Requested capacity in bytes, rounded up to a power of two
+ * @return New ring or NULL on error
+ */
+serial_ring_t *serial_ring_create(size_t capacity);
+
+/**
+ * @brief Destroys a ring buffer
+ * @param ring Ring to destroy (may be NULL)
+ */
+void serial_ring_destroy(serial_ring_t *ring);
+
+/**
+ * @brief Returns the capacity of the ring in bytes
+ */
+size_t serial_ring_capacity(const serial_ring_t *ring);
+
+/**
+ * @brief Returns the storage behind the ring, e.g. to pre-fault or lock it before use
+ * @param ring Ring instance
+ * @return Start of serial_ring_capacity() bytes of storage
+ */
+void *serial_ring_storage(serial_ring_t *ring);
+
+/**
+ * @brief Returns the number of bytes available to the consumer
+ */
+size_t serial_ring_used(const serial_ring_t *ring);
+
+/**
+ * @brief Returns the number of bytes the producer can still write
+ */
+size_t serial_ring_space(const serial_ring_t *ring);
+
+/**
+ * @brief Copies data into the ring (producer)
+ * @param ring Ring instance
+ * @param data Data to append
+ * @param size Number of bytes to append
+ * @return Number of bytes written, less than size when the ring is full
+ */
+size_t serial_ring_write(serial_ring_t *ring, const void *data, size_t size);
+
+/**
+ * @brief Copies data out of the ring (consumer)
+ * @param ring Ring instance
+ * @param buffer Destination buffer
+ * @param size Maximum number of bytes to read
+ * @return Number of bytes read
+ */
+size_t serial_ring_read(serial_ring_t *ring, void *buffer, size_t size);
+
+/**
+ * @brief Returns the largest contiguous free region (producer)
+ *
+ * Lets the producer fill the ring in place, e.g. straight from read().
+ * @param ring Ring instance
+ * @param data Receives a pointer to the free region
+ * @return Size of the region in bytes
+ */
+size_t serial_ring_reserve(serial_ring_t *ring, void **data);
+
+/**
+ * @brief Publishes bytes filled in after serial_ring_reserve() (producer)
+ * @param ring Ring instance
+ * @param size Number of bytes to publish
+ */
+void serial_ring_commit(serial_ring_t *ring, size_t size);
+
+/**
+ * @brief Returns the largest contiguous readable region (consumer)
+ *
+ * Lets the consumer drain the ring in place, e.g. straight into write().
+ * @param ring Ring instance
+ * @param data Receives a pointer to the readable region
+ * @return Size of the region in bytes
+ */
+size_t serial_ring_peek(serial_ring_t *ring, const void **data);
+
+/**
+ * @brief Releases bytes obtained with serial_ring_peek() (consumer)
+ * @param ring Ring instance
+ * @param size Number of bytes to release
+ */
+void serial_ring_consume(serial_ring_t *ring, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SERIAL_RING_H_ */
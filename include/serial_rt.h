@@ -0,0 +1,87 @@
+/**
+ * @file serial_rt.h
+ * @brief Real-time settings for threads that service serial handles (Linux only)
+ *
+ * On a busy host the thread that reads replies competes for the CPU with
+ * everything else, so a reply that arrived on an idle link can wait a whole
+ * scheduler time slice before anyone looks at it. serial_rt_apply() lets the
+ * calling thread opt out of that:
+ *
+ *   - cpu pins the thread to one core, so it keeps a warm cache and is not
+ *     migrated behind other work;
+ *   - priority moves it to SCHED_FIFO, so it preempts every normal thread
+ *     as soon as its descriptor becomes readable;
+ *   - lock_memory pre-faults SERIAL_RT_STACK_PREFAULT bytes of stack and,
+ *     on the main thread, calls mlockall(MCL_CURRENT | MCL_FUTURE), so
+ *     servicing a reply never takes a page fault.
+ *
+ * Each setting is tried on its own and skipped when the process lacks the
+ * privilege (CAP_SYS_NICE or RLIMIT_RTPRIO for SCHED_FIFO), so the same
+ * configuration works everywhere; the applied flags tell what took effect.
+ * mlockall() applies to the whole process, so it is only called from the
+ * main thread, and only with CAP_IPC_LOCK or an unlimited RLIMIT_MEMLOCK:
+ * under a finite limit, MCL_FUTURE charges every later thread stack to it
+ * and pthread_create() starts failing. The stack is pre-faulted either way.
+ *
+ * Buffered handles, the emulator and the telemetry pipeline take a
+ * serial_rt_config_s for their own threads and pre-fault and mlock() their
+ * buffers instead; for serial_client, serial_reactor or serial_aio loops,
+ * call serial_rt_apply() from the thread that runs them.
+ */
+
+#ifndef SERIAL_RT_H_
+#define SERIAL_RT_H_
+
+#include "serial_functions.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(__linux__)
+
+#define SERIAL_RT_STACK_PREFAULT (64u << 10)
+
+/* Real-time settings; zero-initialised pins nothing, so set cpu to -1 or a core */
+struct serial_rt_config_s {
+    int cpu;                    /* core to pin the thread to, -1 to keep its affinity */
+    int priority;               /* SCHED_FIFO priority from 1 to 99, 0 to keep the normal policy */
+    int lock_memory;            /* pre-fault the stack, and mlockall() where allowed */
+};
+
+/* Settings that took effect, reported by serial_rt_apply() */
+enum serial_rt_applied_e {
+    SERIAL_RT_PINNED = 1u << 0,
+    SERIAL_RT_FIFO = 1u << 1,
+    SERIAL_RT_LOCKED = 1u << 2
+};
+
+/**
+ * @brief Applies real-time settings to the calling thread
+ *
+ * Settings the process is not allowed to use are skipped rather than
+ * failing the call.
+ * @param config Settings
+ * @param applied Receives the serial_rt_applied_e flags that took effect (may be NULL)
+ * @return SERIAL_SUCCESS, or SERIAL_ERROR_CONFIG for a core or priority out of range
+ */
+int serial_rt_apply(const struct serial_rt_config_s *config, unsigned *applied);
+
+/**
+ * @brief Pre-faults a buffer and locks it in memory where permitted
+ *
+ * Touches every page without changing its contents, so call it before
+ * other threads use the buffer.
+ * @param data Buffer
+ * @param size Buffer size in bytes
+ * @return 1 if the buffer is locked, 0 if it is only pre-faulted
+ */
+int serial_rt_prefault(void *data, size_t size);
+
+#endif /* __linux__ */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SERIAL_RT_H_ */
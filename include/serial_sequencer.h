@@ -0,0 +1,90 @@
+/**
+ * @file serial_sequencer.h
+ * @brief Deadline-scheduled command timelines with jitter reporting (Linux only)
+ *
+ * A timeline is a list of steps, each holding the bytes to send and the
+ * time they are due, as an offset from the start of the run. The sequencer
+ * waits for each deadline on an absolute CLOCK_MONOTONIC time, with a
+ * timerfd or clock_nanosleep(TIMER_ABSTIME), and sends the step with
+ * serial_write_all(). Because every wait targets the planned time rather
+ * than "period after the previous write", the time spent writing and the
+ * wake-up latency of one step are not carried into the next, so a long
+ * animation ends on time instead of drifting behind by the sum of its
+ * delays, as a loop around usleep() does.
+ *
+ * The kernel wakes a sleeping thread some tens of microseconds after the
+ * deadline. Setting spin_ns wakes the sequencer that much early and polls
+ * the clock until the deadline, trading CPU time for lower jitter.
+ *
+ * Every run reports how late each step was, from the planned time to the
+ * start and to the end of its write, in serial_histogram_s histograms.
+ */
+
+#ifndef SERIAL_SEQUENCER_H_
+#define SERIAL_SEQUENCER_H_
+
+#include "serial_stats.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(__linux__)
+
+#define SERIAL_SEQUENCER_DEFAULT_WRITE_TIMEOUT_MS 1000
+
+/* How the sequencer sleeps until a deadline */
+enum serial_sequencer_wait_e {
+    SERIAL_SEQUENCER_TIMERFD = 0,   /* absolute timerfd, one descriptor per run */
+    SERIAL_SEQUENCER_NANOSLEEP = 1  /* clock_nanosleep() with TIMER_ABSTIME */
+};
+
+/* One timeline entry */
+struct serial_sequence_step_s {
+    uint64_t due_ns;            /* planned send time, from the start of the run; not decreasing */
+    const void *data;           /* bytes to send, e.g. an encoded frame */
+    size_t length;
+};
+
+/* Sequencer settings; pass NULL to serial_sequencer_run() for the defaults */
+struct serial_sequencer_config_s {
+    int wait;                   /* serial_sequencer_wait_e */
+    uint64_t spin_ns;           /* wake this early and spin to the deadline, 0 to only sleep */
+    uint64_t skip_late_ns;      /* drop steps this late or later instead of sending them, 0 to send all */
+    int write_timeout_ms;       /* per step, 0 for SERIAL_SEQUENCER_DEFAULT_WRITE_TIMEOUT_MS */
+    uint64_t start_ns;          /* serial_monotonic_ns() time of step offset 0, 0 for when the run starts */
+};
+
+/* Outcome of a run; lateness is achieved minus planned time */
+struct serial_sequencer_report_s {
+    uint64_t sent;              /* steps written */
+    uint64_t skipped;           /* steps dropped by skip_late_ns */
+    uint64_t start_ns;          /* serial_monotonic_ns() time of step offset 0 */
+    uint64_t elapsed_ns;        /* start_ns to the end of the last write */
+    struct serial_histogram_s dispatch_lateness;    /* deadline to the start of the write */
+    struct serial_histogram_s complete_lateness;    /* deadline to the end of the write */
+};
+
+/**
+ * @brief Sends a timeline, each step at its due time
+ *
+ * Blocks until the last step is written. A step whose deadline has already
+ * passed is sent at once, so a stall delays the steps behind it only until
+ * the sequencer has caught up.
+ * @param handle Open serial handle
+ * @param steps Timeline, sorted by due_ns
+ * @param count Number of steps
+ * @param config Settings, or NULL for the defaults
+ * @param report Receives the counters and lateness histograms (may be NULL)
+ * @return SERIAL_SUCCESS, SERIAL_ERROR_CONFIG for an unsorted timeline or bad settings, or the write error
+ */
+int serial_sequencer_run(serial_handle_t handle, const struct serial_sequence_step_s *steps, size_t count,
+                         const struct serial_sequencer_config_s *config, struct serial_sequencer_report_s *report);
+
+#endif /* __linux__ */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SERIAL_SEQUENCER_H_ */
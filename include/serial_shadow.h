@@ -0,0 +1,143 @@
+/**
+ * @file serial_shadow.h
+ * @brief Host-side mirror of the device's LED state that skips redundant commands
+ *
+ * The shadow sits in front of a serial_client. It tracks the LED state the
+ * device reported in its last acknowledgement plus the effect of every
+ * command still in flight, and for each state bit whether it is known. A
+ * command that would leave every LED it touches as it already is (LED_ON of
+ * LEDs that are on, LED_SET to the current state, a BATCH made of such
+ * steps) is not sent, and GET_STATE is answered from the mirror while the
+ * whole state is known. Both complete at once through the callback with an
+ * ACK built from the mirror and a latency of 0.
+ *
+ * Every ACK carries the device state, so the mirror resynchronises on each
+ * reply: the reported state replaces the prediction and the commands still
+ * in flight are applied on top of it. A reply that disagrees with the
+ * prediction (another program or a reset changed the LEDs) is counted as a
+ * mismatch. A NAK or a timeout makes the state unknown until the next ACK,
+ * so the following commands are sent and a GET_STATE goes to the device.
+ *
+ * On a link other programs also write to, such as a serial_mux socket, set
+ * max_age_ms so that a mirror nobody has confirmed for that long is not
+ * trusted. Call serial_shadow_invalidate() after reopening the port: the
+ * sketch restarts with every LED off when the port opens, but the shadow
+ * cannot tell.
+ */
+
+#ifndef SERIAL_SHADOW_H_
+#define SERIAL_SHADOW_H_
+
+#include "serial_client.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SERIAL_SHADOW_KNOWN_ALL 0xFFu
+
+/* LED state with the bits that are known; zero-initialised means nothing is known */
+struct serial_led_state_s {
+    uint8_t leds;               /* SERIAL_LED_* bits believed to be on */
+    uint8_t known;              /* bits of leds that are known, SERIAL_SHADOW_KNOWN_ALL when all are */
+};
+
+typedef struct serial_shadow_s serial_shadow_t;
+
+/* Shadow settings; pass NULL to serial_shadow_create() for the defaults */
+struct serial_shadow_config_s {
+    int max_age_ms;             /* trust the mirror this long after the last ACK, 0 for ever */
+};
+
+/* Counters */
+struct serial_shadow_stats_s {
+    uint64_t commands;          /* commands submitted to the shadow */
+    uint64_t sent;              /* commands passed on to the client */
+    uint64_t elided;            /* commands not sent because they would change nothing */
+    uint64_t local_queries;     /* GET_STATE answered from the mirror */
+    uint64_t mismatches;        /* ACKs whose state differed from the prediction */
+    uint64_t invalidations;     /* times the whole state became unknown */
+};
+
+/**
+ * @brief Tells whether a command would leave the LED state unchanged
+ * @param state Current state
+ * @param cmd Command identifier (see serial_frame_cmd_e)
+ * @param payload Command payload (may be NULL when length is 0)
+ * @param length Payload size
+ * @return 1 when the known state shows the command to be a no-op, otherwise 0
+ */
+int serial_led_state_is_noop(const struct serial_led_state_s *state, uint8_t cmd, const void *payload,
+                             size_t length);
+
+/**
+ * @brief Applies the effect a command has on the device when it is accepted
+ *
+ * Commands the device would reject leave the state unchanged; a BATCH the
+ * device would stop part way makes the state unknown.
+ * @param state State to update
+ * @param cmd Command identifier (see serial_frame_cmd_e)
+ * @param payload Command payload (may be NULL when length is 0)
+ * @param length Payload size
+ */
+void serial_led_state_apply(struct serial_led_state_s *state, uint8_t cmd, const void *payload, size_t length);
+
+/**
+ * @brief Creates a shadow in front of a client
+ * @param client Client to send commands on; the shadow does not take ownership
+ * @param config Settings, or NULL for the defaults
+ * @return New shadow or NULL on error
+ */
+serial_shadow_t *serial_shadow_create(serial_client_t *client, const struct serial_shadow_config_s *config);
+
+/**
+ * @brief Destroys a shadow; destroy it together with its client
+ * @param shadow Shadow to destroy (may be NULL)
+ */
+void serial_shadow_destroy(serial_shadow_t *shadow);
+
+/**
+ * @brief Sends a command unless the mirror can complete it
+ *
+ * Takes the same arguments as serial_client_submit(). The callback receives
+ * the underlying client and runs before this returns when the command is
+ * elided or answered locally. Replies are collected with serial_client_poll()
+ * and serial_client_drain() on the client.
+ * @param shadow Shadow instance
+ * @param cmd Command identifier (see serial_frame_cmd_e)
+ * @param payload Command payload (may be NULL when length is 0)
+ * @param length Payload size, at most SERIAL_FRAME_MAX_PAYLOAD
+ * @param callback Completion callback (may be NULL)
+ * @param user_data Pointer passed back to the callback
+ * @return SERIAL_SUCCESS or error code
+ */
+int serial_shadow_submit(serial_shadow_t *shadow, uint8_t cmd, const void *payload, size_t length,
+                         serial_client_callback_t callback, void *user_data);
+
+/**
+ * @brief Forgets the mirrored state, e.g. after the port was reopened
+ *
+ * The next GET_STATE goes to the device and its reply restores the mirror.
+ * @param shadow Shadow instance
+ */
+void serial_shadow_invalidate(serial_shadow_t *shadow);
+
+/**
+ * @brief Returns the predicted state after every command submitted so far
+ * @param shadow Shadow instance
+ * @param state Receives the state and its known bits
+ */
+void serial_shadow_get_state(const serial_shadow_t *shadow, struct serial_led_state_s *state);
+
+/**
+ * @brief Copies the counters
+ * @param shadow Shadow instance
+ * @param stats Receives the counters
+ */
+void serial_shadow_get_stats(const serial_shadow_t *shadow, struct serial_shadow_stats_s *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SERIAL_SHADOW_H_ */
@@ -0,0 +1,109 @@
+/**
+ * @file serial_stats.h
+ * @brief Opt-in per-handle I/O counters and latency histograms
+ *
+ * Once enabled on a handle, every read and write system call on it is
+ * counted, including the ones issued by the buffered-mode I/O thread, so a
+ * misbehaving line can be diagnosed as syscall-bound, starved by EAGAIN or
+ * hitting short writes. Updates are relaxed atomic increments without locks
+ * and are cheap enough to leave on in production; handles without stats pay
+ * a single table lookup.
+ *
+ * Write-to-first-byte latency is the time from the first write after the
+ * last received data to the next read that returns data, i.e. the command
+ * round trip as the application sees it. It is kept in a log-bucketed
+ * histogram with 8 sub-buckets per power of two (relative error below 12.5%).
+ * The histogram type can also be filled directly, for latencies the
+ * application measures itself.
+ *
+ * Histograms work on every platform; per-handle counters are only
+ * available on Linux.
+ */
+
+#ifndef SERIAL_STATS_H_
+#define SERIAL_STATS_H_
+
+#include "serial_functions.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SERIAL_HISTOGRAM_SUB_BITS 3
+#define SERIAL_HISTOGRAM_BUCKETS ((64 - SERIAL_HISTOGRAM_SUB_BITS + 1) << SERIAL_HISTOGRAM_SUB_BITS)
+
+/* Log-bucketed histogram of nanosecond values; zero-initialise before use */
+struct serial_histogram_s {
+    uint64_t counts[SERIAL_HISTOGRAM_BUCKETS];
+    uint64_t count;
+    uint64_t sum_ns;
+    uint64_t max_ns;
+};
+
+/**
+ * @brief Adds one value to a histogram (not thread-safe)
+ * @param histogram Histogram to update
+ * @param value_ns Value in nanoseconds
+ */
+void serial_histogram_record(struct serial_histogram_s *histogram, uint64_t value_ns);
+
+/**
+ * @brief Returns the value at a quantile of a histogram
+ * @param histogram Histogram snapshot
+ * @param quantile Quantile between 0.0 and 1.0 (e.g. 0.99)
+ * @return Upper bound of the bucket holding the quantile, in nanoseconds, or 0 if empty
+ */
+uint64_t serial_histogram_quantile(const struct serial_histogram_s *histogram, double quantile);
+
+#if defined(__linux__)
+
+/* Snapshot of the counters of one handle */
+struct serial_stats_s {
+    uint64_t bytes_read;
+    uint64_t bytes_written;
+    uint64_t read_syscalls;         /* read()/readv() calls on the descriptor, or transport reads */
+    uint64_t write_syscalls;        /* write()/writev() calls on the descriptor, or transport writes */
+    uint64_t read_eagain;           /* reads that found no data */
+    uint64_t write_eagain;          /* writes that found the output queue full */
+    uint64_t short_writes;          /* writes that accepted only part of the data */
+    uint64_t read_errors;
+    uint64_t write_errors;
+    struct serial_histogram_s first_byte_latency;
+};
+
+/**
+ * @brief Starts collecting statistics on a handle, from zero
+ *
+ * The counters are allocated on the first call and kept until serial_close(),
+ * so enabling and disabling may race with I/O on other threads. Counts from
+ * I/O that overlaps the call may land on either side of the reset.
+ * @param handle Open serial handle
+ * @return SERIAL_SUCCESS or error code
+ */
+int serial_enable_stats(serial_handle_t handle);
+
+/**
+ * @brief Stops collecting statistics on a handle; the counters are freed by serial_close()
+ * @param handle Serial handle
+ * @return SERIAL_SUCCESS or error code
+ */
+int serial_disable_stats(serial_handle_t handle);
+
+/**
+ * @brief Copies the current counters of a handle
+ *
+ * Counters are read one by one while I/O may continue, so the snapshot is
+ * not atomic as a whole.
+ * @param handle Serial handle with stats enabled
+ * @param stats Receives the counters
+ * @return SERIAL_SUCCESS, or SERIAL_ERROR_INVALID_HANDLE if stats are not enabled
+ */
+int serial_get_stats(serial_handle_t handle, struct serial_stats_s *stats);
+
+#endif /* __linux__ */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SERIAL_STATS_H_ */
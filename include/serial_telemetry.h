@@ -0,0 +1,229 @@
+/**
+ * @file serial_telemetry.h
+ * @brief Sensor sample ingestion into memory-mapped columnar logs (Linux only)
+ *
+ * Boards stream readings as SERIAL_CMD_SAMPLES frames: a 32-bit microsecond
+ * timestamp followed by one signed 16-bit value per channel, little endian.
+ * The device sends them on its own and the host does not acknowledge them.
+ *
+ * A telemetry log is a file sized for a fixed number of rows when it is
+ * created and mapped into memory, so appending a row is a few stores and
+ * never allocates or calls into the kernel. Each channel is a contiguous
+ * column, next to a column of timestamps widened to 64 bits, so a reader
+ * scans one channel without touching the others. Rows can be decimated:
+ * every group of `decimation` samples becomes one row holding the last
+ * sample, or the mean, minimum or maximum of the group per channel.
+ *
+ * File layout, native byte order: a serial_telemetry_header_s padded to
+ * SERIAL_TELEMETRY_ALIGN bytes, the time column of `capacity` uint64_t
+ * values, then `channels` columns of `capacity` int16_t values, each
+ * starting on a SERIAL_TELEMETRY_ALIGN boundary. Pages written since the
+ * last sync are flushed with msync(), so after a crash of the machine at
+ * most one sync period is lost; after a crash of the process nothing is.
+ *
+ * The pipeline reads any number of ports and appends their samples to one
+ * log per port in two stages. A reader thread services every port from one
+ * epoll loop and reads straight into a per-port ring buffer. A parser
+ * thread decodes the frames from the rings and appends the rows. The rings
+ * absorb the parser's pauses, such as a sync, so the reader keeps draining
+ * the ports. If a ring still fills up, the reader stops reading that port
+ * until the parser has caught up, and the bytes wait in the driver.
+ */
+
+#ifndef SERIAL_TELEMETRY_H_
+#define SERIAL_TELEMETRY_H_
+
+#include "serial_frame.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(__linux__)
+
+#define SERIAL_TELEMETRY_MAGIC "SERTLM\r\n"
+#define SERIAL_TELEMETRY_VERSION 1
+#define SERIAL_TELEMETRY_ALIGN 4096u
+#define SERIAL_TELEMETRY_MAX_CHANNELS ((SERIAL_FRAME_MAX_PAYLOAD - 4) / 2)
+#define SERIAL_TELEMETRY_DEFAULT_RING (64u << 10)
+#define SERIAL_TELEMETRY_DEFAULT_SYNC_MS 1000
+
+/* How a group of `decimation` samples becomes one row */
+enum serial_telemetry_aggregate_e {
+    SERIAL_TELEMETRY_LAST = 0,  /* the last sample of the group */
+    SERIAL_TELEMETRY_MEAN = 1,  /* per-channel mean, rounded toward zero */
+    SERIAL_TELEMETRY_MIN = 2,
+    SERIAL_TELEMETRY_MAX = 3
+};
+
+/* File header */
+struct serial_telemetry_header_s {
+    char magic[8];              /* SERIAL_TELEMETRY_MAGIC */
+    uint32_t version;           /* SERIAL_TELEMETRY_VERSION */
+    uint32_t channels;
+    uint64_t capacity;          /* rows the file has room for */
+    uint64_t rows;              /* rows written */
+    uint32_t decimation;        /* samples per row */
+    uint32_t aggregate;         /* serial_telemetry_aggregate_e */
+    uint64_t time_offset;       /* file offset of the time column */
+    uint64_t column_offset;     /* file offset of the first channel column */
+    uint64_t column_stride;     /* bytes from one channel column to the next */
+};
+
+/* Log settings */
+struct serial_telemetry_log_config_s {
+    unsigned channels;          /* 1 to SERIAL_TELEMETRY_MAX_CHANNELS */
+    uint64_t capacity;          /* rows to allocate */
+    unsigned decimation;        /* samples per row, 0 or 1 for every sample */
+    int aggregate;              /* serial_telemetry_aggregate_e */
+};
+
+typedef struct serial_telemetry_log_s serial_telemetry_log_t;
+
+/**
+ * @brief Creates a log file with room for config->capacity rows and maps it
+ *
+ * An existing file is replaced. The whole file is allocated on disk up
+ * front, so running out of space shows up here and not while appending.
+ * @param path File to create
+ * @param config Channel count, capacity and decimation
+ * @return New log, or NULL if the settings are invalid or the file cannot be created
+ */
+serial_telemetry_log_t *serial_telemetry_log_create(const char *path,
+                                                    const struct serial_telemetry_log_config_s *config);
+
+/**
+ * @brief Maps an existing log for reading
+ * @param path Log file
+ * @return Log handle, or NULL if the file is missing or not a log
+ */
+serial_telemetry_log_t *serial_telemetry_log_open(const char *path);
+
+/**
+ * @brief Appends one sample
+ *
+ * With decimation the row is written once its group is complete. A sample
+ * that arrives when the log is full is dropped.
+ * @param log Log created with serial_telemetry_log_create()
+ * @param time_us Device time of the sample; a 32-bit counter that wraps is widened
+ * @param values One value per channel
+ * @return SERIAL_SUCCESS, or SERIAL_ERROR_OVERFLOW when the log is full
+ */
+int serial_telemetry_log_append(serial_telemetry_log_t *log, uint32_t time_us, const int16_t *values);
+
+/**
+ * @brief Flushes the rows written since the last sync to disk with msync()
+ * @param log Log created with serial_telemetry_log_create()
+ * @return SERIAL_SUCCESS or SERIAL_ERROR_WRITE
+ */
+int serial_telemetry_log_sync(serial_telemetry_log_t *log);
+
+/**
+ * @brief Writes an incomplete decimation group as a last row, syncs and unmaps a log
+ * @param log Log handle (NULL is ignored)
+ * @return SERIAL_SUCCESS, or SERIAL_ERROR_WRITE if the final sync failed
+ */
+int serial_telemetry_log_close(serial_telemetry_log_t *log);
+
+/**
+ * @brief Returns the header of a log, including the current row count
+ */
+const struct serial_telemetry_header_s *serial_telemetry_log_header(const serial_telemetry_log_t *log);
+
+/**
+ * @brief Returns the time column: one widened device timestamp in microseconds per row
+ */
+const uint64_t *serial_telemetry_log_times(const serial_telemetry_log_t *log);
+
+/**
+ * @brief Returns the column of one channel, or NULL if the channel does not exist
+ */
+const int16_t *serial_telemetry_log_column(const serial_telemetry_log_t *log, unsigned channel);
+
+/**
+ * @brief Encodes one sample as a SERIAL_CMD_SAMPLES frame, as a board sends it
+ * @param seq Sequence number
+ * @param time_us Device time in microseconds
+ * @param values One value per channel
+ * @param channels Number of values, 1 to SERIAL_TELEMETRY_MAX_CHANNELS
+ * @param out Output buffer, SERIAL_FRAME_MAX_ENCODED bytes is always enough
+ * @param out_size Size of the output buffer
+ * @param out_length Pointer to store the encoded size
+ * @return SERIAL_SUCCESS, SERIAL_ERROR_CONFIG for a bad channel count, or SERIAL_ERROR_OVERFLOW
+ */
+int serial_telemetry_encode(uint8_t seq, uint32_t time_us, const int16_t *values, unsigned channels, uint8_t *out,
+                            size_t out_size, size_t *out_length);
+
+/* Pipeline settings; pass NULL to serial_telemetry_create() for the defaults */
+struct serial_telemetry_config_s {
+    size_t ring_size;           /* bytes buffered per port between the stages, 0 for SERIAL_TELEMETRY_DEFAULT_RING */
+    int sync_ms;                /* msync() period of the logs, 0 for the default, negative only when stopping */
+    const struct serial_rt_config_s *rt;    /* real-time settings for the reader thread (may be NULL) */
+};
+
+/* Counters summed over all ports; exact once serial_telemetry_stop() has returned */
+struct serial_telemetry_stats_s {
+    uint64_t bytes;             /* bytes read from the ports */
+    uint64_t pauses;            /* times a port was not read because its ring was full */
+    uint64_t samples;           /* sample frames decoded */
+    uint64_t rows;              /* rows appended to the logs */
+    uint64_t full;              /* samples dropped because their log was full */
+    uint64_t bad_frames;        /* frames dropped for bad COBS or CRC, or a sample of the wrong size */
+    uint64_t other_frames;      /* valid frames that are not samples */
+    uint64_t syncs;             /* periodic msync() passes */
+};
+
+typedef struct serial_telemetry_s serial_telemetry_t;
+
+/**
+ * @brief Creates a stopped pipeline with no ports
+ * @param config Settings, or NULL for the defaults
+ * @return New pipeline, or NULL if the settings are invalid or resources are exhausted
+ */
+serial_telemetry_t *serial_telemetry_create(const struct serial_telemetry_config_s *config);
+
+/**
+ * @brief Stops the pipeline if it runs and frees it; ports and logs stay open
+ * @param telemetry Pipeline (NULL is ignored)
+ */
+void serial_telemetry_destroy(serial_telemetry_t *telemetry);
+
+/**
+ * @brief Adds a port whose samples go to a log; only while the pipeline is stopped
+ *
+ * Samples must have as many channels as the log. Give each port its own log.
+ * @param telemetry Pipeline
+ * @param handle Open descriptor handle, not a transport or buffered handle
+ * @param log Log created with serial_telemetry_log_create()
+ * @return SERIAL_SUCCESS, SERIAL_ERROR_CONFIG if the port cannot be added, or error code
+ */
+int serial_telemetry_add(serial_telemetry_t *telemetry, serial_handle_t handle, serial_telemetry_log_t *log);
+
+/**
+ * @brief Starts the reader and parser threads
+ * @param telemetry Pipeline
+ * @return SERIAL_SUCCESS or SERIAL_ERROR_CONFIG if a thread cannot start
+ */
+int serial_telemetry_start(serial_telemetry_t *telemetry);
+
+/**
+ * @brief Stops reading, appends what the rings still hold and syncs the logs
+ * @param telemetry Pipeline
+ * @return SERIAL_SUCCESS, or SERIAL_ERROR_WRITE if a log could not be synced
+ */
+int serial_telemetry_stop(serial_telemetry_t *telemetry);
+
+/**
+ * @brief Returns the counters of a pipeline
+ * @param telemetry Pipeline
+ * @param stats Receives the counters
+ */
+void serial_telemetry_stats(const serial_telemetry_t *telemetry, struct serial_telemetry_stats_s *stats);
+
+#endif /* __linux__ */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SERIAL_TELEMETRY_H_ */
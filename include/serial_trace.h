@@ -0,0 +1,125 @@
+/**
+ * @file serial_trace.h
+ * @brief Opt-in span tracing exported as Chrome Trace Event JSON
+ *
+ * Records where the time of each command goes: serial_client commands are
+ * split into queued (submitted, waiting for the window), write (the write
+ * calls), device (from the write until a read first returns data: kernel
+ * transmit, the device and the way back), receive (until the read holding
+ * the end of the reply), parse (frame decoding) and callback spans. Read
+ * and write system calls on descriptor handles, and the transport calls
+ * that stand in for them, get spans of their own.
+ * The dump loads in chrome://tracing and https://ui.perfetto.dev; commands
+ * are async slices, system calls sit on the thread that made them.
+ *
+ * Each thread appends to its own fixed-size buffer, created on its first
+ * span and kept after the thread exits, without locks or atomic
+ * read-modify-write operations. A full buffer drops new spans and counts
+ * them. A dump copies what is there while threads keep recording.
+ *
+ * Tracing is off until serial_trace_start(); until then each trace point
+ * costs one relaxed load and a branch. Built without SERIAL_USE_TRACE
+ * (make TRACE=0) or for another platform than Linux, the library has no
+ * trace points at all and serial_trace_start() fails.
+ *
+ * Span and argument names must be string literals or otherwise outlive the
+ * last dump; they are stored by pointer.
+ */
+
+#ifndef SERIAL_TRACE_H_
+#define SERIAL_TRACE_H_
+
+#include "serial_functions.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SERIAL_TRACE_DEFAULT_CAPACITY 16384
+
+/* Counters over all thread buffers */
+struct serial_trace_stats_s {
+    uint64_t spans;             /* spans held in the buffers */
+    uint64_t dropped;           /* spans lost to a full buffer */
+    unsigned threads;           /* threads that have recorded */
+};
+
+/**
+ * @brief Turns recording on
+ * @param capacity Spans per thread buffer, 0 for SERIAL_TRACE_DEFAULT_CAPACITY; only
+ *                 buffers created afterwards use a new capacity
+ * @return SERIAL_SUCCESS, or SERIAL_ERROR_CONFIG when tracing is compiled out
+ */
+int serial_trace_start(size_t capacity);
+
+/**
+ * @brief Turns recording off; recorded spans stay for the next dump
+ */
+void serial_trace_stop(void);
+
+/**
+ * @brief Returns 1 while recording is on
+ */
+int serial_trace_enabled(void);
+
+/**
+ * @brief Returns a new id for serial_trace_async(), unique within the process
+ */
+uint64_t serial_trace_id(void);
+
+/**
+ * @brief Records a span on the calling thread (ignored while recording is off)
+ * @param name Span name
+ * @param start_ns Start, from serial_monotonic_ns()
+ * @param end_ns End, from serial_monotonic_ns()
+ * @param arg_name Name of the argument shown with the span, or NULL for none
+ * @param arg Argument value
+ */
+void serial_trace_span(const char *name, uint64_t start_ns, uint64_t end_ns, const char *arg_name, int64_t arg);
+
+/**
+ * @brief Records a span of an operation that is not tied to one thread
+ *
+ * Spans with the same id are shown together, nested by time.
+ * @param name Span name
+ * @param id Operation id from serial_trace_id()
+ * @param start_ns Start, from serial_monotonic_ns()
+ * @param end_ns End, from serial_monotonic_ns()
+ * @param arg_name Name of the argument shown with the span, or NULL for none
+ * @param arg Argument value
+ */
+void serial_trace_async(const char *name, uint64_t id, uint64_t start_ns, uint64_t end_ns, const char *arg_name,
+                        int64_t arg);
+
+/**
+ * @brief Writes every recorded span to a file as Chrome Trace Event JSON
+ * @param path Output file, replaced if it exists
+ * @return SERIAL_SUCCESS, SERIAL_ERROR_WRITE, or SERIAL_ERROR_CONFIG when tracing is compiled out
+ */
+int serial_trace_dump(const char *path);
+
+/**
+ * @brief Dumps to a file when the process exits, and whenever a signal arrives
+ *
+ * The exit dump runs from atexit(), so it happens on a return from main()
+ * or exit() but not when the process is killed. The signal handler only
+ * wakes a helper thread that writes the dump, so the signal may arrive at
+ * any point. A later call replaces the path.
+ * @param path Output file, or NULL to cancel both dumps
+ * @param signal_number Signal that triggers a dump, e.g. SIGUSR1, or 0 for none
+ * @return SERIAL_SUCCESS, or SERIAL_ERROR_CONFIG if the path is too long, the handler cannot
+ *         be installed or tracing is compiled out
+ */
+int serial_trace_dump_at_exit(const char *path, int signal_number);
+
+/**
+ * @brief Returns the counters over all thread buffers
+ * @param stats Receives the counters
+ */
+void serial_trace_stats(struct serial_trace_stats_s *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SERIAL_TRACE_H_ */
@@ -0,0 +1,99 @@
+/**
+ * @file serial_transport.h
+ * @brief Handles backed by a transport other than a kernel tty (Linux only)
+ *
+ * serial_open() handles are tty descriptors and go straight to the kernel.
+ * A handle can instead be bound to a table of transport operations with
+ * serial_open_transport(); serial_read(), serial_write(), their vector forms,
+ * the wait functions, serial_read_until(), serial_get_baud() and
+ * serial_close() then call the table. Statistics, capture and tracing see
+ * such handles like descriptors: each read or write operation counts as a
+ * system call, and 0 bytes moved as EAGAIN. Buffered mode, the reactor and
+ * serial_aio need a descriptor and reject them.
+ *
+ * Built-in transports:
+ * - pty: serial_open_pty() opens the device side of a pseudo-terminal as a
+ *   plain descriptor handle, for programs that act as the device.
+ * - loopback: serial_loopback_create() connects two handles through
+ *   in-memory rings. Reads and writes are memory copies and make no system
+ *   calls unless the other end is blocked in a wait, so protocol, batching
+ *   and parsing code can be measured without kernel noise.
+ *
+ * A transport handle still owns a descriptor (an eventfd) so its number can
+ * never collide with a real port.
+ */
+
+#ifndef SERIAL_TRANSPORT_H_
+#define SERIAL_TRANSPORT_H_
+
+#include "serial_functions.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(__linux__)
+
+/*
+ * Transport operations. read, write and close are required; the others may
+ * be NULL: vector I/O then loops over read or write, waits report ready at
+ * once and serial_get_baud() fails with SERIAL_ERROR_CONFIG.
+ */
+struct serial_transport_ops_s {
+    const char *name;
+    int (*read)(void *state, void *buffer, size_t size, size_t *bytes_read);
+    int (*write)(void *state, const void *data, size_t size, size_t *bytes_written);
+    int (*readv)(void *state, const struct iovec *iov, int iovcnt, size_t *bytes_read);
+    int (*writev)(void *state, const struct iovec *iov, int iovcnt, size_t *bytes_written);
+    int (*wait_readable)(void *state, int timeout_ms);
+    int (*wait_writable)(void *state, int timeout_ms);
+    int (*get_baud)(void *state, uint32_t *baud_rate);
+    int (*close)(void *state);
+};
+
+/**
+ * @brief Creates a handle that dispatches to a transport
+ * @param ops Operations table, must outlive the handle
+ * @param state Passed to every operation; released by ops->close
+ * @return New handle or SERIAL_INVALID_HANDLE on error
+ */
+serial_handle_t serial_open_transport(const struct serial_transport_ops_s *ops, void *state);
+
+/**
+ * @brief Returns the operations table of a handle
+ * @param handle Serial handle
+ * @return Table passed to serial_open_transport(), or NULL for a descriptor handle
+ */
+const struct serial_transport_ops_s *serial_transport_ops(serial_handle_t handle);
+
+/**
+ * @brief Opens a pseudo-terminal and returns its device side
+ *
+ * The pty is in raw mode, so a program opening peer_path with serial_open()
+ * sees exactly the bytes written to the returned handle.
+ * @param peer_path Receives the path for the other program to open
+ * @param size Size of peer_path
+ * @return Descriptor handle of the pty master, or SERIAL_INVALID_HANDLE on error
+ */
+serial_handle_t serial_open_pty(char *peer_path, size_t size);
+
+/**
+ * @brief Creates two handles connected by in-memory rings
+ *
+ * Bytes written to one handle are read from the other. Each handle may be
+ * used by one reading and one writing thread at a time. Once one end is
+ * closed, the other reads what is left and then gets SERIAL_ERROR_READ;
+ * writes fail with SERIAL_ERROR_WRITE.
+ * @param handles Receives the two ends
+ * @param capacity Ring size per direction, rounded up to a power of two (0 for 4096)
+ * @return SERIAL_SUCCESS or error code
+ */
+int serial_loopback_create(serial_handle_t handles[2], size_t capacity);
+
+#endif /* __linux__ */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SERIAL_TRANSPORT_H_ */
@@ -0,0 +1,221 @@
+/**
+ * @file led_firmware.c
+ * @brief Non-blocking command handling shared by the sketch and the host emulator
+ */
+
+#include "led_firmware.h"
+
+#include <string.h>
+
+static const char *const ASCII_REPLIES[] = {"LED RED ON\r\n", "LED YELLOW ON\r\n", "LED BLUE ON\r\n", "LEDS OFF\r\n"};
+
+void led_firmware_init(struct led_firmware_s *firmware) {
+    memset(firmware, 0, sizeof(*firmware));
+}
+
+uint8_t led_firmware_leds(const struct led_firmware_s *firmware) {
+    return firmware->leds;
+}
+
+/* CRC-16/CCITT-FALSE a nibble at a time: a quarter of the bitwise loop's steps for 32 bytes of table */
+static uint16_t crc16(const uint8_t *data, uint16_t size) {
+    static const uint16_t NIBBLE_TABLE[16] = {
+        0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+        0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF,
+    };
+    uint16_t crc = 0xFFFF;
+    for (uint16_t i = 0; i < size; i++) {
+        crc = (uint16_t)((crc << 4) ^ NIBBLE_TABLE[(crc >> 12) ^ (data[i] >> 4)]);
+        crc = (uint16_t)((crc << 4) ^ NIBBLE_TABLE[(crc >> 12) ^ (data[i] & 0x0F)]);
+    }
+    return crc;
+}
+
+/* Decodes COBS in place, returns decoded size or 0 on error */
+static uint16_t cobs_decode(uint8_t *data, uint16_t size) {
+    uint16_t read_index = 0;
+    uint16_t write_index = 0;
+    while (read_index < size) {
+        uint8_t code = data[read_index++];
+        if (code == 0 || read_index + code - 1 > size) {
+            return 0;
+        }
+        for (uint8_t i = 1; i < code; i++) {
+            data[write_index++] = data[read_index++];
+        }
+        if (code != 0xFF && read_index < size) {
+            data[write_index++] = 0;
+        }
+    }
+    return write_index;
+}
+
+static void queue_byte(struct led_firmware_s *firmware, uint8_t byte) {
+    firmware->tx[(uint8_t)(firmware->tx_head + firmware->tx_count) % LED_FIRMWARE_TX_QUEUE] = byte;
+    firmware->tx_count++;
+}
+
+/* Encodes one reply frame with both delimiters into the reply queue */
+static void queue_frame(struct led_firmware_s *firmware, uint8_t seq, uint8_t cmd, const uint8_t *payload,
+                        uint8_t length) {
+    uint8_t raw[6];
+    raw[0] = seq;
+    raw[1] = cmd;
+    for (uint8_t i = 0; i < length; i++) {
+        raw[2 + i] = payload[i];
+    }
+    uint16_t crc = crc16(raw, (uint16_t)(length + 2));
+    raw[length + 2] = (uint8_t)(crc & 0xFF);
+    raw[length + 3] = (uint8_t)(crc >> 8);
+
+    /* Replies are shorter than 254 bytes, so every COBS block ends at a zero or at the end */
+    uint8_t encoded[8];
+    uint8_t code_index = 0;
+    uint8_t write_index = 1;
+    for (uint8_t i = 0; i < length + 4; i++) {
+        if (raw[i] != 0) {
+            encoded[write_index++] = raw[i];
+        } else {
+            encoded[code_index] = (uint8_t)(write_index - code_index);
+            code_index = write_index++;
+        }
+    }
+    encoded[code_index] = (uint8_t)(write_index - code_index);
+
+    queue_byte(firmware, 0);
+    for (uint8_t i = 0; i < write_index; i++) {
+        queue_byte(firmware, encoded[i]);
+    }
+    queue_byte(firmware, 0);
+}
+
+/* Applies one LED command, returns 0 for unknown commands */
+static uint8_t apply_led_command(struct led_firmware_s *firmware, uint8_t cmd, uint8_t mask) {
+    if (cmd == LED_FIRMWARE_CMD_LED_ON) {
+        firmware->leds |= mask;
+    } else if (cmd == LED_FIRMWARE_CMD_LED_OFF) {
+        firmware->leds &= (uint8_t)~mask;
+    } else if (cmd == LED_FIRMWARE_CMD_LED_SET) {
+        firmware->leds = mask;
+    } else {
+        return 0;
+    }
+    return 1;
+}
+
+static void handle_frame(struct led_firmware_s *firmware, uint8_t seq, uint8_t cmd, const uint8_t *payload,
+                         uint16_t length) {
+    uint8_t status = LED_FIRMWARE_STATUS_OK;
+
+    if (cmd == LED_FIRMWARE_CMD_LED_ON || cmd == LED_FIRMWARE_CMD_LED_OFF || cmd == LED_FIRMWARE_CMD_LED_SET) {
+        if (length != 1) {
+            status = LED_FIRMWARE_STATUS_BAD_PAYLOAD;
+        } else {
+            apply_led_command(firmware, cmd, payload[0]);
+        }
+    } else if (cmd == LED_FIRMWARE_CMD_BATCH) {
+        if (length % 2 != 0) {
+            status = LED_FIRMWARE_STATUS_BAD_PAYLOAD;
+        } else {
+            for (uint16_t i = 0; i < length && status == LED_FIRMWARE_STATUS_OK; i += 2) {
+                if (!apply_led_command(firmware, payload[i], payload[i + 1])) {
+                    status = LED_FIRMWARE_STATUS_BAD_COMMAND;
+                }
+            }
+        }
+    } else if (cmd != LED_FIRMWARE_CMD_GET_STATE) {
+        status = LED_FIRMWARE_STATUS_BAD_COMMAND;
+    }
+
+    firmware->frames++;
+    if (status == LED_FIRMWARE_STATUS_OK) {
+        uint8_t reply[2] = {status, firmware->leds};
+        queue_frame(firmware, seq, LED_FIRMWARE_CMD_ACK, reply, 2);
+    } else {
+        queue_frame(firmware, seq, LED_FIRMWARE_CMD_NAK, &status, 1);
+    }
+}
+
+/* Called on the closing delimiter of a frame */
+static void finish_frame(struct led_firmware_s *firmware) {
+    uint16_t size = firmware->overflow ? 0 : cobs_decode(firmware->frame, firmware->frame_length);
+    if (size < 4) {
+        firmware->bad_frames++;
+        return;
+    }
+    uint16_t crc = (uint16_t)(firmware->frame[size - 2] | ((uint16_t)firmware->frame[size - 1] << 8));
+    if (crc16(firmware->frame, (uint16_t)(size - 2)) != crc) {
+        firmware->bad_frames++;     /* the host times out and retries */
+        return;
+    }
+    handle_frame(firmware, firmware->frame[0], firmware->frame[1], firmware->frame + 2, (uint16_t)(size - 4));
+}
+
+/* Legacy single-character commands used by the interactive menu; other characters are ignored */
+static void handle_ascii(struct led_firmware_s *firmware, uint8_t command) {
+    static const uint8_t MASKS[] = {LED_FIRMWARE_LED_RED, LED_FIRMWARE_LED_YELLOW, LED_FIRMWARE_LED_BLUE};
+    if (command < '1' || command > '4') {
+        return;
+    }
+    uint8_t index = (uint8_t)(command - '1');
+    firmware->leds = index < 3 ? (uint8_t)(firmware->leds | MASKS[index]) : 0;
+    for (const char *reply = ASCII_REPLIES[index]; *reply; reply++) {
+        queue_byte(firmware, (uint8_t)*reply);
+    }
+    firmware->ascii_commands++;
+}
+
+uint8_t led_firmware_completes(const struct led_firmware_s *firmware, uint8_t byte) {
+    if (byte == 0) {
+        return firmware->in_frame && firmware->frame_length > 0;
+    }
+    return !firmware->in_frame && byte >= '1' && byte <= '4';
+}
+
+uint16_t led_firmware_receive(struct led_firmware_s *firmware, const uint8_t *data, uint16_t length) {
+    uint16_t taken = 0;
+    while (taken < length) {
+        uint8_t byte = data[taken];
+        if (led_firmware_completes(firmware, byte) &&
+            LED_FIRMWARE_TX_QUEUE - firmware->tx_count < LED_FIRMWARE_REPLY_MAX) {
+            break;
+        }
+        taken++;
+
+        if (byte == 0) {
+            /* Delimiter: closes a frame in progress or opens a new one */
+            if (firmware->in_frame && firmware->frame_length > 0) {
+                finish_frame(firmware);
+                firmware->in_frame = 0;
+            } else {
+                firmware->in_frame = 1;
+            }
+            firmware->frame_length = 0;
+            firmware->overflow = 0;
+        } else if (firmware->in_frame) {
+            /* Copy the rest of the frame body up to the next delimiter at once */
+            const uint8_t *end = memchr(data + taken, 0, (size_t)(length - taken));
+            uint16_t run = (uint16_t)(1 + (end ? (uint16_t)(end - (data + taken)) : length - taken));
+            uint16_t room = (uint16_t)(LED_FIRMWARE_FRAME_MAX_ENCODED - firmware->frame_length);
+            if (run > room) {
+                firmware->overflow = 1;
+            }
+            memcpy(firmware->frame + firmware->frame_length, data + taken - 1, run < room ? run : room);
+            firmware->frame_length = (uint16_t)(firmware->frame_length + (run < room ? run : room));
+            taken = (uint16_t)(taken + run - 1);
+        } else {
+            handle_ascii(firmware, byte);
+        }
+    }
+    return taken;
+}
+
+uint16_t led_firmware_transmit(struct led_firmware_s *firmware, uint8_t *out, uint16_t size) {
+    uint16_t count = 0;
+    while (count < size && firmware->tx_count > 0) {
+        out[count++] = firmware->tx[firmware->tx_head];
+        firmware->tx_head = (uint8_t)((firmware->tx_head + 1) % LED_FIRMWARE_TX_QUEUE);
+        firmware->tx_count--;
+    }
+    return count;
+}
@@ -0,0 +1,116 @@
+/**
+ * @file led_firmware.h
+ * @brief Command handling of the LED sketch as portable, non-blocking C
+ *
+ * The same file builds into sketch_mar2a.ino (the Arduino IDE compiles every
+ * .c file in the sketch folder) and on the host, where the sketch emulator,
+ * the tests and the benchmarks run it. It has no Arduino dependencies and
+ * never waits: the sketch hands it received bytes, sets the pins from
+ * led_firmware_leds() and sends whatever led_firmware_transmit() returns
+ * while the serial transmit buffer has room.
+ *
+ * Protocol, see include/serial_frame.h on the host side:
+ *
+ *     0x00 | COBS( seq | cmd | payload | crc16_lo | crc16_hi ) | 0x00
+ *
+ * Commands carry LED bitmasks (LED_ON, LED_OFF, LED_SET, and BATCH with
+ * several (cmd, mask) steps); every frame is answered with a 9-byte ACK
+ * carrying the LED state, or an 8-byte NAK. Bytes outside a frame are the
+ * legacy menu commands '1' to '4', answered with a text line.
+ *
+ * A command is only taken when the reply queue can hold its reply, so a host
+ * that does not read its replies is held off instead of losing them.
+ */
+
+#ifndef LED_FIRMWARE_H_
+#define LED_FIRMWARE_H_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define LED_FIRMWARE_FRAME_MAX_ENCODED 258  /* largest COBS body including overhead */
+#define LED_FIRMWARE_TX_QUEUE 64            /* reply bytes queued, at least LED_FIRMWARE_REPLY_MAX */
+#define LED_FIRMWARE_REPLY_MAX 16           /* longest reply: a text line */
+
+#define LED_FIRMWARE_CMD_LED_ON 0x01        /* payload: LED mask */
+#define LED_FIRMWARE_CMD_LED_OFF 0x02       /* payload: LED mask */
+#define LED_FIRMWARE_CMD_LED_SET 0x03       /* payload: LED mask, others off */
+#define LED_FIRMWARE_CMD_GET_STATE 0x04     /* no payload */
+#define LED_FIRMWARE_CMD_BATCH 0x10         /* payload: (cmd, mask) pairs */
+#define LED_FIRMWARE_CMD_ACK 0x80           /* payload: status, LED state */
+#define LED_FIRMWARE_CMD_NAK 0x81           /* payload: status */
+
+#define LED_FIRMWARE_STATUS_OK 0
+#define LED_FIRMWARE_STATUS_BAD_COMMAND 1
+#define LED_FIRMWARE_STATUS_BAD_PAYLOAD 2
+
+#define LED_FIRMWARE_LED_RED 0x01           /* LED mask bits */
+#define LED_FIRMWARE_LED_YELLOW 0x02
+#define LED_FIRMWARE_LED_BLUE 0x04
+
+/* Firmware state; statically allocated on the board, initialise with led_firmware_init() */
+struct led_firmware_s {
+    uint8_t frame[LED_FIRMWARE_FRAME_MAX_ENCODED];  /* COBS bytes collected between delimiters */
+    uint16_t frame_length;
+    uint8_t in_frame;           /* after a 0x00 delimiter */
+    uint8_t overflow;           /* the frame in progress did not fit */
+    uint8_t leds;               /* current LED mask */
+    uint8_t tx[LED_FIRMWARE_TX_QUEUE];
+    uint8_t tx_head;
+    uint8_t tx_count;
+    uint32_t frames;            /* frames answered */
+    uint32_t bad_frames;        /* frames dropped for bad COBS, CRC, size or overflow */
+    uint32_t ascii_commands;    /* menu commands answered */
+};
+
+/**
+ * @brief Resets the firmware to its power-on state, every LED off
+ * @param firmware Firmware state
+ */
+void led_firmware_init(struct led_firmware_s *firmware);
+
+/**
+ * @brief Tells whether a byte would complete a command, and so queue a reply
+ * @param firmware Firmware state
+ * @param byte Next received byte
+ * @return 1 if the byte completes a frame or is a menu character, otherwise 0
+ */
+uint8_t led_firmware_completes(const struct led_firmware_s *firmware, uint8_t byte);
+
+/**
+ * @brief Handles received bytes
+ *
+ * Stops before a byte that completes a command while the reply queue has
+ * less than LED_FIRMWARE_REPLY_MAX bytes free; hand it over again once
+ * led_firmware_transmit() has made room.
+ * @param firmware Firmware state
+ * @param data Received bytes
+ * @param length Number of bytes
+ * @return Number of bytes taken
+ */
+uint16_t led_firmware_receive(struct led_firmware_s *firmware, const uint8_t *data, uint16_t length);
+
+/**
+ * @brief Takes queued reply bytes for sending
+ * @param firmware Firmware state
+ * @param out Receives the bytes
+ * @param size Most bytes to take, e.g. the room in the transmit buffer
+ * @return Number of bytes stored in out
+ */
+uint16_t led_firmware_transmit(struct led_firmware_s *firmware, uint8_t *out, uint16_t size);
+
+/**
+ * @brief Returns the LED mask the pins should show
+ * @param firmware Firmware state
+ * @return LED_FIRMWARE_LED_* bits that are on
+ */
+uint8_t led_firmware_leds(const struct led_firmware_s *firmware);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LED_FIRMWARE_H_ */
@@ -1,35 +1,50 @@
+// Thin Arduino shim over led_firmware.c, which holds the command handling.
+// loop() never waits: it takes bytes while the firmware can queue their
+// replies, updates the pins when the LED state changes, and sends replies
+// only as fast as the transmit buffer drains.
+
+#include "led_firmware.h"
+
 #define ledPinRed 13 // Pin number where the LED is connected
 #define ledPinYellow 12 // Pin number where the LED is connected
 #define ledPinBlue 11 // Pin number where the LED is connected
 
+struct led_firmware_s firmware;
+uint8_t shownLeds = 0; // LED mask currently on the pins
+
 void setup() {
   pinMode(ledPinRed, OUTPUT);
   pinMode(ledPinYellow, OUTPUT);
   pinMode(ledPinBlue, OUTPUT);
+  led_firmware_init(&firmware);
   Serial.begin(9600); // Set the baud rate to 9600
 }
 
+void writeLeds(uint8_t leds) {
+  digitalWrite(ledPinRed, (leds & LED_FIRMWARE_LED_RED) ? HIGH : LOW);
+  digitalWrite(ledPinYellow, (leds & LED_FIRMWARE_LED_YELLOW) ? HIGH : LOW);
+  digitalWrite(ledPinBlue, (leds & LED_FIRMWARE_LED_BLUE) ? HIGH : LOW);
+  shownLeds = leds;
+}
+
 void loop() {
-  if (Serial.available() > 0) {
-    char command = Serial.read();
-    if (command == '1') {
-      digitalWrite(ledPinRed, HIGH); // Turn on the LED
-      Serial.println("LED RED ON");
-      delay(100);
-    } else if (command == '2') {
-      digitalWrite(ledPinYellow, HIGH); // Turn on the LED
-      Serial.println("LED YELLOW ON");
-      delay(100);
-    } else if (command == '3') {
-      digitalWrite(ledPinBlue, HIGH); // Turn on the LED
-      Serial.println("LED BLUE ON");
-      delay(100);
-    } else if (command == '4') {
-      digitalWrite(ledPinRed, LOW); // Turn off the LED
-      digitalWrite(ledPinBlue, LOW); // Turn off the LED
-      digitalWrite(ledPinYellow, LOW); // Turn off the LED
-      Serial.println("LEDS OFF");
-      delay(100);
+  // A byte the firmware does not take stays in the receive buffer until its reply fits
+  while (Serial.available() > 0) {
+    uint8_t data = (uint8_t)Serial.peek();
+    if (led_firmware_receive(&firmware, &data, 1) == 0) {
+      break;
     }
+    Serial.read();
+  }
+
+  if (led_firmware_leds(&firmware) != shownLeds) {
+    writeLeds(led_firmware_leds(&firmware));
+  }
+
+  uint8_t out[LED_FIRMWARE_TX_QUEUE];
+  int room = Serial.availableForWrite();
+  uint16_t count = led_firmware_transmit(&firmware, out, room < (int)sizeof(out) ? (uint16_t)room : sizeof(out));
+  if (count > 0) {
+    Serial.write(out, count);
   }
 }
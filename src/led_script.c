@@ -0,0 +1,326 @@
+/**
+ * @file led_script.c
+ * @brief Streaming script parser and pipelined runner for led_control
+ */
+
+#include "led_script.h"
+
+#include <ctype.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../include/serial_lines.h"
+
+#if defined(_WIN32)
+#include <io.h>
+#else
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+#define SCRIPT_LINE_MAX 4096
+#define SCRIPT_CHUNK 4096
+
+static const struct {
+    const char *name;
+    uint8_t mask;
+} LED_NAMES[] = {
+    {"red", SERIAL_LED_RED},
+    {"yellow", SERIAL_LED_YELLOW},
+    {"blue", SERIAL_LED_BLUE},
+    {"all", SERIAL_LED_ALL},
+    {"none", 0},
+};
+
+/* Returns 1 when text[0..length) equals word, ignoring case */
+static int word_equals(const char *text, size_t length, const char *word) {
+    if (length != strlen(word)) {
+        return 0;
+    }
+    for (size_t i = 0; i < length; i++) {
+        if (tolower((unsigned char)text[i]) != word[i]) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static void trim(const char **text, size_t *length) {
+    while (*length > 0 && isspace((unsigned char)**text)) {
+        (*text)++;
+        (*length)--;
+    }
+    while (*length > 0 && isspace((unsigned char)(*text)[*length - 1])) {
+        (*length)--;
+    }
+}
+
+/* Parses a comma-separated list of LED names */
+static int parse_leds(const char *text, size_t length, uint8_t *mask) {
+    *mask = 0;
+    while (length > 0) {
+        const char *comma = memchr(text, ',', length);
+        size_t item_length = comma ? (size_t)(comma - text) : length;
+        const char *item = text;
+        trim(&item, &item_length);
+
+        size_t i = 0;
+        while (i < sizeof(LED_NAMES) / sizeof(LED_NAMES[0]) && !word_equals(item, item_length, LED_NAMES[i].name)) {
+            i++;
+        }
+        if (i == sizeof(LED_NAMES) / sizeof(LED_NAMES[0])) {
+            return SERIAL_ERROR_CONFIG;
+        }
+        *mask |= LED_NAMES[i].mask;
+
+        if (!comma) {
+            break;
+        }
+        length -= (size_t)(comma - text) + 1;
+        text = comma + 1;
+        if (length == 0) {
+            return SERIAL_ERROR_CONFIG;     /* trailing comma */
+        }
+    }
+    return SERIAL_SUCCESS;
+}
+
+static int parse_milliseconds(const char *text, size_t length, uint32_t *value) {
+    if (length == 0 || length > 9) {
+        return SERIAL_ERROR_CONFIG;
+    }
+    uint32_t result = 0;
+    for (size_t i = 0; i < length; i++) {
+        if (!isdigit((unsigned char)text[i])) {
+            return SERIAL_ERROR_CONFIG;
+        }
+        result = result * 10 + (uint32_t)(text[i] - '0');
+    }
+    *value = result;
+    return SERIAL_SUCCESS;
+}
+
+int led_script_parse_line(const char *line, size_t length, struct led_script_command_s *command) {
+    memset(command, 0, sizeof(*command));
+
+    const char *comment = memchr(line, '#', length);
+    if (comment) {
+        length = (size_t)(comment - line);
+    }
+    trim(&line, &length);
+    if (length == 0) {
+        return SERIAL_SUCCESS;
+    }
+
+    size_t word_length = 0;
+    while (word_length < length && !isspace((unsigned char)line[word_length])) {
+        word_length++;
+    }
+    const char *argument = line + word_length;
+    size_t argument_length = length - word_length;
+    trim(&argument, &argument_length);
+
+    command->kind = LED_SCRIPT_COMMAND;
+    if (word_length == 1 && line[0] >= '1' && line[0] <= '4' && argument_length == 0) {
+        static const uint8_t DIGIT_MASKS[] = {SERIAL_LED_RED, SERIAL_LED_YELLOW, SERIAL_LED_BLUE};
+        command->cmd = line[0] == '4' ? SERIAL_CMD_LED_SET : SERIAL_CMD_LED_ON;
+        command->mask = line[0] == '4' ? 0 : DIGIT_MASKS[line[0] - '1'];
+        return SERIAL_SUCCESS;
+    }
+    if (word_equals(line, word_length, "get") && argument_length == 0) {
+        command->cmd = SERIAL_CMD_GET_STATE;
+        return SERIAL_SUCCESS;
+    }
+    if (word_equals(line, word_length, "wait")) {
+        command->kind = LED_SCRIPT_WAIT;
+        return parse_milliseconds(argument, argument_length, &command->wait_ms);
+    }
+    if (word_equals(line, word_length, "on")) {
+        command->cmd = SERIAL_CMD_LED_ON;
+    } else if (word_equals(line, word_length, "off")) {
+        command->cmd = SERIAL_CMD_LED_OFF;
+    } else if (word_equals(line, word_length, "set")) {
+        command->cmd = SERIAL_CMD_LED_SET;
+    } else {
+        return SERIAL_ERROR_CONFIG;
+    }
+    if (argument_length == 0) {
+        return SERIAL_ERROR_CONFIG;
+    }
+    return parse_leds(argument, argument_length, &command->mask);
+}
+
+static void on_reply(serial_client_t *client, int status, const struct serial_frame_s *reply, uint64_t latency_ns,
+                     void *user_data) {
+    struct led_script_summary_s *summary = user_data;
+    (void)client;
+    summary->commands++;
+    if (status != SERIAL_SUCCESS) {
+        summary->timeouts++;
+    } else if (reply->cmd != SERIAL_CMD_ACK) {
+        summary->naks++;
+    } else if (latency_ns > 0) {
+        /* Commands the cache completes report no latency and stay out of the histogram */
+        serial_histogram_record(&summary->latency, latency_ns);
+    }
+}
+
+static void sleep_ms(uint32_t milliseconds) {
+#if defined(_WIN32)
+    Sleep(milliseconds);
+#else
+    struct timespec delay = { .tv_sec = milliseconds / 1000, .tv_nsec = (long)(milliseconds % 1000) * 1000000L };
+    while (nanosleep(&delay, &delay) != 0 && errno == EINTR) {
+    }
+#endif
+}
+
+/* Whether reading the script would return at once; Windows always reads */
+static int input_ready(int fd) {
+#if defined(_WIN32)
+    (void)fd;
+    return 1;
+#else
+    struct pollfd pfd = { .fd = fd, .events = POLLIN };
+    return poll(&pfd, 1, 0) != 0;
+#endif
+}
+
+static int run_command(serial_client_t *client, serial_shadow_t *shadow, const struct led_script_command_s *command,
+                       struct led_script_summary_s *summary) {
+    if (command->kind == LED_SCRIPT_WAIT) {
+        int result = serial_client_drain(client);
+        sleep_ms(command->wait_ms);
+        summary->waits++;
+        return result;
+    }
+    if (command->kind == LED_SCRIPT_COMMAND) {
+        size_t length = command->cmd == SERIAL_CMD_GET_STATE ? 0 : 1;
+        if (shadow) {
+            return serial_shadow_submit(shadow, command->cmd, &command->mask, length, on_reply, summary);
+        }
+        return serial_client_submit(client, command->cmd, &command->mask, length, on_reply, summary);
+    }
+    return SERIAL_SUCCESS;
+}
+
+int led_script_run(serial_handle_t handle, int input_fd, const struct led_script_options_s *options,
+                   struct led_script_summary_s *summary) {
+    if (!summary) {
+        return SERIAL_ERROR_INVALID_HANDLE;
+    }
+    memset(summary, 0, sizeof(*summary));
+
+    struct serial_client_config_s config = {
+        .window = options && options->window ? options->window : SERIAL_CLIENT_DEFAULT_WINDOW,
+        .timeout_ms = options && options->timeout_ms ? options->timeout_ms : SERIAL_CLIENT_DEFAULT_TIMEOUT_MS,
+    };
+    serial_client_t *client = serial_client_create(handle, &config);
+    serial_lines_t *lines = serial_lines_create(SCRIPT_LINE_MAX, '\n');
+    serial_shadow_t *shadow = NULL;
+    if (client && options && options->cache) {
+        struct serial_shadow_config_s shadow_config = { .max_age_ms = options->cache_max_age_ms };
+        shadow = serial_shadow_create(client, &shadow_config);
+        summary->cached = 1;
+    }
+    if (!client || !lines || (summary->cached && !shadow)) {
+        serial_shadow_destroy(shadow);
+        serial_client_destroy(client);
+        serial_lines_destroy(lines);
+        return SERIAL_ERROR_CONFIG;
+    }
+
+    char chunk[SCRIPT_CHUNK];
+    size_t chunk_length = 0;
+    size_t chunk_offset = 0;
+    unsigned line_number = 0;
+    int at_end = 0;
+    int result = SERIAL_SUCCESS;
+    uint64_t start = serial_monotonic_ns();
+
+    while (result == SERIAL_SUCCESS) {
+        struct serial_line_s line;
+        while (result == SERIAL_SUCCESS && serial_lines_next(lines, &line)) {
+            struct led_script_command_s command;
+            line_number++;
+            if (line.truncated || led_script_parse_line(line.data, line.length, &command) != SERIAL_SUCCESS) {
+                summary->error_line = line_number;
+                result = SERIAL_ERROR_CONFIG;
+                break;
+            }
+            result = run_command(client, shadow, &command, summary);
+        }
+        if (result != SERIAL_SUCCESS) {
+            break;
+        }
+
+        if (chunk_offset < chunk_length) {
+            chunk_offset += serial_lines_feed(lines, chunk + chunk_offset, chunk_length - chunk_offset);
+            continue;
+        }
+        if (at_end) {
+            break;
+        }
+
+        /* Keep collecting replies while the script producer is slow */
+        if (serial_client_in_flight(client) > 0 && !input_ready(input_fd)) {
+            int polled = serial_client_poll(client, 1);
+            result = polled < 0 ? polled : SERIAL_SUCCESS;
+            continue;
+        }
+
+        long count = (long)read(input_fd, chunk, sizeof(chunk));
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+        if (count < 0) {
+            result = SERIAL_ERROR_READ;
+            break;
+        }
+        if (count == 0) {
+            at_end = 1;
+            if (serial_lines_pending(lines) == 0) {
+                continue;
+            }
+            /* End the last line even if the script lacks a final newline */
+            chunk[0] = '\n';
+            count = 1;
+        }
+        chunk_length = (size_t)count;
+        chunk_offset = 0;
+    }
+
+    int drained = serial_client_drain(client);
+    if (result == SERIAL_SUCCESS) {
+        result = drained;
+    }
+    summary->elapsed_ns = serial_monotonic_ns() - start;
+    serial_shadow_get_stats(shadow, &summary->cache);
+
+    serial_shadow_destroy(shadow);
+    serial_lines_destroy(lines);
+    serial_client_destroy(client);
+    return result;
+}
+
+void led_script_print_summary(const struct led_script_summary_s *summary, FILE *out) {
+    double seconds = (double)summary->elapsed_ns / 1e9;
+    fprintf(out, "%llu commands in %.3f s (%.1f commands/s): %llu NAK, %llu timeouts, %llu waits\n",
+            (unsigned long long)summary->commands, seconds,
+            seconds > 0 ? (double)summary->commands / seconds : 0.0, (unsigned long long)summary->naks,
+            (unsigned long long)summary->timeouts, (unsigned long long)summary->waits);
+    if (summary->cached) {
+        fprintf(out, "Cache: %llu sent, %llu elided, %llu answered locally, %llu mismatches\n",
+                (unsigned long long)summary->cache.sent, (unsigned long long)summary->cache.elided,
+                (unsigned long long)summary->cache.local_queries, (unsigned long long)summary->cache.mismatches);
+    }
+    if (summary->latency.count > 0) {
+        const struct serial_histogram_s *latency = &summary->latency;
+        fprintf(out, "Latency: p50 %.2f ms, p90 %.2f ms, p99 %.2f ms, p99.9 %.2f ms, max %.2f ms\n",
+                (double)serial_histogram_quantile(latency, 0.5) / 1e6,
+                (double)serial_histogram_quantile(latency, 0.9) / 1e6,
+                (double)serial_histogram_quantile(latency, 0.99) / 1e6,
+                (double)serial_histogram_quantile(latency, 0.999) / 1e6, (double)latency->max_ns / 1e6);
+    }
+}
@@ -0,0 +1,100 @@
+/**
+ * @file led_script.h
+ * @brief Batch mode of led_control: runs a command script through the pipelined client
+ *
+ * A script has one command per line; blank lines and text after '#' are
+ * ignored:
+ *
+ *     1, 2, 3        turn the red, yellow or blue LED on (the menu digits)
+ *     4              turn all LEDs off
+ *     on LEDS        turn LEDS on, e.g. "on red" or "on red,blue"
+ *     off LEDS       turn LEDS off
+ *     set LEDS       turn LEDS on and every other LED off ("set none" for none)
+ *     get            read the LED state
+ *     wait MS        wait for every reply so far, then pause for MS milliseconds
+ *
+ * LEDS is a comma-separated list of red, yellow, blue, all or none. Commands
+ * go out as binary frames, so they are pipelined instead of waiting for the
+ * text reply to every ASCII command. With the cache option the
+ * commands go through serial_shadow, which skips those that would not change
+ * the LEDs and answers get from its mirror of the device state.
+ *
+ * Not part of the library interface.
+ */
+
+#ifndef LED_SCRIPT_H_
+#define LED_SCRIPT_H_
+
+#include <stdio.h>
+#include "../include/serial_client.h"
+#include "../include/serial_shadow.h"
+#include "../include/serial_stats.h"
+
+/* Line kinds */
+enum led_script_kind_e {
+    LED_SCRIPT_EMPTY = 0,       /* blank line or comment */
+    LED_SCRIPT_COMMAND = 1,     /* frame to send */
+    LED_SCRIPT_WAIT = 2         /* drain replies, then pause */
+};
+
+/* One parsed script line */
+struct led_script_command_s {
+    uint8_t kind;
+    uint8_t cmd;                /* SERIAL_CMD_* for LED_SCRIPT_COMMAND */
+    uint8_t mask;               /* SERIAL_LED_* payload, unused for SERIAL_CMD_GET_STATE */
+    uint32_t wait_ms;           /* pause for LED_SCRIPT_WAIT */
+};
+
+/* Settings; pass NULL to led_script_run() for the client defaults */
+struct led_script_options_s {
+    unsigned window;            /* commands in flight, 0 for SERIAL_CLIENT_DEFAULT_WINDOW */
+    int timeout_ms;             /* reply timeout, 0 for SERIAL_CLIENT_DEFAULT_TIMEOUT_MS */
+    int cache;                  /* skip redundant commands through serial_shadow */
+    int cache_max_age_ms;       /* serial_shadow_config_s.max_age_ms when cache is set */
+};
+
+/* Outcome of a script run */
+struct led_script_summary_s {
+    uint64_t commands;          /* commands completed, including NAKs and timeouts */
+    uint64_t naks;
+    uint64_t timeouts;
+    uint64_t waits;
+    int cached;                 /* the run used the cache option */
+    struct serial_shadow_stats_s cache;     /* what the cache elided, valid when cached is set */
+    uint64_t elapsed_ns;
+    unsigned error_line;        /* first line that did not parse, 0 if none */
+    struct serial_histogram_s latency;  /* submission to reply, acknowledged commands sent to the device */
+};
+
+/**
+ * @brief Parses one script line
+ * @param line Line text without the line ending
+ * @param length Line length
+ * @param command Receives the parsed line
+ * @return SERIAL_SUCCESS or SERIAL_ERROR_CONFIG when the line is not a valid command
+ */
+int led_script_parse_line(const char *line, size_t length, struct led_script_command_s *command);
+
+/**
+ * @brief Streams a script from a descriptor and runs it against the device
+ *
+ * Lines are parsed as they arrive and commands are sent as soon as the
+ * client window has room, so a slow producer on a pipe never stalls replies.
+ * Stops at the first line that does not parse.
+ * @param handle Open serial handle to the sketch
+ * @param input_fd Descriptor to read the script from, e.g. 0 for stdin
+ * @param options Settings, or NULL for the defaults
+ * @param summary Receives the counters and the latency histogram
+ * @return SERIAL_SUCCESS, SERIAL_ERROR_CONFIG on a parse error, or error code
+ */
+int led_script_run(serial_handle_t handle, int input_fd, const struct led_script_options_s *options,
+                   struct led_script_summary_s *summary);
+
+/**
+ * @brief Prints the throughput and latency percentiles of a run
+ * @param summary Result of led_script_run()
+ * @param out Stream to print to
+ */
+void led_script_print_summary(const struct led_script_summary_s *summary, FILE *out);
+
+#endif /* LED_SCRIPT_H_ */
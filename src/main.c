@@ -3,22 +3,43 @@
  * @brief LED control program using serial communication
  */
 
+#include <fcntl.h>
+#include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include "../include/serial_capture.h"
 #include "../include/serial_functions.h"
+#include "../include/serial_lines.h"
+#include "../include/serial_shadow.h"
+#include "../include/serial_trace.h"
+#include "led_script.h"
+
+#if defined(_WIN32)
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
 
 #if defined(__linux__)
-    #include <unistd.h>
-    #define SLEEP_MS(ms) usleep((ms) * 1000)
-#elif defined(_WIN32)
-    #include <windows.h>
-    #define SLEEP_MS(ms) Sleep(ms)
+#include <signal.h>
+#include <sys/stat.h>
+#include "../include/serial_mux.h"
+#include "../include/serial_rt.h"
 #endif
 
 #define COMMAND_BUFFER_SIZE 2
 #define READ_BUFFER_SIZE 256
-#define SERIAL_DELAY_MS 100
+#define RESPONSE_TIMEOUT_MS 1000
+#define RESPONSE_DELIMITER '\n'
+#define DEFAULT_BAUD_RATE 9600
+
+/* Signal that writes the --trace file without stopping the program */
+#if defined(__linux__)
+#define TRACE_DUMP_SIGNAL SIGUSR1
+#else
+#define TRACE_DUMP_SIGNAL 0
+#endif
 
 static const char* const MENU_OPTIONS[] = {
     "1-Turn on Red Led",
@@ -42,10 +63,47 @@ static void display_menu(void) {
     fflush(stdout);
 }
 
-static int process_command(serial_handle_t serial_port, char command) {
-    size_t bytes_written, bytes_read;
-    char read_buffer[READ_BUFFER_SIZE];
-    
+/* Menu choices '1' to '4' as frame commands, with the line the sketch answers */
+static const struct {
+    uint8_t cmd;
+    uint8_t mask;
+    const char *response;
+} MENU_COMMANDS[] = {
+    {SERIAL_CMD_LED_ON, SERIAL_LED_RED, "LED RED ON"},
+    {SERIAL_CMD_LED_ON, SERIAL_LED_YELLOW, "LED YELLOW ON"},
+    {SERIAL_CMD_LED_ON, SERIAL_LED_BLUE, "LED BLUE ON"},
+    {SERIAL_CMD_LED_SET, 0, "LEDS OFF"},
+};
+
+/* LED state of the sketch as the menu's responses showed it */
+struct menu_cache_s {
+    struct serial_led_state_s mirror;
+    int max_age_ms;             /* forget the state this long after the last response, 0 never */
+    uint64_t confirmed_ms;
+};
+
+/* Updates the LED mirror from a response line; a line it does not know makes the state unknown */
+static void mirror_response(struct menu_cache_s *cache, const struct serial_line_s *line) {
+    size_t length = line->length;
+    if (length > 0 && line->data[length - 1] == '\r') {
+        length--;
+    }
+    for (size_t i = 0; i < sizeof(MENU_COMMANDS) / sizeof(MENU_COMMANDS[0]); i++) {
+        const char *response = MENU_COMMANDS[i].response;
+        if (length == strlen(response) && memcmp(line->data, response, length) == 0) {
+            serial_led_state_apply(&cache->mirror, MENU_COMMANDS[i].cmd, &MENU_COMMANDS[i].mask, 1);
+            cache->confirmed_ms = serial_monotonic_ms();
+            return;
+        }
+    }
+    cache->mirror.known = 0;
+}
+
+static int process_command(serial_handle_t serial_port, serial_lines_t *responses, struct menu_cache_s *cache,
+                           char command) {
+    size_t bytes_written;
+    struct serial_line_s line;
+
     /* Validate command range */
     if (command == '5') {
         return 0;  /* Exit requested */
@@ -56,52 +114,332 @@ static int process_command(serial_handle_t serial_port, char command) {
         return 1;
     }
 
+    /* Skip commands the sketch has already carried out, e.g. red on while red is on */
+    const uint8_t cmd = MENU_COMMANDS[command - '1'].cmd;
+    const uint8_t *mask = &MENU_COMMANDS[command - '1'].mask;
+    if (cache && cache->max_age_ms > 0 && serial_monotonic_ms() - cache->confirmed_ms > (uint64_t)cache->max_age_ms) {
+        cache->mirror.known = 0;
+    }
+    if (cache && serial_led_state_is_noop(&cache->mirror, cmd, mask, 1)) {
+        printf("Arduino response (cached): %s\n", MENU_COMMANDS[command - '1'].response);
+        return 1;
+    }
+
     /* Send command to device */
+    uint64_t start_ns = serial_monotonic_ns();
     if (serial_write(serial_port, &command, 1, &bytes_written) != SERIAL_SUCCESS || bytes_written != 1) {
         fprintf(stderr, "Failed to send command to device\n");
+        if (cache) {
+            cache->mirror.known = 0;
+        }
         return -1;
     }
 
-    /* Wait for device to process command */
-    SLEEP_MS(SERIAL_DELAY_MS);
-
-    /* Read response */
-    if (serial_read(serial_port, read_buffer, READ_BUFFER_SIZE - 1, &bytes_read) != SERIAL_SUCCESS) {
+    /* Wait for the response line; a partial line stays buffered for the next command */
+    int result = serial_lines_wait(responses, serial_port, serial_monotonic_ms() + RESPONSE_TIMEOUT_MS, &line);
+    if (result == SERIAL_ERROR_TIMEOUT) {
+        fprintf(stderr, "No response from device\n");
+        /* The sketch may still carry the command out */
+        if (cache) {
+            cache->mirror.known &= (uint8_t)(cmd == SERIAL_CMD_LED_SET ? 0 : ~*mask);
+        }
+        return 1;
+    } else if (result != SERIAL_SUCCESS) {
         fprintf(stderr, "Failed to read device response\n");
         return -1;
     }
 
-    if (bytes_read > 0) {
-        read_buffer[bytes_read] = '\0';
-        printf("Arduino response: %s", read_buffer);
+    /* Also show lines that arrived in the same read, such as a late earlier response */
+    do {
+        printf("Arduino response: %.*s\n", (int)line.length, line.data);
+        if (cache) {
+            mirror_response(cache, &line);
+        }
+    } while (serial_lines_next(responses, &line));
+    serial_trace_span("menu command", start_ns, serial_monotonic_ns(), "choice", command - '0');
+
+    return 1;
+}
+
+static void print_usage(const char *program) {
+    fprintf(stderr, "Usage: %s [--script FILE|-] [--window N] [--timeout MS] [--cache MS|off] [--capture FILE] "
+                    "[--mux SOCKET] [--rt CPU[:PRIORITY]] [--trace FILE] <serial_port|socket> [baud_rate]\n",
+            program);
+    fprintf(stderr, "Example: %s /dev/ttyACM0 115200\n", program);
+    fprintf(stderr, "         %s --script burn_in.txt /dev/ttyACM0 115200\n", program);
+    fprintf(stderr, "         %s --mux /tmp/led.sock /dev/ttyACM0 115200\n", program);
+    fprintf(stderr, "         %s --script burn_in.txt /tmp/led.sock\n", program);
+    fprintf(stderr, "         %s --script dashboard.txt --cache 500 /tmp/led.sock\n", program);
+    fprintf(stderr, "         %s --rt 3:50 --mux /tmp/led.sock /dev/ttyACM0 115200\n", program);
+    fprintf(stderr, "         %s --trace trace.json --script burn_in.txt /dev/ttyACM0 115200\n", program);
+}
+
+/* Parses a positive decimal option value */
+static int parse_option_value(const char *text, unsigned long max, unsigned long *value) {
+    char *end;
+    *value = strtoul(text, &end, 10);
+    return *end == '\0' && *value > 0 && *value <= max;
+}
+
+/* Runs a script in batch mode and prints its summary; returns the exit status */
+static int run_script(serial_handle_t serial_port, const char *path, const struct led_script_options_s *options) {
+    int input_fd = strcmp(path, "-") == 0 ? 0 : open(path, O_RDONLY);
+    if (input_fd < 0) {
+        fprintf(stderr, "Error: Unable to open script %s\n", path);
+        return EXIT_FAILURE;
+    }
+
+    struct led_script_summary_s summary;
+    int result = led_script_run(serial_port, input_fd, options, &summary);
+    if (input_fd != 0) {
+        close(input_fd);
+    }
+
+    led_script_print_summary(&summary, stdout);
+    if (summary.error_line > 0) {
+        fprintf(stderr, "Error: Invalid command on script line %u\n", summary.error_line);
+    } else if (result != SERIAL_SUCCESS) {
+        fprintf(stderr, "Error during communication with device\n");
+    }
+    return result == SERIAL_SUCCESS && summary.naks == 0 && summary.timeouts == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+#if defined(__linux__)
+/* Parses CPU or CPU:PRIORITY for --rt */
+static int parse_rt_option(const char *text, struct serial_rt_config_s *rt) {
+    char *end;
+    long cpu = strtol(text, &end, 10);
+    long priority = 0;
+    if (end == text || cpu < 0 || cpu > INT_MAX) {
+        return 0;
     }
+    if (*end == ':') {
+        const char *priority_text = end + 1;
+        priority = strtol(priority_text, &end, 10);
+        if (end == priority_text || priority <= 0 || priority > INT_MAX) {
+            return 0;
+        }
+    }
+    *rt = (struct serial_rt_config_s){ .cpu = (int)cpu, .priority = (int)priority, .lock_memory = 1 };
+    return *end == '\0';
+}
 
+/* Applies --rt to the thread that services the port; settings that are not permitted only warn */
+static int apply_rt_option(const struct serial_rt_config_s *rt) {
+    unsigned applied;
+    if (serial_rt_apply(rt, &applied) != SERIAL_SUCCESS) {
+        fprintf(stderr, "Error: Invalid --rt setting %d:%d\n", rt->cpu, rt->priority);
+        return 0;
+    }
+    if (!(applied & SERIAL_RT_PINNED)) {
+        fprintf(stderr, "Warning: Unable to pin to CPU %d\n", rt->cpu);
+    }
+    if (rt->priority > 0 && !(applied & SERIAL_RT_FIFO)) {
+        fprintf(stderr, "Warning: SCHED_FIFO not permitted, running at normal priority\n");
+    }
+    if (!(applied & SERIAL_RT_LOCKED)) {
+        fprintf(stderr, "Warning: Unable to lock memory\n");
+    }
     return 1;
 }
 
+static serial_mux_t *active_mux;
+
+static void stop_mux(int signal_number) {
+    (void)signal_number;
+    serial_mux_stop(active_mux);
+}
+
+/* Shares the port with local clients until interrupted; returns the exit status */
+static int run_mux(serial_handle_t serial_port, const char *port_path, const char *socket_path,
+                   const struct led_script_options_s *options) {
+    struct serial_mux_config_s config = { .window = options->window, .timeout_ms = options->timeout_ms };
+    active_mux = serial_mux_create(serial_port, socket_path, &config);
+    if (!active_mux) {
+        fprintf(stderr, "Error: Unable to listen on %s\n", socket_path);
+        return EXIT_FAILURE;
+    }
+
+    struct sigaction action = { .sa_handler = stop_mux };
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+    printf("Sharing %s on %s, Ctrl+C to stop\n", port_path, socket_path);
+    fflush(stdout);
+
+    int result = serial_mux_run(active_mux);
+    struct serial_mux_stats_s stats;
+    serial_mux_get_stats(active_mux, &stats);
+    printf("%llu commands from %llu clients: %llu sent in %llu writes, %llu coalesced, %llu timeouts\n",
+           (unsigned long long)stats.commands, (unsigned long long)stats.accepted,
+           (unsigned long long)stats.link_commands, (unsigned long long)stats.link_writes,
+           (unsigned long long)stats.coalesced, (unsigned long long)stats.timeouts);
+    serial_mux_destroy(active_mux);
+    if (result != SERIAL_SUCCESS) {
+        fprintf(stderr, "Error: Lost the serial port\n");
+    }
+    return result == SERIAL_SUCCESS ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+static int is_socket(const char *path) {
+    struct stat st;
+    return stat(path, &st) == 0 && S_ISSOCK(st.st_mode);
+}
+#endif
+
 int main(int argc, char* argv[]) {
-    if (argc < 2) {
-        fprintf(stderr, "Usage: %s <serial_port>\n", argv[0]);
-        fprintf(stderr, "Example: %s /dev/ttyACM0\n", argv[0]);
+    const char *script = NULL;
+    const char *capture = NULL;
+    const char *mux_socket = NULL;
+    const char *trace = NULL;
+    struct led_script_options_s script_options = {0};
+    int arg = 1;
+#if defined(__linux__)
+    struct serial_rt_config_s rt;
+    int use_rt = 0;
+#endif
+
+    for (; arg < argc && strncmp(argv[arg], "--", 2) == 0; arg += 2) {
+        unsigned long value;
+        if (arg + 1 >= argc) {
+            print_usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+        if (strcmp(argv[arg], "--script") == 0) {
+            script = argv[arg + 1];
+        } else if (strcmp(argv[arg], "--capture") == 0) {
+            capture = argv[arg + 1];
+        } else if (strcmp(argv[arg], "--mux") == 0) {
+            mux_socket = argv[arg + 1];
+        } else if (strcmp(argv[arg], "--trace") == 0) {
+            trace = argv[arg + 1];
+        } else if (strcmp(argv[arg], "--window") == 0 &&
+                   parse_option_value(argv[arg + 1], SERIAL_CLIENT_MAX_WINDOW, &value)) {
+            script_options.window = (unsigned)value;
+        } else if (strcmp(argv[arg], "--timeout") == 0 && parse_option_value(argv[arg + 1], 3600000, &value)) {
+            script_options.timeout_ms = (int)value;
+#if defined(__linux__)
+        } else if (strcmp(argv[arg], "--rt") == 0 && parse_rt_option(argv[arg + 1], &rt)) {
+            use_rt = 1;
+#endif
+        } else if (strcmp(argv[arg], "--cache") == 0 && strcmp(argv[arg + 1], "off") == 0) {
+            script_options.cache = 0;
+        } else if (strcmp(argv[arg], "--cache") == 0 &&
+                   (strcmp(argv[arg + 1], "0") == 0 || parse_option_value(argv[arg + 1], 3600000, &value))) {
+            /* 0 trusts the mirror for as long as the program runs */
+            script_options.cache = 1;
+            script_options.cache_max_age_ms = strcmp(argv[arg + 1], "0") == 0 ? 0 : (int)value;
+        } else {
+            fprintf(stderr, "Error: Invalid option %s %s\n", argv[arg], argv[arg + 1]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (arg >= argc) {
+        print_usage(argv[0]);
         return EXIT_FAILURE;
     }
+    /* Spans are written when the program exits, and on TRACE_DUMP_SIGNAL while it runs */
+    if (trace && (serial_trace_start(0) != SERIAL_SUCCESS ||
+                  serial_trace_dump_at_exit(trace, TRACE_DUMP_SIGNAL) != SERIAL_SUCCESS)) {
+        fprintf(stderr, "Error: Unable to trace to %s; tracing needs a build with TRACE=1\n", trace);
+        return EXIT_FAILURE;
+    }
+#if defined(__linux__)
+    /* The main thread services the port in every mode */
+    if (use_rt && !apply_rt_option(&rt)) {
+        return EXIT_FAILURE;
+    }
+#endif
+    const char *port_path = argv[arg];
+    const char *baud_text = arg + 1 < argc ? argv[arg + 1] : NULL;
 
     /* Configure serial port */
     struct serial_config_s config = {
-        .baud_rate = 9600,
+        .baud_rate = DEFAULT_BAUD_RATE,
         .data_bits = 8,
         .stop_bits = 1,
-        .parity = 0
+        .parity = 0,
+        .latency_mode = SERIAL_LATENCY_LOW
     };
 
-    /* Open serial port */
-    serial_handle_t serial_port = serial_open(argv[1], &config);
-    if (serial_port == SERIAL_INVALID_HANDLE) {
-        fprintf(stderr, "Error: Unable to open serial port %s\n", argv[1]);
+    if (baud_text) {
+        char *end;
+        unsigned long baud_rate = strtoul(baud_text, &end, 10);
+        if (*end != '\0' || baud_rate == 0 || baud_rate > UINT32_MAX) {
+            fprintf(stderr, "Error: Invalid baud rate %s\n", baud_text);
+            return EXIT_FAILURE;
+        }
+        config.baud_rate = (uint32_t)baud_rate;
+    }
+
+    /* Open serial port, or connect to a process sharing it */
+    int shared = 0;
+#if defined(__linux__)
+    shared = is_socket(port_path);
+    if (shared) {
+        if (!script) {
+            fprintf(stderr, "Error: A shared port takes framed commands only; use --script\n");
+            return EXIT_FAILURE;
+        }
+        signal(SIGPIPE, SIG_IGN);
+    }
+    serial_handle_t serial_port = shared ? serial_mux_connect(port_path) : serial_open(port_path, &config);
+#else
+    serial_handle_t serial_port = serial_open(port_path, &config);
+#endif
+    if (serial_port == SERIAL_INVALID_HANDLE && shared) {
+        fprintf(stderr, "Error: Unable to connect to %s\n", port_path);
         return EXIT_FAILURE;
+    } else if (serial_port == SERIAL_INVALID_HANDLE) {
+        fprintf(stderr, "Error: Unable to open serial port %s at %u baud\n", port_path, (unsigned)config.baud_rate);
+        return EXIT_FAILURE;
+    }
+
+    if (capture) {
+#if defined(__linux__)
+        int result = serial_enable_capture(serial_port, capture);
+#else
+        int result = SERIAL_ERROR_CONFIG;
+#endif
+        if (result != SERIAL_SUCCESS) {
+            fprintf(stderr, "Error: Unable to capture traffic to %s\n", capture);
+            serial_close(serial_port);
+            return EXIT_FAILURE;
+        }
     }
 
-    printf("Connected to %s\n", argv[1]);
+    if (mux_socket) {
+#if defined(__linux__)
+        int status = run_mux(serial_port, port_path, mux_socket, &script_options);
+#else
+        int status = EXIT_FAILURE;
+        fprintf(stderr, "Error: Sharing a port is only available on Linux\n");
+#endif
+        if (serial_close(serial_port) != SERIAL_SUCCESS) {
+            fprintf(stderr, "Warning: Error while closing serial port\n");
+        }
+        return status;
+    }
+
+    if (script) {
+        int status = run_script(serial_port, script, &script_options);
+        if (serial_close(serial_port) != SERIAL_SUCCESS) {
+            fprintf(stderr, "Warning: Error while closing serial port\n");
+        }
+        return status;
+    }
+
+    serial_lines_t *responses = serial_lines_create(READ_BUFFER_SIZE, RESPONSE_DELIMITER);
+    if (!responses) {
+        fprintf(stderr, "Error: Out of memory\n");
+        serial_close(serial_port);
+        return EXIT_FAILURE;
+    }
+
+    printf("Connected to %s\n", port_path);
+
+    /* With --cache the menu skips choices the sketch has already carried out */
+    struct menu_cache_s cache = { .max_age_ms = script_options.cache_max_age_ms };
 
     /* Main program loop */
     int running = 1;
@@ -116,7 +454,7 @@ int main(int argc, char* argv[]) {
         }
         clear_input_buffer();
 
-        int result = process_command(serial_port, command);
+        int result = process_command(serial_port, responses, script_options.cache ? &cache : NULL, command);
         if (result < 0) {
             /* Error occurred */
             fprintf(stderr, "Error during communication with device\n");
@@ -128,6 +466,7 @@ int main(int argc, char* argv[]) {
     }
 
     /* Cleanup */
+    serial_lines_destroy(responses);
     if (serial_close(serial_port) != SERIAL_SUCCESS) {
         fprintf(stderr, "Warning: Error while closing serial port\n");
     }
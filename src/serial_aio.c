@@ -0,0 +1,913 @@
+/**
+ * @file serial_aio.c
+ * @brief Completion loop for many serial ports on io_uring or epoll
+ */
+
+#include "../include/serial_aio.h"
+#include "serial_internal.h"
+
+#if defined(__linux__)
+
+#include <errno.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <unistd.h>
+
+#if defined(SERIAL_USE_IO_URING)
+#include <linux/io_uring.h>
+/* Provided buffer rings need the 6.0 headers, which also brought SINGLE_ISSUER */
+#if defined(IORING_SETUP_SINGLE_ISSUER)
+#define AIO_HAVE_IO_URING 1
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+#endif
+
+#ifndef AIO_HAVE_IO_URING
+#define AIO_HAVE_IO_URING 0
+#endif
+
+#define AIO_DEFAULT_QUEUE_DEPTH 256
+#define AIO_DEFAULT_BUFFER_COUNT 256
+#define AIO_DEFAULT_BUFFER_SIZE 256
+#define AIO_MAX_BUFFER_COUNT 32768
+#define AIO_MAX_EVENTS 64
+#define AIO_DRAIN_ATTEMPTS 100
+
+#if AIO_HAVE_IO_URING
+/* IORING_OP_READ_MULTISHOT (Linux 6.7), missing from older headers */
+#define AIO_OP_READ_MULTISHOT 49
+#define AIO_BUFFER_GROUP 0
+
+/* The low bits of a request's user_data say which request of the port completed */
+#define TAG_READ   0u
+#define TAG_WRITE  1u
+#define TAG_POLL   2u
+#define TAG_CANCEL 3u
+#define TAG_MASK   3u
+#endif
+
+struct aio_write_s {
+    const uint8_t *data;
+    size_t size;
+    size_t done;
+    serial_aio_write_callback_t on_written;
+    void *user_data;
+    struct aio_write_s *next;
+};
+
+struct aio_port_s {
+    serial_handle_t handle;
+    serial_aio_read_callback_t on_read;
+    void *user_data;
+
+    /* Queued writes, the head is the one being written */
+    struct aio_write_s *writes;
+    struct aio_write_s *writes_tail;
+    int write_in_flight;            /* io_uring: write submitted; epoll: waiting for EPOLLOUT */
+
+    int read_armed;                 /* io_uring read request outstanding */
+    int rearm_read;                 /* read request to be posted with the next batch */
+    int write_poll;                 /* next write waits for POLLOUT first */
+    int poll_in_flight;
+    unsigned in_flight;             /* io_uring requests that still refer to the port */
+    unsigned cancels;               /* io_uring cancels still to be posted, 1 << tag each */
+
+    int dirty;                      /* on the list of ports with work for the next batch */
+    struct aio_port_s *next_dirty;
+    int dead;
+    struct aio_port_s *next_dead;
+};
+
+#if AIO_HAVE_IO_URING
+struct aio_ring_s {
+    int fd;
+    unsigned sq_entries;
+    unsigned sq_mask;
+    unsigned sq_tail;               /* local tail, published before io_uring_enter() */
+    unsigned *sq_head_ptr;
+    unsigned *sq_tail_ptr;
+    unsigned *sq_flags_ptr;
+    struct io_uring_sqe *sqes;
+    unsigned cq_mask;
+    unsigned *cq_head_ptr;
+    unsigned *cq_tail_ptr;
+    struct io_uring_cqe *cqes;
+    void *sq_map;
+    size_t sq_map_size;
+    void *cq_map;
+    size_t cq_map_size;
+    size_t sqes_size;
+    uint8_t read_op;
+
+    /* Provided buffers are returned to this ring, published once per batch */
+    struct io_uring_buf_ring *buf_ring;
+    size_t buf_ring_size;
+    unsigned buf_tail;
+};
+#endif
+
+struct serial_aio_s {
+    int backend;
+    size_t count;
+
+    /* Ports indexed by descriptor for O(1) lookup */
+    struct aio_port_s **ports;
+    size_t ports_size;
+
+    /* Ports with writes or a read to post in the next batch */
+    struct aio_port_s *dirty;
+
+    /* Removed ports, freed once nothing refers to them any more */
+    struct aio_port_s *graveyard;
+
+    /* Completed write requests kept for reuse */
+    struct aio_write_s *free_writes;
+
+    uint8_t *buffers;
+    unsigned buffer_count;
+    unsigned buffer_size;
+
+    int epoll_fd;
+#if AIO_HAVE_IO_URING
+    struct aio_ring_s ring;
+#endif
+};
+
+static struct aio_port_s *find_port(const serial_aio_t *aio, serial_handle_t handle) {
+    if (handle < 0 || (size_t)handle >= aio->ports_size) {
+        return NULL;
+    }
+    return aio->ports[handle];
+}
+
+static void mark_dirty(serial_aio_t *aio, struct aio_port_s *port) {
+    if (!port->dirty) {
+        port->dirty = 1;
+        port->next_dirty = aio->dirty;
+        aio->dirty = port;
+    }
+}
+
+static void release_writes(serial_aio_t *aio, struct aio_port_s *port) {
+    if (port->writes) {
+        port->writes_tail->next = aio->free_writes;
+        aio->free_writes = port->writes;
+        port->writes = NULL;
+        port->writes_tail = NULL;
+    }
+}
+
+static void free_graveyard(serial_aio_t *aio, int all) {
+    struct aio_port_s **link = &aio->graveyard;
+    while (*link) {
+        struct aio_port_s *port = *link;
+        if (!all && (port->in_flight > 0 || port->dirty)) {
+            link = &port->next_dead;
+            continue;
+        }
+        *link = port->next_dead;
+        release_writes(aio, port);
+        free(port);
+    }
+}
+
+/* Pops the head write and reports it; returns the number of callbacks made */
+static int finish_write(serial_aio_t *aio, struct aio_port_s *port, int status) {
+    struct aio_write_s *write_request = port->writes;
+    port->writes = write_request->next;
+    if (!port->writes) {
+        port->writes_tail = NULL;
+    }
+
+    serial_aio_write_callback_t on_written = write_request->on_written;
+    void *user_data = write_request->user_data;
+    size_t done = write_request->done;
+    write_request->next = aio->free_writes;
+    aio->free_writes = write_request;
+
+    if (on_written) {
+        on_written(aio, port->handle, done, status, user_data);
+        return 1;
+    }
+    return 0;
+}
+
+/* Reports end of file or a read error and drops the port */
+static int fail_read(serial_aio_t *aio, struct aio_port_s *port) {
+    port->on_read(aio, port->handle, NULL, 0, SERIAL_ERROR_READ, port->user_data);
+    if (!port->dead) {
+        serial_aio_remove(aio, port->handle);
+    }
+    return 1;
+}
+
+/* epoll backend */
+
+static void watch_writable(serial_aio_t *aio, struct aio_port_s *port, int enable) {
+    struct epoll_event event = { .events = EPOLLIN | (enable ? EPOLLOUT : 0u), .data.ptr = port };
+    epoll_ctl(aio->epoll_fd, EPOLL_CTL_MOD, port->handle, &event);
+    port->write_in_flight = enable;
+}
+
+static int epoll_flush_port(serial_aio_t *aio, struct aio_port_s *port) {
+    int dispatched = 0;
+    while (!port->dead && port->writes && !port->write_in_flight) {
+        struct aio_write_s *write_request = port->writes;
+        ssize_t written = write(port->handle, write_request->data + write_request->done,
+                                write_request->size - write_request->done);
+        if (written > 0 || (written == 0 && write_request->done == write_request->size)) {
+            write_request->done += (size_t)written;
+            if (write_request->done == write_request->size) {
+                dispatched += finish_write(aio, port, SERIAL_SUCCESS);
+            }
+        } else if (written == 0 || errno == EAGAIN) {
+            watch_writable(aio, port, 1);
+        } else if (errno != EINTR) {
+            dispatched += finish_write(aio, port, SERIAL_ERROR_WRITE);
+        }
+    }
+    return dispatched;
+}
+
+static int epoll_read_port(serial_aio_t *aio, struct aio_port_s *port) {
+    ssize_t count = read(port->handle, aio->buffers, aio->buffer_size);
+    if (count > 0) {
+        port->on_read(aio, port->handle, aio->buffers, (size_t)count, SERIAL_SUCCESS, port->user_data);
+        return 1;
+    }
+    if (count < 0 && (errno == EAGAIN || errno == EINTR)) {
+        return 0;
+    }
+    return fail_read(aio, port);
+}
+
+static int epoll_run_once(serial_aio_t *aio, int timeout_ms) {
+    int dispatched = 0;
+    struct aio_port_s *port = aio->dirty;
+    aio->dirty = NULL;
+    while (port) {
+        struct aio_port_s *next = port->next_dirty;
+        port->dirty = 0;
+        if (!port->dead) {
+            dispatched += epoll_flush_port(aio, port);
+        }
+        port = next;
+    }
+    if (dispatched > 0 || aio->dirty) {
+        timeout_ms = 0;
+    }
+
+    struct epoll_event events[AIO_MAX_EVENTS];
+    int count = epoll_wait(aio->epoll_fd, events, AIO_MAX_EVENTS, timeout_ms);
+    if (count < 0) {
+        if (errno != EINTR) {
+            return SERIAL_ERROR_READ;
+        }
+        count = 0;
+    }
+
+    for (int i = 0; i < count; i++) {
+        port = events[i].data.ptr;
+        uint32_t ready = events[i].events;
+        if (!port->dead && (ready & EPOLLOUT)) {
+            watch_writable(aio, port, 0);
+            dispatched += epoll_flush_port(aio, port);
+        }
+        if (!port->dead && (ready & (EPOLLIN | EPOLLERR | EPOLLHUP))) {
+            dispatched += epoll_read_port(aio, port);
+        }
+    }
+
+    free_graveyard(aio, 0);
+    return dispatched;
+}
+
+/* io_uring backend */
+
+#if AIO_HAVE_IO_URING
+
+static int ring_enter(serial_aio_t *aio, unsigned min_complete, int timeout_ms) {
+    struct aio_ring_s *ring = &aio->ring;
+    __atomic_store_n(ring->sq_tail_ptr, ring->sq_tail, __ATOMIC_RELEASE);
+    unsigned to_submit = ring->sq_tail - __atomic_load_n(ring->sq_head_ptr, __ATOMIC_ACQUIRE);
+
+    struct __kernel_timespec ts;
+    struct io_uring_getevents_arg arg;
+    memset(&arg, 0, sizeof(arg));
+    if (min_complete > 0 && timeout_ms >= 0) {
+        ts.tv_sec = timeout_ms / 1000;
+        ts.tv_nsec = (long long)(timeout_ms % 1000) * 1000000;
+        arg.ts = (uint64_t)(uintptr_t)&ts;
+    }
+
+    long result = syscall(__NR_io_uring_enter, ring->fd, to_submit, min_complete,
+                          IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg, sizeof(arg));
+    if (result < 0 && errno != ETIME && errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+        return SERIAL_ERROR_READ;
+    }
+    return SERIAL_SUCCESS;
+}
+
+static unsigned sq_space(const struct aio_ring_s *ring) {
+    return ring->sq_entries - (ring->sq_tail - __atomic_load_n(ring->sq_head_ptr, __ATOMIC_ACQUIRE));
+}
+
+/* Makes room for count submission entries, flushing the queue first if needed; returns 0 if there is none */
+static int reserve_sqes(serial_aio_t *aio, unsigned count) {
+    if (sq_space(&aio->ring) < count) {
+        ring_enter(aio, 0, 0);
+    }
+    return sq_space(&aio->ring) >= count;
+}
+
+/*
+ * Returns a cleared submission entry, or NULL when the kernel does not take
+ * the queued ones; callers then mark the port dirty to retry with the next batch.
+ */
+static struct io_uring_sqe *get_sqe(serial_aio_t *aio) {
+    struct aio_ring_s *ring = &aio->ring;
+    if (!reserve_sqes(aio, 1)) {
+        return NULL;
+    }
+    struct io_uring_sqe *sqe = &ring->sqes[ring->sq_tail & ring->sq_mask];
+    ring->sq_tail++;
+    memset(sqe, 0, sizeof(*sqe));
+    return sqe;
+}
+
+static void recycle_buffer(serial_aio_t *aio, unsigned id) {
+    struct aio_ring_s *ring = &aio->ring;
+    struct io_uring_buf *buffer = &ring->buf_ring->bufs[ring->buf_tail & (aio->buffer_count - 1)];
+    buffer->addr = (uint64_t)(uintptr_t)(aio->buffers + (size_t)id * aio->buffer_size);
+    buffer->len = aio->buffer_size;
+    buffer->bid = (uint16_t)id;
+    ring->buf_tail++;
+}
+
+static void publish_buffers(serial_aio_t *aio) {
+    __atomic_store_n(&aio->ring.buf_ring->tail, (uint16_t)aio->ring.buf_tail, __ATOMIC_RELEASE);
+}
+
+static void uring_arm_read(serial_aio_t *aio, struct aio_port_s *port) {
+    struct io_uring_sqe *sqe = get_sqe(aio);
+    if (!sqe) {
+        mark_dirty(aio, port);
+        return;
+    }
+    sqe->opcode = aio->ring.read_op;
+    sqe->fd = port->handle;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = AIO_BUFFER_GROUP;
+    sqe->off = (uint64_t)-1;
+    sqe->len = aio->ring.read_op == AIO_OP_READ_MULTISHOT ? 0 : aio->buffer_size;
+    sqe->user_data = (uint64_t)((uintptr_t)port | TAG_READ);
+    port->read_armed = 1;
+    port->rearm_read = 0;
+    port->in_flight++;
+}
+
+static void uring_submit_write(serial_aio_t *aio, struct aio_port_s *port) {
+    struct aio_write_s *write_request = port->writes;
+    struct io_uring_sqe *sqe;
+
+    /* A poll is linked to the write after it, so both go into the same batch */
+    if (!reserve_sqes(aio, port->write_poll ? 2u : 1u)) {
+        mark_dirty(aio, port);
+        return;
+    }
+    if (port->write_poll) {
+        /* The last attempt would have blocked: wait for room, then write */
+        sqe = get_sqe(aio);
+        sqe->opcode = IORING_OP_POLL_ADD;
+        sqe->fd = port->handle;
+        sqe->flags = IOSQE_IO_LINK;
+        sqe->poll32_events = POLLOUT;
+        sqe->user_data = (uint64_t)((uintptr_t)port | TAG_POLL);
+        port->write_poll = 0;
+        port->poll_in_flight = 1;
+        port->in_flight++;
+    }
+
+    sqe = get_sqe(aio);
+    size_t remaining = write_request->size - write_request->done;
+    sqe->opcode = IORING_OP_WRITE;
+    sqe->fd = port->handle;
+    sqe->addr = (uint64_t)(uintptr_t)(write_request->data + write_request->done);
+    sqe->len = remaining > UINT32_MAX ? UINT32_MAX : (uint32_t)remaining;
+    sqe->off = (uint64_t)-1;
+    sqe->user_data = (uint64_t)((uintptr_t)port | TAG_WRITE);
+    port->write_in_flight = 1;
+    port->in_flight++;
+}
+
+/* Without a free entry the cancel is kept on the port and posted with the next batch */
+static void uring_cancel(serial_aio_t *aio, struct aio_port_s *port, unsigned tag) {
+    struct io_uring_sqe *sqe = get_sqe(aio);
+    if (!sqe) {
+        port->cancels |= 1u << tag;
+        return;
+    }
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->addr = (uint64_t)((uintptr_t)port | tag);
+    sqe->user_data = TAG_CANCEL;
+    port->cancels &= ~(1u << tag);
+}
+
+static int uring_complete_read(serial_aio_t *aio, struct aio_port_s *port, int result, unsigned flags) {
+    int dispatched = 0;
+    if (!(flags & IORING_CQE_F_MORE)) {
+        port->read_armed = 0;
+        port->in_flight--;
+    }
+
+    if (flags & IORING_CQE_F_BUFFER) {
+        unsigned id = flags >> IORING_CQE_BUFFER_SHIFT;
+        if (result > 0 && !port->dead) {
+            port->on_read(aio, port->handle, aio->buffers + (size_t)id * aio->buffer_size, (size_t)result,
+                          SERIAL_SUCCESS, port->user_data);
+            dispatched = 1;
+        }
+        recycle_buffer(aio, id);
+    }
+    if (port->dead || port->read_armed) {
+        return dispatched;
+    }
+
+    if ((result == -EINVAL || result == -EOPNOTSUPP || result == -EBADFD) &&
+        aio->ring.read_op == AIO_OP_READ_MULTISHOT) {
+        /* The file cannot do multishot reads: post one read per completion from now on */
+        aio->ring.read_op = IORING_OP_READ;
+        result = -EAGAIN;
+    }
+    if (result > 0 || result == -ENOBUFS || result == -EAGAIN || result == -EINTR || result == -ECANCELED) {
+        port->rearm_read = 1;
+        mark_dirty(aio, port);
+        return dispatched;
+    }
+    return dispatched + fail_read(aio, port);
+}
+
+static int uring_complete_write(serial_aio_t *aio, struct aio_port_s *port, int result) {
+    port->write_in_flight = 0;
+    port->in_flight--;
+    if (port->dead) {
+        return 0;
+    }
+
+    struct aio_write_s *write_request = port->writes;
+    int dispatched = 0;
+    if (result == -EAGAIN) {
+        port->write_poll = 1;
+    } else if (result == -EINTR || result == -ECANCELED) {
+        /* Retried with the next batch */
+    } else if (result < 0 || (result == 0 && write_request->done < write_request->size)) {
+        dispatched = finish_write(aio, port, SERIAL_ERROR_WRITE);
+    } else {
+        write_request->done += (size_t)result;
+        if (write_request->done == write_request->size) {
+            dispatched = finish_write(aio, port, SERIAL_SUCCESS);
+        }
+    }
+    if (!port->dead && port->writes && !port->write_in_flight) {
+        mark_dirty(aio, port);
+    }
+    return dispatched;
+}
+
+static int uring_dispatch(serial_aio_t *aio, const struct io_uring_cqe *cqe) {
+    uintptr_t user_data = (uintptr_t)cqe->user_data;
+    struct aio_port_s *port = (struct aio_port_s *)(user_data & ~(uintptr_t)TAG_MASK);
+
+    switch (user_data & TAG_MASK) {
+    case TAG_READ:
+        return uring_complete_read(aio, port, cqe->res, cqe->flags);
+    case TAG_WRITE:
+        return uring_complete_write(aio, port, cqe->res);
+    case TAG_POLL:
+        port->poll_in_flight = 0;
+        port->in_flight--;
+        return 0;
+    default:
+        return 0;
+    }
+}
+
+static int uring_run_once(serial_aio_t *aio, int timeout_ms) {
+    struct aio_ring_s *ring = &aio->ring;
+
+    /* Queue this batch: cancels left over from removed ports, reads to (re)post and the next write of every port */
+    for (struct aio_port_s *dead = aio->graveyard; dead; dead = dead->next_dead) {
+        for (unsigned tag = TAG_READ; dead->cancels && tag <= TAG_POLL; tag++) {
+            if (dead->cancels & (1u << tag)) {
+                uring_cancel(aio, dead, tag);
+            }
+        }
+    }
+    struct aio_port_s *port = aio->dirty;
+    aio->dirty = NULL;
+    while (port) {
+        struct aio_port_s *next = port->next_dirty;
+        port->dirty = 0;
+        if (!port->dead) {
+            if (port->rearm_read && !port->read_armed) {
+                uring_arm_read(aio, port);
+            }
+            if (port->writes && !port->write_in_flight) {
+                uring_submit_write(aio, port);
+            }
+        }
+        port = next;
+    }
+
+    /* One system call submits the batch and waits, none if completions are already there */
+    unsigned head = *ring->cq_head_ptr;
+    unsigned ready = __atomic_load_n(ring->cq_tail_ptr, __ATOMIC_ACQUIRE) - head;
+    unsigned sq_flags = __atomic_load_n(ring->sq_flags_ptr, __ATOMIC_RELAXED);
+    int pending = ring->sq_tail != __atomic_load_n(ring->sq_head_ptr, __ATOMIC_ACQUIRE);
+    int wait = ready == 0 && timeout_ms != 0 && !aio->dirty;
+    if (pending || wait || (sq_flags & (IORING_SQ_TASKRUN | IORING_SQ_CQ_OVERFLOW))) {
+        int result = ring_enter(aio, wait ? 1u : 0u, timeout_ms);
+        if (result != SERIAL_SUCCESS) {
+            return result;
+        }
+    }
+
+    int dispatched = 0;
+    unsigned tail = __atomic_load_n(ring->cq_tail_ptr, __ATOMIC_ACQUIRE);
+    for (; head != tail; head++) {
+        dispatched += uring_dispatch(aio, &ring->cqes[head & ring->cq_mask]);
+    }
+    __atomic_store_n(ring->cq_head_ptr, head, __ATOMIC_RELEASE);
+
+    publish_buffers(aio);
+    free_graveyard(aio, 0);
+    return dispatched;
+}
+
+static int probe_opcode(int ring_fd, unsigned opcode) {
+    size_t size = sizeof(struct io_uring_probe) + 256 * sizeof(struct io_uring_probe_op);
+    struct io_uring_probe *probe = calloc(1, size);
+    if (!probe) {
+        return 0;
+    }
+    int supported = syscall(__NR_io_uring_register, ring_fd, IORING_REGISTER_PROBE, probe, 256) == 0 &&
+                    opcode <= probe->last_op && (probe->ops[opcode].flags & IO_URING_OP_SUPPORTED);
+    free(probe);
+    return supported;
+}
+
+static void uring_teardown(serial_aio_t *aio) {
+    struct aio_ring_s *ring = &aio->ring;
+    if (ring->fd >= 0) {
+        close(ring->fd);
+    }
+    if (ring->buf_ring) {
+        munmap(ring->buf_ring, ring->buf_ring_size);
+    }
+    if (ring->sqes) {
+        munmap(ring->sqes, ring->sqes_size);
+    }
+    if (ring->cq_map && ring->cq_map != ring->sq_map) {
+        munmap(ring->cq_map, ring->cq_map_size);
+    }
+    if (ring->sq_map) {
+        munmap(ring->sq_map, ring->sq_map_size);
+    }
+    memset(ring, 0, sizeof(*ring));
+    ring->fd = -1;
+}
+
+static int uring_setup(serial_aio_t *aio, unsigned queue_depth) {
+    struct aio_ring_s *ring = &aio->ring;
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    params.flags = IORING_SETUP_COOP_TASKRUN | IORING_SETUP_TASKRUN_FLAG;
+    ring->fd = (int)syscall(__NR_io_uring_setup, queue_depth, &params);
+    if (ring->fd < 0 && errno == EINVAL) {
+        memset(&params, 0, sizeof(params));
+        ring->fd = (int)syscall(__NR_io_uring_setup, queue_depth, &params);
+    }
+    if (ring->fd < 0) {
+        return -1;
+    }
+    if (!(params.features & IORING_FEAT_EXT_ARG) || !(params.features & IORING_FEAT_NODROP)) {
+        uring_teardown(aio);
+        return -1;
+    }
+
+    ring->sq_map_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cq_map_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        if (ring->cq_map_size > ring->sq_map_size) {
+            ring->sq_map_size = ring->cq_map_size;
+        }
+        ring->cq_map_size = ring->sq_map_size;
+    }
+    ring->sq_map = mmap(NULL, ring->sq_map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd,
+                        IORING_OFF_SQ_RING);
+    if (ring->sq_map == MAP_FAILED) {
+        ring->sq_map = NULL;
+        uring_teardown(aio);
+        return -1;
+    }
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        ring->cq_map = ring->sq_map;
+    } else {
+        ring->cq_map = mmap(NULL, ring->cq_map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                            ring->fd, IORING_OFF_CQ_RING);
+        if (ring->cq_map == MAP_FAILED) {
+            ring->cq_map = NULL;
+            uring_teardown(aio);
+            return -1;
+        }
+    }
+    ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd,
+                      IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED) {
+        ring->sqes = NULL;
+        uring_teardown(aio);
+        return -1;
+    }
+
+    uint8_t *sq = ring->sq_map;
+    uint8_t *cq = ring->cq_map;
+    ring->sq_entries = params.sq_entries;
+    ring->sq_mask = *(unsigned *)(sq + params.sq_off.ring_mask);
+    ring->sq_head_ptr = (unsigned *)(sq + params.sq_off.head);
+    ring->sq_tail_ptr = (unsigned *)(sq + params.sq_off.tail);
+    ring->sq_flags_ptr = (unsigned *)(sq + params.sq_off.flags);
+    ring->sq_tail = *ring->sq_tail_ptr;
+    ring->cq_mask = *(unsigned *)(cq + params.cq_off.ring_mask);
+    ring->cq_head_ptr = (unsigned *)(cq + params.cq_off.head);
+    ring->cq_tail_ptr = (unsigned *)(cq + params.cq_off.tail);
+    ring->cqes = (struct io_uring_cqe *)(cq + params.cq_off.cqes);
+
+    /* Entries are always used in order, so the index array never changes */
+    unsigned *array = (unsigned *)(sq + params.sq_off.array);
+    for (unsigned i = 0; i < params.sq_entries; i++) {
+        array[i] = i;
+    }
+
+    ring->buf_ring_size = aio->buffer_count * sizeof(struct io_uring_buf);
+    ring->buf_ring = mmap(NULL, ring->buf_ring_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (ring->buf_ring == MAP_FAILED) {
+        ring->buf_ring = NULL;
+        uring_teardown(aio);
+        return -1;
+    }
+    struct io_uring_buf_reg registration;
+    memset(&registration, 0, sizeof(registration));
+    registration.ring_addr = (uint64_t)(uintptr_t)ring->buf_ring;
+    registration.ring_entries = aio->buffer_count;
+    registration.bgid = AIO_BUFFER_GROUP;
+    if (syscall(__NR_io_uring_register, ring->fd, IORING_REGISTER_PBUF_RING, &registration, 1) != 0) {
+        uring_teardown(aio);
+        return -1;
+    }
+    for (unsigned i = 0; i < aio->buffer_count; i++) {
+        recycle_buffer(aio, i);
+    }
+    publish_buffers(aio);
+
+    ring->read_op = probe_opcode(ring->fd, AIO_OP_READ_MULTISHOT) ? AIO_OP_READ_MULTISHOT : IORING_OP_READ;
+    return 0;
+}
+
+/* Cancels everything still in flight and waits for the kernel to let go of the buffers */
+static void uring_drain(serial_aio_t *aio) {
+    for (size_t i = 0; i < aio->ports_size; i++) {
+        if (aio->ports[i]) {
+            serial_aio_remove(aio, (serial_handle_t)i);
+        }
+    }
+    for (int attempt = 0; aio->graveyard && attempt < AIO_DRAIN_ATTEMPTS; attempt++) {
+        if (uring_run_once(aio, 10) < 0) {
+            break;
+        }
+    }
+}
+
+#endif /* AIO_HAVE_IO_URING */
+
+serial_aio_t *serial_aio_create(const struct serial_aio_config_s *config) {
+    struct serial_aio_config_s settings;
+    memset(&settings, 0, sizeof(settings));
+    if (config) {
+        settings = *config;
+    }
+    unsigned queue_depth = settings.queue_depth ? settings.queue_depth : AIO_DEFAULT_QUEUE_DEPTH;
+    unsigned buffer_count = settings.buffer_count ? settings.buffer_count : AIO_DEFAULT_BUFFER_COUNT;
+    unsigned buffer_size = settings.buffer_size ? settings.buffer_size : AIO_DEFAULT_BUFFER_SIZE;
+    if (settings.backend > SERIAL_AIO_IO_URING || (buffer_count & (buffer_count - 1)) != 0 ||
+        buffer_count > AIO_MAX_BUFFER_COUNT) {
+        return NULL;
+    }
+
+    serial_aio_t *aio = calloc(1, sizeof(*aio));
+    if (!aio) {
+        return NULL;
+    }
+    aio->epoll_fd = -1;
+    aio->buffer_count = buffer_count;
+    aio->buffer_size = buffer_size;
+
+#if AIO_HAVE_IO_URING
+    aio->ring.fd = -1;
+    if (settings.backend != SERIAL_AIO_EPOLL) {
+        aio->buffers = malloc((size_t)buffer_count * buffer_size);
+        if (aio->buffers && uring_setup(aio, queue_depth) == 0) {
+            aio->backend = SERIAL_AIO_IO_URING;
+            return aio;
+        }
+        free(aio->buffers);
+        aio->buffers = NULL;
+    }
+#else
+    (void)queue_depth;
+#endif
+
+    /* epoll reads one buffer at a time */
+    aio->backend = SERIAL_AIO_EPOLL;
+    aio->buffers = malloc(buffer_size);
+    aio->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (!aio->buffers || aio->epoll_fd < 0) {
+        serial_aio_destroy(aio);
+        return NULL;
+    }
+    return aio;
+}
+
+void serial_aio_destroy(serial_aio_t *aio) {
+    if (!aio) {
+        return;
+    }
+
+#if AIO_HAVE_IO_URING
+    if (aio->backend == SERIAL_AIO_IO_URING) {
+        uring_drain(aio);
+        uring_teardown(aio);
+    }
+#endif
+    if (aio->epoll_fd >= 0) {
+        close(aio->epoll_fd);
+    }
+
+    for (size_t i = 0; i < aio->ports_size; i++) {
+        if (aio->ports[i]) {
+            release_writes(aio, aio->ports[i]);
+            free(aio->ports[i]);
+        }
+    }
+    free_graveyard(aio, 1);
+    while (aio->free_writes) {
+        struct aio_write_s *write_request = aio->free_writes;
+        aio->free_writes = write_request->next;
+        free(write_request);
+    }
+    free(aio->ports);
+    free(aio->buffers);
+    free(aio);
+}
+
+int serial_aio_backend(const serial_aio_t *aio) {
+    return aio ? aio->backend : SERIAL_AIO_EPOLL;
+}
+
+int serial_aio_add(serial_aio_t *aio, serial_handle_t handle, serial_aio_read_callback_t on_read,
+                   void *user_data) {
+    if (!aio || !on_read || handle == SERIAL_INVALID_HANDLE || handle < 0) {
+        return SERIAL_ERROR_INVALID_HANDLE;
+    }
+    if (find_port(aio, handle) || serial_transport_lookup(handle)) {
+        return SERIAL_ERROR_CONFIG;
+    }
+
+    if ((size_t)handle >= aio->ports_size) {
+        size_t size = aio->ports_size ? aio->ports_size : 64;
+        while (size <= (size_t)handle) {
+            size *= 2;
+        }
+        struct aio_port_s **ports = realloc(aio->ports, size * sizeof(*ports));
+        if (!ports) {
+            return SERIAL_ERROR_CONFIG;
+        }
+        memset(ports + aio->ports_size, 0, (size - aio->ports_size) * sizeof(*ports));
+        aio->ports = ports;
+        aio->ports_size = size;
+    }
+
+    struct aio_port_s *port = calloc(1, sizeof(*port));
+    if (!port) {
+        return SERIAL_ERROR_CONFIG;
+    }
+    port->handle = handle;
+    port->on_read = on_read;
+    port->user_data = user_data;
+
+    if (aio->backend == SERIAL_AIO_EPOLL) {
+        struct epoll_event event = { .events = EPOLLIN, .data.ptr = port };
+        if (epoll_ctl(aio->epoll_fd, EPOLL_CTL_ADD, handle, &event) != 0) {
+            free(port);
+            return SERIAL_ERROR_CONFIG;
+        }
+    } else {
+        /* The read is posted with the next batch */
+        port->rearm_read = 1;
+        mark_dirty(aio, port);
+    }
+
+    aio->ports[handle] = port;
+    aio->count++;
+    return SERIAL_SUCCESS;
+}
+
+int serial_aio_remove(serial_aio_t *aio, serial_handle_t handle) {
+    struct aio_port_s *port = aio ? find_port(aio, handle) : NULL;
+    if (!port) {
+        return SERIAL_ERROR_INVALID_HANDLE;
+    }
+
+    if (aio->backend == SERIAL_AIO_EPOLL) {
+        epoll_ctl(aio->epoll_fd, EPOLL_CTL_DEL, handle, NULL);
+    }
+#if AIO_HAVE_IO_URING
+    else {
+        if (port->read_armed) {
+            uring_cancel(aio, port, TAG_READ);
+        }
+        if (port->poll_in_flight) {
+            uring_cancel(aio, port, TAG_POLL);
+        }
+        if (port->write_in_flight) {
+            uring_cancel(aio, port, TAG_WRITE);
+        }
+    }
+#endif
+    aio->ports[handle] = NULL;
+    aio->count--;
+
+    /* Completions for this port may still be pending in the current batch or the kernel */
+    port->dead = 1;
+    port->next_dead = aio->graveyard;
+    aio->graveyard = port;
+    return SERIAL_SUCCESS;
+}
+
+int serial_aio_write(serial_aio_t *aio, serial_handle_t handle, const void *data, size_t size,
+                     serial_aio_write_callback_t on_written, void *user_data) {
+    struct aio_port_s *port = aio ? find_port(aio, handle) : NULL;
+    if (!port) {
+        return SERIAL_ERROR_INVALID_HANDLE;
+    }
+    if (!data && size > 0) {
+        return SERIAL_ERROR_WRITE;
+    }
+
+    struct aio_write_s *write_request = aio->free_writes;
+    if (write_request) {
+        aio->free_writes = write_request->next;
+    } else if (!(write_request = malloc(sizeof(*write_request)))) {
+        return SERIAL_ERROR_WRITE;
+    }
+    write_request->data = data;
+    write_request->size = size;
+    write_request->done = 0;
+    write_request->on_written = on_written;
+    write_request->user_data = user_data;
+    write_request->next = NULL;
+
+    if (port->writes_tail) {
+        port->writes_tail->next = write_request;
+    } else {
+        port->writes = write_request;
+    }
+    port->writes_tail = write_request;
+    if (!port->write_in_flight) {
+        mark_dirty(aio, port);
+    }
+    return SERIAL_SUCCESS;
+}
+
+int serial_aio_run_once(serial_aio_t *aio, int timeout_ms) {
+    if (!aio) {
+        return SERIAL_ERROR_INVALID_HANDLE;
+    }
+#if AIO_HAVE_IO_URING
+    if (aio->backend == SERIAL_AIO_IO_URING) {
+        return uring_run_once(aio, timeout_ms);
+    }
+#endif
+    return epoll_run_once(aio, timeout_ms);
+}
+
+size_t serial_aio_count(const serial_aio_t *aio) {
+    return aio ? aio->count : 0;
+}
+
+#else
+typedef int serial_aio_unsupported_t;
+#endif /* __linux__ */
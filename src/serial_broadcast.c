@@ -0,0 +1,213 @@
+/**
+ * @file serial_broadcast.c
+ * @brief Parallel fan-out of one write: a sweep, a poll() loop and a worker pool
+ */
+
+#include "serial_internal.h"
+#include "../include/serial_broadcast.h"
+
+#if defined(__linux__)
+
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct broadcast_s {
+    const serial_handle_t *handles;
+    const uint8_t *data;
+    size_t size;
+    uint64_t start_ns;
+    uint64_t deadline_ms;
+    struct serial_broadcast_result_s *results;
+    size_t *blocking;           /* ports left for the worker pool */
+    size_t blocking_count;
+    atomic_size_t next_blocking;
+};
+
+/* One non-blocking write attempt; records the first and last byte times */
+static int write_some(struct broadcast_s *broadcast, size_t port) {
+    struct serial_broadcast_result_s *result = &broadcast->results[port];
+    struct iovec iov = { .iov_base = (void *)(broadcast->data + result->written),
+                         .iov_len = broadcast->size - result->written };
+    size_t written = 0;
+    int status = serial_writev(broadcast->handles[port], &iov, 1, &written);     /* EAGAIN writes nothing */
+    if (written > 0) {
+        uint64_t now_ns = serial_monotonic_ns() - broadcast->start_ns;
+        result->first_ns = result->written == 0 ? now_ns : result->first_ns;
+        result->written += written;
+        result->complete_ns = result->written == broadcast->size ? now_ns : 0;
+    }
+    if (status != SERIAL_SUCCESS) {
+        result->status = status;
+    } else if (result->written == broadcast->size) {
+        result->status = SERIAL_SUCCESS;
+    }
+    return status;
+}
+
+static int remaining_ms(const struct broadcast_s *broadcast) {
+    uint64_t now = serial_monotonic_ms();
+    return now >= broadcast->deadline_ms ? 0 : (int)(broadcast->deadline_ms - now);
+}
+
+/* Finishes buffered and transport handles with their own blocking waits */
+static void *worker_main(void *arg) {
+    struct broadcast_s *broadcast = arg;
+    size_t index;
+    while ((index = atomic_fetch_add(&broadcast->next_blocking, 1)) < broadcast->blocking_count) {
+        size_t port = broadcast->blocking[index];
+        struct serial_broadcast_result_s *result = &broadcast->results[port];
+        while (result->status == SERIAL_ERROR_TIMEOUT) {
+            int wait_ms = remaining_ms(broadcast);
+            if (wait_ms == 0) {
+                break;
+            }
+            int status = serial_wait_writable(broadcast->handles[port], wait_ms);
+            if (status != SERIAL_SUCCESS) {
+                result->status = status;
+            } else {
+                write_some(broadcast, port);
+            }
+        }
+    }
+    return NULL;
+}
+
+/* Services the partially written descriptor handles together until they finish or time out */
+static void poll_descriptors(struct broadcast_s *broadcast, size_t *ports, struct pollfd *pfds, size_t count) {
+    while (count > 0) {
+        for (size_t i = 0; i < count; i++) {
+            pfds[i] = (struct pollfd){ .fd = broadcast->handles[ports[i]], .events = POLLOUT };
+        }
+        int wait_ms = remaining_ms(broadcast);
+        int ready = wait_ms > 0 ? poll(pfds, (nfds_t)count, wait_ms) : 0;
+        if (ready == 0) {
+            return;                     /* the rest keep SERIAL_ERROR_TIMEOUT */
+        }
+        if (ready < 0 && errno != EINTR) {
+            for (size_t i = 0; i < count; i++) {
+                broadcast->results[ports[i]].status = SERIAL_ERROR_WRITE;
+            }
+            return;
+        }
+
+        size_t kept = 0;
+        for (size_t i = 0; i < count; i++) {
+            size_t port = ports[i];
+            if (ready > 0 && (pfds[i].revents & POLLOUT)) {
+                write_some(broadcast, port);
+            } else if (ready > 0 && (pfds[i].revents & (POLLERR | POLLHUP | POLLNVAL))) {
+                broadcast->results[port].status = SERIAL_ERROR_WRITE;
+            }
+            if (broadcast->results[port].status == SERIAL_ERROR_TIMEOUT) {
+                ports[kept++] = port;
+            }
+        }
+        count = kept;
+    }
+}
+
+int serial_broadcast(const serial_handle_t *handles, size_t count, const void *data, size_t size, int timeout_ms,
+                     struct serial_broadcast_result_s *results, struct serial_broadcast_report_s *report) {
+    if ((count > 0 && !handles) || (size > 0 && !data) || timeout_ms < 0) {
+        return SERIAL_ERROR_INVALID_HANDLE;
+    }
+    struct serial_broadcast_result_s *own_results = NULL;
+    size_t *ports = malloc((count > 0 ? count : 1) * sizeof(*ports));
+    struct pollfd *pfds = malloc((count > 0 ? count : 1) * sizeof(*pfds));
+    if (!results) {
+        results = own_results = malloc((count > 0 ? count : 1) * sizeof(*results));
+    }
+    if (!ports || !pfds || !results) {
+        free(ports);
+        free(pfds);
+        free(own_results);
+        return SERIAL_ERROR_CONFIG;
+    }
+
+    struct broadcast_s broadcast = {
+        .handles = handles, .data = data, .size = size, .results = results,
+        .deadline_ms = serial_monotonic_ms() + (uint64_t)timeout_ms,
+    };
+    for (size_t i = 0; i < count; i++) {
+        results[i] = (struct serial_broadcast_result_s){ .status = size > 0 ? SERIAL_ERROR_TIMEOUT : SERIAL_SUCCESS };
+        if (handles[i] == SERIAL_INVALID_HANDLE) {
+            results[i].status = SERIAL_ERROR_INVALID_HANDLE;
+        }
+    }
+
+    /* Sweep: one non-blocking write per port, back to back */
+    broadcast.start_ns = serial_monotonic_ns();
+    for (size_t i = 0; i < count; i++) {
+        if (results[i].status == SERIAL_ERROR_TIMEOUT) {
+            write_some(&broadcast, i);
+        }
+    }
+
+    /* Sort the unfinished ports: descriptors to the poll() loop, the rest to the workers */
+    size_t descriptor_count = 0;
+    size_t blocking_count = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (results[i].status != SERIAL_ERROR_TIMEOUT) {
+            continue;
+        }
+        if (serial_transport_lookup(handles[i]) || serial_buffered_lookup(handles[i])) {
+            ports[count - 1 - blocking_count++] = i;
+        } else {
+            ports[descriptor_count++] = i;
+        }
+    }
+    broadcast.blocking = ports + count - blocking_count;
+    broadcast.blocking_count = blocking_count;
+    atomic_init(&broadcast.next_blocking, 0);
+
+    /* The calling thread joins the pool once the poll() loop is done */
+    pthread_t workers[SERIAL_BROADCAST_MAX_WORKERS];
+    size_t wanted = descriptor_count > 0 || blocking_count == 0 ? blocking_count : blocking_count - 1;
+    size_t started = 0;
+    while (started < wanted && started < SERIAL_BROADCAST_MAX_WORKERS &&
+           pthread_create(&workers[started], NULL, worker_main, &broadcast) == 0) {
+        started++;
+    }
+    poll_descriptors(&broadcast, ports, pfds, descriptor_count);
+    worker_main(&broadcast);            /* also covers worker threads that could not start */
+    for (size_t i = 0; i < started; i++) {
+        pthread_join(workers[i], NULL);
+    }
+    uint64_t elapsed_ns = serial_monotonic_ns() - broadcast.start_ns;
+
+    int status = SERIAL_SUCCESS;
+    struct serial_broadcast_report_s summary = { .elapsed_ns = elapsed_ns };
+    uint64_t first_min = UINT64_MAX, first_max = 0, complete_min = UINT64_MAX, complete_max = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (results[i].written > 0) {
+            first_min = results[i].first_ns < first_min ? results[i].first_ns : first_min;
+            first_max = results[i].first_ns > first_max ? results[i].first_ns : first_max;
+        }
+        if (results[i].status == SERIAL_SUCCESS) {
+            summary.completed++;
+            complete_min = results[i].complete_ns < complete_min ? results[i].complete_ns : complete_min;
+            complete_max = results[i].complete_ns > complete_max ? results[i].complete_ns : complete_max;
+        } else {
+            summary.failed++;
+            status = status == SERIAL_SUCCESS ? results[i].status : status;
+        }
+    }
+    summary.send_skew_ns = first_max > first_min ? first_max - first_min : 0;
+    summary.complete_skew_ns = complete_max > complete_min ? complete_max - complete_min : 0;
+    if (report) {
+        *report = summary;
+    }
+
+    free(ports);
+    free(pfds);
+    free(own_results);
+    return status;
+}
+
+#else
+typedef int serial_broadcast_unsupported_t;
+#endif
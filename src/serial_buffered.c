@@ -0,0 +1,374 @@
+/**
+ * @file serial_buffered.c
+ * @brief Buffered handle mode: a background I/O thread per handle
+ *
+ * The I/O thread moves bytes between the descriptor and two SPSC rings, so
+ * serial_read() and serial_write() on a buffered handle are plain memcpy
+ * calls. The thread parks in poll() when there is nothing to do; the
+ * application only pays for an eventfd write when it has to wake it.
+ */
+
+#include "serial_internal.h"
+
+#if defined(__linux__)
+
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <sys/eventfd.h>
+#include "../include/serial_ring.h"
+#include "../include/serial_rt.h"
+
+/* Descriptors at or above this value cannot be buffered */
+#define SERIAL_BUFFERED_MAX_FD 4096
+#define DEFAULT_RING_SIZE 4096
+#define CLOSE_FLUSH_TIMEOUT_MS 100
+
+struct serial_buffered_s {
+    serial_handle_t handle;
+    serial_ring_t *rx;
+    serial_ring_t *tx;
+    int wake_fd;                 /* application -> I/O thread */
+    int notify_fd;               /* I/O thread -> waiting reader */
+    int tx_notify_fd;            /* I/O thread -> waiting writer */
+    pthread_t thread;
+    atomic_int stop;
+    atomic_int error;
+    atomic_int parked;           /* I/O thread is (about to be) blocked in poll() */
+    atomic_int rx_stalled;       /* ...because the RX ring is full */
+    atomic_int reader_waiting;   /* a reader is blocked in serial_wait_readable() */
+    atomic_int writer_waiting;   /* a writer is blocked in serial_wait_writable() */
+    int use_rt;                  /* apply rt when the I/O thread starts */
+    struct serial_rt_config_s rt;
+};
+
+static _Atomic(struct serial_buffered_s *) buffered_ports[SERIAL_BUFFERED_MAX_FD];
+
+struct serial_buffered_s *serial_buffered_lookup(serial_handle_t handle) {
+    if (handle < 0 || handle >= SERIAL_BUFFERED_MAX_FD) {
+        return NULL;
+    }
+    return atomic_load_explicit(&buffered_ports[handle], memory_order_acquire);
+}
+
+static void signal_fd(int fd) {
+    uint64_t one = 1;
+    while (write(fd, &one, sizeof(one)) < 0 && errno == EINTR) {
+    }
+}
+
+static void drain_fd(int fd) {
+    uint64_t value;
+    while (read(fd, &value, sizeof(value)) < 0 && errno == EINTR) {
+    }
+}
+
+/* Wakes the I/O thread if it is parked */
+static void wake_io_thread(struct serial_buffered_s *buffered) {
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_exchange(&buffered->parked, 0)) {
+        signal_fd(buffered->wake_fd);
+    }
+}
+
+/* Wakes an application thread blocked in one of the wait functions */
+static void notify_waiter(atomic_int *waiting, int fd) {
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_exchange(waiting, 0)) {
+        signal_fd(fd);
+    }
+}
+
+static void notify_reader(struct serial_buffered_s *buffered) {
+    notify_waiter(&buffered->reader_waiting, buffered->notify_fd);
+}
+
+static void notify_writer(struct serial_buffered_s *buffered) {
+    notify_waiter(&buffered->writer_waiting, buffered->tx_notify_fd);
+}
+
+static void flush_on_stop(struct serial_buffered_s *buffered) {
+    const void *pending;
+    size_t size;
+
+    while ((size = serial_ring_peek(buffered->tx, &pending)) > 0) {
+        struct pollfd pfd = { .fd = buffered->handle, .events = POLLOUT };
+        if (poll(&pfd, 1, CLOSE_FLUSH_TIMEOUT_MS) <= 0) {
+            return;
+        }
+        ssize_t written = write(buffered->handle, pending, size);
+        struct serial_stats_block_s *stats = serial_stats_lookup(buffered->handle);
+        if (stats) {
+            serial_stats_write_syscall(stats, written, size, errno);
+        }
+        if (written < 0 && errno != EAGAIN && errno != EINTR) {
+            return;
+        }
+        if (written > 0) {
+            serial_ring_consume(buffered->tx, (size_t)written);
+        }
+    }
+}
+
+static void *io_thread_main(void *arg) {
+    struct serial_buffered_s *buffered = arg;
+    int fd = buffered->handle;
+    if (buffered->use_rt) {
+        serial_rt_apply(&buffered->rt, NULL);
+    }
+
+    while (!atomic_load_explicit(&buffered->stop, memory_order_acquire)) {
+        int progress = 0;
+
+        /* Device -> RX ring, read straight into the ring */
+        void *space;
+        size_t room = serial_ring_reserve(buffered->rx, &space);
+        if (room > 0) {
+            ssize_t count = read(fd, space, room);
+            struct serial_stats_block_s *stats = serial_stats_lookup(fd);
+            if (stats) {
+                serial_stats_read_syscall(stats, count, errno);
+            }
+            if (count > 0) {
+                serial_ring_commit(buffered->rx, (size_t)count);
+                notify_reader(buffered);
+                progress = 1;
+            } else if (count == 0 || (errno != EAGAIN && errno != EINTR)) {
+                break;
+            }
+        }
+
+        /* TX ring -> device, written straight from the ring */
+        const void *pending;
+        size_t size = serial_ring_peek(buffered->tx, &pending);
+        if (size > 0) {
+            ssize_t count = write(fd, pending, size);
+            struct serial_stats_block_s *stats = serial_stats_lookup(fd);
+            if (stats) {
+                serial_stats_write_syscall(stats, count, size, errno);
+            }
+            if (count > 0) {
+                serial_ring_consume(buffered->tx, (size_t)count);
+                notify_writer(buffered);
+                progress = 1;
+            } else if (count < 0 && errno != EAGAIN && errno != EINTR) {
+                break;
+            }
+        }
+
+        if (progress) {
+            continue;
+        }
+
+        /* Nothing moved: park until the device or the application needs us */
+        int rx_full = serial_ring_space(buffered->rx) == 0;
+        atomic_store(&buffered->rx_stalled, rx_full);
+        atomic_store(&buffered->parked, 1);
+        atomic_thread_fence(memory_order_seq_cst);
+
+        int tx_pending = serial_ring_used(buffered->tx) > 0;
+        if ((rx_full && serial_ring_space(buffered->rx) > 0) ||
+            (tx_pending && size == 0)) {
+            /* The application raced with us; go round again */
+            atomic_store(&buffered->parked, 0);
+            continue;
+        }
+
+        struct pollfd pfds[2] = {
+            { .fd = fd, .events = (short)((rx_full ? 0 : POLLIN) | (tx_pending ? POLLOUT : 0)) },
+            { .fd = buffered->wake_fd, .events = POLLIN },
+        };
+        int result = poll(pfds, 2, -1);
+        atomic_store(&buffered->parked, 0);
+        if (result < 0 && errno != EINTR) {
+            break;
+        }
+        if (result > 0 && (pfds[1].revents & POLLIN)) {
+            drain_fd(buffered->wake_fd);
+        }
+        if (result > 0 && (pfds[0].revents & (POLLERR | POLLHUP | POLLNVAL)) &&
+            !(pfds[0].revents & POLLIN)) {
+            break;
+        }
+    }
+
+    if (atomic_load(&buffered->stop)) {
+        flush_on_stop(buffered);
+    } else {
+        atomic_store(&buffered->error, 1);
+        notify_reader(buffered);
+        notify_writer(buffered);
+    }
+    return NULL;
+}
+
+static void destroy_buffered(struct serial_buffered_s *buffered) {
+    /* No munlock(): it works on whole pages, which the rings may share with other allocations */
+    if (buffered->wake_fd >= 0) {
+        close(buffered->wake_fd);
+    }
+    if (buffered->notify_fd >= 0) {
+        close(buffered->notify_fd);
+    }
+    if (buffered->tx_notify_fd >= 0) {
+        close(buffered->tx_notify_fd);
+    }
+    serial_ring_destroy(buffered->rx);
+    serial_ring_destroy(buffered->tx);
+    free(buffered);
+}
+
+int serial_enable_buffering(serial_handle_t handle, const struct serial_buffer_config_s *config) {
+    if (handle < 0 || handle >= SERIAL_BUFFERED_MAX_FD) {
+        return SERIAL_ERROR_INVALID_HANDLE;
+    }
+    if (serial_buffered_lookup(handle) || serial_transport_lookup(handle)) {
+        return SERIAL_ERROR_CONFIG;
+    }
+
+    if (config && config->rt && !serial_rt_valid(config->rt)) {
+        return SERIAL_ERROR_CONFIG;
+    }
+
+    size_t rx_size = config && config->rx_size ? config->rx_size : DEFAULT_RING_SIZE;
+    size_t tx_size = config && config->tx_size ? config->tx_size : DEFAULT_RING_SIZE;
+
+    struct serial_buffered_s *buffered = calloc(1, sizeof(*buffered));
+    if (!buffered) {
+        return SERIAL_ERROR_CONFIG;
+    }
+    buffered->handle = handle;
+    buffered->rx = serial_ring_create(rx_size);
+    buffered->tx = serial_ring_create(tx_size);
+    buffered->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    buffered->notify_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    buffered->tx_notify_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (!buffered->rx || !buffered->tx || buffered->wake_fd < 0 || buffered->notify_fd < 0 ||
+        buffered->tx_notify_fd < 0) {
+        destroy_buffered(buffered);
+        return SERIAL_ERROR_CONFIG;
+    }
+
+    if (config && config->rt) {
+        buffered->use_rt = 1;
+        buffered->rt = *config->rt;
+    }
+    if (buffered->use_rt && buffered->rt.lock_memory) {
+        /* Faulting ring pages in now keeps page faults out of the I/O thread */
+        serial_rt_prefault(serial_ring_storage(buffered->rx), serial_ring_capacity(buffered->rx));
+        serial_rt_prefault(serial_ring_storage(buffered->tx), serial_ring_capacity(buffered->tx));
+    }
+
+    if (pthread_create(&buffered->thread, NULL, io_thread_main, buffered) != 0) {
+        destroy_buffered(buffered);
+        return SERIAL_ERROR_CONFIG;
+    }
+
+    atomic_store_explicit(&buffered_ports[handle], buffered, memory_order_release);
+    return SERIAL_SUCCESS;
+}
+
+int serial_disable_buffering(serial_handle_t handle) {
+    if (handle < 0 || handle >= SERIAL_BUFFERED_MAX_FD) {
+        return SERIAL_ERROR_INVALID_HANDLE;
+    }
+
+    struct serial_buffered_s *buffered = atomic_exchange(&buffered_ports[handle], NULL);
+    if (!buffered) {
+        return SERIAL_ERROR_INVALID_HANDLE;
+    }
+
+    atomic_store_explicit(&buffered->stop, 1, memory_order_release);
+    signal_fd(buffered->wake_fd);
+    pthread_join(buffered->thread, NULL);
+    destroy_buffered(buffered);
+    return SERIAL_SUCCESS;
+}
+
+int serial_buffered_read(struct serial_buffered_s *buffered, void *buffer, size_t size, size_t *bytes_read) {
+    *bytes_read = serial_ring_read(buffered->rx, buffer, size);
+    if (*bytes_read > 0) {
+        if (atomic_load_explicit(&buffered->rx_stalled, memory_order_relaxed)) {
+            wake_io_thread(buffered);
+        }
+        return SERIAL_SUCCESS;
+    }
+    return atomic_load(&buffered->error) ? SERIAL_ERROR_READ : SERIAL_SUCCESS;
+}
+
+int serial_buffered_write(struct serial_buffered_s *buffered, const void *data, size_t size,
+                          size_t *bytes_written) {
+    if (atomic_load_explicit(&buffered->error, memory_order_relaxed)) {
+        *bytes_written = 0;
+        return SERIAL_ERROR_WRITE;
+    }
+    *bytes_written = serial_ring_write(buffered->tx, data, size);
+    if (*bytes_written > 0) {
+        wake_io_thread(buffered);
+    }
+    return SERIAL_SUCCESS;
+}
+
+/* Blocks until ready() holds, using the waiting flag to request a wakeup on fd */
+static int wait_for_ring(struct serial_buffered_s *buffered, int (*ready)(struct serial_buffered_s *),
+                         atomic_int *waiting, int fd, int timeout_ms, int error_code) {
+    uint64_t deadline = serial_monotonic_ms() + (uint64_t)(timeout_ms > 0 ? timeout_ms : 0);
+
+    for (;;) {
+        if (ready(buffered)) {
+            return SERIAL_SUCCESS;
+        }
+        if (atomic_load(&buffered->error)) {
+            return error_code;
+        }
+
+        atomic_store(waiting, 1);
+        atomic_thread_fence(memory_order_seq_cst);
+        if (ready(buffered) || atomic_load(&buffered->error)) {
+            atomic_store(waiting, 0);
+            continue;
+        }
+
+        int wait_ms = timeout_ms;
+        if (timeout_ms >= 0) {
+            uint64_t now = serial_monotonic_ms();
+            if (now >= deadline) {
+                atomic_store(waiting, 0);
+                return SERIAL_ERROR_TIMEOUT;
+            }
+            wait_ms = (int)(deadline - now);
+        }
+
+        struct pollfd pfd = { .fd = fd, .events = POLLIN };
+        int result = poll(&pfd, 1, wait_ms);
+        if (result > 0) {
+            drain_fd(fd);
+        } else if (result < 0 && errno != EINTR) {
+            return error_code;
+        }
+    }
+}
+
+static int rx_ready(struct serial_buffered_s *buffered) {
+    return serial_ring_used(buffered->rx) > 0;
+}
+
+static int tx_ready(struct serial_buffered_s *buffered) {
+    return serial_ring_space(buffered->tx) > 0;
+}
+
+int serial_buffered_wait_readable(struct serial_buffered_s *buffered, int timeout_ms) {
+    return wait_for_ring(buffered, rx_ready, &buffered->reader_waiting, buffered->notify_fd,
+                         timeout_ms, SERIAL_ERROR_READ);
+}
+
+int serial_buffered_wait_writable(struct serial_buffered_s *buffered, int timeout_ms) {
+    return wait_for_ring(buffered, tx_ready, &buffered->writer_waiting, buffered->tx_notify_fd,
+                         timeout_ms, SERIAL_ERROR_WRITE);
+}
+
+#else
+typedef int serial_buffered_unsupported_t;
+#endif /* __linux__ */
@@ -0,0 +1,347 @@
+/**
+ * @file serial_capture.c
+ * @brief Double-buffered traffic capture with a background writer, and mmap-based replay
+ *
+ * The I/O path appends records to the active buffer under a mutex. When it
+ * fills up, or SERIAL_CAPTURE_FLUSH_MS pass, it is swapped with the spare
+ * and the writer thread appends the spare to the file outside the lock.
+ */
+
+#include "serial_internal.h"
+#include "../include/serial_capture.h"
+
+#if defined(__linux__)
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+
+/* Descriptors at or above this value cannot be captured */
+#define SERIAL_CAPTURE_MAX_FD 4096
+#define RECORD_ALIGN 8u
+#define REPLAY_WRITE_TIMEOUT_MS 5000
+
+struct serial_capture_s {
+    int fd;
+    uint64_t start_ns;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;        /* writer: spare buffer ready or stop requested */
+    pthread_cond_t written;     /* I/O path: spare buffer is free again */
+    char *active;
+    char *spare;
+    size_t active_length;
+    size_t spare_length;        /* bytes waiting to be written, 0 when the spare is free */
+    int stop;
+    int error;
+};
+
+static _Atomic(struct serial_capture_s *) capture_table[SERIAL_CAPTURE_MAX_FD];
+
+struct serial_capture_s *serial_capture_lookup(serial_handle_t handle) {
+    if (handle < 0 || handle >= SERIAL_CAPTURE_MAX_FD) {
+        return NULL;
+    }
+    return atomic_load_explicit(&capture_table[handle], memory_order_acquire);
+}
+
+static size_t record_size(size_t length) {
+    return (sizeof(struct serial_capture_record_s) + length + RECORD_ALIGN - 1) & ~(size_t)(RECORD_ALIGN - 1);
+}
+
+static int write_fully(int fd, const char *data, size_t size) {
+    while (size > 0) {
+        ssize_t count = write(fd, data, size);
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+        if (count <= 0) {
+            return -1;
+        }
+        data += count;
+        size -= (size_t)count;
+    }
+    return 0;
+}
+
+/* Hands the active buffer to the writer; the spare must be free. Called with the lock held */
+static void swap_buffers(struct serial_capture_s *capture) {
+    char *full = capture->active;
+    capture->active = capture->spare;
+    capture->spare = full;
+    capture->spare_length = capture->active_length;
+    capture->active_length = 0;
+    pthread_cond_signal(&capture->wake);
+}
+
+static void *writer_main(void *arg) {
+    struct serial_capture_s *capture = arg;
+    int flush_due = 0;
+    pthread_mutex_lock(&capture->lock);
+    for (;;) {
+        if (capture->spare_length > 0) {
+            size_t length = capture->spare_length;
+            pthread_mutex_unlock(&capture->lock);
+            int result = write_fully(capture->fd, capture->spare, length);
+            pthread_mutex_lock(&capture->lock);
+            capture->error |= result != 0;
+            capture->spare_length = 0;
+            pthread_cond_broadcast(&capture->written);
+            continue;
+        }
+        if (capture->active_length > 0 && (flush_due || capture->stop)) {
+            swap_buffers(capture);      /* periodic or final flush of a partial buffer */
+            flush_due = 0;
+            continue;
+        }
+        if (capture->stop) {
+            break;
+        }
+        struct timespec deadline;
+        clock_gettime(CLOCK_MONOTONIC, &deadline);
+        deadline.tv_nsec += SERIAL_CAPTURE_FLUSH_MS * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+        flush_due = pthread_cond_timedwait(&capture->wake, &capture->lock, &deadline) == ETIMEDOUT;
+    }
+    pthread_mutex_unlock(&capture->lock);
+    return NULL;
+}
+
+void serial_capture_record(struct serial_capture_s *capture, uint8_t direction, const struct iovec *iov,
+                           int iovcnt, size_t size) {
+    const size_t max_payload = SERIAL_CAPTURE_BUFFER_SIZE - sizeof(struct serial_capture_record_s);
+    int index = 0;
+    size_t offset = 0;
+
+    pthread_mutex_lock(&capture->lock);
+    uint64_t time_ns = serial_monotonic_ns() - capture->start_ns;
+    while (size > 0) {
+        /* Chunks larger than a buffer become several records with the same time */
+        size_t length = size < max_payload ? size : max_payload;
+        size_t needed = record_size(length);
+        while (capture->active_length + needed > SERIAL_CAPTURE_BUFFER_SIZE) {
+            if (capture->spare_length == 0) {
+                swap_buffers(capture);
+            } else {
+                pthread_cond_wait(&capture->written, &capture->lock);
+            }
+        }
+
+        char *out = capture->active + capture->active_length;
+        struct serial_capture_record_s record = { .time_ns = time_ns, .length = (uint32_t)length,
+                                                  .direction = direction };
+        memcpy(out, &record, sizeof(record));
+        out += sizeof(record);
+        for (size_t copied = 0; copied < length;) {
+            size_t piece = iov[index].iov_len - offset;
+            piece = piece < length - copied ? piece : length - copied;
+            memcpy(out + copied, (const char *)iov[index].iov_base + offset, piece);
+            copied += piece;
+            offset += piece;
+            if (offset == iov[index].iov_len && index + 1 < iovcnt) {
+                index++;
+                offset = 0;
+            }
+        }
+        memset(out + length, 0, needed - sizeof(record) - length);
+        capture->active_length += needed;
+        size -= length;
+    }
+    pthread_mutex_unlock(&capture->lock);
+}
+
+int serial_enable_capture(serial_handle_t handle, const char *path) {
+    if (handle < 0 || handle >= SERIAL_CAPTURE_MAX_FD || !path) {
+        return SERIAL_ERROR_INVALID_HANDLE;
+    }
+    int previous = serial_disable_capture(handle);
+    if (previous != SERIAL_SUCCESS) {
+        return previous;
+    }
+    struct serial_capture_s *capture = calloc(1, sizeof(*capture));
+    if (!capture) {
+        return SERIAL_ERROR_CONFIG;
+    }
+    capture->active = malloc(SERIAL_CAPTURE_BUFFER_SIZE);
+    capture->spare = malloc(SERIAL_CAPTURE_BUFFER_SIZE);
+    capture->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (!capture->active || !capture->spare || capture->fd < 0) {
+        int result = capture->fd < 0 ? SERIAL_ERROR_OPEN : SERIAL_ERROR_CONFIG;
+        if (capture->fd >= 0) {
+            close(capture->fd);
+        }
+        free(capture->active);
+        free(capture->spare);
+        free(capture);
+        return result;
+    }
+
+    capture->start_ns = serial_monotonic_ns();
+    struct serial_capture_header_s header = {
+        .magic = SERIAL_CAPTURE_MAGIC,
+        .version = SERIAL_CAPTURE_VERSION,
+        .record_header_size = sizeof(struct serial_capture_record_s),
+        .start_ns = capture->start_ns,
+    };
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_mutex_init(&capture->lock, NULL);
+    pthread_cond_init(&capture->wake, &attr);
+    pthread_condattr_destroy(&attr);
+    pthread_cond_init(&capture->written, NULL);
+    if (write_fully(capture->fd, (const char *)&header, sizeof(header)) != 0 ||
+        pthread_create(&capture->thread, NULL, writer_main, capture) != 0) {
+        pthread_cond_destroy(&capture->written);
+        pthread_cond_destroy(&capture->wake);
+        pthread_mutex_destroy(&capture->lock);
+        close(capture->fd);
+        free(capture->active);
+        free(capture->spare);
+        free(capture);
+        return SERIAL_ERROR_WRITE;
+    }
+
+    atomic_store_explicit(&capture_table[handle], capture, memory_order_release);
+    return SERIAL_SUCCESS;
+}
+
+int serial_disable_capture(serial_handle_t handle) {
+    if (handle < 0 || handle >= SERIAL_CAPTURE_MAX_FD) {
+        return SERIAL_ERROR_INVALID_HANDLE;
+    }
+    struct serial_capture_s *capture = atomic_exchange(&capture_table[handle], NULL);
+    if (!capture) {
+        return SERIAL_SUCCESS;
+    }
+
+    pthread_mutex_lock(&capture->lock);
+    capture->stop = 1;
+    pthread_cond_signal(&capture->wake);
+    pthread_mutex_unlock(&capture->lock);
+    pthread_join(capture->thread, NULL);
+
+    int result = capture->error ? SERIAL_ERROR_WRITE : SERIAL_SUCCESS;
+    if (close(capture->fd) != 0) {
+        result = SERIAL_ERROR_WRITE;
+    }
+    pthread_cond_destroy(&capture->written);
+    pthread_cond_destroy(&capture->wake);
+    pthread_mutex_destroy(&capture->lock);
+    free(capture->active);
+    free(capture->spare);
+    free(capture);
+    return result;
+}
+
+struct serial_replay_s {
+    const char *data;
+    size_t size;
+    size_t offset;              /* next record */
+};
+
+serial_replay_t *serial_replay_open(const char *path) {
+    if (!path) {
+        return NULL;
+    }
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return NULL;
+    }
+    struct stat st;
+    const struct serial_capture_header_s *header = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(*header)) {
+        header = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    close(fd);
+    if (header == MAP_FAILED) {
+        return NULL;
+    }
+
+    serial_replay_t *replay = NULL;
+    if (memcmp(header->magic, SERIAL_CAPTURE_MAGIC, sizeof(header->magic)) == 0 &&
+        header->version == SERIAL_CAPTURE_VERSION &&
+        header->record_header_size == sizeof(struct serial_capture_record_s)) {
+        replay = malloc(sizeof(*replay));
+    }
+    if (!replay) {
+        munmap((void *)header, (size_t)st.st_size);
+        return NULL;
+    }
+    madvise((void *)header, (size_t)st.st_size, MADV_SEQUENTIAL);
+    replay->data = (const char *)header;
+    replay->size = (size_t)st.st_size;
+    replay->offset = sizeof(*header);
+    return replay;
+}
+
+void serial_replay_close(serial_replay_t *replay) {
+    if (replay) {
+        munmap((void *)replay->data, replay->size);
+        free(replay);
+    }
+}
+
+int serial_replay_next(serial_replay_t *replay, struct serial_capture_record_s *record, const void **payload) {
+    size_t left = replay->size - replay->offset;
+    if (left < sizeof(*record)) {
+        return 0;
+    }
+    memcpy(record, replay->data + replay->offset, sizeof(*record));
+    if (record_size(record->length) > left) {
+        return 0;                       /* cut short while being written */
+    }
+    *payload = replay->data + replay->offset + sizeof(*record);
+    replay->offset += record_size(record->length);
+    return 1;
+}
+
+void serial_replay_rewind(serial_replay_t *replay) {
+    replay->offset = sizeof(struct serial_capture_header_s);
+}
+
+int serial_replay_run(serial_replay_t *replay, serial_handle_t handle, uint8_t direction, double speed) {
+    if (!replay || handle == SERIAL_INVALID_HANDLE || speed < 0) {
+        return SERIAL_ERROR_INVALID_HANDLE;
+    }
+    serial_replay_rewind(replay);
+
+    struct serial_capture_record_s record;
+    const void *payload;
+    uint64_t first_ns = 0;
+    uint64_t start_ns = serial_monotonic_ns();
+    int started = 0;
+    while (serial_replay_next(replay, &record, &payload)) {
+        if (record.direction != direction) {
+            continue;
+        }
+        if (!started) {
+            first_ns = record.time_ns;
+            started = 1;
+        }
+        if (speed > 0) {
+            uint64_t due_ns = start_ns + (uint64_t)((double)(record.time_ns - first_ns) / speed);
+            struct timespec due = { .tv_sec = (time_t)(due_ns / 1000000000u), .tv_nsec = (long)(due_ns % 1000000000u) };
+            while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &due, NULL) == EINTR) {
+            }
+        }
+        size_t written;
+        int result = serial_write_all(handle, payload, record.length, REPLAY_WRITE_TIMEOUT_MS, &written);
+        if (result != SERIAL_SUCCESS) {
+            return result;
+        }
+    }
+    return SERIAL_SUCCESS;
+}
+
+#else
+typedef int serial_capture_unsupported_t;
+#endif
@@ -0,0 +1,292 @@
+/**
+ * @file serial_client.c
+ * @brief Pipelined command client with sequence-matched replies
+ */
+
+#include "serial_internal.h"
+#include "../include/serial_client.h"
+#include "../include/serial_trace.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define SEQ_COUNT 256
+#define RX_CHUNK 512
+
+/* One command in flight, indexed by its sequence number */
+struct client_slot_s {
+    int active;
+    uint64_t submitted_ns;
+    uint64_t deadline_ns;
+    serial_client_callback_t callback;
+    void *user_data;
+    uint64_t trace_id;      /* 0 unless the command is traced */
+    uint64_t enqueued_ns;   /* serial_client_submit() called */
+    uint64_t written_ns;    /* the frame has been written */
+    uint64_t first_rx_ns;   /* a read after the write returned data */
+    uint8_t cmd;
+    uint8_t queued_behind;  /* commands in flight when it was submitted */
+    uint16_t length;        /* encoded frame bytes */
+};
+
+struct serial_client_s {
+    serial_handle_t handle;
+    unsigned window;
+    int timeout_ms;
+    unsigned in_flight;
+    uint8_t next_seq;
+    uint8_t oldest_seq;     /* every slot before this one is idle */
+    struct client_slot_s slots[SEQ_COUNT];
+    struct serial_frame_decoder_s decoder;
+    uint8_t rx[RX_CHUNK];   /* kept in the client so callbacks may re-enter */
+    size_t rx_head;
+    size_t rx_tail;
+    uint64_t rx_read_ns;    /* when the bytes in rx were read, while tracing or traced commands are in flight */
+    unsigned traced;        /* traced commands in flight, which outlive serial_trace_stop() */
+    uint8_t rx_mark_seq;    /* commands from here on have not seen a read since their write */
+};
+
+serial_client_t *serial_client_create(serial_handle_t handle, const struct serial_client_config_s *config) {
+    if (handle == SERIAL_INVALID_HANDLE) {
+        return NULL;
+    }
+    unsigned window = config ? config->window : SERIAL_CLIENT_DEFAULT_WINDOW;
+    int timeout_ms = config ? config->timeout_ms : SERIAL_CLIENT_DEFAULT_TIMEOUT_MS;
+    if (window == 0 || window > SERIAL_CLIENT_MAX_WINDOW || timeout_ms <= 0) {
+        return NULL;
+    }
+
+    serial_client_t *client = calloc(1, sizeof(*client));
+    if (!client) {
+        return NULL;
+    }
+    client->handle = handle;
+    client->window = window;
+    client->timeout_ms = timeout_ms;
+    serial_frame_decoder_init(&client->decoder);
+    return client;
+}
+
+void serial_client_destroy(serial_client_t *client) {
+    free(client);
+}
+
+unsigned serial_client_in_flight(const serial_client_t *client) {
+    return client ? client->in_flight : 0;
+}
+
+/*
+ * Records the stages of a finished command: queued until the write started,
+ * write, device until a read returned data, receive until the read holding
+ * the end of the reply, parse, and the callback. A timed-out command has a
+ * timeout stage in place of the device, receive and parse stages.
+ */
+static void trace_command(const serial_client_t *client, const struct client_slot_s *slot, int replied,
+                          uint64_t decoded_ns, uint64_t done_ns) {
+    uint64_t id = slot->trace_id;
+    serial_trace_async("command", id, slot->enqueued_ns, done_ns, "cmd", slot->cmd);
+    serial_trace_async("queued", id, slot->enqueued_ns, slot->submitted_ns, "in_flight", slot->queued_behind);
+    serial_trace_async("write", id, slot->submitted_ns, slot->written_ns, "bytes", slot->length);
+    if (replied) {
+        uint64_t response_ns = client->rx_read_ns;
+        uint64_t first_rx_ns = slot->first_rx_ns ? slot->first_rx_ns : response_ns;
+        serial_trace_async("device", id, slot->written_ns, first_rx_ns, NULL, 0);
+        serial_trace_async("receive", id, first_rx_ns, response_ns, NULL, 0);
+        serial_trace_async("parse", id, response_ns, decoded_ns, NULL, 0);
+    } else {
+        serial_trace_async("timeout", id, slot->written_ns, decoded_ns, NULL, 0);
+    }
+    serial_trace_async("callback", id, decoded_ns, done_ns, NULL, 0);
+}
+
+/* Frees the slot before calling back, so the callback may submit again */
+static void complete(serial_client_t *client, uint8_t seq, int status, const struct serial_frame_s *reply) {
+    struct client_slot_s slot = client->slots[seq];
+    uint64_t decoded_ns = slot.trace_id ? serial_monotonic_ns() : 0;
+    client->slots[seq].active = 0;
+    client->in_flight--;
+    client->traced -= slot.trace_id != 0;
+    if (slot.callback) {
+        slot.callback(client, status, reply, serial_monotonic_ns() - slot.submitted_ns, slot.user_data);
+    }
+    if (slot.trace_id) {
+        trace_command(client, &slot, reply != NULL, decoded_ns, serial_monotonic_ns());
+    }
+}
+
+/* Stamps the first read after their write on the commands written since the last read */
+static void mark_first_rx(serial_client_t *client, uint64_t now_ns) {
+    while (client->rx_mark_seq != client->next_seq) {
+        struct client_slot_s *slot = &client->slots[client->rx_mark_seq++];
+        if (slot->active && slot->trace_id) {
+            slot->first_rx_ns = now_ns;
+        }
+    }
+}
+
+/* Decodes buffered bytes; replies to unknown or expired sequence numbers are dropped */
+static int process_rx(serial_client_t *client) {
+    int completed = 0;
+    while (client->rx_head < client->rx_tail) {
+        struct serial_frame_s frame;
+        int ready;
+        client->rx_head += serial_frame_decode(&client->decoder, client->rx + client->rx_head,
+                                               client->rx_tail - client->rx_head, &frame, &ready);
+        if (ready && client->slots[frame.seq].active &&
+            (frame.cmd == SERIAL_CMD_ACK || frame.cmd == SERIAL_CMD_NAK)) {
+            complete(client, frame.seq, SERIAL_SUCCESS, &frame);
+            completed++;
+        }
+    }
+    return completed;
+}
+
+/*
+ * Times out expired commands; deadlines grow with the sequence number.
+ * The oldest command may be a full 256 submissions old, so oldest_seq equal
+ * to next_seq does not mean nothing is in flight.
+ */
+static int expire(serial_client_t *client, uint64_t now_ns) {
+    int completed = 0;
+    while (client->in_flight > 0) {
+        struct client_slot_s *slot = &client->slots[client->oldest_seq];
+        if (slot->active) {
+            if (slot->deadline_ns > now_ns) {
+                break;
+            }
+            complete(client, client->oldest_seq, SERIAL_ERROR_TIMEOUT, NULL);
+            completed++;
+        }
+        client->oldest_seq++;
+    }
+    return completed;
+}
+
+/* Milliseconds until the oldest command expires, or -1 with nothing in flight */
+static int next_expiry_ms(const serial_client_t *client, uint64_t now_ns) {
+    for (unsigned i = 0; client->in_flight > 0 && i < 256; i++) {
+        const struct client_slot_s *slot = &client->slots[(uint8_t)(client->oldest_seq + i)];
+        if (slot->active) {
+            return slot->deadline_ns > now_ns ? (int)((slot->deadline_ns - now_ns + 999999u) / 1000000u) : 0;
+        }
+    }
+    return -1;
+}
+
+int serial_client_poll(serial_client_t *client, int timeout_ms) {
+    if (!client) {
+        return SERIAL_ERROR_INVALID_HANDLE;
+    }
+
+    uint64_t deadline = serial_monotonic_ms() + (uint64_t)(timeout_ms > 0 ? timeout_ms : 0);
+    int readable = 0;
+    for (;;) {
+        int completed = process_rx(client);
+
+        size_t count = 0;
+        int result = serial_read(client->handle, client->rx, sizeof(client->rx), &count);
+        if (result != SERIAL_SUCCESS) {
+            return result;
+        }
+        if (readable && count == 0) {
+            return SERIAL_ERROR_READ; /* readable without data: the device hung up */
+        }
+        client->rx_head = 0;
+        client->rx_tail = count;
+        if (count > 0 && (SERIAL_TRACE_ON() || client->traced > 0)) {
+            client->rx_read_ns = serial_monotonic_ns();
+            mark_first_rx(client, client->rx_read_ns);
+        }
+        completed += process_rx(client);
+
+        uint64_t now_ns = serial_monotonic_ns();
+        completed += expire(client, now_ns);
+        if (completed > 0) {
+            return completed;
+        }
+
+        int wait_ms = -1;
+        if (timeout_ms >= 0) {
+            uint64_t now_ms = serial_monotonic_ms();
+            if (now_ms >= deadline) {
+                return 0;
+            }
+            wait_ms = (int)(deadline - now_ms);
+        }
+        int expiry_ms = next_expiry_ms(client, now_ns);
+        if (expiry_ms >= 0 && (wait_ms < 0 || expiry_ms < wait_ms)) {
+            wait_ms = expiry_ms;
+        }
+
+        result = serial_wait_readable(client->handle, wait_ms);
+        if (result != SERIAL_SUCCESS && result != SERIAL_ERROR_TIMEOUT) {
+            return result;
+        }
+        readable = result == SERIAL_SUCCESS;
+    }
+}
+
+int serial_client_submit(serial_client_t *client, uint8_t cmd, const void *payload, size_t length,
+                         serial_client_callback_t callback, void *user_data) {
+    if (!client) {
+        return SERIAL_ERROR_INVALID_HANDLE;
+    }
+    uint64_t enqueued_ns = SERIAL_TRACE_ON() ? serial_monotonic_ns() : 0;
+    unsigned queued_behind = client->in_flight;
+
+    /* A slot still held by a command 256 submissions ago also blocks reuse of its sequence number */
+    while (client->in_flight >= client->window || client->slots[client->next_seq].active) {
+        int result = serial_client_poll(client, client->timeout_ms);
+        if (result < 0) {
+            return result;
+        }
+    }
+
+    uint8_t seq = client->next_seq;
+    uint8_t encoded[SERIAL_FRAME_MAX_ENCODED];
+    size_t encoded_length;
+    int result = serial_frame_encode(seq, cmd, payload, length, encoded, sizeof(encoded), &encoded_length);
+    if (result != SERIAL_SUCCESS) {
+        return result;
+    }
+
+    uint64_t now_ns = serial_monotonic_ns();
+    size_t written;
+    result = serial_write_all(client->handle, encoded, encoded_length, client->timeout_ms, &written);
+    if (result != SERIAL_SUCCESS) {
+        return result;
+    }
+
+    struct client_slot_s *slot = &client->slots[seq];
+    slot->active = 1;
+    slot->submitted_ns = now_ns;
+    slot->deadline_ns = now_ns + (uint64_t)client->timeout_ms * 1000000u;
+    slot->callback = callback;
+    slot->user_data = user_data;
+    slot->trace_id = 0;
+    if (enqueued_ns && SERIAL_TRACE_ON()) {
+        slot->trace_id = serial_trace_id();
+        slot->enqueued_ns = enqueued_ns;
+        slot->written_ns = serial_monotonic_ns();
+        slot->first_rx_ns = 0;
+        slot->cmd = cmd;
+        slot->queued_behind = (uint8_t)queued_behind;
+        slot->length = (uint16_t)encoded_length;
+        client->traced++;
+    }
+    client->in_flight++;
+    client->next_seq++;
+    return SERIAL_SUCCESS;
+}
+
+int serial_client_drain(serial_client_t *client) {
+    if (!client) {
+        return SERIAL_ERROR_INVALID_HANDLE;
+    }
+    while (client->in_flight > 0) {
+        int result = serial_client_poll(client, client->timeout_ms);
+        if (result < 0) {
+            return result;
+        }
+    }
+    return SERIAL_SUCCESS;
+}
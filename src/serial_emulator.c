@@ -0,0 +1,410 @@
+/**
+ * @file serial_emulator.c
+ * @brief The sketch's firmware core, led_firmware.c, running on a pty master
+ *
+ * Timing model: every received byte finishes arriving one byte time after
+ * the previous one (or when it was read, if later) and lands in the 64-byte
+ * receive buffer. The sketch takes it out once any modelled delay() from the
+ * previous ASCII command has elapsed and the replies queued before it fit in
+ * the transmit buffer; a byte that finds the receive buffer full is lost. Only
+ * the byte that completes a command has to wait for its time, so the thread
+ * never sleeps with work pending. Replies are queued and released once they
+ * would have been clocked out completely.
+ *
+ * With flow control in effect the host is held off when the receive buffer
+ * reaches FLOW_HIGH_WATER bytes and let go once the sketch has taken it down
+ * to FLOW_LOW_WATER: later bytes simply arrive later. For XON/XOFF the
+ * control characters are also sent, so the host's tty really stops.
+ */
+
+#include "serial_internal.h"
+#include "../include/serial_emulator.h"
+
+#if defined(__linux__)
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <termios.h>
+#include <unistd.h>
+#include "../include/serial_frame.h"
+#include "../include/serial_rt.h"
+#include "../sketch_mar2a/led_firmware.h"
+
+#define EMULATOR_RX_CHUNK 4096
+#define EMULATOR_TX_QUEUE 64
+#define NO_WAKE UINT64_MAX
+
+/* SERIAL_RX_BUFFER_SIZE and SERIAL_TX_BUFFER_SIZE of the AVR core */
+#define SKETCH_RX_BUFFER 64
+#define SKETCH_TX_BUFFER 64
+#define FLOW_HIGH_WATER 48
+#define FLOW_LOW_WATER 16
+
+/* A reply waiting to be released to the host */
+struct pending_tx_s {
+    uint64_t due_ns;
+    size_t length;
+    size_t offset;
+    uint8_t data[SERIAL_FRAME_MAX_ENCODED];
+};
+
+struct serial_emulator_s {
+    int master_fd;
+    int slave_fd;               /* held open so the master never sees a hangup */
+    int wake_fd;
+    char path[64];
+    pthread_t thread;
+    atomic_int stop;
+    uint64_t byte_ns;
+    uint64_t ascii_delay_ns;
+    uint8_t flow_control;
+    int use_rt;
+    struct serial_rt_config_s rt;
+
+    /* Owned by the emulator thread */
+    uint8_t rx[EMULATOR_RX_CHUNK];
+    uint64_t rx_read_ns[EMULATOR_RX_CHUNK];     /* when each buffered byte was read from the pty */
+    size_t rx_head;
+    size_t rx_tail;
+    uint64_t rx_clock;          /* when the last accepted byte finished arriving */
+    uint64_t fifo[SKETCH_RX_BUFFER];            /* when the sketch took out the last accepted bytes */
+    size_t fifo_next;
+    uint64_t busy_until;        /* end of the last delay() or blocked Serial.write() */
+    uint64_t tx_clock;          /* when the last queued reply finishes leaving */
+    int host_flow;              /* flow control enabled on both ends */
+    uint64_t flow_resume_ns;    /* host held off until then, 0 if it is not */
+    uint64_t xon_due_ns;        /* XON to send, 0 if none */
+    int tx_paused;              /* host sent XOFF */
+    struct led_firmware_s firmware;
+    struct pending_tx_s tx[EMULATOR_TX_QUEUE];
+    size_t tx_head;
+    size_t tx_count;
+
+    /* Read by other threads */
+    atomic_uint led_state;
+    atomic_ullong rx_bytes;
+    atomic_ullong tx_bytes;
+    atomic_ullong ascii_commands;
+    atomic_ullong frames;
+    atomic_ullong bad_frames;
+    atomic_ullong overruns;
+};
+
+static uint64_t max_u64(uint64_t a, uint64_t b) {
+    return a > b ? a : b;
+}
+
+/* Queues a reply that starts clocking out at start_ns */
+static void queue_reply(serial_emulator_t *emulator, const void *data, size_t length, uint64_t start_ns) {
+    struct pending_tx_s *entry = &emulator->tx[(emulator->tx_head + emulator->tx_count) % EMULATOR_TX_QUEUE];
+    emulator->tx_clock = max_u64(emulator->tx_clock, start_ns) + length * emulator->byte_ns;
+    entry->due_ns = emulator->tx_clock;
+    entry->length = length;
+    entry->offset = 0;
+    memcpy(entry->data, data, length);
+    emulator->tx_count++;
+
+    /* Serial.write() returns once the rest fits in the transmit buffer */
+    uint64_t buffered_ns = SKETCH_TX_BUFFER * emulator->byte_ns;
+    if (emulator->tx_clock > buffered_ns) {
+        emulator->busy_until = max_u64(emulator->busy_until, emulator->tx_clock - buffered_ns);
+    }
+}
+
+/* Feeds one byte to the firmware and queues the reply it produced, if any */
+static void feed_byte(serial_emulator_t *emulator, uint8_t byte, uint64_t now_ns) {
+    struct led_firmware_s *firmware = &emulator->firmware;
+    uint32_t frames = firmware->frames;
+    uint32_t bad_frames = firmware->bad_frames;
+    uint32_t ascii_commands = firmware->ascii_commands;
+
+    /* The reply queue is emptied after every byte, so the firmware always takes it */
+    uint8_t reply[LED_FIRMWARE_TX_QUEUE];
+    led_firmware_receive(firmware, &byte, 1);
+    uint16_t length = led_firmware_transmit(firmware, reply, sizeof(reply));
+    if (length > 0) {
+        queue_reply(emulator, reply, length, now_ns);
+    }
+    atomic_store_explicit(&emulator->led_state, led_firmware_leds(firmware), memory_order_relaxed);
+
+    atomic_fetch_add_explicit(&emulator->frames, firmware->frames - frames, memory_order_relaxed);
+    atomic_fetch_add_explicit(&emulator->bad_frames, firmware->bad_frames - bad_frames, memory_order_relaxed);
+    if (firmware->ascii_commands != ascii_commands) {
+        /* The delay() earlier sketches made after each menu command */
+        emulator->busy_until = max_u64(emulator->busy_until, now_ns) + emulator->ascii_delay_ns;
+        atomic_fetch_add_explicit(&emulator->ascii_commands, 1, memory_order_relaxed);
+    }
+}
+
+/* Bytes in the receive buffer at time_ns; the sketch takes them out in order */
+static size_t fifo_level(const serial_emulator_t *emulator, uint64_t time_ns) {
+    size_t level = 0;
+    while (level < SKETCH_RX_BUFFER &&
+           emulator->fifo[(emulator->fifo_next + SKETCH_RX_BUFFER - 1 - level) % SKETCH_RX_BUFFER] > time_ns) {
+        level++;
+    }
+    return level;
+}
+
+/* Holds the host off until the sketch has emptied the buffer down to FLOW_LOW_WATER */
+static void hold_off_host(serial_emulator_t *emulator) {
+    uint64_t resume = emulator->fifo[(emulator->fifo_next + SKETCH_RX_BUFFER - 1 - FLOW_LOW_WATER) % SKETCH_RX_BUFFER];
+    emulator->flow_resume_ns = resume;
+    if (emulator->flow_control == SERIAL_FLOW_XONXOFF) {
+        uint8_t xoff = SERIAL_XOFF;
+        if (write(emulator->master_fd, &xoff, 1) == 1) {
+            emulator->xon_due_ns = resume;
+        }
+        /* The XON still has to reach the host */
+        emulator->flow_resume_ns += emulator->byte_ns;
+    }
+}
+
+/*
+ * Consumes buffered input up to the first command that is not due yet.
+ * Bytes inside a frame have no visible effect, so only the byte that
+ * completes a command has to wait for its time.
+ */
+static void process_input(serial_emulator_t *emulator, uint64_t now_ns, uint64_t *wake_ns) {
+    while (emulator->rx_head < emulator->rx_tail) {
+        uint8_t byte = emulator->rx[emulator->rx_head];
+        uint64_t arrived = max_u64(emulator->rx_clock, emulator->rx_read_ns[emulator->rx_head]) + emulator->byte_ns;
+        if (emulator->flow_resume_ns) {
+            arrived = max_u64(arrived, emulator->flow_resume_ns + emulator->byte_ns);
+        }
+        size_t level = fifo_level(emulator, arrived);
+        if (level == SKETCH_RX_BUFFER) {
+            emulator->rx_head++;
+            emulator->rx_clock = arrived;
+            atomic_fetch_add_explicit(&emulator->overruns, 1, memory_order_relaxed);
+            continue;
+        }
+
+        uint64_t last_taken = emulator->fifo[(emulator->fifo_next + SKETCH_RX_BUFFER - 1) % SKETCH_RX_BUFFER];
+        uint64_t handled = max_u64(max_u64(arrived, emulator->busy_until), last_taken);
+        int flow_byte = emulator->flow_control == SERIAL_FLOW_XONXOFF && (byte == SERIAL_XON || byte == SERIAL_XOFF);
+        int completes = !flow_byte && led_firmware_completes(&emulator->firmware, byte);
+        if (completes) {
+            if (handled > now_ns) {
+                *wake_ns = handled < *wake_ns ? handled : *wake_ns;
+                return;
+            }
+            if (emulator->tx_count == EMULATOR_TX_QUEUE) {
+                *wake_ns = emulator->tx[emulator->tx_head].due_ns;
+                return;
+            }
+        }
+        emulator->rx_head++;
+        emulator->rx_clock = arrived;
+        emulator->flow_resume_ns = 0;
+        emulator->fifo[emulator->fifo_next] = handled;
+        emulator->fifo_next = (emulator->fifo_next + 1) % SKETCH_RX_BUFFER;
+        if (emulator->host_flow && level + 1 >= FLOW_HIGH_WATER) {
+            hold_off_host(emulator);
+        }
+
+        if (flow_byte) {
+            emulator->tx_paused = byte == SERIAL_XOFF;
+        } else {
+            feed_byte(emulator, byte, handled);
+        }
+    }
+}
+
+/* Writes due replies; returns 1 when the pty is full and POLLOUT is needed */
+static int flush_output(serial_emulator_t *emulator, uint64_t now_ns, uint64_t *wake_ns) {
+    if (emulator->xon_due_ns) {
+        uint8_t xon = SERIAL_XON;
+        if (emulator->xon_due_ns > now_ns) {
+            *wake_ns = emulator->xon_due_ns < *wake_ns ? emulator->xon_due_ns : *wake_ns;
+        } else if (write(emulator->master_fd, &xon, 1) == 1) {
+            emulator->xon_due_ns = 0;
+        } else {
+            return 1;
+        }
+    }
+    while (emulator->tx_count > 0 && !emulator->tx_paused) {
+        struct pending_tx_s *entry = &emulator->tx[emulator->tx_head];
+        if (entry->due_ns > now_ns) {
+            if (entry->due_ns < *wake_ns) {
+                *wake_ns = entry->due_ns;
+            }
+            return 0;
+        }
+        ssize_t count = write(emulator->master_fd, entry->data + entry->offset, entry->length - entry->offset);
+        if (count < 0) {
+            return errno == EAGAIN || errno == EINTR;
+        }
+        atomic_fetch_add_explicit(&emulator->tx_bytes, (unsigned long long)count, memory_order_relaxed);
+        entry->offset += (size_t)count;
+        if (entry->offset < entry->length) {
+            return 1;
+        }
+        emulator->tx_head = (emulator->tx_head + 1) % EMULATOR_TX_QUEUE;
+        emulator->tx_count--;
+    }
+    return 0;
+}
+
+/* Flow control only works once the host has enabled the same kind on the slave side */
+static int host_flow_enabled(const serial_emulator_t *emulator) {
+    struct termios tty;
+    if (emulator->flow_control == SERIAL_FLOW_NONE || tcgetattr(emulator->slave_fd, &tty) != 0) {
+        return 0;
+    }
+    return emulator->flow_control == SERIAL_FLOW_RTSCTS ? (tty.c_cflag & CRTSCTS) != 0 : (tty.c_iflag & IXON) != 0;
+}
+
+static void *emulator_main(void *arg) {
+    serial_emulator_t *emulator = arg;
+    if (emulator->use_rt) {
+        serial_rt_apply(&emulator->rt, NULL);
+    }
+
+    while (!atomic_load_explicit(&emulator->stop, memory_order_acquire)) {
+        uint64_t now_ns = serial_monotonic_ns();
+        uint64_t wake_ns = NO_WAKE;
+        process_input(emulator, now_ns, &wake_ns);
+        int output_blocked = flush_output(emulator, now_ns, &wake_ns);
+
+        /* Read ahead while there is room, leaving the rest queued in the pty */
+        if (emulator->rx_head == emulator->rx_tail) {
+            emulator->rx_head = emulator->rx_tail = 0;
+        } else if (emulator->rx_tail == EMULATOR_RX_CHUNK && emulator->rx_head > 0) {
+            size_t pending = emulator->rx_tail - emulator->rx_head;
+            memmove(emulator->rx, emulator->rx + emulator->rx_head, pending);
+            memmove(emulator->rx_read_ns, emulator->rx_read_ns + emulator->rx_head, pending * sizeof(uint64_t));
+            emulator->rx_head = 0;
+            emulator->rx_tail = pending;
+        }
+        struct pollfd pfds[2] = {
+            { .fd = emulator->wake_fd, .events = POLLIN },
+            { .fd = emulator->master_fd,
+              .events = (short)((emulator->rx_tail < EMULATOR_RX_CHUNK ? POLLIN : 0) |
+                                (output_blocked ? POLLOUT : 0)) },
+        };
+        struct timespec timeout;
+        if (wake_ns != NO_WAKE) {
+            uint64_t wait_ns = wake_ns > now_ns ? wake_ns - now_ns : 0;
+            timeout.tv_sec = (time_t)(wait_ns / 1000000000u);
+            timeout.tv_nsec = (long)(wait_ns % 1000000000u);
+        }
+        if (ppoll(pfds, 2, wake_ns != NO_WAKE ? &timeout : NULL, NULL) <= 0) {
+            continue;
+        }
+
+        if (pfds[1].revents & POLLIN) {
+            ssize_t count = read(emulator->master_fd, emulator->rx + emulator->rx_tail,
+                                 EMULATOR_RX_CHUNK - emulator->rx_tail);
+            if (count > 0) {
+                uint64_t read_ns = serial_monotonic_ns();
+                for (size_t i = 0; i < (size_t)count; i++) {
+                    emulator->rx_read_ns[emulator->rx_tail + i] = read_ns;
+                }
+                emulator->rx_tail += (size_t)count;
+                emulator->host_flow = host_flow_enabled(emulator);
+                atomic_fetch_add_explicit(&emulator->rx_bytes, (unsigned long long)count, memory_order_relaxed);
+            }
+        }
+    }
+    return NULL;
+}
+
+serial_emulator_t *serial_emulator_create(const struct serial_emulator_config_s *config) {
+    if (config && config->rt && !serial_rt_valid(config->rt)) {
+        return NULL;
+    }
+    serial_emulator_t *emulator = calloc(1, sizeof(*emulator));
+    if (!emulator) {
+        return NULL;
+    }
+    emulator->master_fd = -1;
+    emulator->slave_fd = -1;
+    emulator->wake_fd = -1;
+    if (config) {
+        emulator->byte_ns = config->baud_rate ? 10000000000ull / config->baud_rate : 0;
+        emulator->ascii_delay_ns = (uint64_t)config->ascii_delay_ms * 1000000u;
+        emulator->flow_control = config->flow_control;
+        if (config->rt) {
+            emulator->use_rt = 1;
+            emulator->rt = *config->rt;
+        }
+    }
+    led_firmware_init(&emulator->firmware);
+
+    emulator->master_fd = posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if (emulator->master_fd < 0 || grantpt(emulator->master_fd) != 0 || unlockpt(emulator->master_fd) != 0 ||
+        ptsname_r(emulator->master_fd, emulator->path, sizeof(emulator->path)) != 0) {
+        serial_emulator_destroy(emulator);
+        return NULL;
+    }
+
+    /* Raw mode until the host configures the port, so early bytes are not line-edited */
+    struct termios tty;
+    emulator->slave_fd = open(emulator->path, O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if (emulator->slave_fd < 0 || tcgetattr(emulator->slave_fd, &tty) != 0) {
+        serial_emulator_destroy(emulator);
+        return NULL;
+    }
+    cfmakeraw(&tty);
+    tcsetattr(emulator->slave_fd, TCSANOW, &tty);
+
+    emulator->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (emulator->wake_fd < 0 || pthread_create(&emulator->thread, NULL, emulator_main, emulator) != 0) {
+        if (emulator->wake_fd >= 0) {
+            close(emulator->wake_fd);
+            emulator->wake_fd = -1;
+        }
+        serial_emulator_destroy(emulator);
+        return NULL;
+    }
+    return emulator;
+}
+
+void serial_emulator_destroy(serial_emulator_t *emulator) {
+    if (!emulator) {
+        return;
+    }
+    if (emulator->wake_fd >= 0) {
+        uint64_t one = 1;
+        atomic_store_explicit(&emulator->stop, 1, memory_order_release);
+        if (write(emulator->wake_fd, &one, sizeof(one)) == (ssize_t)sizeof(one)) {
+            pthread_join(emulator->thread, NULL);
+        }
+        close(emulator->wake_fd);
+    }
+    if (emulator->slave_fd >= 0) {
+        close(emulator->slave_fd);
+    }
+    if (emulator->master_fd >= 0) {
+        close(emulator->master_fd);
+    }
+    free(emulator);
+}
+
+const char *serial_emulator_path(const serial_emulator_t *emulator) {
+    return emulator->path;
+}
+
+uint8_t serial_emulator_led_state(const serial_emulator_t *emulator) {
+    return (uint8_t)atomic_load_explicit(&emulator->led_state, memory_order_relaxed);
+}
+
+void serial_emulator_get_stats(const serial_emulator_t *emulator, struct serial_emulator_stats_s *stats) {
+    stats->rx_bytes = atomic_load_explicit(&emulator->rx_bytes, memory_order_relaxed);
+    stats->tx_bytes = atomic_load_explicit(&emulator->tx_bytes, memory_order_relaxed);
+    stats->ascii_commands = atomic_load_explicit(&emulator->ascii_commands, memory_order_relaxed);
+    stats->frames = atomic_load_explicit(&emulator->frames, memory_order_relaxed);
+    stats->bad_frames = atomic_load_explicit(&emulator->bad_frames, memory_order_relaxed);
+    stats->overruns = atomic_load_explicit(&emulator->overruns, memory_order_relaxed);
+}
+
+#else
+typedef int serial_emulator_unsupported_t;
+#endif /* __linux__ */
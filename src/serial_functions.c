@@ -4,13 +4,124 @@
  */
 
 #include "../include/serial_functions.h"
+#include "serial_internal.h"
+#include "serial_termios2.h"
 #include <errno.h>
+#include <limits.h>
 #include <string.h>
 
 #if defined(__linux__)
-    static const int BAUD_RATES[] = {B9600, B19200, B38400, B57600, B115200};
-    static const int BAUD_VALUES[] = {9600, 19200, 38400, 57600, 115200};
-    #define NUM_BAUD_RATES (sizeof(BAUD_RATES) / sizeof(BAUD_RATES[0]))
+    #include <linux/serial.h>
+    #include <poll.h>
+    #include <sys/ioctl.h>
+    #include <time.h>
+    #include "../include/serial_capture.h"
+    #include "../include/serial_stats.h"
+    #include "../include/serial_trace.h"
+    #include "../include/serial_transport.h"
+#endif
+
+#if defined(__linux__)
+    /* Rates with a dedicated Bxxx constant; anything else goes through termios2 */
+    static const struct {
+        uint32_t value;
+        speed_t constant;
+    } BAUD_TABLE[] = {
+        {9600, B9600}, {19200, B19200}, {38400, B38400}, {57600, B57600}, {115200, B115200},
+        {230400, B230400},
+    #ifdef B460800
+        {460800, B460800}, {500000, B500000}, {576000, B576000}, {921600, B921600},
+        {1000000, B1000000}, {1152000, B1152000}, {1500000, B1500000}, {2000000, B2000000},
+    #endif
+    #ifdef B4000000
+        {2500000, B2500000}, {3000000, B3000000}, {3500000, B3500000}, {4000000, B4000000},
+    #endif
+    };
+    #define NUM_BAUD_RATES (sizeof(BAUD_TABLE) / sizeof(BAUD_TABLE[0]))
+
+    /* Largest deviation between requested and applied rate, in percent */
+    #define BAUD_TOLERANCE_PERCENT 2
+
+    /* Records one buffer in a handle's capture */
+    static void capture_buffer(struct serial_capture_s *capture, uint8_t direction, const void *data, size_t size) {
+        struct iovec iov = { .iov_base = (void *)data, .iov_len = size };
+        serial_capture_record(capture, direction, &iov, 1, size);
+    }
+
+    /*
+     * Statistics and trace span of one transport call, counted like the system call it stands in
+     * for: data moved, nothing moved (as EAGAIN) or an error. span is NULL for calls without one.
+     */
+    static void transport_done(serial_handle_t handle, uint8_t direction, const char *span, uint64_t trace_ns,
+                               int status, size_t count, size_t requested) {
+        if (trace_ns && span && count > 0) {
+            serial_trace_span(span, trace_ns, serial_monotonic_ns(), "bytes", (int64_t)count);
+        }
+        struct serial_stats_block_s *stats = serial_stats_lookup(handle);
+        if (!stats) {
+            return;
+        }
+        ssize_t result = status == SERIAL_SUCCESS && count > 0 ? (ssize_t)count : -1;
+        int error = status == SERIAL_SUCCESS ? EAGAIN : EIO;
+        if (direction == SERIAL_CAPTURE_TX) {
+            serial_stats_write_syscall(stats, result, requested, error);
+            if (count > 0) {
+                serial_stats_sent(stats);
+            }
+        } else {
+            serial_stats_read_syscall(stats, result, error);
+            if (count > 0) {
+                serial_stats_received(stats);
+            }
+        }
+    }
+
+    static size_t iov_total(const struct iovec *iov, int iovcnt) {
+        size_t total = 0;
+        for (int i = 0; i < iovcnt; i++) {
+            total += iov[i].iov_len;
+        }
+        return total;
+    }
+
+    /* Vector I/O for transports without readv/writev: one call per buffer until one falls short */
+    static int transport_readv(struct serial_transport_port_s *port, const struct iovec *iov, int iovcnt,
+                               size_t *bytes_read) {
+        if (port->ops->readv) {
+            return port->ops->readv(port->state, iov, iovcnt, bytes_read);
+        }
+        for (int i = 0; i < iovcnt; i++) {
+            size_t count;
+            int result = port->ops->read(port->state, iov[i].iov_base, iov[i].iov_len, &count);
+            if (result != SERIAL_SUCCESS) {
+                return *bytes_read > 0 ? SERIAL_SUCCESS : result;
+            }
+            *bytes_read += count;
+            if (count < iov[i].iov_len) {
+                break;
+            }
+        }
+        return SERIAL_SUCCESS;
+    }
+
+    static int transport_writev(struct serial_transport_port_s *port, const struct iovec *iov, int iovcnt,
+                                size_t *bytes_written) {
+        if (port->ops->writev) {
+            return port->ops->writev(port->state, iov, iovcnt, bytes_written);
+        }
+        for (int i = 0; i < iovcnt; i++) {
+            size_t count;
+            int result = port->ops->write(port->state, iov[i].iov_base, iov[i].iov_len, &count);
+            if (result != SERIAL_SUCCESS) {
+                return *bytes_written > 0 ? SERIAL_SUCCESS : result;
+            }
+            *bytes_written += count;
+            if (count < iov[i].iov_len) {
+                break;
+            }
+        }
+        return SERIAL_SUCCESS;
+    }
 #endif
 
 /* Default configuration (9600-8N1) */
@@ -18,29 +129,74 @@ static const struct serial_config_s DEFAULT_CONFIG = {
     .baud_rate = 9600,
     .data_bits = 8,
     .stop_bits = 1,
-    .parity = 0
+    .parity = 0,
+    .latency_mode = SERIAL_LATENCY_THROUGHPUT,
+    .flow_control = SERIAL_FLOW_NONE
 };
 
 #if defined(__linux__)
-static int get_baud_const(uint32_t baud_rate) {
+/* Requests ASYNC_LOW_LATENCY; drivers without serial_struct support are left as they are */
+static void set_low_latency(serial_handle_t handle) {
+    struct serial_struct serial;
+    if (ioctl(handle, TIOCGSERIAL, &serial) != 0 || (serial.flags & ASYNC_LOW_LATENCY)) {
+        return;
+    }
+    serial.flags |= ASYNC_LOW_LATENCY;
+    ioctl(handle, TIOCSSERIAL, &serial);
+}
+
+/* Returns the Bxxx constant for a rate, or B0 if it needs termios2 */
+static speed_t get_baud_const(uint32_t baud_rate) {
+    for (size_t i = 0; i < NUM_BAUD_RATES; i++) {
+        if (BAUD_TABLE[i].value == baud_rate) {
+            return BAUD_TABLE[i].constant;
+        }
+    }
+    return B0;
+}
+
+static uint32_t get_baud_value(speed_t constant) {
     for (size_t i = 0; i < NUM_BAUD_RATES; i++) {
-        if (BAUD_VALUES[i] == baud_rate) {
-            return BAUD_RATES[i];
+        if (BAUD_TABLE[i].constant == constant) {
+            return BAUD_TABLE[i].value;
         }
     }
-    return B9600; /* Default to 9600 if unsupported */
+    return 0;
+}
+
+/* Reads back the rate the driver actually applied */
+static int read_applied_baud(serial_handle_t handle, uint32_t *baud_rate) {
+    if (serial_termios2_get_speed(handle, baud_rate) == 0 && *baud_rate != 0) {
+        return SERIAL_SUCCESS;
+    }
+
+    struct termios options;
+    if (tcgetattr(handle, &options) != 0) {
+        return SERIAL_ERROR_CONFIG;
+    }
+    *baud_rate = get_baud_value(cfgetospeed(&options));
+    return *baud_rate != 0 ? SERIAL_SUCCESS : SERIAL_ERROR_CONFIG;
+}
+
+static int baud_matches(uint32_t requested, uint32_t applied) {
+    uint64_t difference = requested > applied ? requested - applied : applied - requested;
+    return difference * 100u <= (uint64_t)requested * BAUD_TOLERANCE_PERCENT;
 }
 
 static int configure_port(serial_handle_t handle, const struct serial_config_s *config) {
     struct termios options;
 
+    if (config->baud_rate == 0 || config->flow_control > SERIAL_FLOW_XONXOFF) {
+        return SERIAL_ERROR_CONFIG;
+    }
+
     if (tcgetattr(handle, &options) != 0) {
         return SERIAL_ERROR_CONFIG;
     }
 
-    /* Configure baud rate */
-    int baud = get_baud_const(config->baud_rate);
-    if (cfsetispeed(&options, baud) != 0 || cfsetospeed(&options, baud) != 0) {
+    /* Configure baud rate; non-standard rates are applied after tcsetattr() */
+    speed_t baud = get_baud_const(config->baud_rate);
+    if (baud != B0 && (cfsetispeed(&options, baud) != 0 || cfsetospeed(&options, baud) != 0)) {
         return SERIAL_ERROR_CONFIG;
     }
 
@@ -69,11 +225,42 @@ static int configure_port(serial_handle_t handle, const struct serial_config_s *
     options.c_iflag &= ~(IXON | IXOFF | IXANY | ICRNL);
     options.c_oflag &= ~OPOST;
 
+    /* Configure flow control */
+    options.c_cflag &= ~CRTSCTS;
+    if (config->flow_control == SERIAL_FLOW_RTSCTS) {
+        options.c_cflag |= CRTSCTS;
+    } else if (config->flow_control == SERIAL_FLOW_XONXOFF) {
+        options.c_iflag |= IXON | IXOFF;
+        options.c_cc[VSTART] = SERIAL_XON;
+        options.c_cc[VSTOP] = SERIAL_XOFF;
+    }
+
+    /* Wake on the first byte; the throughput profile lets blocking readers collect a burst */
+    options.c_cc[VMIN] = 1;
+    options.c_cc[VTIME] = (config->latency_mode == SERIAL_LATENCY_LOW) ? 0 : 1;
+
     /* Apply settings */
     if (tcsetattr(handle, TCSANOW, &options) != 0) {
         return SERIAL_ERROR_CONFIG;
     }
 
+    if (baud == B0 && serial_termios2_set_speed(handle, config->baud_rate) != 0) {
+        return SERIAL_ERROR_CONFIG;
+    }
+
+    /* Fail instead of silently running at a different rate */
+    uint32_t applied;
+    if (read_applied_baud(handle, &applied) != SERIAL_SUCCESS || !baud_matches(config->baud_rate, applied)) {
+        return SERIAL_ERROR_CONFIG;
+    }
+
+    if (config->latency_mode == SERIAL_LATENCY_LOW) {
+        set_low_latency(handle);
+        if (tcflush(handle, TCIFLUSH) != 0) {
+            return SERIAL_ERROR_CONFIG;
+        }
+    }
+
     return SERIAL_SUCCESS;
 }
 
@@ -82,6 +269,10 @@ static int configure_port(serial_handle_t handle, const struct serial_config_s *
     DCB dcb = {0};
     dcb.DCBlength = sizeof(DCB);
 
+    if (config->baud_rate == 0 || config->flow_control > SERIAL_FLOW_XONXOFF) {
+        return SERIAL_ERROR_CONFIG;
+    }
+
     if (!GetCommState(handle, &dcb)) {
         return SERIAL_ERROR_CONFIG;
     }
@@ -91,10 +282,23 @@ static int configure_port(serial_handle_t handle, const struct serial_config_s *
     dcb.StopBits = (config->stop_bits == 2) ? TWOSTOPBITS : ONESTOPBIT;
     dcb.Parity = config->parity;
 
+    /* Configure flow control */
+    dcb.fOutxCtsFlow = config->flow_control == SERIAL_FLOW_RTSCTS;
+    dcb.fRtsControl = (config->flow_control == SERIAL_FLOW_RTSCTS) ? RTS_CONTROL_HANDSHAKE : RTS_CONTROL_ENABLE;
+    dcb.fOutxDsrFlow = FALSE;
+    dcb.fOutX = dcb.fInX = config->flow_control == SERIAL_FLOW_XONXOFF;
+    dcb.XonChar = SERIAL_XON;
+    dcb.XoffChar = SERIAL_XOFF;
+
     if (!SetCommState(handle, &dcb)) {
         return SERIAL_ERROR_CONFIG;
     }
 
+    /* Fail instead of silently running at a different rate */
+    if (!GetCommState(handle, &dcb) || dcb.BaudRate != config->baud_rate) {
+        return SERIAL_ERROR_CONFIG;
+    }
+
     /* Configure timeouts */
     COMMTIMEOUTS timeouts = {0};
     timeouts.ReadIntervalTimeout = MAXDWORD;
@@ -107,6 +311,10 @@ static int configure_port(serial_handle_t handle, const struct serial_config_s *
         return SERIAL_ERROR_CONFIG;
     }
 
+    if (config->latency_mode == SERIAL_LATENCY_LOW && !PurgeComm(handle, PURGE_RXCLEAR)) {
+        return SERIAL_ERROR_CONFIG;
+    }
+
     return SERIAL_SUCCESS;
 }
 #endif
@@ -144,12 +352,45 @@ serial_handle_t serial_open(const char *port_name, const struct serial_config_s
     return handle;
 }
 
+int serial_get_baud(serial_handle_t handle, uint32_t *baud_rate) {
+    if (handle == SERIAL_INVALID_HANDLE || !baud_rate) {
+        return SERIAL_ERROR_INVALID_HANDLE;
+    }
+
+#if defined(__linux__)
+    struct serial_transport_port_s *transport = serial_transport_lookup(handle);
+    if (transport) {
+        return transport->ops->get_baud ? transport->ops->get_baud(transport->state, baud_rate)
+                                        : SERIAL_ERROR_CONFIG;
+    }
+    return read_applied_baud(handle, baud_rate);
+#elif defined(_WIN32)
+    DCB dcb = {0};
+    dcb.DCBlength = sizeof(DCB);
+    if (!GetCommState(handle, &dcb)) {
+        return SERIAL_ERROR_CONFIG;
+    }
+    *baud_rate = dcb.BaudRate;
+    return SERIAL_SUCCESS;
+#endif
+}
+
 int serial_close(serial_handle_t handle) {
     if (handle == SERIAL_INVALID_HANDLE) {
         return SERIAL_ERROR_INVALID_HANDLE;
     }
 
 #if defined(__linux__)
+    if (serial_transport_lookup(handle)) {
+        serial_stats_release(handle);
+        serial_disable_capture(handle);
+        return serial_transport_close(handle);
+    }
+    if (serial_buffered_lookup(handle)) {
+        serial_disable_buffering(handle);
+    }
+    serial_stats_release(handle);
+    serial_disable_capture(handle);
     return close(handle) == 0 ? SERIAL_SUCCESS : SERIAL_ERROR_CONFIG;
 #elif defined(_WIN32)
     return CloseHandle(handle) ? SERIAL_SUCCESS : SERIAL_ERROR_CONFIG;
@@ -162,12 +403,49 @@ int serial_write(serial_handle_t handle, const void *data, size_t size, size_t *
     }
 
 #if defined(__linux__)
+    struct serial_stats_block_s *stats = serial_stats_lookup(handle);
+    struct serial_capture_s *capture = serial_capture_lookup(handle);
+    struct serial_transport_port_s *transport = serial_transport_lookup(handle);
+    if (transport) {
+        uint64_t trace_ns = SERIAL_TRACE_ON() ? serial_monotonic_ns() : 0;
+        int status = transport->ops->write(transport->state, data, size, bytes_written);
+        transport_done(handle, SERIAL_CAPTURE_TX, "write", trace_ns, status, *bytes_written, size);
+        if (capture && *bytes_written > 0) {
+            capture_buffer(capture, SERIAL_CAPTURE_TX, data, *bytes_written);
+        }
+        return status;
+    }
+    struct serial_buffered_s *buffered = serial_buffered_lookup(handle);
+    if (buffered) {
+        int status = serial_buffered_write(buffered, data, size, bytes_written);
+        if (stats && *bytes_written > 0) {
+            serial_stats_sent(stats);
+        }
+        if (capture && *bytes_written > 0) {
+            capture_buffer(capture, SERIAL_CAPTURE_TX, data, *bytes_written);
+        }
+        return status;
+    }
+
+    uint64_t trace_ns = SERIAL_TRACE_ON() ? serial_monotonic_ns() : 0;
     ssize_t result = write(handle, data, size);
+    if (trace_ns && result > 0) {
+        serial_trace_span("write", trace_ns, serial_monotonic_ns(), "bytes", result);
+    }
+    if (stats) {
+        serial_stats_write_syscall(stats, result, size, errno);
+        if (result > 0) {
+            serial_stats_sent(stats);
+        }
+    }
     if (result < 0) {
         *bytes_written = 0;
-        return SERIAL_ERROR_WRITE;
+        return (errno == EAGAIN) ? SERIAL_SUCCESS : SERIAL_ERROR_WRITE;
     }
     *bytes_written = (size_t)result;
+    if (capture && result > 0) {
+        capture_buffer(capture, SERIAL_CAPTURE_TX, data, (size_t)result);
+    }
 #elif defined(_WIN32)
     DWORD written;
     if (!WriteFile(handle, data, (DWORD)size, &written, NULL)) {
@@ -186,12 +464,49 @@ int serial_read(serial_handle_t handle, void *buffer, size_t size, size_t *bytes
     }
 
 #if defined(__linux__)
+    struct serial_stats_block_s *stats = serial_stats_lookup(handle);
+    struct serial_capture_s *capture = serial_capture_lookup(handle);
+    struct serial_transport_port_s *transport = serial_transport_lookup(handle);
+    if (transport) {
+        uint64_t trace_ns = SERIAL_TRACE_ON() ? serial_monotonic_ns() : 0;
+        int status = transport->ops->read(transport->state, buffer, size, bytes_read);
+        transport_done(handle, SERIAL_CAPTURE_RX, "read", trace_ns, status, *bytes_read, size);
+        if (capture && *bytes_read > 0) {
+            capture_buffer(capture, SERIAL_CAPTURE_RX, buffer, *bytes_read);
+        }
+        return status;
+    }
+    struct serial_buffered_s *buffered = serial_buffered_lookup(handle);
+    if (buffered) {
+        int status = serial_buffered_read(buffered, buffer, size, bytes_read);
+        if (stats && *bytes_read > 0) {
+            serial_stats_received(stats);
+        }
+        if (capture && *bytes_read > 0) {
+            capture_buffer(capture, SERIAL_CAPTURE_RX, buffer, *bytes_read);
+        }
+        return status;
+    }
+
+    uint64_t trace_ns = SERIAL_TRACE_ON() ? serial_monotonic_ns() : 0;
     ssize_t result = read(handle, buffer, size);
+    if (trace_ns && result > 0) {
+        serial_trace_span("read", trace_ns, serial_monotonic_ns(), "bytes", result);
+    }
+    if (stats) {
+        serial_stats_read_syscall(stats, result, errno);
+        if (result > 0) {
+            serial_stats_received(stats);
+        }
+    }
     if (result < 0) {
         *bytes_read = 0;
         return (errno == EAGAIN) ? SERIAL_SUCCESS : SERIAL_ERROR_READ;
     }
     *bytes_read = (size_t)result;
+    if (capture && result > 0) {
+        capture_buffer(capture, SERIAL_CAPTURE_RX, buffer, (size_t)result);
+    }
 #elif defined(_WIN32)
     DWORD read_count;
     if (!ReadFile(handle, buffer, (DWORD)size, &read_count, NULL)) {
@@ -203,3 +518,421 @@ int serial_read(serial_handle_t handle, void *buffer, size_t size, size_t *bytes
 
     return SERIAL_SUCCESS;
 }
+
+#if defined(__linux__)
+/* Waits for events on a descriptor, retrying after signals with the time left */
+static int poll_ready(int fd, short events, int timeout_ms, int error_code) {
+    uint64_t deadline = serial_monotonic_ms() + (uint64_t)(timeout_ms > 0 ? timeout_ms : 0);
+    struct pollfd pfd = { .fd = fd, .events = events };
+
+    for (;;) {
+        int result = poll(&pfd, 1, timeout_ms);
+        if (result > 0) {
+            if (pfd.revents & events) {
+                return SERIAL_SUCCESS;
+            }
+            return error_code; /* POLLERR, POLLHUP or POLLNVAL */
+        }
+        if (result == 0) {
+            return SERIAL_ERROR_TIMEOUT;
+        }
+        if (errno != EINTR) {
+            return error_code;
+        }
+        if (timeout_ms > 0) {
+            uint64_t now = serial_monotonic_ms();
+            if (now >= deadline) {
+                return SERIAL_ERROR_TIMEOUT;
+            }
+            timeout_ms = (int)(deadline - now);
+        }
+    }
+}
+#endif
+
+uint64_t serial_monotonic_ms(void) {
+#if defined(__linux__)
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000u + (uint64_t)ts.tv_nsec / 1000000u;
+#elif defined(_WIN32)
+    return (uint64_t)GetTickCount64();
+#endif
+}
+
+int serial_timeout_until(uint64_t deadline_ms, uint64_t now_ms) {
+    uint64_t left = deadline_ms - now_ms;
+    return left > (uint64_t)INT_MAX ? INT_MAX : (int)left;
+}
+
+uint64_t serial_monotonic_ns(void) {
+#if defined(__linux__)
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+#elif defined(_WIN32)
+    LARGE_INTEGER counter, frequency;
+    QueryPerformanceCounter(&counter);
+    QueryPerformanceFrequency(&frequency);
+    return (uint64_t)counter.QuadPart / (uint64_t)frequency.QuadPart * 1000000000u +
+           (uint64_t)counter.QuadPart % (uint64_t)frequency.QuadPart * 1000000000u / (uint64_t)frequency.QuadPart;
+#endif
+}
+
+int serial_wait_readable(serial_handle_t handle, int timeout_ms) {
+    if (handle == SERIAL_INVALID_HANDLE) {
+        return SERIAL_ERROR_INVALID_HANDLE;
+    }
+
+#if defined(__linux__)
+    struct serial_transport_port_s *transport = serial_transport_lookup(handle);
+    if (transport) {
+        return transport->ops->wait_readable ? transport->ops->wait_readable(transport->state, timeout_ms)
+                                             : SERIAL_SUCCESS;
+    }
+    struct serial_buffered_s *buffered = serial_buffered_lookup(handle);
+    if (buffered) {
+        return serial_buffered_wait_readable(buffered, timeout_ms);
+    }
+
+    return poll_ready(handle, POLLIN, timeout_ms, SERIAL_ERROR_READ);
+#elif defined(_WIN32)
+    uint64_t deadline = serial_monotonic_ms() + (uint64_t)(timeout_ms > 0 ? timeout_ms : 0);
+
+    for (;;) {
+        COMSTAT status;
+        DWORD errors;
+        if (!ClearCommError(handle, &errors, &status)) {
+            return SERIAL_ERROR_READ;
+        }
+        if (status.cbInQue > 0) {
+            return SERIAL_SUCCESS;
+        }
+        if (timeout_ms >= 0 && serial_monotonic_ms() >= deadline) {
+            return SERIAL_ERROR_TIMEOUT;
+        }
+        Sleep(1);
+    }
+#endif
+}
+
+int serial_wait_writable(serial_handle_t handle, int timeout_ms) {
+    if (handle == SERIAL_INVALID_HANDLE) {
+        return SERIAL_ERROR_INVALID_HANDLE;
+    }
+
+#if defined(__linux__)
+    struct serial_transport_port_s *transport = serial_transport_lookup(handle);
+    if (transport) {
+        return transport->ops->wait_writable ? transport->ops->wait_writable(transport->state, timeout_ms)
+                                             : SERIAL_SUCCESS;
+    }
+    struct serial_buffered_s *buffered = serial_buffered_lookup(handle);
+    if (buffered) {
+        return serial_buffered_wait_writable(buffered, timeout_ms);
+    }
+    return poll_ready(handle, POLLOUT, timeout_ms, SERIAL_ERROR_WRITE);
+#elif defined(_WIN32)
+    (void)timeout_ms;
+    return SERIAL_SUCCESS; /* WriteFile blocks until the data is queued */
+#endif
+}
+
+/* Finds delim in buffer, starting the scan at offset start */
+static const char *find_delim(const char *buffer, size_t length, size_t start,
+                              const char *delim, size_t delim_len) {
+    for (size_t i = start; i + delim_len <= length; i++) {
+        const char *hit = memchr(buffer + i, delim[0], length - i - delim_len + 1);
+        if (!hit) {
+            return NULL;
+        }
+        i = (size_t)(hit - buffer);
+        if (memcmp(hit, delim, delim_len) == 0) {
+            return hit;
+        }
+    }
+    return NULL;
+}
+
+int serial_read_until(serial_handle_t handle, void *buffer, size_t size, const char *delim,
+                      uint64_t deadline_ms, size_t *bytes_read) {
+    if (handle == SERIAL_INVALID_HANDLE || !buffer || !delim || !bytes_read || delim[0] == '\0') {
+        return SERIAL_ERROR_INVALID_HANDLE;
+    }
+
+    char *data = buffer;
+    size_t delim_len = strlen(delim);
+    size_t total = 0;
+    *bytes_read = 0;
+
+    for (;;) {
+        if (total == size) {
+            return SERIAL_ERROR_OVERFLOW;
+        }
+
+        uint64_t now = serial_monotonic_ms();
+        if (now >= deadline_ms) {
+            return SERIAL_ERROR_TIMEOUT;
+        }
+
+        int result = serial_wait_readable(handle, serial_timeout_until(deadline_ms, now));
+        if (result != SERIAL_SUCCESS) {
+            return result;
+        }
+
+        size_t count;
+        if (serial_read(handle, data + total, size - total, &count) != SERIAL_SUCCESS) {
+            return SERIAL_ERROR_READ;
+        }
+        if (count == 0) {
+            /* Readable but nothing to read: the other end hung up */
+            return SERIAL_ERROR_READ;
+        }
+
+        /* Only rescan the tail that could contain a new match */
+        size_t start = total >= delim_len ? total - delim_len + 1 : 0;
+        total += count;
+        *bytes_read = total;
+
+        if (find_delim(data, total, start, delim, delim_len)) {
+            return SERIAL_SUCCESS;
+        }
+    }
+}
+
+int serial_writev(serial_handle_t handle, const struct iovec *iov, int iovcnt, size_t *bytes_written) {
+    if (handle == SERIAL_INVALID_HANDLE || (!iov && iovcnt > 0) || iovcnt < 0 || !bytes_written) {
+        return SERIAL_ERROR_INVALID_HANDLE;
+    }
+    *bytes_written = 0;
+
+#if defined(__linux__)
+    struct serial_transport_port_s *transport = serial_transport_lookup(handle);
+    if (transport) {
+        uint64_t trace_ns = SERIAL_TRACE_ON() ? serial_monotonic_ns() : 0;
+        int result = transport_writev(transport, iov, iovcnt, bytes_written);
+        transport_done(handle, SERIAL_CAPTURE_TX, "writev", trace_ns, result, *bytes_written, iov_total(iov, iovcnt));
+        struct serial_capture_s *capture = serial_capture_lookup(handle);
+        if (capture && *bytes_written > 0) {
+            serial_capture_record(capture, SERIAL_CAPTURE_TX, iov, iovcnt, *bytes_written);
+        }
+        return result;
+    }
+    struct serial_buffered_s *buffered = serial_buffered_lookup(handle);
+    if (buffered) {
+        for (int i = 0; i < iovcnt; i++) {
+            size_t count;
+            int result = serial_buffered_write(buffered, iov[i].iov_base, iov[i].iov_len, &count);
+            if (result != SERIAL_SUCCESS) {
+                return *bytes_written > 0 ? SERIAL_SUCCESS : result;
+            }
+            *bytes_written += count;
+            if (count < iov[i].iov_len) {
+                break;
+            }
+        }
+        struct serial_stats_block_s *stats = serial_stats_lookup(handle);
+        if (stats && *bytes_written > 0) {
+            serial_stats_sent(stats);
+        }
+        struct serial_capture_s *capture = serial_capture_lookup(handle);
+        if (capture && *bytes_written > 0) {
+            serial_capture_record(capture, SERIAL_CAPTURE_TX, iov, iovcnt, *bytes_written);
+        }
+        return SERIAL_SUCCESS;
+    }
+
+    struct serial_stats_block_s *stats = serial_stats_lookup(handle);
+    uint64_t trace_ns = SERIAL_TRACE_ON() ? serial_monotonic_ns() : 0;
+    ssize_t result = writev(handle, iov, iovcnt);
+    if (trace_ns && result > 0) {
+        serial_trace_span("writev", trace_ns, serial_monotonic_ns(), "bytes", result);
+    }
+    if (stats) {
+        serial_stats_write_syscall(stats, result, iov_total(iov, iovcnt), errno);
+        if (result > 0) {
+            serial_stats_sent(stats);
+        }
+    }
+    if (result < 0) {
+        return (errno == EAGAIN) ? SERIAL_SUCCESS : SERIAL_ERROR_WRITE;
+    }
+    *bytes_written = (size_t)result;
+    struct serial_capture_s *capture = serial_capture_lookup(handle);
+    if (capture && result > 0) {
+        serial_capture_record(capture, SERIAL_CAPTURE_TX, iov, iovcnt, (size_t)result);
+    }
+#elif defined(_WIN32)
+    for (int i = 0; i < iovcnt; i++) {
+        DWORD written;
+        if (!WriteFile(handle, iov[i].iov_base, (DWORD)iov[i].iov_len, &written, NULL)) {
+            return *bytes_written > 0 ? SERIAL_SUCCESS : SERIAL_ERROR_WRITE;
+        }
+        *bytes_written += written;
+        if (written < iov[i].iov_len) {
+            break;
+        }
+    }
+#endif
+
+    return SERIAL_SUCCESS;
+}
+
+int serial_readv(serial_handle_t handle, const struct iovec *iov, int iovcnt, size_t *bytes_read) {
+    if (handle == SERIAL_INVALID_HANDLE || (!iov && iovcnt > 0) || iovcnt < 0 || !bytes_read) {
+        return SERIAL_ERROR_INVALID_HANDLE;
+    }
+    *bytes_read = 0;
+
+#if defined(__linux__)
+    struct serial_transport_port_s *transport = serial_transport_lookup(handle);
+    if (transport) {
+        int result = transport_readv(transport, iov, iovcnt, bytes_read);
+        transport_done(handle, SERIAL_CAPTURE_RX, NULL, 0, result, *bytes_read, iov_total(iov, iovcnt));
+        struct serial_capture_s *capture = serial_capture_lookup(handle);
+        if (capture && *bytes_read > 0) {
+            serial_capture_record(capture, SERIAL_CAPTURE_RX, iov, iovcnt, *bytes_read);
+        }
+        return result;
+    }
+    struct serial_buffered_s *buffered = serial_buffered_lookup(handle);
+    if (buffered) {
+        for (int i = 0; i < iovcnt; i++) {
+            size_t count;
+            int result = serial_buffered_read(buffered, iov[i].iov_base, iov[i].iov_len, &count);
+            if (result != SERIAL_SUCCESS) {
+                return *bytes_read > 0 ? SERIAL_SUCCESS : result;
+            }
+            *bytes_read += count;
+            if (count < iov[i].iov_len) {
+                break;
+            }
+        }
+        struct serial_stats_block_s *stats = serial_stats_lookup(handle);
+        if (stats && *bytes_read > 0) {
+            serial_stats_received(stats);
+        }
+        struct serial_capture_s *capture = serial_capture_lookup(handle);
+        if (capture && *bytes_read > 0) {
+            serial_capture_record(capture, SERIAL_CAPTURE_RX, iov, iovcnt, *bytes_read);
+        }
+        return SERIAL_SUCCESS;
+    }
+
+    struct serial_stats_block_s *stats = serial_stats_lookup(handle);
+    ssize_t result = readv(handle, iov, iovcnt);
+    if (stats) {
+        serial_stats_read_syscall(stats, result, errno);
+        if (result > 0) {
+            serial_stats_received(stats);
+        }
+    }
+    if (result < 0) {
+        return (errno == EAGAIN) ? SERIAL_SUCCESS : SERIAL_ERROR_READ;
+    }
+    *bytes_read = (size_t)result;
+    struct serial_capture_s *capture = serial_capture_lookup(handle);
+    if (capture && result > 0) {
+        serial_capture_record(capture, SERIAL_CAPTURE_RX, iov, iovcnt, (size_t)result);
+    }
+#elif defined(_WIN32)
+    for (int i = 0; i < iovcnt; i++) {
+        DWORD read_count;
+        if (!ReadFile(handle, iov[i].iov_base, (DWORD)iov[i].iov_len, &read_count, NULL)) {
+            return *bytes_read > 0 ? SERIAL_SUCCESS : SERIAL_ERROR_READ;
+        }
+        *bytes_read += read_count;
+        if (read_count < iov[i].iov_len) {
+            break;
+        }
+    }
+#endif
+
+    return SERIAL_SUCCESS;
+}
+
+/* Number of iovec entries handed to one writev() call by serial_writev_all() */
+#define WRITEV_BATCH 16
+
+int serial_writev_all(serial_handle_t handle, const struct iovec *iov, int iovcnt, int timeout_ms,
+                      size_t *bytes_written) {
+    if (handle == SERIAL_INVALID_HANDLE || (!iov && iovcnt > 0) || iovcnt < 0 || !bytes_written) {
+        return SERIAL_ERROR_INVALID_HANDLE;
+    }
+
+    uint64_t deadline = serial_monotonic_ms() + (uint64_t)(timeout_ms > 0 ? timeout_ms : 0);
+    int index = 0;
+    size_t offset = 0; /* bytes of iov[index] already sent */
+    *bytes_written = 0;
+
+    for (;;) {
+        /* Skip finished and empty entries */
+        while (index < iovcnt && offset == iov[index].iov_len) {
+            index++;
+            offset = 0;
+        }
+        if (index == iovcnt) {
+            return SERIAL_SUCCESS;
+        }
+
+        /* Build a window over the unsent remainder without copying payload */
+        struct iovec window[WRITEV_BATCH];
+        int count = 0;
+        for (int i = index; i < iovcnt && count < WRITEV_BATCH; i++) {
+            size_t skip = (i == index) ? offset : 0;
+            window[count].iov_base = (char *)iov[i].iov_base + skip;
+            window[count].iov_len = iov[i].iov_len - skip;
+            count++;
+        }
+
+        size_t written;
+        int result = serial_writev(handle, window, count, &written);
+        if (result != SERIAL_SUCCESS) {
+            return result;
+        }
+        *bytes_written += written;
+
+        /* Advance past what was written */
+        while (written > 0) {
+            size_t left = iov[index].iov_len - offset;
+            if (written < left) {
+                offset += written;
+                break;
+            }
+            written -= left;
+            index++;
+            offset = 0;
+        }
+
+        while (index < iovcnt && offset == iov[index].iov_len) {
+            index++;
+            offset = 0;
+        }
+        if (index == iovcnt) {
+            return SERIAL_SUCCESS;
+        }
+
+        /* Partial write or full queue: block until the port drains */
+        int wait_ms = timeout_ms;
+        if (timeout_ms >= 0) {
+            uint64_t now = serial_monotonic_ms();
+            if (now >= deadline) {
+                return SERIAL_ERROR_TIMEOUT;
+            }
+            wait_ms = (int)(deadline - now);
+        }
+        result = serial_wait_writable(handle, wait_ms);
+        if (result != SERIAL_SUCCESS) {
+            return result;
+        }
+    }
+}
+
+int serial_write_all(serial_handle_t handle, const void *data, size_t size, int timeout_ms,
+                     size_t *bytes_written) {
+    if (!data) {
+        return SERIAL_ERROR_INVALID_HANDLE;
+    }
+    struct iovec iov = { .iov_base = (void *)data, .iov_len = size };
+    return serial_writev_all(handle, &iov, 1, timeout_ms, bytes_written);
+}
@@ -0,0 +1,101 @@
+/**
+ * @file serial_internal.h
+ * @brief Declarations shared between the serial implementation files
+ *
+ * Not part of the public interface.
+ */
+
+#ifndef SERIAL_INTERNAL_H_
+#define SERIAL_INTERNAL_H_
+
+#include "../include/serial_functions.h"
+
+#if defined(__linux__)
+
+#include <sys/types.h>
+
+/* Buffered handle mode (serial_buffered.c) */
+struct serial_buffered_s;
+
+/**
+ * @brief Returns the buffered-mode state attached to a handle, or NULL
+ */
+struct serial_buffered_s *serial_buffered_lookup(serial_handle_t handle);
+
+int serial_buffered_read(struct serial_buffered_s *buffered, void *buffer, size_t size, size_t *bytes_read);
+int serial_buffered_write(struct serial_buffered_s *buffered, const void *data, size_t size,
+                          size_t *bytes_written);
+int serial_buffered_wait_readable(struct serial_buffered_s *buffered, int timeout_ms);
+int serial_buffered_wait_writable(struct serial_buffered_s *buffered, int timeout_ms);
+
+/* Per-handle statistics (serial_stats.c) */
+struct serial_stats_block_s;
+
+/**
+ * @brief Returns the statistics attached to a handle, or NULL
+ */
+struct serial_stats_block_s *serial_stats_lookup(serial_handle_t handle);
+
+/* Called after every read()/write() family system call with its result and errno */
+void serial_stats_read_syscall(struct serial_stats_block_s *stats, ssize_t result, int error);
+void serial_stats_write_syscall(struct serial_stats_block_s *stats, ssize_t result, size_t requested, int error);
+
+/* Called when the application has handed data to, or taken data from, the handle */
+void serial_stats_sent(struct serial_stats_block_s *stats);
+void serial_stats_received(struct serial_stats_block_s *stats);
+
+/* Frees the statistics of a handle being closed, enabled or not */
+void serial_stats_release(serial_handle_t handle);
+
+/* Traffic capture (serial_capture.c) */
+struct serial_capture_s;
+
+/**
+ * @brief Returns the capture attached to a handle, or NULL
+ */
+struct serial_capture_s *serial_capture_lookup(serial_handle_t handle);
+
+/* Appends the first size bytes of iov as one record (direction is a serial_capture_direction_e) */
+void serial_capture_record(struct serial_capture_s *capture, uint8_t direction, const struct iovec *iov,
+                           int iovcnt, size_t size);
+
+/* Transport-backed handles (serial_transport.c) */
+struct serial_transport_ops_s;
+
+struct serial_transport_port_s {
+    const struct serial_transport_ops_s *ops;
+    void *state;
+};
+
+/**
+ * @brief Returns the transport bound to a handle, or NULL for a descriptor handle
+ */
+struct serial_transport_port_s *serial_transport_lookup(serial_handle_t handle);
+
+/* Unbinds a transport handle, closes the transport and releases the handle */
+int serial_transport_close(serial_handle_t handle);
+
+/* Real-time thread settings (serial_rt.c) */
+struct serial_rt_config_s;
+
+/* Returns 1 if a core and priority are in range for serial_rt_apply() */
+int serial_rt_valid(const struct serial_rt_config_s *config);
+
+#endif /* __linux__ */
+
+/* Time left until a deadline that is still ahead, as a wait timeout; clamped to INT_MAX */
+int serial_timeout_until(uint64_t deadline_ms, uint64_t now_ms);
+
+/* Span tracing (serial_trace.c); a trace point is one relaxed load while recording is off */
+#if defined(__linux__) && defined(SERIAL_USE_TRACE)
+
+#include <stdatomic.h>
+
+extern atomic_int serial_trace_active;
+
+#define SERIAL_TRACE_ON() atomic_load_explicit(&serial_trace_active, memory_order_relaxed)
+#else
+#define SERIAL_TRACE_ON() 0
+#endif
+
+#endif /* SERIAL_INTERNAL_H_ */
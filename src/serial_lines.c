@@ -0,0 +1,294 @@
+/**
+ * @file serial_lines.c
+ * @brief Line splitter with a vectorised delimiter search
+ */
+
+#include "../include/serial_lines.h"
+#include "serial_internal.h"
+
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__)))
+#define LINES_HAVE_X86 1
+#include <immintrin.h>
+#else
+#define LINES_HAVE_X86 0
+#endif
+
+typedef const char *(*find_fn_t)(const char *data, const char *end, uint8_t byte);
+
+struct serial_lines_s {
+    char *buffer;
+    size_t capacity;
+    size_t start;       /* first byte not handed out yet */
+    size_t scanned;     /* no delimiter between start and here */
+    size_t end;         /* bytes received */
+    char delimiter;
+};
+
+static const char *find_bytewise(const char *data, const char *end, uint8_t byte) {
+    for (; data < end; data++) {
+        if ((uint8_t)*data == byte) {
+            return data;
+        }
+    }
+    return NULL;
+}
+
+/* Eight bytes per step: a zero byte in (word ^ pattern) marks a match */
+static const char *find_scalar(const char *data, const char *end, uint8_t byte) {
+    const uint64_t ones = 0x0101010101010101ull;
+    const uint64_t highs = 0x8080808080808080ull;
+    const uint64_t pattern = ones * byte;
+
+    while (end - data >= 8) {
+        uint64_t word;
+        memcpy(&word, data, sizeof(word));
+        word ^= pattern;
+        if ((word - ones) & ~word & highs) {
+            break;
+        }
+        data += 8;
+    }
+    return find_bytewise(data, end, byte);
+}
+
+#if LINES_HAVE_X86
+
+static const char *find_sse2(const char *data, const char *end, uint8_t byte) {
+    const __m128i needle = _mm_set1_epi8((char)byte);
+
+    while (end - data >= 64) {
+        __m128i a = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)data), needle);
+        __m128i b = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(data + 16)), needle);
+        __m128i c = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(data + 32)), needle);
+        __m128i d = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(data + 48)), needle);
+        if (_mm_movemask_epi8(_mm_or_si128(_mm_or_si128(a, b), _mm_or_si128(c, d)))) {
+            uint64_t mask = (uint64_t)(unsigned)_mm_movemask_epi8(a) |
+                            (uint64_t)(unsigned)_mm_movemask_epi8(b) << 16 |
+                            (uint64_t)(unsigned)_mm_movemask_epi8(c) << 32 |
+                            (uint64_t)(unsigned)_mm_movemask_epi8(d) << 48;
+            return data + __builtin_ctzll(mask);
+        }
+        data += 64;
+    }
+    while (end - data >= 16) {
+        unsigned mask = (unsigned)_mm_movemask_epi8(
+            _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)data), needle));
+        if (mask) {
+            return data + __builtin_ctz(mask);
+        }
+        data += 16;
+    }
+    return find_bytewise(data, end, byte);
+}
+
+__attribute__((target("avx2")))
+static const char *find_avx2(const char *data, const char *end, uint8_t byte) {
+    const __m256i needle = _mm256_set1_epi8((char)byte);
+
+    while (end - data >= 128) {
+        __m256i a = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)data), needle);
+        __m256i b = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(data + 32)), needle);
+        __m256i c = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(data + 64)), needle);
+        __m256i d = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(data + 96)), needle);
+        if (!_mm256_testz_si256(_mm256_or_si256(_mm256_or_si256(a, b), _mm256_or_si256(c, d)),
+                                _mm256_set1_epi8(-1))) {
+            uint64_t low = (uint64_t)(unsigned)_mm256_movemask_epi8(a) |
+                           (uint64_t)(unsigned)_mm256_movemask_epi8(b) << 32;
+            if (low) {
+                return data + __builtin_ctzll(low);
+            }
+            uint64_t high = (uint64_t)(unsigned)_mm256_movemask_epi8(c) |
+                            (uint64_t)(unsigned)_mm256_movemask_epi8(d) << 32;
+            return data + 64 + __builtin_ctzll(high);
+        }
+        data += 128;
+    }
+    while (end - data >= 32) {
+        unsigned mask = (unsigned)_mm256_movemask_epi8(
+            _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)data), needle));
+        if (mask) {
+            return data + __builtin_ctz(mask);
+        }
+        data += 32;
+    }
+    return find_sse2(data, end, byte);
+}
+
+#endif /* LINES_HAVE_X86 */
+
+static const char *find_resolve(const char *data, const char *end, uint8_t byte);
+
+static _Atomic(find_fn_t) find_impl = find_resolve;
+
+int serial_find_byte_select(int scan) {
+    find_fn_t impl = find_scalar;
+    int selected = SERIAL_SCAN_SCALAR;
+#if LINES_HAVE_X86
+    if (scan == SERIAL_SCAN_AUTO || scan >= SERIAL_SCAN_SSE2) {
+        impl = find_sse2;
+        selected = SERIAL_SCAN_SSE2;
+    }
+    if ((scan == SERIAL_SCAN_AUTO || scan >= SERIAL_SCAN_AVX2) && __builtin_cpu_supports("avx2")) {
+        impl = find_avx2;
+        selected = SERIAL_SCAN_AVX2;
+    }
+#else
+    (void)scan;
+#endif
+    atomic_store_explicit(&find_impl, impl, memory_order_relaxed);
+    return selected;
+}
+
+/* First call picks the implementation for the CPU */
+static const char *find_resolve(const char *data, const char *end, uint8_t byte) {
+    serial_find_byte_select(SERIAL_SCAN_AUTO);
+    return atomic_load_explicit(&find_impl, memory_order_relaxed)(data, end, byte);
+}
+
+const void *serial_find_byte(const void *data, size_t size, uint8_t byte) {
+    if (!data) {
+        return NULL;
+    }
+    const char *start = data;
+    return atomic_load_explicit(&find_impl, memory_order_relaxed)(start, start + size, byte);
+}
+
+serial_lines_t *serial_lines_create(size_t capacity, char delimiter) {
+    if (capacity == 0) {
+        return NULL;
+    }
+    serial_lines_t *lines = calloc(1, sizeof(*lines));
+    if (!lines) {
+        return NULL;
+    }
+    lines->buffer = malloc(capacity);
+    if (!lines->buffer) {
+        free(lines);
+        return NULL;
+    }
+    lines->capacity = capacity;
+    lines->delimiter = delimiter;
+    return lines;
+}
+
+void serial_lines_destroy(serial_lines_t *lines) {
+    if (lines) {
+        free(lines->buffer);
+        free(lines);
+    }
+}
+
+void serial_lines_reset(serial_lines_t *lines) {
+    lines->start = 0;
+    lines->scanned = 0;
+    lines->end = 0;
+}
+
+size_t serial_lines_pending(const serial_lines_t *lines) {
+    return lines->end - lines->start;
+}
+
+/* Moves the partial line to the front to make room behind it */
+static void compact(serial_lines_t *lines) {
+    if (lines->start == 0) {
+        return;
+    }
+    size_t pending = lines->end - lines->start;
+    if (pending > 0) {
+        memmove(lines->buffer, lines->buffer + lines->start, pending);
+    }
+    lines->scanned -= lines->start;
+    lines->end = pending;
+    lines->start = 0;
+}
+
+size_t serial_lines_feed(serial_lines_t *lines, const void *data, size_t size) {
+    compact(lines);
+    size_t room = lines->capacity - lines->end;
+    size_t count = size < room ? size : room;
+    if (count > 0) {
+        memcpy(lines->buffer + lines->end, data, count);
+        lines->end += count;
+    }
+    return count;
+}
+
+int serial_lines_read(serial_lines_t *lines, serial_handle_t handle, size_t *bytes_read) {
+    if (!bytes_read) {
+        return SERIAL_ERROR_INVALID_HANDLE;
+    }
+    *bytes_read = 0;
+    compact(lines);
+    if (lines->end == lines->capacity) {
+        return SERIAL_ERROR_OVERFLOW;
+    }
+
+    int result = serial_read(handle, lines->buffer + lines->end, lines->capacity - lines->end, bytes_read);
+    if (result == SERIAL_SUCCESS) {
+        lines->end += *bytes_read;
+    }
+    return result;
+}
+
+int serial_lines_next(serial_lines_t *lines, struct serial_line_s *line) {
+    if (lines->scanned < lines->end) {
+        const char *found = serial_find_byte(lines->buffer + lines->scanned, lines->end - lines->scanned,
+                                             (uint8_t)lines->delimiter);
+        if (found) {
+            size_t position = (size_t)(found - lines->buffer);
+            line->data = lines->buffer + lines->start;
+            line->length = position - lines->start;
+            line->truncated = 0;
+            if (lines->delimiter == '\n' && line->length > 0 && line->data[line->length - 1] == '\r') {
+                line->length--;
+            }
+            lines->start = position + 1;
+            lines->scanned = lines->start;
+            return 1;
+        }
+        lines->scanned = lines->end;
+    }
+
+    if (lines->start == 0 && lines->end == lines->capacity) {
+        /* No delimiter in a full buffer: hand it out rather than stall */
+        line->data = lines->buffer;
+        line->length = lines->capacity;
+        line->truncated = 1;
+        lines->start = lines->end;
+        lines->scanned = lines->end;
+        return 1;
+    }
+    return 0;
+}
+
+int serial_lines_wait(serial_lines_t *lines, serial_handle_t handle, uint64_t deadline_ms,
+                      struct serial_line_s *line) {
+    for (;;) {
+        if (serial_lines_next(lines, line)) {
+            return SERIAL_SUCCESS;
+        }
+
+        uint64_t now = serial_monotonic_ms();
+        if (now >= deadline_ms) {
+            return SERIAL_ERROR_TIMEOUT;
+        }
+        int result = serial_wait_readable(handle, serial_timeout_until(deadline_ms, now));
+        if (result != SERIAL_SUCCESS) {
+            return result;
+        }
+
+        size_t count;
+        result = serial_lines_read(lines, handle, &count);
+        if (result != SERIAL_SUCCESS) {
+            return result;
+        }
+        if (count == 0) {
+            /* Readable but nothing to read: the other end hung up */
+            return SERIAL_ERROR_READ;
+        }
+    }
+}
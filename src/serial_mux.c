@@ -0,0 +1,679 @@
+/**
+ * @file serial_mux.c
+ * @brief Unix socket multiplexer for one serial link, driven by the reactor
+ */
+
+#include "../include/serial_mux.h"
+
+#if defined(__linux__)
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "../include/serial_client.h"
+#include "../include/serial_frame.h"
+#include "../include/serial_reactor.h"
+
+#define SEQ_COUNT 256
+#define RX_CHUNK 512
+
+struct mux_client_s;
+
+/* A client command, queued on its client and then waiting on a link slot */
+struct mux_command_s {
+    struct mux_client_s *client;
+    struct mux_command_s *next;
+    uint8_t seq;                    /* the client's sequence number */
+    uint8_t cmd;
+    uint8_t length;
+    uint8_t payload[SERIAL_FRAME_MAX_PAYLOAD];
+};
+
+struct mux_client_s {
+    serial_mux_t *mux;
+    serial_handle_t handle;
+    int closed;                     /* kept until its commands in flight complete */
+    int overflowed;                 /* replies did not fit, closed at the next flush */
+    unsigned queued;
+    unsigned in_flight;
+    struct mux_command_s *head;
+    struct mux_command_s *tail;
+    struct mux_client_s *prev;      /* connected clients */
+    struct mux_client_s *next;
+    struct mux_client_s *ready_prev; /* clients with queued commands, in turn order */
+    struct mux_client_s *ready_next;
+    int ready;
+    struct mux_client_s *next_dirty; /* clients with replies added in this batch */
+    int dirty;
+    struct serial_frame_decoder_s decoder;
+    size_t tx_length;
+    uint8_t tx[SERIAL_MUX_CLIENT_BUFFER];
+};
+
+/* A link sequence number in use; waiters share the reply */
+struct mux_slot_s {
+    struct mux_command_s *waiters;
+    uint64_t deadline_ms;
+};
+
+struct serial_mux_s {
+    serial_reactor_t *reactor;
+    serial_handle_t device;
+    int listen_fd;
+    int stop_fd;
+    volatile int stopped;
+    int result;
+    unsigned window;
+    int timeout_ms;
+    unsigned max_clients;
+    struct sockaddr_un address;
+
+    struct mux_client_s *clients;
+    struct mux_client_s *ready_head;
+    struct mux_client_s *ready_tail;
+    struct mux_client_s *dirty;
+    struct mux_command_s *free_commands;
+
+    struct mux_slot_s slots[SEQ_COUNT];
+    unsigned in_flight;
+    uint8_t next_seq;
+    uint8_t oldest_seq;             /* oldest slot in use, next_seq when none is */
+    int coalesce_seq;               /* slot of a GET_STATE sent last, or -1 */
+
+    struct serial_frame_decoder_s decoder;
+    uint8_t rx[RX_CHUNK];
+    size_t tx_head;
+    size_t tx_length;
+    int tx_blocked;                 /* link queue full, waiting to become writable */
+    uint8_t tx[SERIAL_CLIENT_MAX_WINDOW * SERIAL_FRAME_MAX_ENCODED];
+
+    struct serial_mux_stats_s stats;
+};
+
+static struct mux_command_s *alloc_command(serial_mux_t *mux) {
+    struct mux_command_s *command = mux->free_commands;
+    if (command) {
+        mux->free_commands = command->next;
+        return command;
+    }
+    return malloc(sizeof(*command));
+}
+
+static void free_command(serial_mux_t *mux, struct mux_command_s *command) {
+    command->next = mux->free_commands;
+    mux->free_commands = command;
+}
+
+/* Ready list: clients take turns, one command each */
+
+static void ready_push(serial_mux_t *mux, struct mux_client_s *client) {
+    if (client->ready) {
+        return;
+    }
+    client->ready = 1;
+    client->ready_next = NULL;
+    client->ready_prev = mux->ready_tail;
+    if (mux->ready_tail) {
+        mux->ready_tail->ready_next = client;
+    } else {
+        mux->ready_head = client;
+    }
+    mux->ready_tail = client;
+}
+
+static void ready_remove(serial_mux_t *mux, struct mux_client_s *client) {
+    if (!client->ready) {
+        return;
+    }
+    client->ready = 0;
+    if (client->ready_prev) {
+        client->ready_prev->ready_next = client->ready_next;
+    } else {
+        mux->ready_head = client->ready_next;
+    }
+    if (client->ready_next) {
+        client->ready_next->ready_prev = client->ready_prev;
+    } else {
+        mux->ready_tail = client->ready_prev;
+    }
+}
+
+static void release_client(struct mux_client_s *client) {
+    if (client->closed && client->in_flight == 0) {
+        free(client);
+    }
+}
+
+/* Reads from a client while its queue has room, writes while replies are pending */
+static void update_client_events(serial_mux_t *mux, struct mux_client_s *client) {
+    unsigned events = (client->queued < SERIAL_MUX_CLIENT_QUEUE ? SERIAL_REACTOR_READ : 0) |
+                      (client->tx_length > 0 ? SERIAL_REACTOR_WRITE : 0);
+    serial_reactor_set_events(mux->reactor, client->handle, events);
+}
+
+static void close_client(serial_mux_t *mux, struct mux_client_s *client) {
+    serial_reactor_remove(mux->reactor, client->handle);
+    close(client->handle);
+    ready_remove(mux, client);
+    while (client->head) {
+        struct mux_command_s *command = client->head;
+        client->head = command->next;
+        free_command(mux, command);
+    }
+    client->tail = NULL;
+    client->queued = 0;
+    if (client->prev) {
+        client->prev->next = client->next;
+    } else {
+        mux->clients = client->next;
+    }
+    if (client->next) {
+        client->next->prev = client->prev;
+    }
+    client->closed = 1;
+    mux->stats.clients--;
+    release_client(client);
+}
+
+/* Sends pending replies; returns 0 if the client was closed */
+static int flush_client(serial_mux_t *mux, struct mux_client_s *client) {
+    if (client->overflowed) {
+        mux->stats.disconnected++;
+        close_client(mux, client);
+        return 0;
+    }
+    if (client->tx_length > 0) {
+        ssize_t sent = send(client->handle, client->tx, client->tx_length, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (sent < 0 && errno != EAGAIN && errno != EINTR) {
+            close_client(mux, client);
+            return 0;
+        }
+        if (sent > 0) {
+            client->tx_length -= (size_t)sent;
+            memmove(client->tx, client->tx + sent, client->tx_length);
+        }
+    }
+    update_client_events(mux, client);
+    return 1;
+}
+
+/* Queues one reply frame for a client; it goes out when the batch is flushed */
+static void reply_to_client(serial_mux_t *mux, struct mux_client_s *client, uint8_t seq,
+                            const struct serial_frame_s *frame) {
+    if (client->closed || client->overflowed) {
+        return;
+    }
+    size_t length;
+    if (serial_frame_encode(seq, frame->cmd, frame->payload, frame->length, client->tx + client->tx_length,
+                            sizeof(client->tx) - client->tx_length, &length) == SERIAL_SUCCESS) {
+        client->tx_length += length;
+    } else {
+        client->overflowed = 1;
+    }
+    if (!client->dirty) {
+        client->dirty = 1;
+        client->next_dirty = mux->dirty;
+        mux->dirty = client;
+    }
+}
+
+static void flush_dirty_clients(serial_mux_t *mux) {
+    while (mux->dirty) {
+        struct mux_client_s *client = mux->dirty;
+        mux->dirty = client->next_dirty;
+        client->dirty = 0;
+        if (!client->closed) {
+            flush_client(mux, client);
+        }
+    }
+}
+
+/* Frees a link slot; reply is NULL when the device did not answer */
+static void complete_slot(serial_mux_t *mux, uint8_t seq, const struct serial_frame_s *reply) {
+    struct mux_slot_s *slot = &mux->slots[seq];
+    while (slot->waiters) {
+        struct mux_command_s *command = slot->waiters;
+        struct mux_client_s *client = command->client;
+        slot->waiters = command->next;
+        if (reply) {
+            reply_to_client(mux, client, command->seq, reply);
+        }
+        free_command(mux, command);
+        client->in_flight--;
+        release_client(client);
+    }
+    if (mux->coalesce_seq == seq) {
+        mux->coalesce_seq = -1;
+    }
+    mux->in_flight--;
+    /* Replies come back in any order; keep oldest_seq on the oldest slot still waiting */
+    if (mux->in_flight == 0) {
+        mux->oldest_seq = mux->next_seq;
+    }
+    while (mux->in_flight > 0 && !mux->slots[mux->oldest_seq].waiters) {
+        mux->oldest_seq++;
+    }
+}
+
+static void fail(serial_mux_t *mux, int result) {
+    if (mux->result == SERIAL_SUCCESS) {
+        mux->result = result;
+    }
+}
+
+/* Writes pending link bytes; a full queue writes 0 bytes and waits for the link to become writable */
+static void flush_link(serial_mux_t *mux) {
+    if (mux->tx_head < mux->tx_length) {
+        size_t written = 0;
+        int result = serial_write(mux->device, mux->tx + mux->tx_head, mux->tx_length - mux->tx_head, &written);
+        mux->stats.link_writes++;
+        if (result != SERIAL_SUCCESS) {
+            fail(mux, result);
+            return;
+        }
+        mux->tx_head += written;
+        if (mux->tx_head == mux->tx_length) {
+            mux->tx_head = mux->tx_length = 0;
+        }
+    }
+    mux->tx_blocked = mux->tx_head < mux->tx_length;
+    unsigned events = SERIAL_REACTOR_READ | (mux->tx_blocked ? SERIAL_REACTOR_WRITE : 0);
+    serial_reactor_set_events(mux->reactor, mux->device, events);
+}
+
+/*
+ * Moves commands from the client queues onto the link, one per client in
+ * turn, while the window, the sequence space and the link buffer allow,
+ * then writes them. Commands that timed out while the link was held off
+ * still take up the buffer until they are written; the rest wait queued.
+ */
+static void schedule(serial_mux_t *mux) {
+    if (mux->tx_head > 0) {
+        mux->tx_length -= mux->tx_head;
+        memmove(mux->tx, mux->tx + mux->tx_head, mux->tx_length);
+        mux->tx_head = 0;
+    }
+
+    int was_idle = mux->in_flight == 0;
+    while (mux->ready_head && mux->in_flight < mux->window && !mux->slots[mux->next_seq].waiters &&
+           sizeof(mux->tx) - mux->tx_length >= SERIAL_FRAME_MAX_ENCODED) {
+        struct mux_client_s *client = mux->ready_head;
+        struct mux_command_s *command = client->head;
+        int coalesce = command->cmd == SERIAL_CMD_GET_STATE && mux->coalesce_seq >= 0;
+        size_t length = 0;
+        if (!coalesce && serial_frame_encode(mux->next_seq, command->cmd, command->payload, command->length,
+                                             mux->tx + mux->tx_length, sizeof(mux->tx) - mux->tx_length,
+                                             &length) != SERIAL_SUCCESS) {
+            /* The command stays first in its client's queue */
+            break;
+        }
+        ready_remove(mux, client);
+        client->head = command->next;
+        if (!client->head) {
+            client->tail = NULL;
+        }
+        client->queued--;
+        client->in_flight++;
+        command->next = NULL;
+
+        if (coalesce) {
+            /* Nothing was sent since that GET_STATE, so its reply answers this one too */
+            struct mux_slot_s *slot = &mux->slots[mux->coalesce_seq];
+            command->next = slot->waiters;
+            slot->waiters = command;
+            mux->stats.coalesced++;
+        } else {
+            uint8_t seq = mux->next_seq;
+            mux->tx_length += length;
+            mux->slots[seq].waiters = command;
+            mux->slots[seq].deadline_ms = serial_monotonic_ms() + (uint64_t)mux->timeout_ms;
+            mux->coalesce_seq = command->cmd == SERIAL_CMD_GET_STATE ? seq : -1;
+            mux->next_seq++;
+            mux->in_flight++;
+            mux->stats.link_commands++;
+        }
+
+        if (client->head) {
+            ready_push(mux, client);
+        }
+        update_client_events(mux, client);
+    }
+
+    if (was_idle && mux->in_flight > 0) {
+        serial_reactor_set_timer(mux->reactor, mux->device, mux->timeout_ms);
+    }
+    /* While the link is full, the writable callback sends the new commands along with the rest */
+    if (!mux->tx_blocked) {
+        flush_link(mux);
+    }
+}
+
+/* Routes one device frame: a reply to its waiters, anything else to every client */
+static void handle_device_frame(serial_mux_t *mux, const struct serial_frame_s *frame) {
+    if (frame->cmd == SERIAL_CMD_ACK || frame->cmd == SERIAL_CMD_NAK) {
+        if (mux->slots[frame->seq].waiters) {
+            complete_slot(mux, frame->seq, frame);
+        }
+        return;
+    }
+    mux->stats.unsolicited++;
+    for (struct mux_client_s *client = mux->clients; client; client = client->next) {
+        reply_to_client(mux, client, frame->seq, frame);
+    }
+}
+
+static void on_device_readable(serial_reactor_t *reactor, serial_handle_t handle, void *user_data) {
+    serial_mux_t *mux = user_data;
+    size_t count;
+    (void)reactor;
+    int result = serial_read(handle, mux->rx, sizeof(mux->rx), &count);
+    if (result != SERIAL_SUCCESS) {
+        fail(mux, result);
+        return;
+    }
+    for (size_t offset = 0; offset < count;) {
+        struct serial_frame_s frame;
+        int ready;
+        offset += serial_frame_decode(&mux->decoder, mux->rx + offset, count - offset, &frame, &ready);
+        if (ready) {
+            handle_device_frame(mux, &frame);
+        }
+    }
+    flush_dirty_clients(mux);
+    schedule(mux);
+}
+
+/* Room on the link: send what is pending, and commands that waited for space in the link buffer */
+static void on_device_writable(serial_reactor_t *reactor, serial_handle_t handle, void *user_data) {
+    serial_mux_t *mux = user_data;
+    (void)reactor;
+    (void)handle;
+    mux->tx_blocked = 0;
+    schedule(mux);
+}
+
+static void on_device_error(serial_reactor_t *reactor, serial_handle_t handle, void *user_data) {
+    (void)reactor;
+    (void)handle;
+    fail(user_data, SERIAL_ERROR_READ);
+}
+
+/*
+ * Drops link commands past their deadline. Deadlines grow with the sequence
+ * number, so the oldest slot in use always expires first.
+ */
+static void on_device_timeout(serial_reactor_t *reactor, serial_handle_t handle, void *user_data) {
+    serial_mux_t *mux = user_data;
+    uint64_t now = serial_monotonic_ms();
+    while (mux->in_flight > 0) {
+        struct mux_slot_s *slot = &mux->slots[mux->oldest_seq];
+        if (slot->deadline_ms > now) {
+            serial_reactor_set_timer(reactor, handle, (int)(slot->deadline_ms - now));
+            break;
+        }
+        complete_slot(mux, mux->oldest_seq, NULL);
+        mux->stats.timeouts++;
+    }
+    schedule(mux);
+}
+
+static void on_client_readable(serial_reactor_t *reactor, serial_handle_t handle, void *user_data) {
+    struct mux_client_s *client = user_data;
+    serial_mux_t *mux = client->mux;
+    uint8_t buffer[RX_CHUNK];
+    ssize_t count = read(handle, buffer, sizeof(buffer));
+    (void)reactor;
+    if (count == 0 || (count < 0 && errno != EAGAIN && errno != EINTR)) {
+        close_client(mux, client);
+        return;
+    }
+    for (ssize_t offset = 0; offset < count;) {
+        struct serial_frame_s frame;
+        int ready;
+        offset += (ssize_t)serial_frame_decode(&client->decoder, buffer + offset, (size_t)(count - offset), &frame,
+                                               &ready);
+        if (!ready) {
+            continue;
+        }
+        struct mux_command_s *command = alloc_command(mux);
+        if (!command) {
+            close_client(mux, client);
+            return;
+        }
+        command->client = client;
+        command->next = NULL;
+        command->seq = frame.seq;
+        command->cmd = frame.cmd;
+        command->length = frame.length;
+        memcpy(command->payload, frame.payload, frame.length);
+        if (client->tail) {
+            client->tail->next = command;
+        } else {
+            client->head = command;
+        }
+        client->tail = command;
+        client->queued++;
+        mux->stats.commands++;
+    }
+    if (client->head) {
+        ready_push(mux, client);
+    }
+    update_client_events(mux, client);
+    schedule(mux);
+}
+
+static void on_client_writable(serial_reactor_t *reactor, serial_handle_t handle, void *user_data) {
+    struct mux_client_s *client = user_data;
+    (void)reactor;
+    (void)handle;
+    flush_client(client->mux, client);
+}
+
+static void on_client_error(serial_reactor_t *reactor, serial_handle_t handle, void *user_data) {
+    struct mux_client_s *client = user_data;
+    (void)reactor;
+    (void)handle;
+    close_client(client->mux, client);
+}
+
+static const struct serial_reactor_ops_s CLIENT_OPS = {
+    .on_readable = on_client_readable,
+    .on_writable = on_client_writable,
+    .on_error = on_client_error,
+};
+
+static void on_listen_readable(serial_reactor_t *reactor, serial_handle_t handle, void *user_data) {
+    serial_mux_t *mux = user_data;
+    for (;;) {
+        int fd = accept4(handle, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            return;
+        }
+        if (mux->stats.clients >= mux->max_clients) {
+            close(fd);
+            mux->stats.rejected++;
+            continue;
+        }
+        struct mux_client_s *client = calloc(1, sizeof(*client));
+        if (!client || serial_reactor_add(reactor, fd, SERIAL_REACTOR_READ, &CLIENT_OPS, client) != SERIAL_SUCCESS) {
+            free(client);
+            close(fd);
+            mux->stats.rejected++;
+            continue;
+        }
+        client->mux = mux;
+        client->handle = fd;
+        serial_frame_decoder_init(&client->decoder);
+        client->next = mux->clients;
+        if (mux->clients) {
+            mux->clients->prev = client;
+        }
+        mux->clients = client;
+        mux->stats.clients++;
+        mux->stats.accepted++;
+    }
+}
+
+static void on_stop(serial_reactor_t *reactor, serial_handle_t handle, void *user_data) {
+    serial_mux_t *mux = user_data;
+    uint64_t value;
+    (void)reactor;
+    if (read(handle, &value, sizeof(value)) == sizeof(value)) {
+        mux->stopped = 1;
+    }
+}
+
+static const struct serial_reactor_ops_s DEVICE_OPS = {
+    .on_readable = on_device_readable,
+    .on_writable = on_device_writable,
+    .on_timeout = on_device_timeout,
+    .on_error = on_device_error,
+};
+
+static const struct serial_reactor_ops_s LISTEN_OPS = { .on_readable = on_listen_readable };
+static const struct serial_reactor_ops_s STOP_OPS = { .on_readable = on_stop };
+
+serial_mux_t *serial_mux_create(serial_handle_t device, const char *socket_path,
+                                const struct serial_mux_config_s *config) {
+    if (device == SERIAL_INVALID_HANDLE || !socket_path) {
+        return NULL;
+    }
+    unsigned window = config && config->window ? config->window : SERIAL_CLIENT_DEFAULT_WINDOW;
+    int timeout_ms = config && config->timeout_ms ? config->timeout_ms : SERIAL_CLIENT_DEFAULT_TIMEOUT_MS;
+    unsigned max_clients = config && config->max_clients ? config->max_clients : SERIAL_MUX_DEFAULT_MAX_CLIENTS;
+    if (window > SERIAL_CLIENT_MAX_WINDOW || timeout_ms < 0 ||
+        strlen(socket_path) >= sizeof(((struct sockaddr_un *)0)->sun_path)) {
+        return NULL;
+    }
+
+    serial_mux_t *mux = calloc(1, sizeof(*mux));
+    if (!mux) {
+        return NULL;
+    }
+    mux->device = device;
+    mux->window = window;
+    mux->timeout_ms = timeout_ms;
+    mux->max_clients = max_clients;
+    mux->coalesce_seq = -1;
+    mux->address.sun_family = AF_UNIX;
+    strcpy(mux->address.sun_path, socket_path);
+    serial_frame_decoder_init(&mux->decoder);
+
+    /* Replace a socket left behind by an earlier run, but never another kind of file */
+    struct stat st;
+    if (lstat(socket_path, &st) == 0 && S_ISSOCK(st.st_mode)) {
+        unlink(socket_path);
+    }
+
+    mux->reactor = serial_reactor_create();
+    mux->listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    mux->stop_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    int bound = mux->listen_fd >= 0 &&
+                bind(mux->listen_fd, (const struct sockaddr *)&mux->address, sizeof(mux->address)) == 0;
+    if (!mux->reactor || mux->stop_fd < 0 || !bound || listen(mux->listen_fd, SOMAXCONN) != 0 ||
+        serial_reactor_add(mux->reactor, device, SERIAL_REACTOR_READ, &DEVICE_OPS, mux) != SERIAL_SUCCESS ||
+        serial_reactor_add(mux->reactor, mux->listen_fd, SERIAL_REACTOR_READ, &LISTEN_OPS, mux) != SERIAL_SUCCESS ||
+        serial_reactor_add(mux->reactor, mux->stop_fd, SERIAL_REACTOR_READ, &STOP_OPS, mux) != SERIAL_SUCCESS) {
+        if (bound) {
+            unlink(socket_path);
+        }
+        if (mux->listen_fd >= 0) {
+            close(mux->listen_fd);
+        }
+        if (mux->stop_fd >= 0) {
+            close(mux->stop_fd);
+        }
+        serial_reactor_destroy(mux->reactor);
+        free(mux);
+        return NULL;
+    }
+    return mux;
+}
+
+void serial_mux_destroy(serial_mux_t *mux) {
+    if (!mux) {
+        return;
+    }
+    for (unsigned seq = 0; seq < SEQ_COUNT; seq++) {
+        if (mux->slots[seq].waiters) {
+            complete_slot(mux, (uint8_t)seq, NULL);
+        }
+    }
+    while (mux->clients) {
+        close_client(mux, mux->clients);
+    }
+    while (mux->free_commands) {
+        struct mux_command_s *command = mux->free_commands;
+        mux->free_commands = command->next;
+        free(command);
+    }
+    serial_reactor_destroy(mux->reactor);
+    close(mux->listen_fd);
+    close(mux->stop_fd);
+    unlink(mux->address.sun_path);
+    free(mux);
+}
+
+int serial_mux_run_once(serial_mux_t *mux, int timeout_ms) {
+    if (!mux) {
+        return SERIAL_ERROR_INVALID_HANDLE;
+    }
+    int result = serial_reactor_run_once(mux->reactor, timeout_ms);
+    return result < 0 || mux->result == SERIAL_SUCCESS ? result : mux->result;
+}
+
+int serial_mux_run(serial_mux_t *mux) {
+    if (!mux) {
+        return SERIAL_ERROR_INVALID_HANDLE;
+    }
+    mux->stopped = 0;
+    while (!mux->stopped) {
+        int result = serial_mux_run_once(mux, -1);
+        if (result < 0) {
+            return result;
+        }
+    }
+    return SERIAL_SUCCESS;
+}
+
+void serial_mux_stop(serial_mux_t *mux) {
+    if (mux) {
+        uint64_t one = 1;
+        ssize_t written = write(mux->stop_fd, &one, sizeof(one));
+        (void)written;
+    }
+}
+
+void serial_mux_get_stats(const serial_mux_t *mux, struct serial_mux_stats_s *stats) {
+    if (mux && stats) {
+        *stats = mux->stats;
+    }
+}
+
+serial_handle_t serial_mux_connect(const char *socket_path) {
+    struct sockaddr_un address = { .sun_family = AF_UNIX };
+    if (!socket_path || strlen(socket_path) >= sizeof(address.sun_path)) {
+        return SERIAL_INVALID_HANDLE;
+    }
+    strcpy(address.sun_path, socket_path);
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return SERIAL_INVALID_HANDLE;
+    }
+    /* Connect while blocking, then switch to the non-blocking mode serial handles use */
+    if (connect(fd, (const struct sockaddr *)&address, sizeof(address)) != 0 ||
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK) != 0) {
+        close(fd);
+        return SERIAL_INVALID_HANDLE;
+    }
+    return fd;
+}
+
+#else
+typedef int serial_mux_unsupported_t;
+#endif
@@ -0,0 +1,391 @@
+/**
+ * @file serial_reactor.c
+ * @brief epoll-based event loop for many serial ports
+ */
+
+#include "../include/serial_reactor.h"
+#include "serial_internal.h"
+
+#if defined(__linux__)
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/ioctl.h>
+
+#define REACTOR_MAX_EVENTS 64
+#define TIMER_NONE ((size_t)-1)
+
+struct reactor_port_s {
+    serial_handle_t handle;
+    unsigned events;
+    struct serial_reactor_ops_s ops;
+    void *user_data;
+    uint64_t deadline_ms;
+    size_t heap_index;              /* TIMER_NONE when no timer is armed */
+    int dead;
+    struct reactor_port_s *next_dead;
+};
+
+struct serial_reactor_s {
+    int epoll_fd;
+    int stopped;
+    size_t count;
+
+    /* Ports indexed by descriptor for O(1) lookup */
+    struct reactor_port_s **ports;
+    size_t ports_size;
+
+    /* Min-heap of armed timers ordered by deadline */
+    struct reactor_port_s **timers;
+    size_t timer_count;
+    size_t timer_capacity;
+
+    /* Ports removed during dispatch, freed once the batch is done */
+    struct reactor_port_s *graveyard;
+};
+
+static uint32_t to_epoll_events(unsigned events) {
+    uint32_t result = 0;
+    if (events & SERIAL_REACTOR_READ) {
+        result |= EPOLLIN;
+    }
+    if (events & SERIAL_REACTOR_WRITE) {
+        result |= EPOLLOUT;
+    }
+    return result;
+}
+
+static struct reactor_port_s *find_port(const serial_reactor_t *reactor, serial_handle_t handle) {
+    if (handle < 0 || (size_t)handle >= reactor->ports_size) {
+        return NULL;
+    }
+    return reactor->ports[handle];
+}
+
+/* Timer heap helpers */
+
+static void heap_swap(serial_reactor_t *reactor, size_t a, size_t b) {
+    struct reactor_port_s *tmp = reactor->timers[a];
+    reactor->timers[a] = reactor->timers[b];
+    reactor->timers[b] = tmp;
+    reactor->timers[a]->heap_index = a;
+    reactor->timers[b]->heap_index = b;
+}
+
+static void heap_sift_up(serial_reactor_t *reactor, size_t index) {
+    while (index > 0) {
+        size_t parent = (index - 1) / 2;
+        if (reactor->timers[parent]->deadline_ms <= reactor->timers[index]->deadline_ms) {
+            break;
+        }
+        heap_swap(reactor, parent, index);
+        index = parent;
+    }
+}
+
+static void heap_sift_down(serial_reactor_t *reactor, size_t index) {
+    for (;;) {
+        size_t smallest = index;
+        size_t left = index * 2 + 1;
+        size_t right = left + 1;
+        if (left < reactor->timer_count &&
+            reactor->timers[left]->deadline_ms < reactor->timers[smallest]->deadline_ms) {
+            smallest = left;
+        }
+        if (right < reactor->timer_count &&
+            reactor->timers[right]->deadline_ms < reactor->timers[smallest]->deadline_ms) {
+            smallest = right;
+        }
+        if (smallest == index) {
+            return;
+        }
+        heap_swap(reactor, index, smallest);
+        index = smallest;
+    }
+}
+
+static void heap_remove(serial_reactor_t *reactor, struct reactor_port_s *port) {
+    size_t index = port->heap_index;
+    if (index == TIMER_NONE) {
+        return;
+    }
+    port->heap_index = TIMER_NONE;
+    reactor->timer_count--;
+    if (index == reactor->timer_count) {
+        return;
+    }
+    reactor->timers[index] = reactor->timers[reactor->timer_count];
+    reactor->timers[index]->heap_index = index;
+    heap_sift_up(reactor, index);
+    heap_sift_down(reactor, reactor->timers[index]->heap_index);
+}
+
+static int heap_insert(serial_reactor_t *reactor, struct reactor_port_s *port) {
+    if (reactor->timer_count == reactor->timer_capacity) {
+        size_t capacity = reactor->timer_capacity ? reactor->timer_capacity * 2 : 16;
+        struct reactor_port_s **timers = realloc(reactor->timers, capacity * sizeof(*timers));
+        if (!timers) {
+            return SERIAL_ERROR_CONFIG;
+        }
+        reactor->timers = timers;
+        reactor->timer_capacity = capacity;
+    }
+    port->heap_index = reactor->timer_count;
+    reactor->timers[reactor->timer_count++] = port;
+    heap_sift_up(reactor, port->heap_index);
+    return SERIAL_SUCCESS;
+}
+
+serial_reactor_t *serial_reactor_create(void) {
+    serial_reactor_t *reactor = calloc(1, sizeof(*reactor));
+    if (!reactor) {
+        return NULL;
+    }
+
+    reactor->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (reactor->epoll_fd < 0) {
+        free(reactor);
+        return NULL;
+    }
+
+    return reactor;
+}
+
+static void free_graveyard(serial_reactor_t *reactor) {
+    while (reactor->graveyard) {
+        struct reactor_port_s *port = reactor->graveyard;
+        reactor->graveyard = port->next_dead;
+        free(port);
+    }
+}
+
+void serial_reactor_destroy(serial_reactor_t *reactor) {
+    if (!reactor) {
+        return;
+    }
+
+    for (size_t i = 0; i < reactor->ports_size; i++) {
+        free(reactor->ports[i]);
+    }
+    free_graveyard(reactor);
+    free(reactor->ports);
+    free(reactor->timers);
+    close(reactor->epoll_fd);
+    free(reactor);
+}
+
+int serial_reactor_add(serial_reactor_t *reactor, serial_handle_t handle, unsigned events,
+                       const struct serial_reactor_ops_s *ops, void *user_data) {
+    if (!reactor || !ops || handle == SERIAL_INVALID_HANDLE || handle < 0) {
+        return SERIAL_ERROR_INVALID_HANDLE;
+    }
+    if (find_port(reactor, handle) || serial_transport_lookup(handle)) {
+        return SERIAL_ERROR_CONFIG;
+    }
+
+    if ((size_t)handle >= reactor->ports_size) {
+        size_t size = reactor->ports_size ? reactor->ports_size : 64;
+        while (size <= (size_t)handle) {
+            size *= 2;
+        }
+        struct reactor_port_s **ports = realloc(reactor->ports, size * sizeof(*ports));
+        if (!ports) {
+            return SERIAL_ERROR_CONFIG;
+        }
+        memset(ports + reactor->ports_size, 0, (size - reactor->ports_size) * sizeof(*ports));
+        reactor->ports = ports;
+        reactor->ports_size = size;
+    }
+
+    struct reactor_port_s *port = calloc(1, sizeof(*port));
+    if (!port) {
+        return SERIAL_ERROR_CONFIG;
+    }
+    port->handle = handle;
+    port->events = events;
+    port->ops = *ops;
+    port->user_data = user_data;
+    port->heap_index = TIMER_NONE;
+
+    struct epoll_event event = { .events = to_epoll_events(events), .data.ptr = port };
+    if (epoll_ctl(reactor->epoll_fd, EPOLL_CTL_ADD, handle, &event) != 0) {
+        free(port);
+        return SERIAL_ERROR_CONFIG;
+    }
+
+    reactor->ports[handle] = port;
+    reactor->count++;
+    return SERIAL_SUCCESS;
+}
+
+int serial_reactor_set_events(serial_reactor_t *reactor, serial_handle_t handle, unsigned events) {
+    struct reactor_port_s *port = reactor ? find_port(reactor, handle) : NULL;
+    if (!port) {
+        return SERIAL_ERROR_INVALID_HANDLE;
+    }
+    if (port->events == events) {
+        return SERIAL_SUCCESS;
+    }
+
+    struct epoll_event event = { .events = to_epoll_events(events), .data.ptr = port };
+    if (epoll_ctl(reactor->epoll_fd, EPOLL_CTL_MOD, handle, &event) != 0) {
+        return SERIAL_ERROR_CONFIG;
+    }
+    port->events = events;
+    return SERIAL_SUCCESS;
+}
+
+int serial_reactor_remove(serial_reactor_t *reactor, serial_handle_t handle) {
+    struct reactor_port_s *port = reactor ? find_port(reactor, handle) : NULL;
+    if (!port) {
+        return SERIAL_ERROR_INVALID_HANDLE;
+    }
+
+    epoll_ctl(reactor->epoll_fd, EPOLL_CTL_DEL, handle, NULL);
+    heap_remove(reactor, port);
+    reactor->ports[handle] = NULL;
+    reactor->count--;
+
+    /* Events for this port may still be pending in the current batch */
+    port->dead = 1;
+    port->next_dead = reactor->graveyard;
+    reactor->graveyard = port;
+    return SERIAL_SUCCESS;
+}
+
+int serial_reactor_set_timer(serial_reactor_t *reactor, serial_handle_t handle, int timeout_ms) {
+    struct reactor_port_s *port = reactor ? find_port(reactor, handle) : NULL;
+    if (!port) {
+        return SERIAL_ERROR_INVALID_HANDLE;
+    }
+
+    if (timeout_ms < 0) {
+        heap_remove(reactor, port);
+        return SERIAL_SUCCESS;
+    }
+
+    uint64_t deadline = serial_monotonic_ms() + (uint64_t)timeout_ms;
+    if (port->heap_index == TIMER_NONE) {
+        port->deadline_ms = deadline;
+        return heap_insert(reactor, port);
+    }
+
+    uint64_t previous = port->deadline_ms;
+    port->deadline_ms = deadline;
+    if (deadline < previous) {
+        heap_sift_up(reactor, port->heap_index);
+    } else {
+        heap_sift_down(reactor, port->heap_index);
+    }
+    return SERIAL_SUCCESS;
+}
+
+/* Clamps the caller's timeout so epoll_wait wakes up for the next timer */
+static int next_wait_ms(const serial_reactor_t *reactor, int timeout_ms) {
+    if (reactor->timer_count == 0) {
+        return timeout_ms;
+    }
+
+    uint64_t now = serial_monotonic_ms();
+    uint64_t deadline = reactor->timers[0]->deadline_ms;
+    uint64_t wait = deadline > now ? deadline - now : 0;
+    if (timeout_ms >= 0 && (uint64_t)timeout_ms < wait) {
+        return timeout_ms;
+    }
+    return wait > (uint64_t)INT32_MAX ? INT32_MAX : (int)wait;
+}
+
+static int dispatch_timers(serial_reactor_t *reactor) {
+    int dispatched = 0;
+    uint64_t now = serial_monotonic_ms();
+
+    while (reactor->timer_count > 0 && reactor->timers[0]->deadline_ms <= now) {
+        struct reactor_port_s *port = reactor->timers[0];
+        heap_remove(reactor, port);
+        if (port->ops.on_timeout) {
+            port->ops.on_timeout(reactor, port->handle, port->user_data);
+            dispatched++;
+        }
+    }
+    return dispatched;
+}
+
+/* Bytes still queued for reading; 0 if the descriptor cannot tell */
+static int input_pending(serial_handle_t handle) {
+    int pending = 0;
+    return ioctl(handle, FIONREAD, &pending) == 0 && pending > 0;
+}
+
+int serial_reactor_run_once(serial_reactor_t *reactor, int timeout_ms) {
+    if (!reactor) {
+        return SERIAL_ERROR_INVALID_HANDLE;
+    }
+
+    struct epoll_event events[REACTOR_MAX_EVENTS];
+    int count = epoll_wait(reactor->epoll_fd, events, REACTOR_MAX_EVENTS, next_wait_ms(reactor, timeout_ms));
+    if (count < 0) {
+        if (errno != EINTR) {
+            return SERIAL_ERROR_READ;
+        }
+        count = 0;
+    }
+
+    int dispatched = 0;
+    for (int i = 0; i < count; i++) {
+        struct reactor_port_s *port = events[i].data.ptr;
+        uint32_t ready = events[i].events;
+
+        if (!port->dead && (ready & EPOLLIN) && port->ops.on_readable) {
+            port->ops.on_readable(reactor, port->handle, port->user_data);
+            dispatched++;
+        }
+        if (!port->dead && (ready & EPOLLOUT) && port->ops.on_writable) {
+            port->ops.on_writable(reactor, port->handle, port->user_data);
+            dispatched++;
+        }
+        /* A hang-up comes with EPOLLIN until the input is drained; reads then return 0 bytes for ever */
+        if (!port->dead && (ready & (EPOLLERR | EPOLLHUP)) && (!(ready & EPOLLIN) || !input_pending(port->handle))) {
+            if (port->ops.on_error) {
+                port->ops.on_error(reactor, port->handle, port->user_data);
+                dispatched++;
+            } else {
+                serial_reactor_remove(reactor, port->handle);
+            }
+        }
+    }
+
+    dispatched += dispatch_timers(reactor);
+    free_graveyard(reactor);
+    return dispatched;
+}
+
+int serial_reactor_run(serial_reactor_t *reactor) {
+    if (!reactor) {
+        return SERIAL_ERROR_INVALID_HANDLE;
+    }
+
+    reactor->stopped = 0;
+    while (!reactor->stopped && reactor->count > 0) {
+        int result = serial_reactor_run_once(reactor, -1);
+        if (result < 0) {
+            return result;
+        }
+    }
+    return SERIAL_SUCCESS;
+}
+
+void serial_reactor_stop(serial_reactor_t *reactor) {
+    if (reactor) {
+        reactor->stopped = 1;
+    }
+}
+
+size_t serial_reactor_count(const serial_reactor_t *reactor) {
+    return reactor ? reactor->count : 0;
+}
+
+#else
+typedef int serial_reactor_unsupported_t;
+#endif /* __linux__ */
@@ -0,0 +1,196 @@
+/**
+ * @file serial_ring.c
+ * @brief Implementation of the lock-free SPSC byte ring
+ */
+
+#include "../include/serial_ring.h"
+#include <stdalign.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_WIN32)
+    #include <malloc.h>
+#endif
+
+#define CACHE_LINE_SIZE 64
+
+struct serial_ring_s {
+    /* Producer side: its index plus a cached copy of the consumer's */
+    alignas(CACHE_LINE_SIZE) atomic_size_t head;
+    size_t cached_tail;
+
+    /* Consumer side: its index plus a cached copy of the producer's */
+    alignas(CACHE_LINE_SIZE) atomic_size_t tail;
+    size_t cached_head;
+
+    /* Read-only after creation */
+    alignas(CACHE_LINE_SIZE) uint8_t *buffer;
+    size_t capacity;
+    size_t mask;
+};
+
+static void *ring_alloc(size_t size) {
+#if defined(_WIN32)
+    return _aligned_malloc(size, CACHE_LINE_SIZE);
+#else
+    return aligned_alloc(CACHE_LINE_SIZE, size);
+#endif
+}
+
+static void ring_free(void *data) {
+#if defined(_WIN32)
+    _aligned_free(data);
+#else
+    free(data);
+#endif
+}
+
+serial_ring_t *serial_ring_create(size_t capacity) {
+    if (capacity == 0 || capacity > (SIZE_MAX >> 1)) {
+        return NULL;
+    }
+
+    size_t size = CACHE_LINE_SIZE;
+    while (size < capacity) {
+        size <<= 1;
+    }
+
+    serial_ring_t *ring = ring_alloc(sizeof(*ring));
+    if (!ring) {
+        return NULL;
+    }
+    memset(ring, 0, sizeof(*ring));
+
+    ring->buffer = ring_alloc(size);
+    if (!ring->buffer) {
+        ring_free(ring);
+        return NULL;
+    }
+
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->tail, 0);
+    ring->capacity = size;
+    ring->mask = size - 1;
+    return ring;
+}
+
+void serial_ring_destroy(serial_ring_t *ring) {
+    if (ring) {
+        ring_free(ring->buffer);
+        ring_free(ring);
+    }
+}
+
+size_t serial_ring_capacity(const serial_ring_t *ring) {
+    return ring->capacity;
+}
+
+void *serial_ring_storage(serial_ring_t *ring) {
+    return ring->buffer;
+}
+
+size_t serial_ring_used(const serial_ring_t *ring) {
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    size_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    return head - tail;
+}
+
+size_t serial_ring_space(const serial_ring_t *ring) {
+    return ring->capacity - serial_ring_used(ring);
+}
+
+/* Free space as seen by the producer, refreshing the cached tail only when needed */
+static size_t producer_space(serial_ring_t *ring, size_t head, size_t wanted) {
+    size_t space = ring->capacity - (head - ring->cached_tail);
+    if (space < wanted) {
+        ring->cached_tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+        space = ring->capacity - (head - ring->cached_tail);
+    }
+    return space;
+}
+
+/* Readable bytes as seen by the consumer, refreshing the cached head only when needed */
+static size_t consumer_used(serial_ring_t *ring, size_t tail, size_t wanted) {
+    size_t used = ring->cached_head - tail;
+    if (used < wanted) {
+        ring->cached_head = atomic_load_explicit(&ring->head, memory_order_acquire);
+        used = ring->cached_head - tail;
+    }
+    return used;
+}
+
+size_t serial_ring_write(serial_ring_t *ring, const void *data, size_t size) {
+    size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    size_t space = producer_space(ring, head, size);
+    if (size > space) {
+        size = space;
+    }
+    if (size == 0) {
+        return 0;
+    }
+
+    size_t offset = head & ring->mask;
+    size_t first = ring->capacity - offset;
+    if (first > size) {
+        first = size;
+    }
+    memcpy(ring->buffer + offset, data, first);
+    memcpy(ring->buffer, (const uint8_t *)data + first, size - first);
+
+    atomic_store_explicit(&ring->head, head + size, memory_order_release);
+    return size;
+}
+
+size_t serial_ring_read(serial_ring_t *ring, void *buffer, size_t size) {
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    size_t used = consumer_used(ring, tail, size);
+    if (size > used) {
+        size = used;
+    }
+    if (size == 0) {
+        return 0;
+    }
+
+    size_t offset = tail & ring->mask;
+    size_t first = ring->capacity - offset;
+    if (first > size) {
+        first = size;
+    }
+    memcpy(buffer, ring->buffer + offset, first);
+    memcpy((uint8_t *)buffer + first, ring->buffer, size - first);
+
+    atomic_store_explicit(&ring->tail, tail + size, memory_order_release);
+    return size;
+}
+
+size_t serial_ring_reserve(serial_ring_t *ring, void **data) {
+    size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    size_t space = producer_space(ring, head, ring->capacity);
+    size_t offset = head & ring->mask;
+    size_t contiguous = ring->capacity - offset;
+
+    *data = ring->buffer + offset;
+    return space < contiguous ? space : contiguous;
+}
+
+void serial_ring_commit(serial_ring_t *ring, size_t size) {
+    size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    atomic_store_explicit(&ring->head, head + size, memory_order_release);
+}
+
+size_t serial_ring_peek(serial_ring_t *ring, const void **data) {
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    size_t used = consumer_used(ring, tail, ring->capacity);
+    size_t offset = tail & ring->mask;
+    size_t contiguous = ring->capacity - offset;
+
+    *data = ring->buffer + offset;
+    return used < contiguous ? used : contiguous;
+}
+
+void serial_ring_consume(serial_ring_t *ring, size_t size) {
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    atomic_store_explicit(&ring->tail, tail + size, memory_order_release);
+}
@@ -0,0 +1,100 @@
+/**
+ * @file serial_rt.c
+ * @brief CPU pinning, SCHED_FIFO and memory locking with a fallback for unprivileged processes
+ */
+
+#include "serial_internal.h"
+#include "../include/serial_rt.h"
+
+#if defined(__linux__)
+
+#include <linux/capability.h>
+#include <pthread.h>
+#include <sched.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+/* Touches SERIAL_RT_STACK_PREFAULT bytes below the caller's frame */
+static __attribute__((noinline)) void prefault_stack(void) {
+    volatile unsigned char stack[SERIAL_RT_STACK_PREFAULT];
+    for (size_t i = 0; i < sizeof(stack); i += 4096) {
+        stack[i] = 0;
+    }
+}
+
+/*
+ * mlockall(MCL_FUTURE) is only safe when RLIMIT_MEMLOCK does not apply;
+ * otherwise the stacks of threads created later no longer fit the limit
+ */
+static int may_lock_process(void) {
+    if ((pid_t)syscall(SYS_gettid) != getpid()) {
+        return 0;                       /* a worker thread must not lock the whole process */
+    }
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_MEMLOCK, &limit) == 0 && limit.rlim_cur == RLIM_INFINITY) {
+        return 1;
+    }
+    struct __user_cap_header_struct header = { .version = _LINUX_CAPABILITY_VERSION_3 };
+    struct __user_cap_data_struct data[_LINUX_CAPABILITY_U32S_3];
+    return syscall(SYS_capget, &header, data) == 0 && (data[0].effective & (1u << CAP_IPC_LOCK)) != 0;
+}
+
+int serial_rt_valid(const struct serial_rt_config_s *config) {
+    return config && config->cpu >= -1 && config->cpu < CPU_SETSIZE && config->priority >= 0 &&
+           (config->priority == 0 || (config->priority >= sched_get_priority_min(SCHED_FIFO) &&
+                                      config->priority <= sched_get_priority_max(SCHED_FIFO)));
+}
+
+int serial_rt_apply(const struct serial_rt_config_s *config, unsigned *applied) {
+    unsigned done = 0;
+    if (applied) {
+        *applied = 0;
+    }
+    if (!serial_rt_valid(config)) {
+        return SERIAL_ERROR_CONFIG;
+    }
+
+    if (config->cpu >= 0) {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(config->cpu, &cpus);
+        if (pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) == 0) {
+            done |= SERIAL_RT_PINNED;   /* fails for cores outside the process's cpuset */
+        }
+    }
+    if (config->priority > 0) {
+        struct sched_param param = { .sched_priority = config->priority };
+        if (pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) == 0) {
+            done |= SERIAL_RT_FIFO;
+        }
+    }
+    if (config->lock_memory) {
+        if (may_lock_process() && mlockall(MCL_CURRENT | MCL_FUTURE) == 0) {
+            done |= SERIAL_RT_LOCKED;
+        }
+        prefault_stack();
+    }
+
+    if (applied) {
+        *applied = done;
+    }
+    return SERIAL_SUCCESS;
+}
+
+int serial_rt_prefault(void *data, size_t size) {
+    if (size > 0 && mlock(data, size) == 0) {
+        return 1;                       /* mlock() faults the pages in */
+    }
+    volatile unsigned char *bytes = data;
+    for (size_t i = 0; i < size; i += 4096) {
+        bytes[i] = bytes[i];
+    }
+    return 0;
+}
+
+#else
+typedef int serial_rt_unsupported_t;
+#endif
@@ -0,0 +1,136 @@
+/**
+ * @file serial_sequencer.c
+ * @brief Absolute-deadline pacing of command timelines
+ */
+
+#include "serial_internal.h"
+#include "../include/serial_sequencer.h"
+
+#if defined(__linux__)
+
+#include <errno.h>
+#include <string.h>
+#include <sys/timerfd.h>
+#include <time.h>
+
+static struct timespec to_timespec(uint64_t time_ns) {
+    struct timespec ts = { .tv_sec = (time_t)(time_ns / 1000000000u), .tv_nsec = (long)(time_ns % 1000000000u) };
+    return ts;
+}
+
+/* Sleeps until wake_ns on CLOCK_MONOTONIC, the clock of serial_monotonic_ns() */
+static int sleep_until(int timer_fd, uint64_t wake_ns) {
+    if (timer_fd < 0) {
+        struct timespec due = to_timespec(wake_ns);
+        int result;
+        while ((result = clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &due, NULL)) == EINTR) {
+        }
+        return result == 0 ? SERIAL_SUCCESS : SERIAL_ERROR_CONFIG;
+    }
+
+    struct itimerspec timer = { .it_value = to_timespec(wake_ns) };
+    if (timer.it_value.tv_sec == 0 && timer.it_value.tv_nsec == 0) {
+        return SERIAL_SUCCESS;          /* a zero value would disarm the timer */
+    }
+    if (timerfd_settime(timer_fd, TFD_TIMER_ABSTIME, &timer, NULL) != 0) {
+        return SERIAL_ERROR_CONFIG;
+    }
+    uint64_t expirations;
+    while (read(timer_fd, &expirations, sizeof(expirations)) < 0) {
+        if (errno != EINTR) {
+            return SERIAL_ERROR_CONFIG;
+        }
+    }
+    return SERIAL_SUCCESS;
+}
+
+/* Sleeps to spin_ns before the deadline, then polls the clock; returns the time at the deadline */
+static int wait_for(int timer_fd, uint64_t due_ns, uint64_t spin_ns, uint64_t *now_ns) {
+    uint64_t now = serial_monotonic_ns();
+    if (now < due_ns) {
+        if (due_ns - now > spin_ns) {
+            int result = sleep_until(timer_fd, due_ns - spin_ns);
+            if (result != SERIAL_SUCCESS) {
+                return result;
+            }
+            now = serial_monotonic_ns();
+        }
+        while (now < due_ns) {
+            now = serial_monotonic_ns();
+        }
+    }
+    *now_ns = now;
+    return SERIAL_SUCCESS;
+}
+
+int serial_sequencer_run(serial_handle_t handle, const struct serial_sequence_step_s *steps, size_t count,
+                         const struct serial_sequencer_config_s *config, struct serial_sequencer_report_s *report) {
+    struct serial_sequencer_config_s settings = {0};
+    struct serial_sequencer_report_s local;
+    if (handle == SERIAL_INVALID_HANDLE) {
+        return SERIAL_ERROR_INVALID_HANDLE;
+    }
+    if (config) {
+        settings = *config;
+    }
+    if (settings.write_timeout_ms == 0) {
+        settings.write_timeout_ms = SERIAL_SEQUENCER_DEFAULT_WRITE_TIMEOUT_MS;
+    }
+    if ((settings.wait != SERIAL_SEQUENCER_TIMERFD && settings.wait != SERIAL_SEQUENCER_NANOSLEEP) ||
+        (count > 0 && !steps)) {
+        return SERIAL_ERROR_CONFIG;
+    }
+    for (size_t i = 1; i < count; i++) {
+        if (steps[i].due_ns < steps[i - 1].due_ns) {
+            return SERIAL_ERROR_CONFIG;
+        }
+    }
+    if (!report) {
+        report = &local;
+    }
+    memset(report, 0, sizeof(*report));
+
+    int timer_fd = -1;
+    if (settings.wait == SERIAL_SEQUENCER_TIMERFD) {
+        timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+        if (timer_fd < 0) {
+            return SERIAL_ERROR_CONFIG;
+        }
+    }
+
+    int result = SERIAL_SUCCESS;
+    uint64_t start_ns = settings.start_ns ? settings.start_ns : serial_monotonic_ns();
+    uint64_t end_ns = start_ns;
+    report->start_ns = start_ns;
+    for (size_t i = 0; i < count && result == SERIAL_SUCCESS; i++) {
+        uint64_t due_ns = start_ns + steps[i].due_ns;
+        uint64_t now_ns;
+        result = wait_for(timer_fd, due_ns, settings.spin_ns, &now_ns);
+        if (result != SERIAL_SUCCESS) {
+            break;
+        }
+        if (settings.skip_late_ns && now_ns - due_ns >= settings.skip_late_ns) {
+            report->skipped++;
+            continue;
+        }
+
+        size_t written;
+        result = serial_write_all(handle, steps[i].data, steps[i].length, settings.write_timeout_ms, &written);
+        end_ns = serial_monotonic_ns();
+        if (result == SERIAL_SUCCESS) {
+            report->sent++;
+            serial_histogram_record(&report->dispatch_lateness, now_ns - due_ns);
+            serial_histogram_record(&report->complete_lateness, end_ns - due_ns);
+        }
+    }
+    report->elapsed_ns = end_ns - start_ns;
+
+    if (timer_fd >= 0) {
+        close(timer_fd);
+    }
+    return result;
+}
+
+#else
+typedef int serial_sequencer_unsupported_t;
+#endif
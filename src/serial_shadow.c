@@ -0,0 +1,251 @@
+/**
+ * @file serial_shadow.c
+ * @brief LED state mirror in front of the pipelined client
+ */
+
+#include "../include/serial_shadow.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define SHADOW_ENTRIES 256
+
+/* One command sent and not yet completed, indexed by its submission number */
+struct shadow_entry_s {
+    serial_shadow_t *shadow;
+    int active;
+    uint64_t index;
+    uint8_t cmd;
+    uint8_t length;
+    uint8_t payload[SERIAL_FRAME_MAX_PAYLOAD];
+    struct serial_led_state_s expected;     /* state after this command, as predicted */
+    serial_client_callback_t callback;
+    void *user_data;
+};
+
+struct serial_shadow_s {
+    serial_client_t *client;
+    int max_age_ms;
+    struct serial_led_state_s predicted;    /* state after every command sent so far */
+    uint64_t confirmed_ms;                  /* when an ACK last reported the state */
+    uint64_t next_index;
+    uint64_t acked_index;                   /* one past the newest command the device acknowledged */
+    struct serial_shadow_stats_s stats;
+    struct shadow_entry_s entries[SHADOW_ENTRIES];
+};
+
+/* Whether one LED command changes nothing in the known state */
+static int led_command_is_noop(const struct serial_led_state_s *state, uint8_t cmd, uint8_t mask) {
+    switch (cmd) {
+    case SERIAL_CMD_LED_ON:
+        return (state->known & mask) == mask && (state->leds & mask) == mask;
+    case SERIAL_CMD_LED_OFF:
+        return (state->known & mask) == mask && (state->leds & mask) == 0;
+    case SERIAL_CMD_LED_SET:
+        return state->known == SERIAL_SHADOW_KNOWN_ALL && state->leds == mask;
+    default:
+        return 0;
+    }
+}
+
+/* Mirrors apply_led_command() of the sketch; returns 0 for a command the sketch rejects */
+static int apply_led_command(struct serial_led_state_s *state, uint8_t cmd, uint8_t mask) {
+    switch (cmd) {
+    case SERIAL_CMD_LED_ON:
+        state->leds |= mask;
+        state->known |= mask;
+        return 1;
+    case SERIAL_CMD_LED_OFF:
+        state->leds &= (uint8_t)~mask;
+        state->known |= mask;
+        return 1;
+    case SERIAL_CMD_LED_SET:
+        state->leds = mask;
+        state->known = SERIAL_SHADOW_KNOWN_ALL;
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+int serial_led_state_is_noop(const struct serial_led_state_s *state, uint8_t cmd, const void *payload,
+                             size_t length) {
+    const uint8_t *bytes = payload;
+    if (cmd == SERIAL_CMD_BATCH) {
+        /* A no-op step leaves the state as it was, so every step is checked against the same state */
+        if (length == 0 || length % 2 != 0 || length > SERIAL_FRAME_MAX_PAYLOAD) {
+            return 0;
+        }
+        for (size_t i = 0; i < length; i += 2) {
+            if (!led_command_is_noop(state, bytes[i], bytes[i + 1])) {
+                return 0;
+            }
+        }
+        return 1;
+    }
+    return length == 1 && led_command_is_noop(state, cmd, bytes[0]);
+}
+
+void serial_led_state_apply(struct serial_led_state_s *state, uint8_t cmd, const void *payload, size_t length) {
+    const uint8_t *bytes = payload;
+    if (cmd == SERIAL_CMD_BATCH) {
+        if (length % 2 != 0) {
+            return;
+        }
+        for (size_t i = 0; i < length; i += 2) {
+            if (!apply_led_command(state, bytes[i], bytes[i + 1])) {
+                /* The sketch stops here and NAKs, after applying the earlier steps */
+                state->known = 0;
+                return;
+            }
+        }
+    } else if (length == 1) {
+        apply_led_command(state, cmd, bytes[0]);
+    }
+}
+
+serial_shadow_t *serial_shadow_create(serial_client_t *client, const struct serial_shadow_config_s *config) {
+    if (!client || (config && config->max_age_ms < 0)) {
+        return NULL;
+    }
+    serial_shadow_t *shadow = calloc(1, sizeof(*shadow));
+    if (!shadow) {
+        return NULL;
+    }
+    shadow->client = client;
+    shadow->max_age_ms = config ? config->max_age_ms : 0;
+    return shadow;
+}
+
+void serial_shadow_destroy(serial_shadow_t *shadow) {
+    free(shadow);
+}
+
+/* Rebuilds the prediction from a base state and the commands after index still in flight */
+static void replay_from(serial_shadow_t *shadow, struct serial_led_state_s base, uint64_t index) {
+    for (uint64_t i = index + 1; i < shadow->next_index; i++) {
+        struct shadow_entry_s *entry = &shadow->entries[i % SHADOW_ENTRIES];
+        if (entry->active && entry->index == i) {
+            serial_led_state_apply(&base, entry->cmd, entry->payload, entry->length);
+            entry->expected = base;
+        }
+    }
+    shadow->predicted = base;
+}
+
+static void on_reply(serial_client_t *client, int status, const struct serial_frame_s *reply, uint64_t latency_ns,
+                     void *user_data) {
+    struct shadow_entry_s *entry = user_data;
+    serial_shadow_t *shadow = entry->shadow;
+    entry->active = 0;
+
+    /* Only a completion newer than every ACK so far says something about the current state */
+    if (entry->index >= shadow->acked_index) {
+        struct serial_led_state_s base = {0, 0};
+        if (status == SERIAL_SUCCESS && reply->cmd == SERIAL_CMD_ACK && reply->length >= 2) {
+            base.leds = reply->payload[1];
+            base.known = SERIAL_SHADOW_KNOWN_ALL;
+            if (((base.leds ^ entry->expected.leds) & entry->expected.known) != 0) {
+                shadow->stats.mismatches++;
+            }
+            shadow->acked_index = entry->index + 1;
+            shadow->confirmed_ms = serial_monotonic_ms();
+        } else if (shadow->predicted.known == SERIAL_SHADOW_KNOWN_ALL) {
+            shadow->stats.invalidations++;
+        }
+        replay_from(shadow, base, entry->index);
+    }
+
+    if (entry->callback) {
+        entry->callback(client, status, reply, latency_ns, entry->user_data);
+    }
+}
+
+/* Completes a command from the mirror with the ACK the device would send */
+static void complete_locally(serial_shadow_t *shadow, uint8_t leds, serial_client_callback_t callback,
+                             void *user_data) {
+    if (callback) {
+        struct serial_frame_s reply = { .cmd = SERIAL_CMD_ACK, .length = 2 };
+        reply.payload[0] = SERIAL_STATUS_OK;
+        reply.payload[1] = leds;
+        callback(shadow->client, SERIAL_SUCCESS, &reply, 0, user_data);
+    }
+}
+
+int serial_shadow_submit(serial_shadow_t *shadow, uint8_t cmd, const void *payload, size_t length,
+                         serial_client_callback_t callback, void *user_data) {
+    if (!shadow) {
+        return SERIAL_ERROR_INVALID_HANDLE;
+    }
+    if (length > SERIAL_FRAME_MAX_PAYLOAD || (length > 0 && !payload)) {
+        return SERIAL_ERROR_CONFIG;
+    }
+    shadow->stats.commands++;
+
+    struct serial_led_state_s view = shadow->predicted;
+    if (shadow->max_age_ms > 0 && serial_monotonic_ms() - shadow->confirmed_ms > (uint64_t)shadow->max_age_ms) {
+        view.known = 0;
+    }
+    if (cmd == SERIAL_CMD_GET_STATE && length == 0 && view.known == SERIAL_SHADOW_KNOWN_ALL) {
+        shadow->stats.local_queries++;
+        complete_locally(shadow, view.leds, callback, user_data);
+        return SERIAL_SUCCESS;
+    }
+    if (serial_led_state_is_noop(&view, cmd, payload, length)) {
+        shadow->stats.elided++;
+        complete_locally(shadow, view.leds, callback, user_data);
+        return SERIAL_SUCCESS;
+    }
+
+    /* An entry outlives its client slot only until the callback runs, so this wait is rare */
+    struct shadow_entry_s *entry = &shadow->entries[shadow->next_index % SHADOW_ENTRIES];
+    while (entry->active) {
+        int result = serial_client_poll(shadow->client, SERIAL_CLIENT_DEFAULT_TIMEOUT_MS);
+        if (result < 0) {
+            return result;
+        }
+    }
+
+    /* Registered before submitting: a full window dispatches older replies, which replay this entry */
+    entry->shadow = shadow;
+    entry->active = 1;
+    entry->index = shadow->next_index++;
+    entry->cmd = cmd;
+    entry->length = (uint8_t)length;
+    if (length > 0) {
+        memcpy(entry->payload, payload, length);
+    }
+    entry->callback = callback;
+    entry->user_data = user_data;
+    serial_led_state_apply(&shadow->predicted, cmd, payload, length);
+    entry->expected = shadow->predicted;
+
+    int result = serial_client_submit(shadow->client, cmd, payload, length, on_reply, entry);
+    if (result != SERIAL_SUCCESS) {
+        /* The frame may have gone out in part */
+        entry->active = 0;
+        serial_shadow_invalidate(shadow);
+        return result;
+    }
+    shadow->stats.sent++;
+    return SERIAL_SUCCESS;
+}
+
+void serial_shadow_invalidate(serial_shadow_t *shadow) {
+    if (!shadow) {
+        return;
+    }
+    shadow->predicted.known = 0;
+    shadow->stats.invalidations++;
+}
+
+void serial_shadow_get_state(const serial_shadow_t *shadow, struct serial_led_state_s *state) {
+    if (shadow && state) {
+        *state = shadow->predicted;
+    }
+}
+
+void serial_shadow_get_stats(const serial_shadow_t *shadow, struct serial_shadow_stats_s *stats) {
+    if (shadow && stats) {
+        *stats = shadow->stats;
+    }
+}
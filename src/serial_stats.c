@@ -0,0 +1,224 @@
+/**
+ * @file serial_stats.c
+ * @brief Latency histograms and per-handle I/O counters kept in a descriptor-indexed side table
+ */
+
+#include "serial_internal.h"
+#include "../include/serial_stats.h"
+
+#define SUB_BUCKETS (1u << SERIAL_HISTOGRAM_SUB_BITS)
+
+/* Values below SUB_BUCKETS get a bucket each, then SUB_BUCKETS per power of two */
+static unsigned bucket_index(uint64_t value) {
+    if (value < SUB_BUCKETS) {
+        return (unsigned)value;
+    }
+    unsigned exponent = 63u - (unsigned)__builtin_clzll(value);
+    unsigned shift = exponent - SERIAL_HISTOGRAM_SUB_BITS;
+    return ((shift + 1) << SERIAL_HISTOGRAM_SUB_BITS) | (unsigned)((value >> shift) & (SUB_BUCKETS - 1));
+}
+
+/* Largest value that maps to a bucket */
+static uint64_t bucket_upper_bound(unsigned index) {
+    if (index < SUB_BUCKETS) {
+        return index;
+    }
+    unsigned shift = (index >> SERIAL_HISTOGRAM_SUB_BITS) - 1;
+    uint64_t lower = (uint64_t)(SUB_BUCKETS + (index & (SUB_BUCKETS - 1))) << shift;
+    return lower + (((uint64_t)1 << shift) - 1);
+}
+
+void serial_histogram_record(struct serial_histogram_s *histogram, uint64_t value_ns) {
+    histogram->counts[bucket_index(value_ns)]++;
+    histogram->count++;
+    histogram->sum_ns += value_ns;
+    if (value_ns > histogram->max_ns) {
+        histogram->max_ns = value_ns;
+    }
+}
+
+uint64_t serial_histogram_quantile(const struct serial_histogram_s *histogram, double quantile) {
+    if (!histogram || histogram->count == 0) {
+        return 0;
+    }
+    uint64_t rank = (uint64_t)(quantile * (double)histogram->count + 0.5);
+    rank = rank < 1 ? 1 : (rank > histogram->count ? histogram->count : rank);
+
+    uint64_t seen = 0;
+    for (unsigned i = 0; i < SERIAL_HISTOGRAM_BUCKETS; i++) {
+        seen += histogram->counts[i];
+        if (seen >= rank) {
+            uint64_t bound = bucket_upper_bound(i);
+            return bound < histogram->max_ns ? bound : histogram->max_ns;
+        }
+    }
+    return histogram->max_ns;
+}
+
+#if defined(__linux__)
+
+#include <errno.h>
+#include <stdalign.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Descriptors at or above this value cannot collect statistics */
+#define SERIAL_STATS_MAX_FD 4096
+
+/* Read and write sides are updated by different threads, keep them apart */
+struct serial_stats_block_s {
+    alignas(64) atomic_uint_fast64_t bytes_read;
+    atomic_uint_fast64_t read_syscalls;
+    atomic_uint_fast64_t read_eagain;
+    atomic_uint_fast64_t read_errors;
+
+    alignas(64) atomic_uint_fast64_t bytes_written;
+    atomic_uint_fast64_t write_syscalls;
+    atomic_uint_fast64_t write_eagain;
+    atomic_uint_fast64_t short_writes;
+    atomic_uint_fast64_t write_errors;
+    atomic_uint_fast64_t sent_at_ns;        /* first write since data was last received, 0 if none */
+
+    alignas(64) atomic_uint_fast64_t latency_sum_ns;
+    atomic_uint_fast64_t latency_max_ns;
+    atomic_uint_fast64_t latency_buckets[SERIAL_HISTOGRAM_BUCKETS];
+};
+
+/*
+ * stats_table holds the blocks being updated. A block stays in stats_blocks
+ * from its first serial_enable_stats() until serial_close(), so I/O that
+ * looked it up just before serial_disable_stats() never touches freed memory.
+ */
+static _Atomic(struct serial_stats_block_s *) stats_table[SERIAL_STATS_MAX_FD];
+static _Atomic(struct serial_stats_block_s *) stats_blocks[SERIAL_STATS_MAX_FD];
+
+struct serial_stats_block_s *serial_stats_lookup(serial_handle_t handle) {
+    if (handle < 0 || handle >= SERIAL_STATS_MAX_FD) {
+        return NULL;
+    }
+    return atomic_load_explicit(&stats_table[handle], memory_order_acquire);
+}
+
+static void add(atomic_uint_fast64_t *counter, uint64_t value) {
+    atomic_fetch_add_explicit(counter, value, memory_order_relaxed);
+}
+
+static uint64_t load(const atomic_uint_fast64_t *counter) {
+    return atomic_load_explicit((atomic_uint_fast64_t *)counter, memory_order_relaxed);
+}
+
+static void record_latency(struct serial_stats_block_s *stats, uint64_t latency_ns) {
+    add(&stats->latency_buckets[bucket_index(latency_ns)], 1);
+    add(&stats->latency_sum_ns, latency_ns);
+    uint_fast64_t max = load(&stats->latency_max_ns);
+    while (latency_ns > max &&
+           !atomic_compare_exchange_weak_explicit(&stats->latency_max_ns, &max, latency_ns,
+                                                  memory_order_relaxed, memory_order_relaxed)) {
+    }
+}
+
+void serial_stats_read_syscall(struct serial_stats_block_s *stats, ssize_t result, int error) {
+    add(&stats->read_syscalls, 1);
+    if (result > 0) {
+        add(&stats->bytes_read, (uint64_t)result);
+    } else if (result < 0 && error == EAGAIN) {
+        add(&stats->read_eagain, 1);
+    } else if (result < 0 && error != EINTR) {
+        add(&stats->read_errors, 1);
+    }
+}
+
+void serial_stats_write_syscall(struct serial_stats_block_s *stats, ssize_t result, size_t requested, int error) {
+    add(&stats->write_syscalls, 1);
+    if (result >= 0) {
+        add(&stats->bytes_written, (uint64_t)result);
+        if ((size_t)result < requested) {
+            add(&stats->short_writes, 1);
+        }
+    } else if (error == EAGAIN) {
+        add(&stats->write_eagain, 1);
+    } else if (error != EINTR) {
+        add(&stats->write_errors, 1);
+    }
+}
+
+void serial_stats_sent(struct serial_stats_block_s *stats) {
+    if (load(&stats->sent_at_ns) == 0) {
+        uint_fast64_t expected = 0;
+        atomic_compare_exchange_strong_explicit(&stats->sent_at_ns, &expected, serial_monotonic_ns(),
+                                                memory_order_relaxed, memory_order_relaxed);
+    }
+}
+
+void serial_stats_received(struct serial_stats_block_s *stats) {
+    if (load(&stats->sent_at_ns) != 0) {
+        uint64_t sent_at = atomic_exchange_explicit(&stats->sent_at_ns, 0, memory_order_relaxed);
+        if (sent_at != 0) {
+            record_latency(stats, serial_monotonic_ns() - sent_at);
+        }
+    }
+}
+
+int serial_enable_stats(serial_handle_t handle) {
+    if (handle < 0 || handle >= SERIAL_STATS_MAX_FD) {
+        return SERIAL_ERROR_INVALID_HANDLE;
+    }
+    size_t size = (sizeof(struct serial_stats_block_s) + 63u) & ~(size_t)63u;
+    struct serial_stats_block_s *stats = atomic_load(&stats_blocks[handle]);
+    if (!stats) {
+        stats = aligned_alloc(64, size);
+        if (!stats) {
+            return SERIAL_ERROR_CONFIG;
+        }
+        atomic_store(&stats_blocks[handle], stats);
+    }
+    atomic_store(&stats_table[handle], NULL);
+    memset(stats, 0, size);
+    atomic_store_explicit(&stats_table[handle], stats, memory_order_release);
+    return SERIAL_SUCCESS;
+}
+
+int serial_disable_stats(serial_handle_t handle) {
+    if (handle < 0 || handle >= SERIAL_STATS_MAX_FD) {
+        return SERIAL_ERROR_INVALID_HANDLE;
+    }
+    atomic_store(&stats_table[handle], NULL);
+    return SERIAL_SUCCESS;
+}
+
+void serial_stats_release(serial_handle_t handle) {
+    if (handle >= 0 && handle < SERIAL_STATS_MAX_FD) {
+        atomic_store(&stats_table[handle], NULL);
+        free(atomic_exchange(&stats_blocks[handle], NULL));
+    }
+}
+
+int serial_get_stats(serial_handle_t handle, struct serial_stats_s *snapshot) {
+    struct serial_stats_block_s *stats = serial_stats_lookup(handle);
+    if (!stats || !snapshot) {
+        return SERIAL_ERROR_INVALID_HANDLE;
+    }
+
+    snapshot->bytes_read = load(&stats->bytes_read);
+    snapshot->bytes_written = load(&stats->bytes_written);
+    snapshot->read_syscalls = load(&stats->read_syscalls);
+    snapshot->write_syscalls = load(&stats->write_syscalls);
+    snapshot->read_eagain = load(&stats->read_eagain);
+    snapshot->write_eagain = load(&stats->write_eagain);
+    snapshot->short_writes = load(&stats->short_writes);
+    snapshot->read_errors = load(&stats->read_errors);
+    snapshot->write_errors = load(&stats->write_errors);
+
+    struct serial_histogram_s *histogram = &snapshot->first_byte_latency;
+    histogram->count = 0;
+    for (unsigned i = 0; i < SERIAL_HISTOGRAM_BUCKETS; i++) {
+        histogram->counts[i] = load(&stats->latency_buckets[i]);
+        histogram->count += histogram->counts[i];
+    }
+    histogram->sum_ns = load(&stats->latency_sum_ns);
+    histogram->max_ns = load(&stats->latency_max_ns);
+    return SERIAL_SUCCESS;
+}
+
+#endif /* __linux__ */
@@ -0,0 +1,687 @@
+/**
+ * @file serial_telemetry.c
+ * @brief Columnar sample logs in shared file mappings, fed by a reader and a parser thread
+ *
+ * The reader thread runs a reactor over the ports and reads each one into
+ * the free region of its ring. It wakes the parser through an eventfd only
+ * when the parser has said it is about to sleep, so a busy pipeline makes
+ * one read() per port per readiness and no other system calls. A port whose
+ * ring is full is paused: the reader stops polling it until the parser has
+ * drained the ring to half and asks for it to be resumed.
+ */
+
+#include "serial_internal.h"
+#include "../include/serial_telemetry.h"
+#include "../include/serial_reactor.h"
+#include "../include/serial_ring.h"
+#include "../include/serial_rt.h"
+
+#if defined(__linux__)
+
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/* Larger logs are refused rather than risking size overflow */
+#define TELEMETRY_MAX_CAPACITY (1ull << 40)
+
+struct serial_telemetry_log_s {
+    char *map;
+    size_t size;
+    int writable;
+    struct serial_telemetry_header_s *header;
+    uint64_t *times;
+    uint64_t synced_rows;       /* rows covered by the last sync */
+    int header_synced;
+    uint32_t last_time_us;      /* for widening the device time */
+    uint64_t time_high;
+    uint64_t group_time;
+    unsigned pending;           /* samples in the current decimation group */
+    int64_t *group;             /* per-channel sum, minimum, maximum or last value */
+};
+
+static uint64_t align_up(uint64_t value) {
+    return (value + SERIAL_TELEMETRY_ALIGN - 1) & ~(uint64_t)(SERIAL_TELEMETRY_ALIGN - 1);
+}
+
+static int16_t *column(const serial_telemetry_log_t *log, unsigned channel) {
+    return (int16_t *)(log->map + log->header->column_offset + channel * log->header->column_stride);
+}
+
+serial_telemetry_log_t *serial_telemetry_log_create(const char *path,
+                                                    const struct serial_telemetry_log_config_s *config) {
+    if (!path || !config || config->channels < 1 || config->channels > SERIAL_TELEMETRY_MAX_CHANNELS ||
+        config->capacity < 1 || config->capacity > TELEMETRY_MAX_CAPACITY ||
+        config->aggregate < SERIAL_TELEMETRY_LAST || config->aggregate > SERIAL_TELEMETRY_MAX) {
+        return NULL;
+    }
+    uint64_t time_offset = align_up(sizeof(struct serial_telemetry_header_s));
+    uint64_t column_offset = time_offset + align_up(config->capacity * sizeof(uint64_t));
+    uint64_t column_stride = align_up(config->capacity * sizeof(int16_t));
+    uint64_t size = column_offset + config->channels * column_stride;
+
+    serial_telemetry_log_t *log = calloc(1, sizeof(*log));
+    int64_t *group = calloc(config->channels, sizeof(*group));
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    int allocated = fd >= 0 && ftruncate(fd, (off_t)size) == 0;
+    if (allocated) {
+        /* Reserve the blocks now; file systems without fallocate() fill holes on first write */
+        int result = posix_fallocate(fd, 0, (off_t)size);
+        allocated = result == 0 || result == EOPNOTSUPP || result == EINVAL;
+    }
+    void *map = allocated ? mmap(NULL, (size_t)size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+    if (fd >= 0) {
+        close(fd);
+    }
+    if (!log || !group || map == MAP_FAILED) {
+        if (map != MAP_FAILED) {
+            munmap(map, (size_t)size);
+        }
+        if (fd >= 0) {
+            unlink(path);
+        }
+        free(group);
+        free(log);
+        return NULL;
+    }
+
+    log->map = map;
+    log->size = (size_t)size;
+    log->writable = 1;
+    log->group = group;
+    log->header = map;
+    log->times = (uint64_t *)(log->map + time_offset);
+    *log->header = (struct serial_telemetry_header_s){
+        .magic = SERIAL_TELEMETRY_MAGIC,
+        .version = SERIAL_TELEMETRY_VERSION,
+        .channels = config->channels,
+        .capacity = config->capacity,
+        .decimation = config->decimation > 1 ? config->decimation : 1,
+        .aggregate = (uint32_t)config->aggregate,
+        .time_offset = time_offset,
+        .column_offset = column_offset,
+        .column_stride = column_stride,
+    };
+    return log;
+}
+
+/*
+ * Checks that every column lies inside the file and is aligned for its type.
+ * Products are bounded before they are formed: capacity by
+ * TELEMETRY_MAX_CAPACITY, the channel columns by dividing the room left.
+ */
+static int header_valid(const struct serial_telemetry_header_s *header, uint64_t size) {
+    if (memcmp(header->magic, SERIAL_TELEMETRY_MAGIC, sizeof(header->magic)) != 0 ||
+        header->version != SERIAL_TELEMETRY_VERSION || header->channels < 1 ||
+        header->channels > SERIAL_TELEMETRY_MAX_CHANNELS || header->capacity > TELEMETRY_MAX_CAPACITY ||
+        header->rows > header->capacity) {
+        return 0;
+    }
+    if (header->time_offset % sizeof(uint64_t) != 0 || header->column_offset % sizeof(int16_t) != 0 ||
+        header->column_stride % sizeof(int16_t) != 0) {
+        return 0;
+    }
+    return header->time_offset <= size && header->capacity * sizeof(uint64_t) <= size - header->time_offset &&
+           header->column_stride >= header->capacity * sizeof(int16_t) && header->column_offset <= size &&
+           header->column_stride <= (size - header->column_offset) / header->channels;
+}
+
+serial_telemetry_log_t *serial_telemetry_log_open(const char *path) {
+    if (!path) {
+        return NULL;
+    }
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return NULL;
+    }
+    struct stat st;
+    const struct serial_telemetry_header_s *header = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(*header)) {
+        header = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if (header == MAP_FAILED) {
+        return NULL;
+    }
+
+    uint64_t size = (uint64_t)st.st_size;
+    serial_telemetry_log_t *log = NULL;
+    if (header_valid(header, size)) {
+        log = calloc(1, sizeof(*log));
+    }
+    if (!log) {
+        munmap((void *)header, (size_t)size);
+        return NULL;
+    }
+    log->map = (char *)header;
+    log->size = (size_t)size;
+    log->header = (struct serial_telemetry_header_s *)header;
+    log->times = (uint64_t *)(log->map + header->time_offset);
+    return log;
+}
+
+/* Publishes a row; the row count is stored last so a concurrent reader never sees a partial row */
+static void write_row(serial_telemetry_log_t *log, uint64_t time_us, unsigned count) {
+    struct serial_telemetry_header_s *header = log->header;
+    uint64_t row = header->rows;
+    log->times[row] = time_us;
+    for (unsigned c = 0; c < header->channels; c++) {
+        int64_t value = log->group[c];
+        column(log, c)[row] = (int16_t)(header->aggregate == SERIAL_TELEMETRY_MEAN ? value / (int64_t)count : value);
+    }
+    atomic_thread_fence(memory_order_release);
+    header->rows = row + 1;
+}
+
+int serial_telemetry_log_append(serial_telemetry_log_t *log, uint32_t time_us, const int16_t *values) {
+    struct serial_telemetry_header_s *header = log->header;
+    if (header->rows >= header->capacity) {
+        return SERIAL_ERROR_OVERFLOW;
+    }
+    if (time_us < log->last_time_us) {
+        log->time_high += 1ull << 32;
+    }
+    log->last_time_us = time_us;
+    log->group_time = log->time_high | time_us;
+
+    int first = log->pending == 0;
+    for (unsigned c = 0; c < header->channels; c++) {
+        int64_t value = values[c];
+        int64_t *slot = &log->group[c];
+        switch (header->aggregate) {
+        case SERIAL_TELEMETRY_MEAN:
+            *slot = first ? value : *slot + value;
+            break;
+        case SERIAL_TELEMETRY_MIN:
+            *slot = first || value < *slot ? value : *slot;
+            break;
+        case SERIAL_TELEMETRY_MAX:
+            *slot = first || value > *slot ? value : *slot;
+            break;
+        default:
+            *slot = value;
+            break;
+        }
+    }
+    if (++log->pending == header->decimation) {
+        write_row(log, log->group_time, log->pending);
+        log->pending = 0;
+    }
+    return SERIAL_SUCCESS;
+}
+
+/* Flushes the pages holding one column's elements [from, to) */
+static int sync_range(const serial_telemetry_log_t *log, uint64_t offset, uint64_t from, uint64_t to, size_t element) {
+    uint64_t page = (uint64_t)sysconf(_SC_PAGESIZE);
+    uint64_t start = (offset + from * element) & ~(page - 1);
+    uint64_t end = offset + to * element;
+    return msync(log->map + start, (size_t)(end - start), MS_SYNC);
+}
+
+int serial_telemetry_log_sync(serial_telemetry_log_t *log) {
+    if (!log || !log->writable) {
+        return SERIAL_ERROR_INVALID_HANDLE;
+    }
+    const struct serial_telemetry_header_s *header = log->header;
+    uint64_t rows = header->rows;
+    if (rows == log->synced_rows && log->header_synced) {
+        return SERIAL_SUCCESS;
+    }
+    int failed = 0;
+    if (rows > log->synced_rows) {
+        failed |= sync_range(log, header->time_offset, log->synced_rows, rows, sizeof(uint64_t));
+        for (unsigned c = 0; c < header->channels; c++) {
+            failed |= sync_range(log, header->column_offset + c * header->column_stride, log->synced_rows, rows,
+                                 sizeof(int16_t));
+        }
+    }
+    /* The row count goes to disk after the rows it covers */
+    failed |= msync(log->map, sizeof(*header), MS_SYNC);
+    if (failed) {
+        return SERIAL_ERROR_WRITE;
+    }
+    log->synced_rows = rows;
+    log->header_synced = 1;
+    return SERIAL_SUCCESS;
+}
+
+int serial_telemetry_log_close(serial_telemetry_log_t *log) {
+    if (!log) {
+        return SERIAL_SUCCESS;
+    }
+    int result = SERIAL_SUCCESS;
+    if (log->writable) {
+        if (log->pending > 0 && log->header->rows < log->header->capacity) {
+            write_row(log, log->group_time, log->pending);
+        }
+        result = serial_telemetry_log_sync(log);
+    }
+    munmap(log->map, log->size);
+    free(log->group);
+    free(log);
+    return result;
+}
+
+const struct serial_telemetry_header_s *serial_telemetry_log_header(const serial_telemetry_log_t *log) {
+    return log->header;
+}
+
+const uint64_t *serial_telemetry_log_times(const serial_telemetry_log_t *log) {
+    return log->times;
+}
+
+const int16_t *serial_telemetry_log_column(const serial_telemetry_log_t *log, unsigned channel) {
+    return channel < log->header->channels ? column(log, channel) : NULL;
+}
+
+int serial_telemetry_encode(uint8_t seq, uint32_t time_us, const int16_t *values, unsigned channels, uint8_t *out,
+                            size_t out_size, size_t *out_length) {
+    if (!values || channels < 1 || channels > SERIAL_TELEMETRY_MAX_CHANNELS) {
+        return SERIAL_ERROR_CONFIG;
+    }
+    uint8_t payload[SERIAL_FRAME_MAX_PAYLOAD];
+    for (int i = 0; i < 4; i++) {
+        payload[i] = (uint8_t)(time_us >> (8 * i));
+    }
+    for (unsigned c = 0; c < channels; c++) {
+        uint16_t value = (uint16_t)values[c];
+        payload[4 + 2 * c] = (uint8_t)value;
+        payload[5 + 2 * c] = (uint8_t)(value >> 8);
+    }
+    return serial_frame_encode(seq, SERIAL_CMD_SAMPLES, payload, 4 + 2 * (size_t)channels, out, out_size, out_length);
+}
+
+struct telemetry_port_s {
+    serial_telemetry_t *telemetry;
+    serial_handle_t handle;
+    serial_telemetry_log_t *log;
+    serial_ring_t *ring;
+    struct serial_frame_decoder_s decoder;      /* parser thread only */
+    atomic_int paused;                          /* not polled until the ring is half empty */
+    atomic_uint_fast64_t bytes;
+    atomic_uint_fast64_t pauses;
+    atomic_uint_fast64_t samples;
+    atomic_uint_fast64_t rows;
+    atomic_uint_fast64_t full;
+    atomic_uint_fast64_t bad_frames;
+    atomic_uint_fast64_t other_frames;
+};
+
+struct serial_telemetry_s {
+    struct telemetry_port_s **ports;
+    size_t count;
+    size_t ring_size;
+    int sync_ms;
+    int use_rt;
+    struct serial_rt_config_s rt;
+    serial_reactor_t *reactor;
+    int stop_fd;                /* tells the reader to return */
+    int resume_fd;              /* tells the reader to resume paused ports */
+    int wake_fd;                /* wakes the sleeping parser */
+    pthread_t reader;
+    pthread_t parser;
+    int running;
+    int reader_stopped;         /* reader thread only */
+    int reader_pending;         /* reader thread only: bytes committed since the parser was last woken */
+    atomic_int parser_idle;     /* the parser is about to sleep on wake_fd */
+    atomic_int parser_stop;
+    atomic_int sync_failed;
+    atomic_uint_fast64_t syncs;
+};
+
+static void signal_fd(int fd) {
+    uint64_t one = 1;
+    ssize_t written = write(fd, &one, sizeof(one));
+    (void)written;
+}
+
+static void clear_fd(int fd) {
+    uint64_t value;
+    ssize_t count = read(fd, &value, sizeof(value));
+    (void)count;
+}
+
+static int half_empty(const struct telemetry_port_s *port) {
+    return serial_ring_used(port->ring) <= serial_ring_capacity(port->ring) / 2;
+}
+
+static void on_port_readable(serial_reactor_t *reactor, serial_handle_t handle, void *user_data) {
+    struct telemetry_port_s *port = user_data;
+    void *region;
+    size_t space = serial_ring_reserve(port->ring, &region);
+    size_t count = 0;
+    if (space == 0) {
+        /* The parser is a whole ring behind: leave the bytes in the driver until it catches up */
+        serial_reactor_set_events(reactor, handle, 0);
+        atomic_store(&port->paused, 1);
+        atomic_fetch_add_explicit(&port->pauses, 1, memory_order_relaxed);
+        port->telemetry->reader_pending = 1;
+        if (half_empty(port)) {
+            atomic_store(&port->paused, 0);     /* drained before it could see the flag */
+            serial_reactor_set_events(reactor, handle, SERIAL_REACTOR_READ);
+        }
+        return;
+    }
+    if (serial_read(handle, region, space, &count) != SERIAL_SUCCESS) {
+        serial_reactor_remove(reactor, handle);
+        return;
+    }
+    if (count > 0) {
+        serial_ring_commit(port->ring, count);
+        atomic_fetch_add_explicit(&port->bytes, count, memory_order_relaxed);
+        port->telemetry->reader_pending = 1;
+    }
+}
+
+static void on_stop(serial_reactor_t *reactor, serial_handle_t handle, void *user_data) {
+    serial_telemetry_t *telemetry = user_data;
+    (void)reactor;
+    clear_fd(handle);
+    telemetry->reader_stopped = 1;
+}
+
+static void on_resume(serial_reactor_t *reactor, serial_handle_t handle, void *user_data) {
+    serial_telemetry_t *telemetry = user_data;
+    clear_fd(handle);
+    for (size_t i = 0; i < telemetry->count; i++) {
+        struct telemetry_port_s *port = telemetry->ports[i];
+        if (atomic_load(&port->paused) && half_empty(port)) {
+            atomic_store(&port->paused, 0);
+            serial_reactor_set_events(reactor, port->handle, SERIAL_REACTOR_READ);
+        }
+    }
+}
+
+static const struct serial_reactor_ops_s PORT_OPS = { .on_readable = on_port_readable };
+static const struct serial_reactor_ops_s STOP_OPS = { .on_readable = on_stop };
+static const struct serial_reactor_ops_s RESUME_OPS = { .on_readable = on_resume };
+
+static void *reader_main(void *arg) {
+    serial_telemetry_t *telemetry = arg;
+    if (telemetry->use_rt) {
+        serial_rt_apply(&telemetry->rt, NULL);
+    }
+    while (!telemetry->reader_stopped) {
+        if (serial_reactor_run_once(telemetry->reactor, -1) < 0) {
+            break;
+        }
+        if (telemetry->reader_pending) {
+            telemetry->reader_pending = 0;
+            /* Pairs with the fence in parser_main: either it sees the bytes or we see it idle */
+            atomic_thread_fence(memory_order_seq_cst);
+            if (atomic_exchange(&telemetry->parser_idle, 0)) {
+                signal_fd(telemetry->wake_fd);
+            }
+        }
+    }
+    return NULL;
+}
+
+/* Decodes one contiguous region of a port's ring; returns 1 if there was anything to parse */
+static int parse_port(struct telemetry_port_s *port) {
+    const void *region;
+    size_t size = serial_ring_peek(port->ring, &region);
+    if (size == 0) {
+        return 0;
+    }
+    const uint8_t *data = region;
+    const struct serial_telemetry_header_s *header = serial_telemetry_log_header(port->log);
+    size_t expected = 4 + 2 * (size_t)header->channels;
+    uint64_t rows_before = header->rows;
+    uint32_t errors_before = port->decoder.errors;
+    uint64_t samples = 0, full = 0, bad = 0, other = 0;
+    int16_t values[SERIAL_TELEMETRY_MAX_CHANNELS];
+    struct serial_frame_s frame;
+
+    for (size_t offset = 0; offset < size;) {
+        int ready;
+        offset += serial_frame_decode(&port->decoder, data + offset, size - offset, &frame, &ready);
+        if (!ready) {
+            continue;
+        }
+        if (frame.cmd != SERIAL_CMD_SAMPLES) {
+            other++;
+            continue;
+        }
+        if (frame.length != expected) {
+            bad++;
+            continue;
+        }
+        const uint8_t *p = frame.payload;
+        uint32_t time_us = (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+        for (unsigned c = 0; c < header->channels; c++) {
+            values[c] = (int16_t)(uint16_t)(p[4 + 2 * c] | p[5 + 2 * c] << 8);
+        }
+        samples++;
+        full += serial_telemetry_log_append(port->log, time_us, values) != SERIAL_SUCCESS;
+    }
+    serial_ring_consume(port->ring, size);
+    if (atomic_load(&port->paused) && half_empty(port)) {
+        signal_fd(port->telemetry->resume_fd);
+    }
+
+    atomic_fetch_add_explicit(&port->samples, samples, memory_order_relaxed);
+    atomic_fetch_add_explicit(&port->rows, header->rows - rows_before, memory_order_relaxed);
+    atomic_fetch_add_explicit(&port->full, full, memory_order_relaxed);
+    atomic_fetch_add_explicit(&port->bad_frames, bad + (uint32_t)(port->decoder.errors - errors_before),
+                              memory_order_relaxed);
+    atomic_fetch_add_explicit(&port->other_frames, other, memory_order_relaxed);
+    return 1;
+}
+
+static void sync_logs(serial_telemetry_t *telemetry) {
+    for (size_t i = 0; i < telemetry->count; i++) {
+        if (serial_telemetry_log_sync(telemetry->ports[i]->log) != SERIAL_SUCCESS) {
+            atomic_store(&telemetry->sync_failed, 1);
+        }
+    }
+}
+
+static void *parser_main(void *arg) {
+    serial_telemetry_t *telemetry = arg;
+    uint64_t next_sync_ms = telemetry->sync_ms > 0 ? serial_monotonic_ms() + (uint64_t)telemetry->sync_ms : UINT64_MAX;
+    for (;;) {
+        int busy = 0;
+        for (size_t i = 0; i < telemetry->count; i++) {
+            busy |= parse_port(telemetry->ports[i]);
+        }
+        uint64_t now_ms = serial_monotonic_ms();
+        if (now_ms >= next_sync_ms) {
+            sync_logs(telemetry);
+            atomic_fetch_add_explicit(&telemetry->syncs, 1, memory_order_relaxed);
+            next_sync_ms = now_ms + (uint64_t)telemetry->sync_ms;
+        }
+        if (busy) {
+            continue;
+        }
+        if (atomic_load(&telemetry->parser_stop)) {
+            break;                      /* the reader has returned and the rings are empty */
+        }
+
+        atomic_store(&telemetry->parser_idle, 1);
+        atomic_thread_fence(memory_order_seq_cst);
+        int empty = 1;
+        for (size_t i = 0; i < telemetry->count && empty; i++) {
+            empty = serial_ring_used(telemetry->ports[i]->ring) == 0;
+        }
+        if (!empty) {
+            atomic_store(&telemetry->parser_idle, 0);
+            continue;
+        }
+        struct pollfd pfd = { .fd = telemetry->wake_fd, .events = POLLIN };
+        int wait_ms = next_sync_ms == UINT64_MAX ? -1 : (int)(next_sync_ms - now_ms);
+        if (poll(&pfd, 1, wait_ms) > 0) {
+            clear_fd(telemetry->wake_fd);
+        }
+        atomic_store(&telemetry->parser_idle, 0);
+    }
+    return NULL;
+}
+
+serial_telemetry_t *serial_telemetry_create(const struct serial_telemetry_config_s *config) {
+    if (config && config->rt && !serial_rt_valid(config->rt)) {
+        return NULL;
+    }
+    serial_telemetry_t *telemetry = calloc(1, sizeof(*telemetry));
+    if (!telemetry) {
+        return NULL;
+    }
+    telemetry->ring_size = config && config->ring_size ? config->ring_size : SERIAL_TELEMETRY_DEFAULT_RING;
+    telemetry->sync_ms = config && config->sync_ms ? config->sync_ms : SERIAL_TELEMETRY_DEFAULT_SYNC_MS;
+    if (config && config->rt) {
+        telemetry->use_rt = 1;
+        telemetry->rt = *config->rt;
+    }
+    telemetry->reactor = serial_reactor_create();
+    telemetry->stop_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    telemetry->resume_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    telemetry->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (!telemetry->reactor || telemetry->stop_fd < 0 || telemetry->resume_fd < 0 || telemetry->wake_fd < 0 ||
+        serial_reactor_add(telemetry->reactor, telemetry->stop_fd, SERIAL_REACTOR_READ, &STOP_OPS, telemetry) !=
+            SERIAL_SUCCESS ||
+        serial_reactor_add(telemetry->reactor, telemetry->resume_fd, SERIAL_REACTOR_READ, &RESUME_OPS, telemetry) !=
+            SERIAL_SUCCESS) {
+        if (telemetry->stop_fd >= 0) {
+            close(telemetry->stop_fd);
+        }
+        if (telemetry->resume_fd >= 0) {
+            close(telemetry->resume_fd);
+        }
+        if (telemetry->wake_fd >= 0) {
+            close(telemetry->wake_fd);
+        }
+        serial_reactor_destroy(telemetry->reactor);
+        free(telemetry);
+        return NULL;
+    }
+    atomic_init(&telemetry->parser_idle, 0);
+    atomic_init(&telemetry->parser_stop, 0);
+    atomic_init(&telemetry->sync_failed, 0);
+    atomic_init(&telemetry->syncs, 0);
+    return telemetry;
+}
+
+void serial_telemetry_destroy(serial_telemetry_t *telemetry) {
+    if (!telemetry) {
+        return;
+    }
+    serial_telemetry_stop(telemetry);
+    for (size_t i = 0; i < telemetry->count; i++) {
+        serial_ring_destroy(telemetry->ports[i]->ring);
+        free(telemetry->ports[i]);
+    }
+    free(telemetry->ports);
+    serial_reactor_destroy(telemetry->reactor);
+    close(telemetry->stop_fd);
+    close(telemetry->resume_fd);
+    close(telemetry->wake_fd);
+    free(telemetry);
+}
+
+int serial_telemetry_add(serial_telemetry_t *telemetry, serial_handle_t handle, serial_telemetry_log_t *log) {
+    if (!telemetry || handle == SERIAL_INVALID_HANDLE || !log || !log->writable) {
+        return SERIAL_ERROR_INVALID_HANDLE;
+    }
+    if (telemetry->running || serial_buffered_lookup(handle)) {
+        return SERIAL_ERROR_CONFIG;
+    }
+    struct telemetry_port_s **ports = realloc(telemetry->ports, (telemetry->count + 1) * sizeof(*ports));
+    if (!ports) {
+        return SERIAL_ERROR_CONFIG;
+    }
+    telemetry->ports = ports;
+    struct telemetry_port_s *port = calloc(1, sizeof(*port));
+    serial_ring_t *ring = port ? serial_ring_create(telemetry->ring_size) : NULL;
+    if (!ring) {
+        free(port);
+        return SERIAL_ERROR_CONFIG;
+    }
+    port->telemetry = telemetry;
+    port->handle = handle;
+    port->log = log;
+    port->ring = ring;
+    serial_frame_decoder_init(&port->decoder);
+    int result = serial_reactor_add(telemetry->reactor, handle, SERIAL_REACTOR_READ, &PORT_OPS, port);
+    if (result != SERIAL_SUCCESS) {
+        serial_ring_destroy(ring);
+        free(port);
+        return result;
+    }
+    if (telemetry->use_rt && telemetry->rt.lock_memory) {
+        serial_rt_prefault(serial_ring_storage(ring), serial_ring_capacity(ring));
+    }
+    ports[telemetry->count++] = port;
+    return SERIAL_SUCCESS;
+}
+
+int serial_telemetry_start(serial_telemetry_t *telemetry) {
+    if (!telemetry) {
+        return SERIAL_ERROR_INVALID_HANDLE;
+    }
+    if (telemetry->running) {
+        return SERIAL_SUCCESS;
+    }
+    telemetry->reader_stopped = 0;
+    atomic_store(&telemetry->parser_stop, 0);
+    for (size_t i = 0; i < telemetry->count; i++) {
+        if (atomic_exchange(&telemetry->ports[i]->paused, 0)) {
+            serial_reactor_set_events(telemetry->reactor, telemetry->ports[i]->handle, SERIAL_REACTOR_READ);
+        }
+    }
+    if (pthread_create(&telemetry->parser, NULL, parser_main, telemetry) != 0) {
+        return SERIAL_ERROR_CONFIG;
+    }
+    if (pthread_create(&telemetry->reader, NULL, reader_main, telemetry) != 0) {
+        atomic_store(&telemetry->parser_stop, 1);
+        signal_fd(telemetry->wake_fd);
+        pthread_join(telemetry->parser, NULL);
+        clear_fd(telemetry->wake_fd);
+        return SERIAL_ERROR_CONFIG;
+    }
+    telemetry->running = 1;
+    return SERIAL_SUCCESS;
+}
+
+int serial_telemetry_stop(serial_telemetry_t *telemetry) {
+    if (!telemetry) {
+        return SERIAL_ERROR_INVALID_HANDLE;
+    }
+    if (!telemetry->running) {
+        return SERIAL_SUCCESS;
+    }
+    signal_fd(telemetry->stop_fd);
+    pthread_join(telemetry->reader, NULL);
+    atomic_store(&telemetry->parser_stop, 1);
+    signal_fd(telemetry->wake_fd);
+    pthread_join(telemetry->parser, NULL);
+    clear_fd(telemetry->wake_fd);
+    telemetry->running = 0;
+
+    sync_logs(telemetry);
+    return atomic_exchange(&telemetry->sync_failed, 0) ? SERIAL_ERROR_WRITE : SERIAL_SUCCESS;
+}
+
+void serial_telemetry_stats(const serial_telemetry_t *telemetry, struct serial_telemetry_stats_s *stats) {
+    memset(stats, 0, sizeof(*stats));
+    for (size_t i = 0; i < telemetry->count; i++) {
+        struct telemetry_port_s *port = telemetry->ports[i];
+        stats->bytes += atomic_load_explicit(&port->bytes, memory_order_relaxed);
+        stats->pauses += atomic_load_explicit(&port->pauses, memory_order_relaxed);
+        stats->samples += atomic_load_explicit(&port->samples, memory_order_relaxed);
+        stats->rows += atomic_load_explicit(&port->rows, memory_order_relaxed);
+        stats->full += atomic_load_explicit(&port->full, memory_order_relaxed);
+        stats->bad_frames += atomic_load_explicit(&port->bad_frames, memory_order_relaxed);
+        stats->other_frames += atomic_load_explicit(&port->other_frames, memory_order_relaxed);
+    }
+    stats->syncs = atomic_load_explicit(&telemetry->syncs, memory_order_relaxed);
+}
+
+#else
+typedef int serial_telemetry_unsupported_t;
+#endif
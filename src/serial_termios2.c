@@ -0,0 +1,41 @@
+/**
+ * @file serial_termios2.c
+ * @brief termios2/BOTHER helpers for non-standard baud rates on Linux
+ */
+
+#include "serial_termios2.h"
+
+#if defined(__linux__)
+
+#include <asm/termbits.h>
+#include <sys/ioctl.h>
+
+int serial_termios2_set_speed(int fd, uint32_t baud_rate) {
+    struct termios2 options;
+
+    if (ioctl(fd, TCGETS2, &options) != 0) {
+        return -1;
+    }
+
+    /* BOTHER takes the rate from c_ispeed/c_ospeed instead of the Bxxx code */
+    options.c_cflag &= ~(tcflag_t)(CBAUD | (CBAUD << IBSHIFT));
+    options.c_cflag |= BOTHER | (BOTHER << IBSHIFT);
+    options.c_ispeed = baud_rate;
+    options.c_ospeed = baud_rate;
+
+    return ioctl(fd, TCSETS2, &options) == 0 ? 0 : -1;
+}
+
+int serial_termios2_get_speed(int fd, uint32_t *baud_rate) {
+    struct termios2 options;
+
+    if (ioctl(fd, TCGETS2, &options) != 0) {
+        return -1;
+    }
+    *baud_rate = options.c_ospeed;
+    return 0;
+}
+
+#else
+typedef int serial_termios2_unsupported_t;
+#endif /* __linux__ */
@@ -0,0 +1,31 @@
+/**
+ * @file serial_termios2.h
+ * @brief Arbitrary baud rate support through the Linux termios2 interface
+ *
+ * Kept apart from serial_internal.h because <asm/termbits.h> cannot be
+ * combined with the <termios.h> pulled in by serial_functions.h.
+ * Not part of the public interface.
+ */
+
+#ifndef SERIAL_TERMIOS2_H_
+#define SERIAL_TERMIOS2_H_
+
+#include <stdint.h>
+
+#if defined(__linux__)
+
+/**
+ * @brief Sets input and output speed to any rate using BOTHER
+ * @return 0 on success, -1 on error
+ */
+int serial_termios2_set_speed(int fd, uint32_t baud_rate);
+
+/**
+ * @brief Reads back the output speed currently applied to the port
+ * @return 0 on success, -1 on error
+ */
+int serial_termios2_get_speed(int fd, uint32_t *baud_rate);
+
+#endif /* __linux__ */
+
+#endif /* SERIAL_TERMIOS2_H_ */
@@ -0,0 +1,368 @@
+/**
+ * @file serial_trace.c
+ * @brief Per-thread span buffers and the Chrome Trace Event JSON writer
+ *
+ * Only the owning thread writes a buffer: it fills the next record, then
+ * publishes it with a release store of the count, so a dump that loads the
+ * count with acquire semantics reads complete records only. Buffers are
+ * pushed onto a global list with compare-and-swap and never freed, so the
+ * spans of threads that have exited are still dumped.
+ */
+
+#include "serial_internal.h"
+#include "../include/serial_trace.h"
+
+#if defined(__linux__) && defined(SERIAL_USE_TRACE)
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+/* One span; id 0 marks a span of the recording thread, anything else an async span */
+struct trace_record_s {
+    const char *name;
+    const char *arg_name;
+    int64_t arg;
+    uint64_t start_ns;
+    uint64_t end_ns;
+    uint64_t id;
+};
+
+struct trace_buffer_s {
+    struct trace_buffer_s *next;
+    pid_t tid;
+    size_t capacity;
+    atomic_size_t count;            /* records published to dumps */
+    atomic_uint_fast64_t dropped;   /* only written by the owner */
+    struct trace_record_s records[];
+};
+
+atomic_int serial_trace_active;
+
+static atomic_size_t trace_capacity = SERIAL_TRACE_DEFAULT_CAPACITY;
+static atomic_uint_fast64_t trace_next_id = 1;
+static _Atomic(struct trace_buffer_s *) trace_buffers;
+static _Thread_local struct trace_buffer_s *thread_buffer;
+static _Thread_local int thread_buffer_failed;
+
+/* Dump destination shared by the exit handler and the signal thread */
+static pthread_mutex_t dump_lock = PTHREAD_MUTEX_INITIALIZER;
+static char dump_path[PATH_MAX];
+static int dump_pipe[2] = {-1, -1};
+static int exit_registered;
+
+/* Creates the calling thread's buffer on its first span; an allocation failure disables the thread */
+static struct trace_buffer_s *buffer_for_thread(void) {
+    struct trace_buffer_s *buffer = thread_buffer;
+    if (buffer || thread_buffer_failed) {
+        return buffer;
+    }
+    size_t capacity = atomic_load_explicit(&trace_capacity, memory_order_relaxed);
+    buffer = malloc(sizeof(*buffer) + capacity * sizeof(buffer->records[0]));
+    if (!buffer) {
+        thread_buffer_failed = 1;
+        return NULL;
+    }
+    buffer->tid = (pid_t)syscall(SYS_gettid);
+    buffer->capacity = capacity;
+    atomic_init(&buffer->count, 0);
+    atomic_init(&buffer->dropped, 0);
+    buffer->next = atomic_load_explicit(&trace_buffers, memory_order_relaxed);
+    while (!atomic_compare_exchange_weak_explicit(&trace_buffers, &buffer->next, buffer, memory_order_release,
+                                                  memory_order_relaxed)) {
+    }
+    thread_buffer = buffer;
+    return buffer;
+}
+
+static void record(const char *name, uint64_t id, uint64_t start_ns, uint64_t end_ns, const char *arg_name,
+                   int64_t arg) {
+    struct trace_buffer_s *buffer = buffer_for_thread();
+    if (!buffer) {
+        return;
+    }
+    size_t count = atomic_load_explicit(&buffer->count, memory_order_relaxed);
+    if (count == buffer->capacity) {
+        uint_fast64_t dropped = atomic_load_explicit(&buffer->dropped, memory_order_relaxed);
+        atomic_store_explicit(&buffer->dropped, dropped + 1, memory_order_relaxed);
+        return;
+    }
+    buffer->records[count] = (struct trace_record_s){
+        .name = name, .arg_name = arg_name, .arg = arg, .start_ns = start_ns, .end_ns = end_ns, .id = id
+    };
+    atomic_store_explicit(&buffer->count, count + 1, memory_order_release);
+}
+
+int serial_trace_start(size_t capacity) {
+    if (capacity == 0) {
+        capacity = SERIAL_TRACE_DEFAULT_CAPACITY;
+    }
+    if (capacity > (SIZE_MAX - sizeof(struct trace_buffer_s)) / sizeof(struct trace_record_s)) {
+        return SERIAL_ERROR_CONFIG;
+    }
+    atomic_store_explicit(&trace_capacity, capacity, memory_order_relaxed);
+    atomic_store_explicit(&serial_trace_active, 1, memory_order_relaxed);
+    return SERIAL_SUCCESS;
+}
+
+void serial_trace_stop(void) {
+    atomic_store_explicit(&serial_trace_active, 0, memory_order_relaxed);
+}
+
+int serial_trace_enabled(void) {
+    return SERIAL_TRACE_ON();
+}
+
+uint64_t serial_trace_id(void) {
+    return atomic_fetch_add_explicit(&trace_next_id, 1, memory_order_relaxed);
+}
+
+void serial_trace_span(const char *name, uint64_t start_ns, uint64_t end_ns, const char *arg_name, int64_t arg) {
+    if (SERIAL_TRACE_ON()) {
+        record(name, 0, start_ns, end_ns, arg_name, arg);
+    }
+}
+
+void serial_trace_async(const char *name, uint64_t id, uint64_t start_ns, uint64_t end_ns, const char *arg_name,
+                        int64_t arg) {
+    if (SERIAL_TRACE_ON() && id != 0) {
+        record(name, id, start_ns, end_ns, arg_name, arg);
+    }
+}
+
+/* Writes a JSON string, escaping what JSON requires */
+static void put_string(FILE *file, const char *text) {
+    fputc('"', file);
+    for (const unsigned char *p = (const unsigned char *)text; *p; p++) {
+        if (*p == '"' || *p == '\\') {
+            fprintf(file, "\\%c", *p);
+        } else if (*p < 0x20) {
+            fprintf(file, "\\u%04x", *p);
+        } else {
+            fputc(*p, file);
+        }
+    }
+    fputc('"', file);
+}
+
+/* Nanoseconds as the microseconds the format uses, keeping full precision */
+static void put_us(FILE *file, const char *key, uint64_t ns) {
+    fprintf(file, ",\"%s\":%llu.%03u", key, (unsigned long long)(ns / 1000u), (unsigned)(ns % 1000u));
+}
+
+static void put_event(FILE *file, int pid, pid_t tid, const struct trace_record_s *span, char phase,
+                      uint64_t ts_ns, int with_arg) {
+    fputs("{\"name\":", file);
+    put_string(file, span->name);
+    fprintf(file, ",\"cat\":\"serial\",\"ph\":\"%c\"", phase);
+    put_us(file, "ts", ts_ns);
+    if (phase == 'X') {
+        put_us(file, "dur", span->end_ns > span->start_ns ? span->end_ns - span->start_ns : 0);
+    } else {
+        fprintf(file, ",\"id\":\"0x%llx\"", (unsigned long long)span->id);
+    }
+    fprintf(file, ",\"pid\":%d,\"tid\":%d", pid, (int)tid);
+    if (with_arg && span->arg_name) {
+        fputs(",\"args\":{", file);
+        put_string(file, span->arg_name);
+        fprintf(file, ":%lld}", (long long)span->arg);
+    }
+    fputc('}', file);
+}
+
+/* Thread spans become complete ("X") events, async spans a begin ("b") and end ("e") pair */
+static int write_dump(const char *path) {
+    FILE *file = fopen(path, "w");
+    if (!file) {
+        return SERIAL_ERROR_WRITE;
+    }
+    int pid = (int)getpid();
+    const char *separator = "\n";
+    fputs("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[", file);
+    for (struct trace_buffer_s *buffer = atomic_load_explicit(&trace_buffers, memory_order_acquire); buffer;
+         buffer = buffer->next) {
+        size_t count = atomic_load_explicit(&buffer->count, memory_order_acquire);
+        for (size_t i = 0; i < count; i++) {
+            const struct trace_record_s *span = &buffer->records[i];
+            fputs(separator, file);
+            separator = ",\n";
+            if (span->id == 0) {
+                put_event(file, pid, buffer->tid, span, 'X', span->start_ns, 1);
+                continue;
+            }
+            put_event(file, pid, buffer->tid, span, 'b', span->start_ns, 1);
+            fputs(separator, file);
+            put_event(file, pid, buffer->tid, span, 'e', span->end_ns > span->start_ns ? span->end_ns : span->start_ns,
+                      0);
+        }
+    }
+    fputs("\n]}\n", file);
+    int failed = ferror(file);
+    failed |= fclose(file) != 0;
+    return failed ? SERIAL_ERROR_WRITE : SERIAL_SUCCESS;
+}
+
+int serial_trace_dump(const char *path) {
+    if (!path) {
+        return SERIAL_ERROR_CONFIG;
+    }
+    pthread_mutex_lock(&dump_lock);
+    int result = write_dump(path);
+    pthread_mutex_unlock(&dump_lock);
+    return result;
+}
+
+static void dump_requested(void) {
+    pthread_mutex_lock(&dump_lock);
+    if (dump_path[0]) {
+        write_dump(dump_path);
+    }
+    pthread_mutex_unlock(&dump_lock);
+}
+
+/* Async-signal-safe: only wakes the dump thread */
+static void dump_signal_handler(int signal_number) {
+    (void)signal_number;
+    int saved_errno = errno;
+    char byte = 0;
+    ssize_t ignored = write(dump_pipe[1], &byte, 1);
+    (void)ignored;
+    errno = saved_errno;
+}
+
+static void *dump_thread_main(void *arg) {
+    (void)arg;
+    for (;;) {
+        char byte;
+        ssize_t result = read(dump_pipe[0], &byte, 1);
+        if (result < 0 && errno == EINTR) {
+            continue;
+        }
+        if (result <= 0) {
+            return NULL;
+        }
+        dump_requested();
+    }
+}
+
+/* Creates the pipe and the thread that dumps on its behalf; called with dump_lock held */
+static int start_dump_thread(void) {
+    if (dump_pipe[0] >= 0) {
+        return SERIAL_SUCCESS;
+    }
+    int fds[2];
+    if (pipe2(fds, O_CLOEXEC) != 0) {
+        return SERIAL_ERROR_CONFIG;
+    }
+    /* A full pipe already has a dump pending, so the handler must not block on it */
+    fcntl(fds[1], F_SETFL, O_NONBLOCK);
+    dump_pipe[0] = fds[0];
+    dump_pipe[1] = fds[1];
+
+    pthread_t thread;
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    int result = pthread_create(&thread, &attr, dump_thread_main, NULL);
+    pthread_attr_destroy(&attr);
+    if (result != 0) {
+        close(fds[0]);
+        close(fds[1]);
+        dump_pipe[0] = dump_pipe[1] = -1;
+        return SERIAL_ERROR_CONFIG;
+    }
+    return SERIAL_SUCCESS;
+}
+
+int serial_trace_dump_at_exit(const char *path, int signal_number) {
+    if (path && strlen(path) >= sizeof(dump_path)) {
+        return SERIAL_ERROR_CONFIG;
+    }
+    pthread_mutex_lock(&dump_lock);
+    int result = SERIAL_SUCCESS;
+    if (!path) {
+        dump_path[0] = '\0';
+    } else {
+        strcpy(dump_path, path);
+        if (!exit_registered && atexit(dump_requested) == 0) {
+            exit_registered = 1;
+        }
+        result = exit_registered ? SERIAL_SUCCESS : SERIAL_ERROR_CONFIG;
+    }
+    if (result == SERIAL_SUCCESS && path && signal_number > 0) {
+        result = start_dump_thread();
+        struct sigaction action = { .sa_handler = dump_signal_handler, .sa_flags = SA_RESTART };
+        sigemptyset(&action.sa_mask);
+        if (result == SERIAL_SUCCESS && sigaction(signal_number, &action, NULL) != 0) {
+            result = SERIAL_ERROR_CONFIG;
+        }
+    }
+    pthread_mutex_unlock(&dump_lock);
+    return result;
+}
+
+void serial_trace_stats(struct serial_trace_stats_s *stats) {
+    *stats = (struct serial_trace_stats_s){0};
+    for (struct trace_buffer_s *buffer = atomic_load_explicit(&trace_buffers, memory_order_acquire); buffer;
+         buffer = buffer->next) {
+        stats->spans += atomic_load_explicit(&buffer->count, memory_order_acquire);
+        stats->dropped += atomic_load_explicit(&buffer->dropped, memory_order_relaxed);
+        stats->threads++;
+    }
+}
+
+#else
+
+int serial_trace_start(size_t capacity) {
+    (void)capacity;
+    return SERIAL_ERROR_CONFIG;
+}
+
+void serial_trace_stop(void) {
+}
+
+int serial_trace_enabled(void) {
+    return 0;
+}
+
+uint64_t serial_trace_id(void) {
+    return 0;
+}
+
+void serial_trace_span(const char *name, uint64_t start_ns, uint64_t end_ns, const char *arg_name, int64_t arg) {
+    (void)name;
+    (void)start_ns;
+    (void)end_ns;
+    (void)arg_name;
+    (void)arg;
+}
+
+void serial_trace_async(const char *name, uint64_t id, uint64_t start_ns, uint64_t end_ns, const char *arg_name,
+                        int64_t arg) {
+    (void)id;
+    serial_trace_span(name, start_ns, end_ns, arg_name, arg);
+}
+
+int serial_trace_dump(const char *path) {
+    (void)path;
+    return SERIAL_ERROR_CONFIG;
+}
+
+int serial_trace_dump_at_exit(const char *path, int signal_number) {
+    (void)path;
+    (void)signal_number;
+    return SERIAL_ERROR_CONFIG;
+}
+
+void serial_trace_stats(struct serial_trace_stats_s *stats) {
+    *stats = (struct serial_trace_stats_s){0};
+}
+
+#endif /* __linux__ && SERIAL_USE_TRACE */
@@ -0,0 +1,277 @@
+/**
+ * @file serial_transport.c
+ * @brief Transport-backed handles kept in a descriptor-indexed side table, plus the pty and loopback transports
+ */
+
+#include "serial_internal.h"
+#include "../include/serial_transport.h"
+
+#if defined(__linux__)
+
+#include <errno.h>
+#include <poll.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include "../include/serial_ring.h"
+
+/* Descriptors at or above this value cannot carry a transport */
+#define SERIAL_TRANSPORT_MAX_FD 4096
+#define DEFAULT_LOOPBACK_SIZE 4096
+
+static _Atomic(struct serial_transport_port_s *) transport_table[SERIAL_TRANSPORT_MAX_FD];
+
+struct serial_transport_port_s *serial_transport_lookup(serial_handle_t handle) {
+    if (handle < 0 || handle >= SERIAL_TRANSPORT_MAX_FD) {
+        return NULL;
+    }
+    return atomic_load_explicit(&transport_table[handle], memory_order_acquire);
+}
+
+serial_handle_t serial_open_transport(const struct serial_transport_ops_s *ops, void *state) {
+    if (!ops || !ops->read || !ops->write || !ops->close) {
+        return SERIAL_INVALID_HANDLE;
+    }
+    struct serial_transport_port_s *port = malloc(sizeof(*port));
+    int fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (!port || fd < 0 || fd >= SERIAL_TRANSPORT_MAX_FD) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        free(port);
+        return SERIAL_INVALID_HANDLE;
+    }
+    port->ops = ops;
+    port->state = state;
+    atomic_store_explicit(&transport_table[fd], port, memory_order_release);
+    return fd;
+}
+
+const struct serial_transport_ops_s *serial_transport_ops(serial_handle_t handle) {
+    struct serial_transport_port_s *port = serial_transport_lookup(handle);
+    return port ? port->ops : NULL;
+}
+
+int serial_transport_close(serial_handle_t handle) {
+    struct serial_transport_port_s *port = atomic_exchange(&transport_table[handle], NULL);
+    if (!port) {
+        return SERIAL_ERROR_INVALID_HANDLE;
+    }
+    int result = port->ops->close(port->state);
+    free(port);
+    if (close(handle) != 0 && result == SERIAL_SUCCESS) {
+        result = SERIAL_ERROR_CONFIG;
+    }
+    return result;
+}
+
+serial_handle_t serial_open_pty(char *peer_path, size_t size) {
+    if (!peer_path) {
+        return SERIAL_INVALID_HANDLE;
+    }
+    int master = posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+    if (master < 0) {
+        return SERIAL_INVALID_HANDLE;
+    }
+    if (grantpt(master) != 0 || unlockpt(master) != 0 || ptsname_r(master, peer_path, size) != 0) {
+        close(master);
+        return SERIAL_INVALID_HANDLE;
+    }
+
+    /* Raw mode on the peer side; the setting outlives this descriptor */
+    struct termios tty;
+    int peer = open(peer_path, O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+    if (peer < 0 || tcgetattr(peer, &tty) != 0) {
+        if (peer >= 0) {
+            close(peer);
+        }
+        close(master);
+        return SERIAL_INVALID_HANDLE;
+    }
+    cfmakeraw(&tty);
+    int result = tcsetattr(peer, TCSANOW, &tty);
+    close(peer);
+    if (result != 0) {
+        close(master);
+        return SERIAL_INVALID_HANDLE;
+    }
+    return master;
+}
+
+/* Loopback transport: one ring per direction, shared by both ends */
+struct loopback_end_s {
+    serial_ring_t *rx;          /* filled by the peer */
+    serial_ring_t *tx;          /* the peer's rx */
+    int wake_fd;                /* signalled when this end's waiter may proceed */
+    atomic_int waiting;         /* a thread of this end is blocked in a wait */
+    atomic_int closed;
+    struct loopback_end_s *peer;
+    struct loopback_s *pair;
+};
+
+struct loopback_s {
+    struct loopback_end_s ends[2];
+    atomic_int references;      /* open ends */
+};
+
+/* Wakes the peer if it is blocked in a wait; the only system call on the I/O path */
+static void wake_end(struct loopback_end_s *end) {
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_exchange(&end->waiting, 0)) {
+        uint64_t one = 1;
+        while (write(end->wake_fd, &one, sizeof(one)) < 0 && errno == EINTR) {
+        }
+    }
+}
+
+static int loopback_read(void *state, void *buffer, size_t size, size_t *bytes_read) {
+    struct loopback_end_s *end = state;
+    *bytes_read = serial_ring_read(end->rx, buffer, size);
+    if (*bytes_read > 0) {
+        wake_end(end->peer);
+        return SERIAL_SUCCESS;
+    }
+    /* Recheck after seeing the close so bytes written just before it are not lost */
+    if (atomic_load(&end->peer->closed)) {
+        *bytes_read = serial_ring_read(end->rx, buffer, size);
+        return *bytes_read > 0 ? SERIAL_SUCCESS : SERIAL_ERROR_READ;
+    }
+    return SERIAL_SUCCESS;
+}
+
+static int loopback_write(void *state, const void *data, size_t size, size_t *bytes_written) {
+    struct loopback_end_s *end = state;
+    if (atomic_load_explicit(&end->peer->closed, memory_order_relaxed)) {
+        *bytes_written = 0;
+        return SERIAL_ERROR_WRITE;
+    }
+    *bytes_written = serial_ring_write(end->tx, data, size);
+    if (*bytes_written > 0) {
+        wake_end(end->peer);
+    }
+    return SERIAL_SUCCESS;
+}
+
+static int readable(struct loopback_end_s *end) {
+    return serial_ring_used(end->rx) > 0 || atomic_load(&end->peer->closed);
+}
+
+static int writable(struct loopback_end_s *end) {
+    return serial_ring_space(end->tx) > 0 || atomic_load(&end->peer->closed);
+}
+
+/* Blocks until ready() holds, asking the peer for a wakeup on wake_fd */
+static int wait_end(struct loopback_end_s *end, int (*ready)(struct loopback_end_s *), int timeout_ms) {
+    uint64_t deadline = serial_monotonic_ms() + (uint64_t)(timeout_ms > 0 ? timeout_ms : 0);
+
+    for (;;) {
+        if (ready(end)) {
+            return SERIAL_SUCCESS;
+        }
+        atomic_store(&end->waiting, 1);
+        atomic_thread_fence(memory_order_seq_cst);
+        if (ready(end)) {
+            atomic_store(&end->waiting, 0);
+            return SERIAL_SUCCESS;
+        }
+
+        int wait_ms = timeout_ms;
+        if (timeout_ms >= 0) {
+            uint64_t now = serial_monotonic_ms();
+            if (now >= deadline) {
+                atomic_store(&end->waiting, 0);
+                return SERIAL_ERROR_TIMEOUT;
+            }
+            wait_ms = (int)(deadline - now);
+        }
+
+        struct pollfd pfd = { .fd = end->wake_fd, .events = POLLIN };
+        if (poll(&pfd, 1, wait_ms) > 0) {
+            uint64_t value;
+            while (read(end->wake_fd, &value, sizeof(value)) < 0 && errno == EINTR) {
+            }
+        }
+    }
+}
+
+static int loopback_wait_readable(void *state, int timeout_ms) {
+    return wait_end(state, readable, timeout_ms);
+}
+
+static int loopback_wait_writable(void *state, int timeout_ms) {
+    return wait_end(state, writable, timeout_ms);
+}
+
+static int loopback_close(void *state) {
+    struct loopback_end_s *end = state;
+    atomic_store(&end->closed, 1);
+    wake_end(end->peer);
+    if (atomic_fetch_sub(&end->pair->references, 1) == 1) {
+        struct loopback_s *loopback = end->pair;
+        for (int i = 0; i < 2; i++) {
+            serial_ring_destroy(loopback->ends[i].rx);
+            close(loopback->ends[i].wake_fd);
+        }
+        free(loopback);
+    }
+    return SERIAL_SUCCESS;
+}
+
+static const struct serial_transport_ops_s LOOPBACK_OPS = {
+    .name = "loopback",
+    .read = loopback_read,
+    .write = loopback_write,
+    .wait_readable = loopback_wait_readable,
+    .wait_writable = loopback_wait_writable,
+    .close = loopback_close,
+};
+
+int serial_loopback_create(serial_handle_t handles[2], size_t capacity) {
+    if (!handles) {
+        return SERIAL_ERROR_INVALID_HANDLE;
+    }
+    struct loopback_s *loopback = calloc(1, sizeof(*loopback));
+    if (!loopback) {
+        return SERIAL_ERROR_CONFIG;
+    }
+    for (int i = 0; i < 2; i++) {
+        struct loopback_end_s *end = &loopback->ends[i];
+        end->rx = serial_ring_create(capacity ? capacity : DEFAULT_LOOPBACK_SIZE);
+        end->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        end->peer = &loopback->ends[1 - i];
+        end->pair = loopback;
+    }
+    loopback->ends[0].tx = loopback->ends[1].rx;
+    loopback->ends[1].tx = loopback->ends[0].rx;
+
+    int ok = 1;
+    for (int i = 0; i < 2; i++) {
+        ok = ok && loopback->ends[i].rx && loopback->ends[i].wake_fd >= 0;
+    }
+    handles[0] = ok ? serial_open_transport(&LOOPBACK_OPS, &loopback->ends[0]) : SERIAL_INVALID_HANDLE;
+    handles[1] = handles[0] != SERIAL_INVALID_HANDLE ? serial_open_transport(&LOOPBACK_OPS, &loopback->ends[1])
+                                                     : SERIAL_INVALID_HANDLE;
+    if (handles[1] == SERIAL_INVALID_HANDLE) {
+        if (handles[0] != SERIAL_INVALID_HANDLE) {
+            /* Unregister without running loopback_close(), which would free the pair */
+            free(atomic_exchange(&transport_table[handles[0]], NULL));
+            close(handles[0]);
+            handles[0] = SERIAL_INVALID_HANDLE;
+        }
+        for (int i = 0; i < 2; i++) {
+            serial_ring_destroy(loopback->ends[i].rx);
+            if (loopback->ends[i].wake_fd >= 0) {
+                close(loopback->ends[i].wake_fd);
+            }
+        }
+        free(loopback);
+        return SERIAL_ERROR_CONFIG;
+    }
+    atomic_store(&loopback->references, 2);
+    return SERIAL_SUCCESS;
+}
+
+#else
+typedef int serial_transport_unsupported_t;
+#endif
@@ -0,0 +1,181 @@
+/**
+ * @file test_aio.c
+ * @brief Tests for the completion-driven loop on each available backend
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "test_serial.h"
+#include "../include/serial_aio.h"
+
+#if defined(__linux__)
+
+#define AIO_TEST_BULK_SIZE 65536
+
+struct aio_test_state_s {
+    char received[32];
+    size_t received_len;
+    int read_errors;
+    int writes_done;
+    size_t written[4];
+    int write_status[4];
+};
+
+static void on_test_read(serial_aio_t *aio, serial_handle_t handle, const void *data, size_t size, int status,
+                         void *user_data) {
+    struct aio_test_state_s *state = user_data;
+    (void)aio;
+    (void)handle;
+    if (status != SERIAL_SUCCESS) {
+        state->read_errors++;
+        return;
+    }
+    size_t room = sizeof(state->received) - state->received_len;
+    size = size < room ? size : room;
+    memcpy(state->received + state->received_len, data, size);
+    state->received_len += size;
+}
+
+static void on_test_written(serial_aio_t *aio, serial_handle_t handle, size_t written, int status,
+                            void *user_data) {
+    struct aio_test_state_s *state = user_data;
+    (void)aio;
+    (void)handle;
+    if (state->writes_done < 4) {
+        state->written[state->writes_done] = written;
+        state->write_status[state->writes_done] = status;
+    }
+    state->writes_done++;
+}
+
+static int run_backend_tests(uint8_t backend, const char *name) {
+    int failed = 0;
+    char slave_path[64];
+    int master = open_test_pty(slave_path, sizeof(slave_path));
+    if (master < 0) {
+        printf("SKIP: Unable to allocate a pty\n");
+        return 0;
+    }
+    struct serial_aio_config_s config = { .backend = backend };
+    serial_handle_t port = serial_open(slave_path, NULL);
+    serial_aio_t *aio = serial_aio_create(&config);
+    if (port == SERIAL_INVALID_HANDLE || !aio) {
+        printf("FAIL: Could not set up %s loop\n", name);
+        serial_aio_destroy(aio);
+        serial_close(port);
+        close(master);
+        return 1;
+    }
+    if (backend == SERIAL_AIO_IO_URING && serial_aio_backend(aio) != SERIAL_AIO_IO_URING) {
+        printf("SKIP: io_uring backend not built in or not supported by the kernel\n");
+        serial_aio_destroy(aio);
+        serial_close(port);
+        close(master);
+        return 0;
+    }
+
+    struct aio_test_state_s state = {0};
+    if (serial_aio_add(aio, port, on_test_read, &state) != SERIAL_SUCCESS ||
+        serial_aio_add(aio, port, on_test_read, &state) == SERIAL_SUCCESS || serial_aio_count(aio) != 1) {
+        printf("FAIL: %s port registration\n", name);
+        failed++;
+    } else {
+        printf("PASS: %s port registered once\n", name);
+    }
+
+    // Two queued writes complete in order
+    serial_aio_write(aio, port, "1\r", 2, on_test_written, &state);
+    serial_aio_write(aio, port, "2\r", 2, on_test_written, &state);
+    for (int i = 0; i < 100 && state.writes_done < 2; i++) {
+        serial_aio_run_once(aio, 10);
+    }
+    char echo[8] = {0};
+    size_t echoed = 0;
+    uint64_t start = serial_monotonic_ms();
+    while (echoed < 4 && serial_monotonic_ms() - start < 1000) {
+        ssize_t count = read(master, echo + echoed, sizeof(echo) - echoed);
+        echoed += count > 0 ? (size_t)count : 0;
+    }
+    if (state.writes_done != 2 || state.written[0] != 2 || state.written[1] != 2 ||
+        state.write_status[0] != SERIAL_SUCCESS || echoed != 4 || memcmp(echo, "1\r2\r", 4) != 0) {
+        printf("FAIL: %s queued writes\n", name);
+        failed++;
+    } else {
+        printf("PASS: %s queued writes completed in order\n", name);
+    }
+
+    if (write(master, "OK\r\n", 4) != 4) {
+        printf("FAIL: Could not write to pty master\n");
+        failed++;
+    }
+    for (int i = 0; i < 100 && state.received_len < 4; i++) {
+        serial_aio_run_once(aio, 10);
+    }
+    if (state.received_len != 4 || memcmp(state.received, "OK\r\n", 4) != 0) {
+        printf("FAIL: %s read callback did not receive data\n", name);
+        failed++;
+    } else {
+        printf("PASS: %s read callback received data\n", name);
+    }
+
+    // A write larger than the pty buffer completes in pieces as the device drains it
+    static uint8_t bulk[AIO_TEST_BULK_SIZE];
+    memset(bulk, 0x55, sizeof(bulk));
+    state.writes_done = 0;
+    serial_aio_write(aio, port, bulk, sizeof(bulk), on_test_written, &state);
+    size_t drained = 0;
+    start = serial_monotonic_ms();
+    while ((state.writes_done == 0 || drained < sizeof(bulk)) && serial_monotonic_ms() - start < 2000) {
+        serial_aio_run_once(aio, 1);
+        uint8_t sink[4096];
+        ssize_t count = read(master, sink, sizeof(sink));
+        drained += count > 0 ? (size_t)count : 0;
+    }
+    if (state.writes_done != 1 || state.written[0] != sizeof(bulk) || drained != sizeof(bulk)) {
+        printf("FAIL: %s bulk write (%zu bytes reported, %zu drained)\n", name, state.written[0], drained);
+        failed++;
+    } else {
+        printf("PASS: %s bulk write completed across partial writes\n", name);
+    }
+
+    // Hang-up reports an error and drops the port
+    close(master);
+    for (int i = 0; i < 100 && serial_aio_count(aio) > 0; i++) {
+        serial_aio_run_once(aio, 10);
+    }
+    if (state.read_errors != 1 || serial_aio_count(aio) != 0) {
+        printf("FAIL: %s hang-up not reported\n", name);
+        failed++;
+    } else {
+        printf("PASS: %s hang-up reported and port removed\n", name);
+    }
+
+    serial_aio_destroy(aio);
+    serial_close(port);
+    return failed;
+}
+
+int run_serial_aio_tests(void) {
+    int failed = 0;
+    printf("\nRunning completion loop tests...\n");
+
+    failed += run_backend_tests(SERIAL_AIO_EPOLL, "epoll");
+    failed += run_backend_tests(SERIAL_AIO_IO_URING, "io_uring");
+
+    struct serial_aio_config_s bad_buffers = { .buffer_count = 100 };
+    serial_aio_t *aio = serial_aio_create(&bad_buffers);
+    if (aio) {
+        printf("FAIL: Buffer count that is not a power of two accepted\n");
+        serial_aio_destroy(aio);
+        failed++;
+    } else {
+        printf("PASS: Buffer count must be a power of two\n");
+    }
+    return failed;
+}
+
+#else
+int run_serial_aio_tests(void) {
+    return 0;
+}
+#endif
@@ -0,0 +1,150 @@
+/**
+ * @file test_broadcast.c
+ * @brief Tests for parallel broadcast to many ports
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "test_serial.h"
+#include "../include/serial_broadcast.h"
+#include "../include/serial_transport.h"
+
+#if defined(__linux__)
+
+#include <pthread.h>
+#include <time.h>
+
+#define PORTS 4
+#define STALL_TIMEOUT_MS 100
+#define LOOPBACK_CAPACITY 64
+#define DRAIN_DELAY_MS 20
+
+static const char COMMAND[] = "\x00\x03\x07\x03\x01\x36\x7e\x00";
+
+// Reads the far end of a full loopback after a pause, making room for the broadcast
+static void *late_reader_main(void *arg) {
+    serial_handle_t peer = *(serial_handle_t *)arg;
+    char buffer[LOOPBACK_CAPACITY];
+    size_t count;
+    struct timespec pause = { .tv_sec = 0, .tv_nsec = DRAIN_DELAY_MS * 1000000L };
+    nanosleep(&pause, NULL);
+    serial_read(peer, buffer, sizeof(buffer), &count);
+    return NULL;
+}
+
+static int test_broadcast(void) {
+    int failed = 0;
+    char slave_path[64];
+    int masters[PORTS];
+    serial_handle_t ports[PORTS];
+    int opened = 0;
+    for (; opened < PORTS; opened++) {
+        masters[opened] = open_test_pty(slave_path, sizeof(slave_path));
+        ports[opened] = masters[opened] >= 0 ? serial_open(slave_path, NULL) : SERIAL_INVALID_HANDLE;
+        if (ports[opened] == SERIAL_INVALID_HANDLE) {
+            break;
+        }
+    }
+    if (opened < PORTS) {
+        printf("SKIP: Unable to allocate %d ptys\n", PORTS);
+        if (masters[opened] >= 0) {
+            close(masters[opened]);
+        }
+        for (int i = 0; i < opened; i++) {
+            serial_close(ports[i]);
+            close(masters[i]);
+        }
+        return 0;
+    }
+
+    // Every port gets the whole command and a completion time
+    struct serial_broadcast_result_s results[PORTS];
+    struct serial_broadcast_report_s report;
+    int ok = serial_broadcast(ports, PORTS, COMMAND, sizeof(COMMAND) - 1, 1000, results, &report) == SERIAL_SUCCESS &&
+             report.completed == PORTS && report.failed == 0 && report.send_skew_ns <= report.elapsed_ns;
+    for (int i = 0; ok && i < PORTS; i++) {
+        char received[sizeof(COMMAND)];
+        ok = results[i].status == SERIAL_SUCCESS && results[i].written == sizeof(COMMAND) - 1 &&
+             results[i].complete_ns >= results[i].first_ns &&
+             read(masters[i], received, sizeof(received)) == (ssize_t)sizeof(COMMAND) - 1 &&
+             memcmp(received, COMMAND, sizeof(COMMAND) - 1) == 0;
+    }
+    if (!ok) {
+        printf("FAIL: Broadcast to every port\n");
+        failed++;
+    } else {
+        printf("PASS: Broadcast reaches every port (send skew %.1f us)\n", (double)report.send_skew_ns / 1e3);
+    }
+
+    // A port whose device stopped reading times out without holding up the others
+    char filler[4096];
+    struct iovec fill = { .iov_base = filler, .iov_len = sizeof(filler) };
+    size_t count;
+    memset(filler, 'x', sizeof(filler));
+    struct timespec settle = { .tv_sec = 0, .tv_nsec = 10000000L };
+    for (int pass = 0; pass < 3; pass++) {
+        // The tty layer frees some room shortly after the first EAGAIN
+        while (serial_writev(ports[0], &fill, 1, &count) == SERIAL_SUCCESS && count > 0) {
+        }
+        fill.iov_len = 1;
+        nanosleep(&settle, NULL);
+    }
+    while (serial_writev(ports[0], &fill, 1, &count) == SERIAL_SUCCESS && count > 0) {
+    }
+    int status = serial_broadcast(ports, PORTS, COMMAND, sizeof(COMMAND) - 1, STALL_TIMEOUT_MS, results, &report);
+    ok = status == SERIAL_ERROR_TIMEOUT && results[0].status == SERIAL_ERROR_TIMEOUT && report.failed == 1 &&
+         report.completed == PORTS - 1 && report.elapsed_ns >= (STALL_TIMEOUT_MS - 1) * 1000000ull;
+    for (int i = 1; ok && i < PORTS; i++) {
+        ok = results[i].status == SERIAL_SUCCESS && results[i].complete_ns < STALL_TIMEOUT_MS * 1000000ull / 2;
+    }
+    if (!ok) {
+        printf("FAIL: A stalled port holds up the broadcast\n");
+        failed++;
+    } else {
+        printf("PASS: A stalled port times out alone (others done within %.1f us)\n",
+               (double)report.complete_skew_ns / 1e3);
+    }
+
+    // Transport handles finish on the worker pool once their peer makes room
+    serial_handle_t loopback[2];
+    if (serial_loopback_create(loopback, LOOPBACK_CAPACITY) == SERIAL_SUCCESS) {
+        pthread_t reader;
+        serial_write(loopback[0], filler, LOOPBACK_CAPACITY, &count);
+        ok = count == LOOPBACK_CAPACITY && pthread_create(&reader, NULL, late_reader_main, &loopback[1]) == 0;
+        status = ok ? serial_broadcast(loopback, 1, COMMAND, sizeof(COMMAND) - 1, 1000, results, &report) : -1;
+        if (ok) {
+            pthread_join(reader, NULL);
+        }
+        char received[sizeof(COMMAND)];
+        ok = ok && status == SERIAL_SUCCESS && results[0].first_ns >= (DRAIN_DELAY_MS - 1) * 1000000ull &&
+             serial_read(loopback[1], received, sizeof(received), &count) == SERIAL_SUCCESS &&
+             count == sizeof(COMMAND) - 1;
+        serial_close(loopback[0]);
+        serial_close(loopback[1]);
+        if (!ok) {
+            printf("FAIL: Broadcast to a transport handle\n");
+            failed++;
+        } else {
+            printf("PASS: Broadcast waits for a full transport handle on a worker\n");
+        }
+    }
+
+    for (int i = 0; i < PORTS; i++) {
+        serial_close(ports[i]);
+        close(masters[i]);
+    }
+    return failed;
+}
+#endif
+
+int run_serial_broadcast_tests(void) {
+    int failed = 0;
+    printf("\nRunning broadcast tests...\n");
+
+#if defined(__linux__)
+    failed += test_broadcast();
+#else
+    printf("SKIP: Broadcast is only available on Linux\n");
+#endif
+    return failed;
+}
@@ -0,0 +1,161 @@
+/**
+ * @file test_capture.c
+ * @brief Tests for traffic capture and replay
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "test_serial.h"
+#include "../include/serial_capture.h"
+
+#if defined(__linux__)
+
+#include <time.h>
+
+#define GAP_MS 50
+
+struct expected_record_s {
+    uint8_t direction;
+    const char *data;
+};
+
+static int next_equals(serial_replay_t *replay, const struct expected_record_s *expected, uint64_t *last_ns) {
+    struct serial_capture_record_s record;
+    const void *payload;
+    if (!serial_replay_next(replay, &record, &payload)) {
+        return 0;
+    }
+    int ordered = record.time_ns >= *last_ns;
+    *last_ns = record.time_ns;
+    return ordered && record.direction == expected->direction && record.length == strlen(expected->data) &&
+           memcmp(payload, expected->data, record.length) == 0;
+}
+
+// Reads from the pty master until size bytes arrived or a second passed
+static size_t read_master(int master, char *buffer, size_t size) {
+    size_t total = 0;
+    uint64_t deadline = serial_monotonic_ms() + 1000;
+    while (total < size && serial_monotonic_ms() < deadline) {
+        ssize_t count = read(master, buffer + total, size - total);
+        if (count > 0) {
+            total += (size_t)count;
+        } else {
+            struct timespec pause = { .tv_sec = 0, .tv_nsec = 1000000 };
+            nanosleep(&pause, NULL);
+        }
+    }
+    return total;
+}
+
+static int test_capture_and_replay(void) {
+    int failed = 0;
+    char slave_path[64];
+    char capture_path[] = "/tmp/test_capture_XXXXXX";
+    int capture_fd = mkstemp(capture_path);
+    int master = open_test_pty(slave_path, sizeof(slave_path));
+    if (master < 0 || capture_fd < 0) {
+        printf("SKIP: Unable to allocate a pty or a capture file\n");
+        if (master >= 0) {
+            close(master);
+        }
+        if (capture_fd >= 0) {
+            close(capture_fd);
+            unlink(capture_path);
+        }
+        return 0;
+    }
+    close(capture_fd);
+
+    serial_handle_t port = serial_open(slave_path, NULL);
+    if (port == SERIAL_INVALID_HANDLE || serial_enable_capture(port, capture_path) != SERIAL_SUCCESS) {
+        printf("FAIL: Could not start a capture\n");
+        serial_close(port);
+        close(master);
+        unlink(capture_path);
+        return 1;
+    }
+
+    // A write, a reply, a gap, then a gathered write
+    char buffer[64];
+    size_t count = 0;
+    struct iovec iov[2] = { { .iov_base = "LED", .iov_len = 3 }, { .iov_base = "S OFF", .iov_len = 5 } };
+    struct timespec gap = { .tv_sec = 0, .tv_nsec = GAP_MS * 1000000L };
+    int io_ok = serial_write(port, "1", 1, &count) == SERIAL_SUCCESS && count == 1 &&
+                write(master, "LED RED ON\r\n", 12) == 12 &&
+                serial_wait_readable(port, 1000) == SERIAL_SUCCESS &&
+                serial_read(port, buffer, sizeof(buffer), &count) == SERIAL_SUCCESS && count == 12;
+    nanosleep(&gap, NULL);
+    io_ok = io_ok && serial_writev(port, iov, 2, &count) == SERIAL_SUCCESS && count == 8;
+    io_ok = io_ok && serial_disable_capture(port) == SERIAL_SUCCESS;
+    read_master(master, buffer, 9);
+
+    static const struct expected_record_s EXPECTED[] = {
+        {SERIAL_CAPTURE_TX, "1"}, {SERIAL_CAPTURE_RX, "LED RED ON\r\n"}, {SERIAL_CAPTURE_TX, "LEDS OFF"},
+    };
+    serial_replay_t *replay = serial_replay_open(capture_path);
+    uint64_t last_ns = 0;
+    int records_ok = replay != NULL;
+    for (size_t i = 0; records_ok && i < sizeof(EXPECTED) / sizeof(EXPECTED[0]); i++) {
+        records_ok = next_equals(replay, &EXPECTED[i], &last_ns);
+    }
+    struct serial_capture_record_s record;
+    const void *payload;
+    if (!io_ok || !records_ok || serial_replay_next(replay, &record, &payload) || last_ns < GAP_MS * 1000000ull) {
+        printf("FAIL: Capture records every chunk with its time\n");
+        failed++;
+    } else {
+        printf("PASS: Capture records every chunk with its time\n");
+    }
+
+    // Replaying the sent side into the port keeps the gap at real time and drops it at full speed
+    uint64_t start = serial_monotonic_ns();
+    int timed = replay && serial_replay_run(replay, master, SERIAL_CAPTURE_TX, 1.0) == SERIAL_SUCCESS;
+    uint64_t timed_ns = serial_monotonic_ns() - start;
+    size_t timed_count = 0;
+    timed = timed && serial_read_until(port, buffer, sizeof(buffer), "OFF", serial_monotonic_ms() + 1000,
+                                       &timed_count) == SERIAL_SUCCESS;
+    start = serial_monotonic_ns();
+    int fast = replay && serial_replay_run(replay, master, SERIAL_CAPTURE_TX, 0) == SERIAL_SUCCESS;
+    uint64_t fast_ns = serial_monotonic_ns() - start;
+    if (!timed || !fast || timed_count != 9 || memcmp(buffer, "1LEDS OFF", 9) != 0 ||
+        timed_ns < (GAP_MS - 5) * 1000000ull || fast_ns >= (GAP_MS - 5) * 1000000ull) {
+        printf("FAIL: Replay timing (%.1f ms real time, %.1f ms full speed)\n", (double)timed_ns / 1e6,
+               (double)fast_ns / 1e6);
+        failed++;
+    } else {
+        printf("PASS: Replay at real time and at full speed\n");
+    }
+    serial_replay_close(replay);
+
+    // A record cut short ends the capture; anything else is not a capture
+    int cut = truncate(capture_path, (off_t)sizeof(struct serial_capture_header_s) + 16 + 8 + 4) == 0;
+    replay = cut ? serial_replay_open(capture_path) : NULL;
+    cut = replay && serial_replay_next(replay, &record, &payload) && record.length == 1 &&
+          !serial_replay_next(replay, &record, &payload);
+    serial_replay_close(replay);
+    if (!cut || serial_replay_open("/dev/null") != NULL) {
+        printf("FAIL: Truncated and foreign files\n");
+        failed++;
+    } else {
+        printf("PASS: Truncated capture ends early, foreign file rejected\n");
+    }
+
+    serial_close(port);
+    close(master);
+    unlink(capture_path);
+    return failed;
+}
+#endif
+
+int run_serial_capture_tests(void) {
+    int failed = 0;
+    printf("\nRunning capture tests...\n");
+
+#if defined(__linux__)
+    failed += test_capture_and_replay();
+#else
+    printf("SKIP: Capture is only available on Linux\n");
+#endif
+    return failed;
+}
@@ -0,0 +1,194 @@
+/**
+ * @file test_client.c
+ * @brief Tests for the pipelined command client
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "test_serial.h"
+#include "../include/serial_client.h"
+
+#if defined(__linux__)
+
+#include <poll.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#define CMD_IGNORED 0x7F
+
+// Device stand-in: collects `group` command frames, then ACKs them in
+// reverse order. Frames with CMD_IGNORED are never answered.
+struct responder_s {
+    int fd;
+    volatile int group;
+    volatile int running;
+};
+
+static void *responder_main(void *arg) {
+    struct responder_s *responder = arg;
+    struct serial_frame_decoder_s decoder;
+    struct serial_frame_s pending[SERIAL_CLIENT_MAX_WINDOW];
+    int pending_count = 0;
+    serial_frame_decoder_init(&decoder);
+
+    while (responder->running) {
+        uint8_t buffer[256];
+        struct pollfd pfd = { .fd = responder->fd, .events = POLLIN };
+        if (poll(&pfd, 1, 10) <= 0) {
+            continue;
+        }
+        ssize_t count = read(responder->fd, buffer, sizeof(buffer));
+        size_t offset = 0;
+        while (count > 0 && offset < (size_t)count) {
+            int ready;
+            offset += serial_frame_decode(&decoder, buffer + offset, (size_t)count - offset,
+                                          &pending[pending_count], &ready);
+            if (!ready || pending[pending_count].cmd == CMD_IGNORED) {
+                continue;
+            }
+            if (++pending_count < responder->group) {
+                continue;
+            }
+            while (pending_count > 0) {
+                struct serial_frame_s *frame = &pending[--pending_count];
+                uint8_t reply[2] = {SERIAL_STATUS_OK, frame->payload[0]};
+                uint8_t encoded[SERIAL_FRAME_MAX_ENCODED];
+                size_t length;
+                serial_frame_encode(frame->seq, SERIAL_CMD_ACK, reply, 2, encoded, sizeof(encoded), &length);
+                if (write(responder->fd, encoded, length) != (ssize_t)length) {
+                    return NULL;
+                }
+            }
+        }
+    }
+    return NULL;
+}
+
+struct completion_s {
+    int calls;
+    int status;
+    uint8_t mask;
+    uint8_t reply_mask;
+    uint64_t latency_ns;
+};
+
+static void on_complete(serial_client_t *client, int status, const struct serial_frame_s *reply,
+                        uint64_t latency_ns, void *user_data) {
+    struct completion_s *completion = user_data;
+    (void)client;
+    completion->calls++;
+    completion->status = status;
+    completion->latency_ns = latency_ns;
+    if (reply && reply->cmd == SERIAL_CMD_ACK && reply->length == 2) {
+        completion->reply_mask = reply->payload[1];
+    }
+}
+
+int run_serial_client_tests(void) {
+    int failed = 0;
+    printf("\nRunning pipelined client tests...\n");
+
+    char slave_path[64];
+    int master = open_test_pty(slave_path, sizeof(slave_path));
+    if (master < 0) {
+        printf("SKIP: Unable to allocate a pty\n");
+        return 0;
+    }
+    serial_handle_t port = serial_open(slave_path, NULL);
+    struct serial_client_config_s config = { .window = 4, .timeout_ms = 50 };
+    serial_client_t *client = serial_client_create(port, &config);
+    if (!client) {
+        printf("FAIL: Could not create client on %s\n", slave_path);
+        serial_close(port);
+        close(master);
+        return 1;
+    }
+
+    struct responder_s responder = { .fd = master, .group = 4, .running = 1 };
+    pthread_t thread;
+    pthread_create(&thread, NULL, responder_main, &responder);
+
+    // 12 commands through a window of 4, answered in reverse order
+    struct completion_s completions[12];
+    memset(completions, 0, sizeof(completions));
+    unsigned max_in_flight = 0;
+    int submit_errors = 0;
+    for (int i = 0; i < 12; i++) {
+        completions[i].mask = (uint8_t)(i % 8);
+        if (serial_client_submit(client, SERIAL_CMD_LED_SET, &completions[i].mask, 1, on_complete,
+                                 &completions[i]) != SERIAL_SUCCESS) {
+            submit_errors++;
+        }
+        if (serial_client_in_flight(client) > max_in_flight) {
+            max_in_flight = serial_client_in_flight(client);
+        }
+    }
+    int drained = serial_client_drain(client);
+
+    int mismatched = 0;
+    for (int i = 0; i < 12; i++) {
+        if (completions[i].calls != 1 || completions[i].status != SERIAL_SUCCESS ||
+            completions[i].reply_mask != completions[i].mask) {
+            mismatched++;
+        }
+    }
+    if (submit_errors || drained != SERIAL_SUCCESS || mismatched || max_in_flight != 4) {
+        printf("FAIL: Pipelined commands (%d submit errors, %d mismatched, max in flight %u)\n",
+               submit_errors, mismatched, max_in_flight);
+        failed++;
+    } else {
+        printf("PASS: 12 commands pipelined 4 deep and matched out of order\n");
+    }
+
+    // An unanswered command times out without holding up the next one
+    responder.group = 1;
+    struct completion_s lost = {0};
+    struct completion_s next = { .mask = 5 };
+    serial_client_submit(client, CMD_IGNORED, &lost.mask, 1, on_complete, &lost);
+    serial_client_submit(client, SERIAL_CMD_LED_SET, &next.mask, 1, on_complete, &next);
+    serial_client_drain(client);
+    if (lost.calls != 1 || lost.status != SERIAL_ERROR_TIMEOUT || lost.latency_ns < 50000000u ||
+        next.calls != 1 || next.status != SERIAL_SUCCESS || next.reply_mask != 5) {
+        printf("FAIL: Timeout handling (lost: %d calls status %d, next: %d calls status %d)\n",
+               lost.calls, lost.status, next.calls, next.status);
+        failed++;
+    } else {
+        printf("PASS: Unanswered command timed out, later command completed\n");
+    }
+
+    // 255 answered commands later the lost one blocks its sequence number until it times out
+    lost = (struct completion_s){0};
+    int answered = 0;
+    serial_client_submit(client, CMD_IGNORED, &lost.mask, 1, on_complete, &lost);
+    for (int i = 0; i < 256; i++) {
+        struct completion_s done = { .mask = 1 };
+        if (serial_client_submit(client, SERIAL_CMD_LED_SET, &done.mask, 1, on_complete, &done) != SERIAL_SUCCESS) {
+            break;
+        }
+        while (done.calls == 0 && serial_client_poll(client, 1000) >= 0) {
+        }
+        answered += done.status == SERIAL_SUCCESS;
+    }
+    serial_client_drain(client);
+    if (lost.calls != 1 || lost.status != SERIAL_ERROR_TIMEOUT || answered != 256) {
+        printf("FAIL: Sequence wrap with a lost command (%d calls, %d answered)\n", lost.calls, answered);
+        failed++;
+    } else {
+        printf("PASS: Lost command expired when its sequence number came round again\n");
+    }
+
+    responder.running = 0;
+    pthread_join(thread, NULL);
+    serial_client_destroy(client);
+    serial_close(port);
+    close(master);
+    return failed;
+}
+
+#else
+
+int run_serial_client_tests(void) {
+    return 0;
+}
+
+#endif
@@ -0,0 +1,239 @@
+/**
+ * @file test_emulator.c
+ * @brief Tests for the pty-backed sketch emulator
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "test_serial.h"
+#include "../include/serial_emulator.h"
+#include "../include/serial_frame.h"
+
+#if defined(__linux__)
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+
+#define REPLY_TIMEOUT_MS 1000
+#define STREAM_BAUD 921600
+#define STREAM_COMMANDS 2000
+#define STREAM_IDLE_MS 200
+
+struct reply_drain_s {
+    serial_handle_t port;
+    atomic_int stop;
+    size_t received;
+};
+
+// Reads replies until told to stop, so the host never throttles the device
+static void *drain_replies(void *arg) {
+    struct reply_drain_s *drain = arg;
+    char buffer[4096];
+    while (!atomic_load(&drain->stop)) {
+        size_t count;
+        if (serial_wait_readable(drain->port, 10) == SERIAL_SUCCESS &&
+            serial_read(drain->port, buffer, sizeof(buffer), &count) == SERIAL_SUCCESS) {
+            drain->received += count;
+        }
+    }
+    return NULL;
+}
+
+// Writes a command stream as fast as the link takes it, with the same flow
+// control on both ends, and returns the emulator counters once it is idle
+static int stream_commands(uint8_t flow_control, const void *data, size_t size,
+                           struct serial_emulator_stats_s *stats) {
+    struct serial_emulator_config_s device = { .baud_rate = STREAM_BAUD, .flow_control = flow_control };
+    struct serial_config_s config = {
+        .baud_rate = STREAM_BAUD, .data_bits = 8, .stop_bits = 1, .parity = 0, .flow_control = flow_control
+    };
+    serial_emulator_t *emulator = serial_emulator_create(&device);
+    serial_handle_t port = emulator ? serial_open(serial_emulator_path(emulator), &config) : SERIAL_INVALID_HANDLE;
+    if (port == SERIAL_INVALID_HANDLE) {
+        serial_emulator_destroy(emulator);
+        return -1;
+    }
+
+    struct reply_drain_s drain = { .port = port };
+    pthread_t thread;
+    pthread_create(&thread, NULL, drain_replies, &drain);
+    size_t count;
+    int result = serial_write_all(port, data, size, 10000, &count);
+
+    // Done once the device has been silent for a while
+    uint64_t last_tx = UINT64_MAX;
+    do {
+        serial_emulator_get_stats(emulator, stats);
+        if (stats->tx_bytes == last_tx) {
+            break;
+        }
+        last_tx = stats->tx_bytes;
+        usleep(STREAM_IDLE_MS * 1000);
+    } while (1);
+
+    atomic_store(&drain.stop, 1);
+    pthread_join(thread, NULL);
+    serial_close(port);
+    serial_emulator_destroy(emulator);
+    return result == SERIAL_SUCCESS ? 0 : -1;
+}
+
+// Sends one ASCII command and reads the reply line
+static int ascii_command(serial_handle_t port, char command, char *reply, size_t size) {
+    size_t count;
+    if (serial_write_all(port, &command, 1, REPLY_TIMEOUT_MS, &count) != SERIAL_SUCCESS ||
+        serial_read_until(port, reply, size - 1, "\r\n", serial_monotonic_ms() + REPLY_TIMEOUT_MS,
+                          &count) != SERIAL_SUCCESS) {
+        return -1;
+    }
+    reply[count] = '\0';
+    return 0;
+}
+
+// Sends one frame and waits for the reply frame
+static int frame_command(serial_handle_t port, uint8_t seq, uint8_t cmd, const uint8_t *payload, size_t length,
+                         struct serial_frame_s *reply) {
+    uint8_t encoded[SERIAL_FRAME_MAX_ENCODED];
+    size_t encoded_length, count;
+    struct serial_frame_decoder_s decoder;
+    serial_frame_decoder_init(&decoder);
+    serial_frame_encode(seq, cmd, payload, length, encoded, sizeof(encoded), &encoded_length);
+    if (serial_write_all(port, encoded, encoded_length, REPLY_TIMEOUT_MS, &count) != SERIAL_SUCCESS) {
+        return -1;
+    }
+    for (;;) {
+        uint8_t byte;
+        int ready;
+        if (serial_wait_readable(port, REPLY_TIMEOUT_MS) != SERIAL_SUCCESS ||
+            serial_read(port, &byte, 1, &count) != SERIAL_SUCCESS) {
+            return -1;
+        }
+        if (count == 1 && serial_frame_decode(&decoder, &byte, 1, reply, &ready) && ready) {
+            return 0;
+        }
+    }
+}
+
+int run_serial_emulator_tests(void) {
+    int failed = 0;
+    printf("\nRunning emulator tests...\n");
+
+    serial_emulator_t *emulator = serial_emulator_create(NULL);
+    if (!emulator) {
+        printf("SKIP: Unable to create an emulator\n");
+        return 0;
+    }
+    serial_handle_t port = serial_open(serial_emulator_path(emulator), NULL);
+    if (port == SERIAL_INVALID_HANDLE) {
+        printf("FAIL: serial_open() failed on %s\n", serial_emulator_path(emulator));
+        serial_emulator_destroy(emulator);
+        return 1;
+    }
+
+    char reply[64];
+    if (ascii_command(port, '1', reply, sizeof(reply)) != 0 || strcmp(reply, "LED RED ON\r\n") != 0 ||
+        ascii_command(port, '3', reply, sizeof(reply)) != 0 || strcmp(reply, "LED BLUE ON\r\n") != 0 ||
+        serial_emulator_led_state(emulator) != (SERIAL_LED_RED | SERIAL_LED_BLUE)) {
+        printf("FAIL: ASCII commands not handled like the sketch\n");
+        failed++;
+    } else {
+        printf("PASS: ASCII commands answered like the sketch\n");
+    }
+
+    struct serial_frame_s frame;
+    uint8_t batch[] = {SERIAL_CMD_LED_OFF, SERIAL_LED_ALL, SERIAL_CMD_LED_ON, SERIAL_LED_YELLOW};
+    uint8_t bad = 0x55;
+    int batch_ok = frame_command(port, 7, SERIAL_CMD_BATCH, batch, sizeof(batch), &frame) == 0 &&
+                   frame.seq == 7 && frame.cmd == SERIAL_CMD_ACK && frame.payload[1] == SERIAL_LED_YELLOW;
+    int nak_ok = frame_command(port, 8, bad, NULL, 0, &frame) == 0 && frame.seq == 8 &&
+                 frame.cmd == SERIAL_CMD_NAK && frame.payload[0] == SERIAL_STATUS_BAD_COMMAND;
+    if (!batch_ok || !nak_ok || serial_emulator_led_state(emulator) != SERIAL_LED_YELLOW) {
+        printf("FAIL: Frames not handled like the sketch (batch %d, nak %d)\n", batch_ok, nak_ok);
+        failed++;
+    } else {
+        printf("PASS: Batch frame ACKed, unknown command NAKed\n");
+    }
+    serial_close(port);
+    serial_emulator_destroy(emulator);
+
+    // 9600 baud: "4" plus "LEDS OFF\r\n" is 11 bytes, about 11.5 ms on the wire
+    struct serial_emulator_config_s paced = { .baud_rate = 9600, .ascii_delay_ms = 30 };
+    emulator = serial_emulator_create(&paced);
+    port = emulator ? serial_open(serial_emulator_path(emulator), NULL) : SERIAL_INVALID_HANDLE;
+    uint64_t start = serial_monotonic_ns();
+    int first = ascii_command(port, '4', reply, sizeof(reply));
+    uint64_t first_ns = serial_monotonic_ns() - start;
+    // The second command waits out the 30 ms delay() of the first
+    int second = ascii_command(port, '4', reply, sizeof(reply));
+    uint64_t total_ns = serial_monotonic_ns() - start;
+    if (first != 0 || second != 0 || first_ns < 11000000u || total_ns < 41000000u) {
+        printf("FAIL: Pacing not modelled (%.1f ms, %.1f ms)\n", first_ns / 1e6, total_ns / 1e6);
+        failed++;
+    } else {
+        printf("PASS: Baud pacing and delay() modelled (%.1f ms, %.1f ms)\n", first_ns / 1e6, total_ns / 1e6);
+    }
+    serial_close(port);
+    serial_emulator_destroy(emulator);
+
+    // Each ACK is longer than its command, so the sketch blocks in Serial.write() and input piles up
+    uint8_t *frames = malloc((size_t)STREAM_COMMANDS * SERIAL_FRAME_MAX_ENCODED);
+    size_t frames_size = 0;
+    for (int i = 0; frames && i < STREAM_COMMANDS; i++) {
+        uint8_t mask = (uint8_t)(i & SERIAL_LED_ALL);
+        size_t length;
+        serial_frame_encode((uint8_t)i, SERIAL_CMD_LED_SET, &mask, 1, frames + frames_size,
+                            SERIAL_FRAME_MAX_ENCODED, &length);
+        frames_size += length;
+    }
+
+    // The same stream overruns the device without flow control and arrives whole with RTS/CTS
+    struct serial_emulator_stats_s off = {0}, on = {0};
+    int streamed = frames && stream_commands(SERIAL_FLOW_NONE, frames, frames_size, &off) == 0 &&
+                   stream_commands(SERIAL_FLOW_RTSCTS, frames, frames_size, &on) == 0;
+    free(frames);
+    if (!streamed || off.overruns == 0 || off.frames == STREAM_COMMANDS) {
+        printf("FAIL: Stream without flow control did not overrun the 64-byte buffer (%llu overruns)\n",
+               (unsigned long long)off.overruns);
+        failed++;
+    } else if (on.overruns != 0 || on.frames != STREAM_COMMANDS || on.bad_frames != 0) {
+        printf("FAIL: RTS/CTS stream lost data (%llu overruns, %llu frames)\n", (unsigned long long)on.overruns,
+               (unsigned long long)on.frames);
+        failed++;
+    } else {
+        printf("PASS: RTS/CTS stream of %d frames at %d baud without loss; %llu bytes dropped without it\n",
+               STREAM_COMMANDS, STREAM_BAUD, (unsigned long long)off.overruns);
+    }
+
+    // XON/XOFF needs text: ASCII commands and their replies never contain 0x11 or 0x13
+    char commands[STREAM_COMMANDS];
+    for (int i = 0; i < STREAM_COMMANDS; i++) {
+        commands[i] = (char)('1' + i % 4);
+    }
+    off = (struct serial_emulator_stats_s){0};
+    on = (struct serial_emulator_stats_s){0};
+    streamed = stream_commands(SERIAL_FLOW_NONE, commands, sizeof(commands), &off) == 0 &&
+               stream_commands(SERIAL_FLOW_XONXOFF, commands, sizeof(commands), &on) == 0;
+    if (!streamed || off.overruns == 0 || off.ascii_commands == STREAM_COMMANDS) {
+        printf("FAIL: Text stream without flow control did not overrun the 64-byte buffer (%llu overruns)\n",
+               (unsigned long long)off.overruns);
+        failed++;
+    } else if (on.overruns != 0 || on.ascii_commands != STREAM_COMMANDS) {
+        printf("FAIL: XON/XOFF stream lost data (%llu overruns, %llu commands)\n", (unsigned long long)on.overruns,
+               (unsigned long long)on.ascii_commands);
+        failed++;
+    } else {
+        printf("PASS: XON/XOFF stream of %d commands at %d baud without loss; %llu bytes dropped without it\n",
+               STREAM_COMMANDS, STREAM_BAUD, (unsigned long long)off.overruns);
+    }
+
+    return failed;
+}
+
+#else
+
+int run_serial_emulator_tests(void) {
+    return 0;
+}
+
+#endif
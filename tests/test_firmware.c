@@ -0,0 +1,126 @@
+/**
+ * @file test_firmware.c
+ * @brief Tests for the sketch's firmware core, built for the host
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "test_serial.h"
+#include "../include/serial_frame.h"
+#include "../sketch_mar2a/led_firmware.h"
+
+// Feeds an encoded command frame, possibly split into pieces of `piece` bytes
+static int feed_frame(struct led_firmware_s *firmware, uint8_t seq, uint8_t cmd, const uint8_t *payload,
+                      size_t length, size_t piece) {
+    uint8_t encoded[SERIAL_FRAME_MAX_ENCODED];
+    size_t encoded_length;
+    if (serial_frame_encode(seq, cmd, payload, length, encoded, sizeof(encoded), &encoded_length) != SERIAL_SUCCESS) {
+        return 0;
+    }
+    for (size_t offset = 0; offset < encoded_length; offset += piece) {
+        uint16_t count = (uint16_t)(encoded_length - offset < piece ? encoded_length - offset : piece);
+        if (led_firmware_receive(firmware, encoded + offset, count) != count) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Decodes the single reply frame the firmware queued
+static int take_reply(struct led_firmware_s *firmware, struct serial_frame_s *reply) {
+    uint8_t out[LED_FIRMWARE_TX_QUEUE];
+    uint16_t count = led_firmware_transmit(firmware, out, sizeof(out));
+    struct serial_frame_decoder_s decoder;
+    int frames = 0;
+    serial_frame_decoder_init(&decoder);
+    for (size_t used = 0; used < count;) {
+        int ready;
+        used += serial_frame_decode(&decoder, out + used, count - used, reply, &ready);
+        frames += ready;
+    }
+    return frames == 1 && decoder.errors == 0;
+}
+
+// Frames with bitmask commands are answered with compact ACKs the host decoder accepts
+static int test_frames(void) {
+    struct led_firmware_s firmware;
+    struct serial_frame_s reply;
+    led_firmware_init(&firmware);
+
+    uint8_t mask = SERIAL_LED_RED | SERIAL_LED_BLUE;
+    int ok = feed_frame(&firmware, 7, SERIAL_CMD_LED_SET, &mask, 1, 64) && take_reply(&firmware, &reply) &&
+             reply.seq == 7 && reply.cmd == SERIAL_CMD_ACK && reply.length == 2 &&
+             reply.payload[1] == mask && led_firmware_leds(&firmware) == mask;
+
+    // Split into single bytes, as the sketch receives them
+    uint8_t batch[] = {SERIAL_CMD_LED_OFF, SERIAL_LED_RED, SERIAL_CMD_LED_ON, SERIAL_LED_YELLOW};
+    ok = ok && feed_frame(&firmware, 0, SERIAL_CMD_BATCH, batch, sizeof(batch), 1) &&
+         take_reply(&firmware, &reply) && reply.seq == 0 && reply.cmd == SERIAL_CMD_ACK &&
+         reply.payload[1] == (SERIAL_LED_YELLOW | SERIAL_LED_BLUE);
+
+    ok = ok && feed_frame(&firmware, 8, SERIAL_CMD_LED_ON, NULL, 0, 64) && take_reply(&firmware, &reply) &&
+         reply.cmd == SERIAL_CMD_NAK && reply.payload[0] == SERIAL_STATUS_BAD_PAYLOAD;
+
+    // A corrupted frame gets no reply
+    uint8_t encoded[SERIAL_FRAME_MAX_ENCODED];
+    size_t encoded_length;
+    serial_frame_encode(9, SERIAL_CMD_GET_STATE, NULL, 0, encoded, sizeof(encoded), &encoded_length);
+    encoded[2] ^= 0x40;
+    uint8_t out[LED_FIRMWARE_TX_QUEUE];
+    ok = ok && led_firmware_receive(&firmware, encoded, (uint16_t)encoded_length) == encoded_length &&
+         led_firmware_transmit(&firmware, out, sizeof(out)) == 0 && firmware.bad_frames == 1 && firmware.frames == 3;
+
+    if (!ok) {
+        printf("FAIL: Firmware frame handling\n");
+        return 1;
+    }
+    printf("PASS: Firmware answers bitmask frames with compact ACKs and drops corrupt ones\n");
+    return 0;
+}
+
+// Menu commands are answered at once, and input waits while the reply queue is full
+static int test_ascii_backpressure(void) {
+    struct led_firmware_s firmware;
+    led_firmware_init(&firmware);
+    uint8_t out[LED_FIRMWARE_TX_QUEUE];
+
+    int ok = led_firmware_receive(&firmware, (const uint8_t *)"2", 1) == 1 &&
+             led_firmware_leds(&firmware) == SERIAL_LED_YELLOW &&
+             led_firmware_transmit(&firmware, out, sizeof(out)) == 15 && memcmp(out, "LED YELLOW ON\r\n", 15) == 0;
+
+    // Nobody sends the replies: the firmware stops taking commands instead of losing them
+    const uint8_t commands[] = "1111111111";
+    uint16_t taken = led_firmware_receive(&firmware, commands, 10);
+    uint16_t queued = firmware.tx_count;
+    ok = ok && taken > 0 && taken < 10 && queued > LED_FIRMWARE_TX_QUEUE - LED_FIRMWARE_REPLY_MAX;
+    size_t total = 0;
+    while (ok && taken < 10) {
+        uint16_t count = led_firmware_transmit(&firmware, out, 20);
+        total += count;
+        uint16_t more = led_firmware_receive(&firmware, commands + taken, (uint16_t)(10 - taken));
+        ok = count > 0 || more > 0;
+        taken = (uint16_t)(taken + more);
+    }
+    while (ok && firmware.tx_count > 0) {
+        total += led_firmware_transmit(&firmware, out, sizeof(out));
+    }
+    ok = ok && total == 10 * strlen("LED RED ON\r\n") && firmware.ascii_commands == 11;
+
+    ok = ok && led_firmware_receive(&firmware, (const uint8_t *)"4", 1) == 1 && led_firmware_leds(&firmware) == 0;
+
+    if (!ok) {
+        printf("FAIL: Firmware menu commands and back-pressure (%u taken)\n", (unsigned)taken);
+        return 1;
+    }
+    printf("PASS: Firmware answers menu commands without delay and holds input while replies are pending\n");
+    return 0;
+}
+
+int run_serial_firmware_tests(void) {
+    int failed = 0;
+    printf("\nRunning firmware tests...\n");
+
+    failed += test_frames();
+    failed += test_ascii_backpressure();
+    return failed;
+}
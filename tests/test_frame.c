@@ -0,0 +1,106 @@
+/**
+ * @file test_frame.c
+ * @brief Tests for the COBS + CRC16 framing layer
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "test_serial.h"
+#include "../include/serial_frame.h"
+
+// Feeds a byte stream to the decoder and counts complete frames
+static int decode_all(struct serial_frame_decoder_s *decoder, const uint8_t *data, size_t size,
+                      struct serial_frame_s *last) {
+    int frames = 0;
+    while (size > 0) {
+        int ready;
+        size_t used = serial_frame_decode(decoder, data, size, last, &ready);
+        data += used;
+        size -= used;
+        frames += ready;
+    }
+    return frames;
+}
+
+int run_serial_frame_tests(void) {
+    int failed = 0;
+    printf("\nRunning framing tests...\n");
+
+    if (serial_crc16((const uint8_t *)"123456789", 9) != 0x29B1) {
+        printf("FAIL: CRC16 check value mismatch\n");
+        failed++;
+    } else {
+        printf("PASS: CRC16 check value\n");
+    }
+
+    // Round-trip every payload size, including zero bytes in the payload
+    uint8_t payload[SERIAL_FRAME_MAX_PAYLOAD];
+    for (size_t i = 0; i < sizeof(payload); i++) {
+        payload[i] = (uint8_t)(i % 7 == 0 ? 0 : i);
+    }
+    int roundtrip_failures = 0;
+    for (size_t length = 0; length <= SERIAL_FRAME_MAX_PAYLOAD; length++) {
+        uint8_t encoded[SERIAL_FRAME_MAX_ENCODED];
+        size_t encoded_length;
+        struct serial_frame_decoder_s decoder;
+        struct serial_frame_s frame;
+        serial_frame_decoder_init(&decoder);
+
+        if (serial_frame_encode((uint8_t)length, SERIAL_CMD_BATCH, payload, length, encoded,
+                                sizeof(encoded), &encoded_length) != SERIAL_SUCCESS ||
+            memchr(encoded + 1, 0, encoded_length - 2) != NULL ||
+            decode_all(&decoder, encoded, encoded_length, &frame) != 1 ||
+            frame.seq != (uint8_t)length || frame.cmd != SERIAL_CMD_BATCH || frame.length != length ||
+            memcmp(frame.payload, payload, length) != 0) {
+            roundtrip_failures++;
+        }
+    }
+    if (roundtrip_failures) {
+        printf("FAIL: %d payload sizes did not round-trip\n", roundtrip_failures);
+        failed++;
+    } else {
+        printf("PASS: All payload sizes 0-%d round-trip\n", SERIAL_FRAME_MAX_PAYLOAD);
+    }
+
+    uint8_t encoded[SERIAL_FRAME_MAX_ENCODED];
+    size_t encoded_length;
+    if (serial_frame_encode(0, SERIAL_CMD_LED_ON, payload, SERIAL_FRAME_MAX_PAYLOAD + 1, encoded,
+                            sizeof(encoded), &encoded_length) == SERIAL_SUCCESS ||
+        serial_frame_encode(0, SERIAL_CMD_LED_ON, payload, 10, encoded, 8, &encoded_length) == SERIAL_SUCCESS) {
+        printf("FAIL: Oversized frame or short buffer accepted\n");
+        failed++;
+    } else {
+        printf("PASS: Oversized frame and short buffer rejected\n");
+    }
+
+    // Byte-at-a-time delivery after ASCII noise, then a corrupted frame
+    struct serial_frame_decoder_s decoder;
+    struct serial_frame_s frame;
+    serial_frame_decoder_init(&decoder);
+    uint8_t mask = SERIAL_LED_RED | SERIAL_LED_BLUE;
+    serial_frame_encode(42, SERIAL_CMD_LED_SET, &mask, 1, encoded, sizeof(encoded), &encoded_length);
+
+    uint8_t stream[3 * SERIAL_FRAME_MAX_ENCODED];
+    size_t stream_length = 0;
+    memcpy(stream, "LED RED ON\r\n", 12);
+    stream_length += 12;
+    memcpy(stream + stream_length, encoded, encoded_length);
+    stream[stream_length + 2] ^= 0x40; // corrupt the first copy
+    stream_length += encoded_length;
+    memcpy(stream + stream_length, encoded, encoded_length);
+    stream_length += encoded_length;
+
+    int frames = 0;
+    for (size_t i = 0; i < stream_length; i++) {
+        frames += decode_all(&decoder, stream + i, 1, &frame);
+    }
+    if (frames != 1 || frame.seq != 42 || frame.cmd != SERIAL_CMD_LED_SET || frame.length != 1 ||
+        frame.payload[0] != mask || decoder.errors != 2) {
+        printf("FAIL: Decoder did not resynchronise (%d frames, %u errors)\n", frames, (unsigned)decoder.errors);
+        failed++;
+    } else {
+        printf("PASS: Decoder dropped noise and a corrupt frame, then resynchronised\n");
+    }
+
+    return failed;
+}
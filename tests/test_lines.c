@@ -0,0 +1,159 @@
+/**
+ * @file test_lines.c
+ * @brief Tests for the line splitter and the delimiter search
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "test_serial.h"
+#include "../include/serial_lines.h"
+
+static int line_equals(const struct serial_line_s *line, const char *expected) {
+    return line->length == strlen(expected) && memcmp(line->data, expected, line->length) == 0;
+}
+
+// Every implementation against a plain loop, for all lengths and match positions up to 300
+static int test_find_byte(void) {
+    static const char *const NAMES[] = {"", "scalar", "SSE2", "AVX2"};
+    char data[320];
+    int failed = 0;
+
+    for (int scan = SERIAL_SCAN_SCALAR; scan <= SERIAL_SCAN_AVX2; scan++) {
+        int selected = serial_find_byte_select(scan);
+        if (selected != scan) {
+            printf("SKIP: %s delimiter search not available\n", NAMES[scan]);
+            continue;
+        }
+        int errors = 0;
+        for (size_t offset = 0; offset < 8; offset++) {
+            for (size_t size = 0; size <= 300; size++) {
+                memset(data, 'x', sizeof(data));
+                for (size_t match = 0; match <= size; match++) {
+                    if (match < size) {
+                        data[offset + match] = '\n';
+                    }
+                    const char *found = serial_find_byte(data + offset, size, '\n');
+                    const char *expected = match < size ? data + offset + match : NULL;
+                    if (found != expected) {
+                        errors++;
+                    }
+                    if (match < size) {
+                        data[offset + match] = 'x';
+                    }
+                }
+            }
+        }
+        // Bytes with the high bit set must not look like a match
+        memset(data, 0x8a, sizeof(data));
+        if (serial_find_byte(data, sizeof(data), 0x0a) != NULL) {
+            errors++;
+        }
+        if (errors > 0) {
+            printf("FAIL: %s delimiter search (%d mismatches)\n", NAMES[scan], errors);
+            failed++;
+        } else {
+            printf("PASS: %s delimiter search matches a plain loop\n", NAMES[scan]);
+        }
+    }
+    serial_find_byte_select(SERIAL_SCAN_AUTO);
+    return failed;
+}
+
+static int test_splitter(void) {
+    int failed = 0;
+    struct serial_line_s line;
+    serial_lines_t *lines = serial_lines_create(32, '\n');
+    serial_lines_t *small = serial_lines_create(16, '\n');
+    if (!lines || !small) {
+        serial_lines_destroy(lines);
+        serial_lines_destroy(small);
+        printf("FAIL: Could not create splitter\n");
+        return 1;
+    }
+
+    // A line split across two reads, then two lines in one read
+    serial_lines_feed(lines, "LED RED ON\r\nLED Y", 17);
+    int first = serial_lines_next(lines, &line) && line_equals(&line, "LED RED ON");
+    int partial = !serial_lines_next(lines, &line) && serial_lines_pending(lines) == 5;
+    serial_lines_feed(lines, "ELLOW ON\r\nOK\n", 13);
+    int second = serial_lines_next(lines, &line) && line_equals(&line, "LED YELLOW ON");
+    int third = serial_lines_next(lines, &line) && line_equals(&line, "OK") && !line.truncated;
+    if (!first || !partial || !second || !third || serial_lines_next(lines, &line)) {
+        printf("FAIL: Lines split across and coalesced in reads\n");
+        failed++;
+    } else {
+        printf("PASS: Partial lines carried over, coalesced lines separated\n");
+    }
+
+    // Feeding takes only what fits; a line longer than the buffer is cut
+    size_t taken = serial_lines_feed(small, "0123456789abcdefXYZ\n", 20);
+    int cut = serial_lines_next(small, &line) && line.truncated && line.length == 16;
+    taken += serial_lines_feed(small, "0123456789abcdefXYZ\n" + taken, 20 - taken);
+    int rest = serial_lines_next(small, &line) && line_equals(&line, "XYZ") && !line.truncated;
+    if (taken != 20 || !cut || !rest) {
+        printf("FAIL: Overlong line handling\n");
+        failed++;
+    } else {
+        printf("PASS: Overlong line handed out in pieces\n");
+    }
+
+    serial_lines_destroy(lines);
+    serial_lines_destroy(small);
+    return failed;
+}
+
+#if defined(__linux__)
+static int test_wait(void) {
+    int failed = 0;
+    char slave_path[64];
+    int master = open_test_pty(slave_path, sizeof(slave_path));
+    if (master < 0) {
+        printf("SKIP: Unable to allocate a pty\n");
+        return 0;
+    }
+    serial_handle_t port = serial_open(slave_path, NULL);
+    serial_lines_t *lines = serial_lines_create(256, '\n');
+    if (port == SERIAL_INVALID_HANDLE || !lines) {
+        printf("FAIL: Could not set up line wait test\n");
+        serial_lines_destroy(lines);
+        close(master);
+        return 1;
+    }
+
+    struct serial_line_s line;
+    int first = 0, second = 0;
+    if (write(master, "LED BLUE ON\r\nLEDS", 17) == 17 &&
+        serial_lines_wait(lines, port, serial_monotonic_ms() + 1000, &line) == SERIAL_SUCCESS) {
+        first = line_equals(&line, "LED BLUE ON");
+    }
+    if (write(master, " OFF\r\n", 6) == 6 &&
+        serial_lines_wait(lines, port, serial_monotonic_ms() + 1000, &line) == SERIAL_SUCCESS) {
+        second = line_equals(&line, "LEDS OFF");
+    }
+    int timeout = serial_lines_wait(lines, port, serial_monotonic_ms() + 20, &line) == SERIAL_ERROR_TIMEOUT;
+    if (!first || !second || !timeout) {
+        printf("FAIL: Waiting for lines on a port\n");
+        failed++;
+    } else {
+        printf("PASS: Lines read from a port as they complete\n");
+    }
+
+    serial_lines_destroy(lines);
+    serial_close(port);
+    close(master);
+    return failed;
+}
+#endif
+
+int run_serial_lines_tests(void) {
+    int failed = 0;
+    printf("\nRunning line splitter tests...\n");
+
+    failed += test_find_byte();
+    failed += test_splitter();
+#if defined(__linux__)
+    failed += test_wait();
+#endif
+    return failed;
+}
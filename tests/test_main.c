@@ -17,6 +17,30 @@ int main(void) {
     failed += run_serial_config_tests();
     failed += run_serial_port_tests();
     failed += run_serial_io_tests();
+    failed += run_serial_wait_tests();
+    failed += run_serial_vector_tests();
+    failed += run_serial_baud_tests();
+    failed += run_serial_reactor_tests();
+    failed += run_serial_ring_tests();
+    failed += run_serial_buffered_tests();
+    failed += run_serial_frame_tests();
+    failed += run_serial_client_tests();
+    failed += run_serial_emulator_tests();
+    failed += run_serial_stats_tests();
+    failed += run_serial_latency_tests();
+    failed += run_serial_aio_tests();
+    failed += run_serial_lines_tests();
+    failed += run_serial_script_tests();
+    failed += run_serial_capture_tests();
+    failed += run_serial_transport_tests();
+    failed += run_serial_mux_tests();
+    failed += run_serial_shadow_tests();
+    failed += run_serial_firmware_tests();
+    failed += run_serial_sequencer_tests();
+    failed += run_serial_rt_tests();
+    failed += run_serial_broadcast_tests();
+    failed += run_serial_telemetry_tests();
+    failed += run_serial_trace_tests();
 
     // Report results
     if (failed == 0) {
@@ -1,12 +1,17 @@
 /**
  * @file test_mock_serial.c
- * @brief Mock implementation of serial port for testing
+ * @brief Mock serial port transport, and tests of the API layers over it and over the loopback
  */
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include "../include/serial_functions.h"
+#include "test_serial.h"
+#include "../include/serial_lines.h"
+#include "../include/serial_stats.h"
+#include "../include/serial_transport.h"
+
+#if defined(__linux__)
 
 // Mock serial port structure
 typedef struct {
@@ -50,60 +55,202 @@ size_t mock_serial_get_tx_data(char* buffer, size_t size) {
     return size;
 }
 
-// Mock implementation of serial_open
+// Transport operations behind handles from mock_serial_open()
+static int mock_serial_close(void* state) {
+    mock_serial_port_t* port = state;
+    if (!port->is_open) {
+        return SERIAL_ERROR_INVALID_HANDLE;
+    }
+    port->is_open = 0;
+    return SERIAL_SUCCESS;
+}
+
+static int mock_serial_write(void* state, const void* data, size_t size, size_t* bytes_written) {
+    mock_serial_port_t* port = state;
+    if (size > sizeof(port->tx_buffer) - port->tx_buffer_size) {
+        size = sizeof(port->tx_buffer) - port->tx_buffer_size;
+    }
+    memcpy(port->tx_buffer + port->tx_buffer_size, data, size);
+    port->tx_buffer_size += size;
+    *bytes_written = size;
+    return SERIAL_SUCCESS;
+}
+
+static int mock_serial_read(void* state, void* buffer, size_t size, size_t* bytes_read) {
+    mock_serial_port_t* port = state;
+    if (size > port->rx_buffer_size - port->rx_buffer_pos) {
+        size = port->rx_buffer_size - port->rx_buffer_pos;
+    }
+    memcpy(buffer, port->rx_buffer + port->rx_buffer_pos, size);
+    port->rx_buffer_pos += size;
+    *bytes_read = size;
+    return SERIAL_SUCCESS;
+}
+
+// Nothing arrives while the caller waits, so pending data or a timeout
+static int mock_serial_wait_readable(void* state, int timeout_ms) {
+    mock_serial_port_t* port = state;
+    (void)timeout_ms;
+    return port->rx_buffer_pos < port->rx_buffer_size ? SERIAL_SUCCESS : SERIAL_ERROR_TIMEOUT;
+}
+
+static int mock_serial_get_baud(void* state, uint32_t* baud_rate) {
+    mock_serial_port_t* port = state;
+    *baud_rate = port->config.baud_rate;
+    return SERIAL_SUCCESS;
+}
+
+static const struct serial_transport_ops_s MOCK_OPS = {
+    .name = "mock",
+    .read = mock_serial_read,
+    .write = mock_serial_write,
+    .wait_readable = mock_serial_wait_readable,
+    .get_baud = mock_serial_get_baud,
+    .close = mock_serial_close,
+};
+
+// Mock implementation of serial_open; the handle works with the whole serial API
 serial_handle_t mock_serial_open(const char* port_name, const struct serial_config_s* config) {
     if (!port_name || mock_port.is_open) {
         return SERIAL_INVALID_HANDLE;
     }
-    
+
     mock_port.is_open = 1;
     if (config) {
         memcpy(&mock_port.config, config, sizeof(struct serial_config_s));
     }
-    
-    return (serial_handle_t)&mock_port;
+
+    return serial_open_transport(&MOCK_OPS, &mock_port);
 }
 
-// Mock implementation of serial_close
-int mock_serial_close(serial_handle_t handle) {
-    if (handle != (serial_handle_t)&mock_port || !mock_port.is_open) {
-        return SERIAL_ERROR_INVALID_HANDLE;
+// The protocol layers on a mock port: lines, read-until and gathered writes
+static int test_mock_port(void) {
+    struct serial_config_s config = { .baud_rate = 115200, .data_bits = 8, .stop_bits = 1, .parity = 0 };
+    mock_serial_init();
+    serial_handle_t port = mock_serial_open("mock0", &config);
+    serial_lines_t *lines = serial_lines_create(64, '\n');
+    if (port == SERIAL_INVALID_HANDLE || !lines) {
+        printf("FAIL: Could not open a mock port\n");
+        serial_lines_destroy(lines);
+        serial_close(port);
+        return 1;
     }
-    
-    mock_port.is_open = 0;
-    return SERIAL_SUCCESS;
+
+    struct serial_line_s line;
+    uint32_t baud_rate = 0;
+    char buffer[32];
+    size_t count = 0;
+    struct iovec iov[2] = { { .iov_base = "1", .iov_len = 1 }, { .iov_base = "23", .iov_len = 2 } };
+    mock_serial_push_rx_data("LED RED ON\r\n", 12);
+    int got_line = serial_lines_wait(lines, port, serial_monotonic_ms() + 100, &line) == SERIAL_SUCCESS &&
+                   line.length == 10 && memcmp(line.data, "LED RED ON", 10) == 0;
+    serial_lines_destroy(lines);
+    mock_serial_push_rx_data("OK>", 3);
+    int got_prompt = serial_read_until(port, buffer, sizeof(buffer), ">", serial_monotonic_ms() + 100,
+                                       &count) == SERIAL_SUCCESS && count == 3 &&
+                     serial_read_until(port, buffer, sizeof(buffer), ">", serial_monotonic_ms() + 100,
+                                       &count) == SERIAL_ERROR_TIMEOUT;
+    int wrote = serial_writev(port, iov, 2, &count) == SERIAL_SUCCESS && count == 3 &&
+                mock_serial_get_tx_data(buffer, sizeof(buffer)) == 3 && memcmp(buffer, "123", 3) == 0;
+    int baud = serial_get_baud(port, &baud_rate) == SERIAL_SUCCESS && baud_rate == 115200;
+    int named = serial_transport_ops(port) == &MOCK_OPS;
+    int rejected = serial_enable_buffering(port, NULL) == SERIAL_ERROR_CONFIG;
+    int closed = serial_close(port) == SERIAL_SUCCESS && !mock_port.is_open;
+    mock_serial_cleanup();
+
+    if (!got_line || !got_prompt || !wrote || !baud || !named || !rejected || !closed) {
+        printf("FAIL: Serial API over the mock transport\n");
+        return 1;
+    }
+    printf("PASS: Serial API over the mock transport\n");
+    return 0;
 }
 
-// Mock implementation of serial_write
-int mock_serial_write(serial_handle_t handle, const void* data, size_t size, size_t* bytes_written) {
-    if (handle != (serial_handle_t)&mock_port || !mock_port.is_open || !data || !bytes_written) {
-        return SERIAL_ERROR_INVALID_HANDLE;
+static int test_loopback(void) {
+    int failed = 0;
+    serial_handle_t ends[2];
+    if (serial_loopback_create(ends, 64) != SERIAL_SUCCESS) {
+        printf("FAIL: Could not create a loopback\n");
+        return 1;
     }
-    
-    if (size > sizeof(mock_port.tx_buffer) - mock_port.tx_buffer_size) {
-        size = sizeof(mock_port.tx_buffer) - mock_port.tx_buffer_size;
+
+    // Writes fill the 64-byte ring, the other end drains it
+    char data[100], received[100];
+    for (size_t i = 0; i < sizeof(data); i++) {
+        data[i] = (char)i;
     }
-    
-    memcpy(mock_port.tx_buffer + mock_port.tx_buffer_size, data, size);
-    mock_port.tx_buffer_size += size;
-    *bytes_written = size;
-    
-    return SERIAL_SUCCESS;
+    size_t written = 0, count = 0;
+    int full = serial_write(ends[0], data, sizeof(data), &written) == SERIAL_SUCCESS && written == 64 &&
+               serial_wait_writable(ends[0], 0) == SERIAL_ERROR_TIMEOUT;
+    int drained = serial_read(ends[1], received, sizeof(received), &count) == SERIAL_SUCCESS && count == 64 &&
+                  serial_write_all(ends[0], data + 64, 36, 100, &written) == SERIAL_SUCCESS &&
+                  serial_read_until(ends[1], received + 64, 36, "\x63", serial_monotonic_ms() + 100,
+                                    &count) == SERIAL_SUCCESS &&
+                  count == 36 && memcmp(received, data, sizeof(data)) == 0;
+    int empty = serial_wait_readable(ends[0], 10) == SERIAL_ERROR_TIMEOUT;
+    if (!full || !drained || !empty) {
+        printf("FAIL: Loopback transfer and waits\n");
+        failed++;
+    } else {
+        printf("PASS: Loopback transfer with ring backpressure\n");
+    }
+
+    // Closing one end: the other reads what is left, then sees the hang-up
+    int sent = serial_write(ends[1], "bye", 3, &written) == SERIAL_SUCCESS;
+    serial_close(ends[1]);
+    int rest = serial_wait_readable(ends[0], 100) == SERIAL_SUCCESS &&
+               serial_read(ends[0], received, sizeof(received), &count) == SERIAL_SUCCESS && count == 3;
+    int hung_up = serial_read(ends[0], received, sizeof(received), &count) == SERIAL_ERROR_READ &&
+                  serial_write(ends[0], "x", 1, &written) == SERIAL_ERROR_WRITE;
+    serial_close(ends[0]);
+    if (!sent || !rest || !hung_up) {
+        printf("FAIL: Loopback hang-up\n");
+        failed++;
+    } else {
+        printf("PASS: Loopback reports the hang-up after the last bytes\n");
+    }
+    return failed;
 }
 
-// Mock implementation of serial_read
-int mock_serial_read(serial_handle_t handle, void* buffer, size_t size, size_t* bytes_read) {
-    if (handle != (serial_handle_t)&mock_port || !mock_port.is_open || !buffer || !bytes_read) {
-        return SERIAL_ERROR_INVALID_HANDLE;
+// Transport reads and writes are counted like the system calls they stand in for
+static int test_transport_stats(void) {
+    serial_handle_t ends[2];
+    if (serial_loopback_create(ends, 64) != SERIAL_SUCCESS) {
+        printf("FAIL: Could not create a loopback\n");
+        return 1;
     }
-    
-    if (size > mock_port.rx_buffer_size - mock_port.rx_buffer_pos) {
-        size = mock_port.rx_buffer_size - mock_port.rx_buffer_pos;
+    char data[100] = {0}, received[100];
+    size_t written = 0, count = 0;
+    struct serial_stats_s tx, rx;
+    int ok = serial_enable_stats(ends[0]) == SERIAL_SUCCESS && serial_enable_stats(ends[1]) == SERIAL_SUCCESS &&
+             serial_write(ends[0], data, sizeof(data), &written) == SERIAL_SUCCESS && written == 64 &&
+             serial_write(ends[0], data, sizeof(data), &written) == SERIAL_SUCCESS && written == 0 &&
+             serial_read(ends[1], received, sizeof(received), &count) == SERIAL_SUCCESS && count == 64 &&
+             serial_read(ends[1], received, sizeof(received), &count) == SERIAL_SUCCESS && count == 0 &&
+             serial_get_stats(ends[0], &tx) == SERIAL_SUCCESS && serial_get_stats(ends[1], &rx) == SERIAL_SUCCESS;
+    ok = ok && tx.write_syscalls == 2 && tx.bytes_written == 64 && tx.short_writes == 1 && tx.write_eagain == 1 &&
+         rx.read_syscalls == 2 && rx.bytes_read == 64 && rx.read_eagain == 1;
+    serial_close(ends[0]);
+    serial_close(ends[1]);
+    if (!ok) {
+        printf("FAIL: Statistics on a transport handle\n");
+        return 1;
     }
-    
-    memcpy(buffer, mock_port.rx_buffer + mock_port.rx_buffer_pos, size);
-    mock_port.rx_buffer_pos += size;
-    *bytes_read = size;
-    
-    return SERIAL_SUCCESS;
-}
\ No newline at end of file
+    printf("PASS: Statistics count transport reads and writes\n");
+    return 0;
+}
+#endif
+
+int run_serial_transport_tests(void) {
+    int failed = 0;
+    printf("\nRunning transport tests...\n");
+
+#if defined(__linux__)
+    failed += test_mock_port();
+    failed += test_loopback();
+    failed += test_transport_stats();
+#else
+    printf("SKIP: Transports are only available on Linux\n");
+#endif
+    return failed;
+}
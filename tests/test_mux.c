@@ -0,0 +1,486 @@
+/**
+ * @file test_mux.c
+ * @brief Tests for the link multiplexer, against the emulated device
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "test_serial.h"
+#include "../include/serial_client.h"
+#include "../include/serial_emulator.h"
+#include "../include/serial_mux.h"
+
+#if defined(__linux__)
+
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <termios.h>
+
+#define MAX_REPLIES 64
+
+struct mux_fixture_s {
+    serial_emulator_t *emulator;
+    serial_handle_t device;
+    serial_mux_t *mux;
+    char path[64];
+};
+
+static int fixture_open(struct mux_fixture_s *fixture, unsigned window, unsigned max_clients) {
+    struct serial_mux_config_s config = { .window = window, .timeout_ms = 1000, .max_clients = max_clients };
+    snprintf(fixture->path, sizeof(fixture->path), "/tmp/test_mux_%d.sock", (int)getpid());
+    fixture->emulator = serial_emulator_create(NULL);
+    fixture->device = fixture->emulator ? serial_open(serial_emulator_path(fixture->emulator), NULL)
+                                        : SERIAL_INVALID_HANDLE;
+    fixture->mux = fixture->device != SERIAL_INVALID_HANDLE
+                       ? serial_mux_create(fixture->device, fixture->path, &config) : NULL;
+    return fixture->mux != NULL;
+}
+
+static void fixture_close(struct mux_fixture_s *fixture) {
+    serial_mux_destroy(fixture->mux);
+    if (fixture->device != SERIAL_INVALID_HANDLE) {
+        serial_close(fixture->device);
+    }
+    serial_emulator_destroy(fixture->emulator);
+}
+
+// Sends frames from a raw connection in a single write, so the multiplexer reads them together
+static int send_burst(serial_handle_t handle, const uint8_t (*commands)[2], size_t count) {
+    uint8_t buffer[MAX_REPLIES * SERIAL_FRAME_MAX_ENCODED];
+    size_t total = 0, written;
+    for (size_t i = 0; i < count; i++) {
+        size_t length;
+        uint8_t mask = commands[i][1];
+        serial_frame_encode((uint8_t)i, commands[i][0], &mask, commands[i][0] == SERIAL_CMD_GET_STATE ? 0 : 1,
+                            buffer + total, sizeof(buffer) - total, &length);
+        total += length;
+    }
+    return serial_write_all(handle, buffer, total, 1000, &written) == SERIAL_SUCCESS;
+}
+
+// Collects replies without blocking; returns how many have arrived in total
+static size_t collect(serial_handle_t handle, struct serial_frame_decoder_s *decoder,
+                      struct serial_frame_s *replies, size_t *count) {
+    uint8_t buffer[512];
+    size_t received;
+    while (serial_read(handle, buffer, sizeof(buffer), &received) == SERIAL_SUCCESS && received > 0) {
+        for (size_t offset = 0; offset < received;) {
+            int ready;
+            offset += serial_frame_decode(decoder, buffer + offset, received - offset, &replies[*count], &ready);
+            if (ready && *count < MAX_REPLIES - 1) {
+                (*count)++;
+            }
+        }
+    }
+    return *count;
+}
+
+// Runs the multiplexer in this thread until a connection has `expected` replies
+static int pump(struct mux_fixture_s *fixture, serial_handle_t handle, struct serial_frame_decoder_s *decoder,
+                struct serial_frame_s *replies, size_t *count, size_t expected) {
+    uint64_t deadline = serial_monotonic_ms() + 2000;
+    while (collect(handle, decoder, replies, count) < expected && serial_monotonic_ms() < deadline) {
+        if (serial_mux_run_once(fixture->mux, 10) < 0) {
+            return 0;
+        }
+    }
+    return *count >= expected;
+}
+
+// Back-to-back GET_STATEs share a link command; one after a change does not
+static int test_coalescing(void) {
+    struct mux_fixture_s fixture = {0};
+    if (!fixture_open(&fixture, 8, 0)) {
+        printf("FAIL: Could not start a multiplexer\n");
+        fixture_close(&fixture);
+        return 1;
+    }
+    serial_handle_t handle = serial_mux_connect(fixture.path);
+    static const uint8_t COMMANDS[][2] = {
+        {SERIAL_CMD_LED_SET, SERIAL_LED_RED}, {SERIAL_CMD_GET_STATE, 0}, {SERIAL_CMD_GET_STATE, 0},
+        {SERIAL_CMD_LED_ON, SERIAL_LED_BLUE}, {SERIAL_CMD_GET_STATE, 0}, {SERIAL_CMD_GET_STATE, 0},
+        {SERIAL_CMD_GET_STATE, 0},
+    };
+    struct serial_frame_decoder_s decoder;
+    struct serial_frame_s replies[MAX_REPLIES];
+    size_t count = 0;
+    serial_frame_decoder_init(&decoder);
+    int ok = handle != SERIAL_INVALID_HANDLE && send_burst(handle, COMMANDS, 7) &&
+             pump(&fixture, handle, &decoder, replies, &count, 7);
+
+    // Each reply carries the client's own sequence number and the state its command saw
+    static const uint8_t EXPECTED_STATE[] = {
+        SERIAL_LED_RED, SERIAL_LED_RED, SERIAL_LED_RED, SERIAL_LED_RED | SERIAL_LED_BLUE,
+        SERIAL_LED_RED | SERIAL_LED_BLUE, SERIAL_LED_RED | SERIAL_LED_BLUE, SERIAL_LED_RED | SERIAL_LED_BLUE,
+    };
+    unsigned seen = 0;
+    for (size_t i = 0; ok && i < count; i++) {
+        ok = replies[i].cmd == SERIAL_CMD_ACK && replies[i].seq < 7 && !(seen & (1u << replies[i].seq)) &&
+             replies[i].payload[1] == EXPECTED_STATE[replies[i].seq];
+        seen |= ok ? 1u << replies[i].seq : 0;
+    }
+    struct serial_mux_stats_s stats;
+    serial_mux_get_stats(fixture.mux, &stats);
+    serial_close(handle);
+    fixture_close(&fixture);
+
+    if (!ok || stats.commands != 7 || stats.link_commands != 4 || stats.coalesced != 3) {
+        printf("FAIL: GET_STATE coalescing (%llu link commands, %llu coalesced)\n",
+               (unsigned long long)stats.link_commands, (unsigned long long)stats.coalesced);
+        return 1;
+    }
+    printf("PASS: Consecutive GET_STATEs share one link command\n");
+    return 0;
+}
+
+// A client with a deep queue does not hold back one that sends a single command
+static int test_fairness(void) {
+    struct mux_fixture_s fixture = {0};
+    if (!fixture_open(&fixture, 2, 2)) {
+        printf("FAIL: Could not start a multiplexer\n");
+        fixture_close(&fixture);
+        return 1;
+    }
+    serial_handle_t greedy = serial_mux_connect(fixture.path);
+    serial_handle_t polite = serial_mux_connect(fixture.path);
+    uint8_t burst[32][2], single[1][2] = {{SERIAL_CMD_LED_SET, SERIAL_LED_YELLOW}};
+    for (size_t i = 0; i < 32; i++) {
+        burst[i][0] = SERIAL_CMD_LED_ON;
+        burst[i][1] = SERIAL_LED_RED;
+    }
+    struct serial_frame_decoder_s greedy_decoder, polite_decoder;
+    struct serial_frame_s greedy_replies[MAX_REPLIES], polite_replies[MAX_REPLIES];
+    size_t greedy_count = 0, polite_count = 0;
+    serial_frame_decoder_init(&greedy_decoder);
+    serial_frame_decoder_init(&polite_decoder);
+
+    int ok = greedy != SERIAL_INVALID_HANDLE && polite != SERIAL_INVALID_HANDLE &&
+             serial_mux_run_once(fixture.mux, 100) >= 0 && send_burst(greedy, (const uint8_t (*)[2])burst, 32) &&
+             serial_mux_run_once(fixture.mux, 100) >= 0 && send_burst(polite, (const uint8_t (*)[2])single, 1) &&
+             pump(&fixture, polite, &polite_decoder, polite_replies, &polite_count, 1);
+    size_t served_before = collect(greedy, &greedy_decoder, greedy_replies, &greedy_count);
+    ok = ok && pump(&fixture, greedy, &greedy_decoder, greedy_replies, &greedy_count, 32);
+
+    // A third connection is over the limit of two and is closed at once
+    serial_handle_t extra = serial_mux_connect(fixture.path);
+    char byte;
+    size_t count = 1;
+    int refused = extra != SERIAL_INVALID_HANDLE && serial_mux_run_once(fixture.mux, 100) >= 0 &&
+                  serial_wait_readable(extra, 100) == SERIAL_SUCCESS &&
+                  serial_read(extra, &byte, 1, &count) == SERIAL_SUCCESS && count == 0;
+    serial_close(extra);
+    serial_close(greedy);
+    serial_close(polite);
+    struct serial_mux_stats_s stats;
+    uint64_t deadline = serial_monotonic_ms() + 1000;
+    do {
+        serial_mux_run_once(fixture.mux, 10);
+        serial_mux_get_stats(fixture.mux, &stats);
+    } while (stats.clients > 0 && serial_monotonic_ms() < deadline);
+    fixture_close(&fixture);
+
+    if (!ok || served_before > 8) {
+        printf("FAIL: Round-robin scheduling (%zu of 32 queued commands served first)\n", served_before);
+        return 1;
+    }
+    printf("PASS: A single command overtakes a 32-command backlog (%zu served first)\n", served_before);
+    if (!refused || stats.rejected != 1 || stats.accepted != 2 || stats.clients != 0) {
+        printf("FAIL: Connection limit\n");
+        return 1;
+    }
+    printf("PASS: Connections over the limit are refused\n");
+    return 0;
+}
+
+// Answers every command waiting on the device side of a pty; returns how many
+static size_t answer_commands(int master, struct serial_frame_decoder_s *decoder) {
+    uint8_t buffer[512];
+    size_t answered = 0;
+    ssize_t count;
+    while ((count = read(master, buffer, sizeof(buffer))) > 0) {
+        for (ssize_t offset = 0; offset < count;) {
+            struct serial_frame_s frame;
+            int ready;
+            offset += (ssize_t)serial_frame_decode(decoder, buffer + offset, (size_t)(count - offset), &frame,
+                                                   &ready);
+            uint8_t reply[2] = {SERIAL_STATUS_OK, frame.payload[0]};
+            uint8_t encoded[SERIAL_FRAME_MAX_ENCODED];
+            size_t length;
+            if (ready && serial_frame_encode(frame.seq, SERIAL_CMD_ACK, reply, 2, encoded, sizeof(encoded),
+                                             &length) == SERIAL_SUCCESS &&
+                write(master, encoded, length) == (ssize_t)length) {
+                answered++;
+            }
+        }
+    }
+    return answered;
+}
+
+// A link held off by flow control waits for room instead of failing, and sends everything once resumed
+static int test_link_full(void) {
+    struct mux_fixture_s fixture = { .device = SERIAL_INVALID_HANDLE };
+    struct serial_mux_config_s config = { .window = 4, .timeout_ms = 1000 };
+    char slave_path[64];
+    snprintf(fixture.path, sizeof(fixture.path), "/tmp/test_mux_%d.sock", (int)getpid());
+    int master = open_test_pty(slave_path, sizeof(slave_path));
+    fixture.device = master >= 0 ? serial_open(slave_path, NULL) : SERIAL_INVALID_HANDLE;
+    if (fixture.device == SERIAL_INVALID_HANDLE || tcflow(fixture.device, TCOOFF) != 0) {
+        printf("SKIP: Unable to open a pty\n");
+        fixture_close(&fixture);
+        if (master >= 0) {
+            close(master);
+        }
+        return 0;
+    }
+    fcntl(master, F_SETFL, O_NONBLOCK);
+    fixture.mux = serial_mux_create(fixture.device, fixture.path, &config);
+    serial_handle_t handle = fixture.mux ? serial_mux_connect(fixture.path) : SERIAL_INVALID_HANDLE;
+    static const uint8_t COMMANDS[][2] = {
+        {SERIAL_CMD_LED_SET, SERIAL_LED_RED}, {SERIAL_CMD_LED_ON, SERIAL_LED_BLUE},
+        {SERIAL_CMD_LED_OFF, SERIAL_LED_RED}, {SERIAL_CMD_LED_ON, SERIAL_LED_YELLOW},
+    };
+    int ok = handle != SERIAL_INVALID_HANDLE && send_burst(handle, COMMANDS, 4);
+
+    // Held off: the commands stay queued and the multiplexer keeps running
+    for (int i = 0; ok && i < 5; i++) {
+        ok = serial_mux_run_once(fixture.mux, 10) >= 0;
+    }
+    struct pollfd device_side = { .fd = master, .events = POLLIN };
+    struct serial_mux_stats_s held = {0};
+    serial_mux_get_stats(fixture.mux, &held);
+    ok = ok && poll(&device_side, 1, 0) == 0 && held.link_commands == 4 && held.link_writes == 1;
+
+    // Resumed: the writable link flushes them and every command is answered
+    struct serial_frame_decoder_s device_decoder, decoder;
+    struct serial_frame_s replies[MAX_REPLIES];
+    size_t answered = 0, count = 0;
+    serial_frame_decoder_init(&device_decoder);
+    serial_frame_decoder_init(&decoder);
+    ok = ok && tcflow(fixture.device, TCOON) == 0;
+    uint64_t deadline = serial_monotonic_ms() + 2000;
+    while (ok && collect(handle, &decoder, replies, &count) < 4 && serial_monotonic_ms() < deadline) {
+        ok = serial_mux_run_once(fixture.mux, 10) >= 0;
+        answered += answer_commands(master, &device_decoder);
+    }
+    ok = ok && answered == 4 && count == 4;
+    if (handle != SERIAL_INVALID_HANDLE) {
+        serial_close(handle);
+    }
+    fixture_close(&fixture);
+    close(master);
+
+    if (!ok) {
+        printf("FAIL: Link held off by flow control (%llu writes while held, %zu answered)\n",
+               (unsigned long long)held.link_writes, answered);
+        return 1;
+    }
+    printf("PASS: A full link waits to become writable, then sends the queued commands\n");
+    return 0;
+}
+
+// Sends count commands with the largest payload, numbered from first; returns 0 if they could not be written
+static int send_large(serial_handle_t handle, size_t first, size_t count) {
+    uint8_t payload[SERIAL_FRAME_MAX_PAYLOAD];
+    uint8_t buffer[SERIAL_FRAME_MAX_ENCODED];
+    memset(payload, SERIAL_LED_RED, sizeof(payload));
+    for (size_t i = first; i < first + count; i++) {
+        size_t length, written;
+        if (serial_frame_encode((uint8_t)i, SERIAL_CMD_LED_ON, payload, sizeof(payload), buffer, sizeof(buffer),
+                                &length) != SERIAL_SUCCESS ||
+            serial_write_all(handle, buffer, length, 1000, &written) != SERIAL_SUCCESS) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Counts the reply frames waiting on a connection
+static size_t count_replies(serial_handle_t handle, struct serial_frame_decoder_s *decoder) {
+    uint8_t buffer[512];
+    size_t received, replies = 0;
+    while (serial_read(handle, buffer, sizeof(buffer), &received) == SERIAL_SUCCESS && received > 0) {
+        for (size_t offset = 0; offset < received;) {
+            struct serial_frame_s frame;
+            int ready;
+            offset += serial_frame_decode(decoder, buffer + offset, received - offset, &frame, &ready);
+            replies += ready;
+        }
+    }
+    return replies;
+}
+
+// Commands that time out while the link is held off keep their bytes queued; new ones wait for room
+static int test_link_held_timeouts(void) {
+    enum { COMMANDS = 320, BURST = 16 };
+    struct mux_fixture_s fixture = { .device = SERIAL_INVALID_HANDLE };
+    struct serial_mux_config_s config = { .window = 32, .timeout_ms = 10 };
+    char slave_path[64];
+    snprintf(fixture.path, sizeof(fixture.path), "/tmp/test_mux_%d.sock", (int)getpid());
+    int master = open_test_pty(slave_path, sizeof(slave_path));
+    fixture.device = master >= 0 ? serial_open(slave_path, NULL) : SERIAL_INVALID_HANDLE;
+    if (fixture.device == SERIAL_INVALID_HANDLE || tcflow(fixture.device, TCOOFF) != 0) {
+        printf("SKIP: Unable to open a pty\n");
+        fixture_close(&fixture);
+        if (master >= 0) {
+            close(master);
+        }
+        return 0;
+    }
+    fcntl(master, F_SETFL, O_NONBLOCK);
+    fixture.mux = serial_mux_create(fixture.device, fixture.path, &config);
+    serial_handle_t handle = fixture.mux ? serial_mux_connect(fixture.path) : SERIAL_INVALID_HANDLE;
+    int ok = handle != SERIAL_INVALID_HANDLE;
+
+    // Held off across many timeout periods while the client keeps sending, a little ahead of the multiplexer
+    size_t sent = 0;
+    struct serial_mux_stats_s held = {0};
+    uint64_t deadline = serial_monotonic_ms() + 300;
+    while (ok && serial_monotonic_ms() < deadline) {
+        if (sent < COMMANDS && sent - held.commands < BURST) {
+            ok = send_large(handle, sent, BURST);
+            sent += BURST;
+        }
+        ok = ok && serial_mux_run_once(fixture.mux, 1) >= 0;
+        serial_mux_get_stats(fixture.mux, &held);
+    }
+    struct pollfd device_side = { .fd = master, .events = POLLIN };
+    // Frames of the largest size fill the link buffer after SERIAL_CLIENT_MAX_WINDOW of them; later ones wait
+    ok = ok && held.timeouts == SERIAL_CLIENT_MAX_WINDOW && held.link_commands == SERIAL_CLIENT_MAX_WINDOW &&
+         poll(&device_side, 1, 0) == 0;
+
+    // Resumed: the rest is sent, every frame reaches the device intact, every command is answered or timed out
+    struct serial_frame_decoder_s device_decoder, decoder;
+    struct serial_mux_stats_s stats = held;
+    size_t answered = 0, replies = 0;
+    serial_frame_decoder_init(&device_decoder);
+    serial_frame_decoder_init(&decoder);
+    ok = ok && tcflow(fixture.device, TCOON) == 0;
+    deadline = serial_monotonic_ms() + 2000;
+    while (ok && (stats.link_commands < COMMANDS || replies + stats.timeouts < COMMANDS) &&
+           serial_monotonic_ms() < deadline) {
+        if (sent < COMMANDS && sent - stats.commands < BURST) {
+            ok = send_large(handle, sent, BURST);
+            sent += BURST;
+        }
+        ok = ok && serial_mux_run_once(fixture.mux, 5) >= 0;
+        answered += answer_commands(master, &device_decoder);
+        replies += count_replies(handle, &decoder);
+        serial_mux_get_stats(fixture.mux, &stats);
+    }
+    ok = ok && sent == COMMANDS && stats.link_commands == COMMANDS && replies + stats.timeouts == COMMANDS;
+    for (int i = 0; ok && i < 5 && answered < COMMANDS; i++) {
+        ok = serial_mux_run_once(fixture.mux, 5) >= 0;
+        answered += answer_commands(master, &device_decoder);
+    }
+    ok = ok && answered == COMMANDS;
+    if (handle != SERIAL_INVALID_HANDLE) {
+        serial_close(handle);
+    }
+    fixture_close(&fixture);
+    close(master);
+
+    if (!ok) {
+        printf("FAIL: Timeouts on a held link (%llu timed out, %zu answered, %zu replies)\n",
+               (unsigned long long)stats.timeouts, answered, replies);
+        return 1;
+    }
+    printf("PASS: Commands timing out on a held link leave the link buffer consistent\n");
+    return 0;
+}
+
+struct mux_thread_s {
+    serial_mux_t *mux;
+    int result;
+};
+
+static void *mux_main(void *arg) {
+    struct mux_thread_s *thread = arg;
+    thread->result = serial_mux_run(thread->mux);
+    return NULL;
+}
+
+static void on_reply(serial_client_t *client, int status, const struct serial_frame_s *reply,
+                     uint64_t latency_ns, void *user_data) {
+    (void)client;
+    (void)latency_ns;
+    if (status == SERIAL_SUCCESS && reply->cmd == SERIAL_CMD_ACK) {
+        (*(unsigned *)user_data)++;
+    }
+}
+
+// serial_client over the socket while another client leaves with commands in flight
+static int test_clients(void) {
+    struct mux_fixture_s fixture = {0};
+    struct mux_thread_s thread = {0};
+    pthread_t id;
+    if (!fixture_open(&fixture, 16, 0) || (thread.mux = fixture.mux, pthread_create(&id, NULL, mux_main, &thread)) != 0) {
+        printf("FAIL: Could not start a multiplexer\n");
+        fixture_close(&fixture);
+        return 1;
+    }
+
+    // A client that queues commands and leaves without waiting for them
+    serial_handle_t leaver = serial_mux_connect(fixture.path);
+    static const uint8_t LEAVING[4][2] = {
+        {SERIAL_CMD_LED_ON, SERIAL_LED_RED}, {SERIAL_CMD_LED_ON, SERIAL_LED_RED},
+        {SERIAL_CMD_LED_ON, SERIAL_LED_RED}, {SERIAL_CMD_LED_ON, SERIAL_LED_RED},
+    };
+    int left = leaver != SERIAL_INVALID_HANDLE && send_burst(leaver, LEAVING, 4);
+    serial_close(leaver);
+
+    serial_handle_t handles[4];
+    serial_client_t *clients[4];
+    unsigned acked[4] = {0};
+    struct serial_client_config_s config = { .window = 8, .timeout_ms = 1000 };
+    int ok = left;
+    for (int i = 0; i < 4; i++) {
+        handles[i] = serial_mux_connect(fixture.path);
+        clients[i] = serial_client_create(handles[i], &config);
+        ok = ok && clients[i];
+    }
+    for (int n = 0; ok && n < 100; n++) {
+        for (int i = 0; ok && i < 4; i++) {
+            uint8_t mask = (uint8_t)(1u << (n % 3));
+            ok = serial_client_submit(clients[i], n % 2 ? SERIAL_CMD_GET_STATE : SERIAL_CMD_LED_SET, &mask,
+                                      n % 2 ? 0 : 1, on_reply, &acked[i]) == SERIAL_SUCCESS;
+        }
+    }
+    for (int i = 0; i < 4; i++) {
+        ok = ok && serial_client_drain(clients[i]) == SERIAL_SUCCESS && acked[i] == 100;
+    }
+
+    for (int i = 0; i < 4; i++) {
+        serial_client_destroy(clients[i]);
+        serial_close(handles[i]);
+    }
+    serial_mux_stop(fixture.mux);
+    pthread_join(id, NULL);
+    struct serial_mux_stats_s stats;
+    serial_mux_get_stats(fixture.mux, &stats);
+    fixture_close(&fixture);
+
+    if (!ok || thread.result != SERIAL_SUCCESS || stats.commands != 404) {
+        printf("FAIL: Shared link with serial_client (%llu commands)\n", (unsigned long long)stats.commands);
+        return 1;
+    }
+    printf("PASS: Four pipelined clients share the link while another leaves mid-flight\n");
+    return 0;
+}
+#endif
+
+int run_serial_mux_tests(void) {
+    int failed = 0;
+    printf("\nRunning multiplexer tests...\n");
+
+#if defined(__linux__)
+    failed += test_coalescing();
+    failed += test_fairness();
+    failed += test_clients();
+    failed += test_link_full();
+    failed += test_link_held_timeouts();
+#else
+    printf("SKIP: The multiplexer is only available on Linux\n");
+#endif
+    return failed;
+}
@@ -0,0 +1,141 @@
+/**
+ * @file test_reactor.c
+ * @brief Tests for the multi-port event loop
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "test_serial.h"
+#include "../include/serial_reactor.h"
+
+#if defined(__linux__)
+
+#include <sys/socket.h>
+
+struct reactor_test_state_s {
+    int readable;
+    int writable;
+    int timeouts;
+    char received[32];
+    size_t received_len;
+};
+
+static void on_test_readable(serial_reactor_t *reactor, serial_handle_t handle, void *user_data) {
+    struct reactor_test_state_s *state = user_data;
+    size_t count;
+    (void)reactor;
+    if (serial_read(handle, state->received + state->received_len,
+                    sizeof(state->received) - state->received_len, &count) == SERIAL_SUCCESS) {
+        state->received_len += count;
+    }
+    state->readable++;
+}
+
+static void on_test_writable(serial_reactor_t *reactor, serial_handle_t handle, void *user_data) {
+    struct reactor_test_state_s *state = user_data;
+    state->writable++;
+    serial_reactor_set_events(reactor, handle, SERIAL_REACTOR_READ);
+}
+
+static void on_test_timeout(serial_reactor_t *reactor, serial_handle_t handle, void *user_data) {
+    struct reactor_test_state_s *state = user_data;
+    state->timeouts++;
+    serial_reactor_remove(reactor, handle);
+}
+
+int run_serial_reactor_tests(void) {
+    int failed = 0;
+    printf("\nRunning reactor tests...\n");
+
+    char slave_path[64];
+    int master = open_test_pty(slave_path, sizeof(slave_path));
+    if (master < 0) {
+        printf("SKIP: Unable to allocate a pty\n");
+        return 0;
+    }
+    serial_handle_t port = serial_open(slave_path, NULL);
+    serial_reactor_t *reactor = serial_reactor_create();
+    if (port == SERIAL_INVALID_HANDLE || !reactor) {
+        printf("FAIL: Could not set up reactor test\n");
+        serial_reactor_destroy(reactor);
+        close(master);
+        return 1;
+    }
+
+    static const struct serial_reactor_ops_s ops = {
+        .on_readable = on_test_readable,
+        .on_writable = on_test_writable,
+        .on_timeout = on_test_timeout,
+    };
+    struct reactor_test_state_s state = {0};
+
+    if (serial_reactor_add(reactor, port, SERIAL_REACTOR_READ | SERIAL_REACTOR_WRITE, &ops, &state) != SERIAL_SUCCESS ||
+        serial_reactor_add(reactor, port, SERIAL_REACTOR_READ, &ops, &state) == SERIAL_SUCCESS) {
+        printf("FAIL: Port registration\n");
+        failed++;
+    } else {
+        printf("PASS: Port registered once\n");
+    }
+
+    serial_reactor_run_once(reactor, 100);
+    if (state.writable != 1) {
+        printf("FAIL: Write-ready callback not dispatched\n");
+        failed++;
+    } else {
+        printf("PASS: Write-ready callback dispatched\n");
+    }
+
+    if (write(master, "OK\r\n", 4) != 4) {
+        printf("FAIL: Could not write to pty master\n");
+        failed++;
+    }
+    serial_reactor_run_once(reactor, 1000);
+    if (state.readable != 1 || state.received_len != 4 || memcmp(state.received, "OK\r\n", 4) != 0) {
+        printf("FAIL: Read callback did not receive data\n");
+        failed++;
+    } else {
+        printf("PASS: Read callback received data\n");
+    }
+
+    serial_reactor_set_timer(reactor, port, 10);
+    uint64_t start = serial_monotonic_ms();
+    serial_reactor_run(reactor);
+    if (state.timeouts != 1 || serial_reactor_count(reactor) != 0 ||
+        serial_monotonic_ms() - start > 500) {
+        printf("FAIL: Timer did not fire and remove the port\n");
+        failed++;
+    } else {
+        printf("PASS: Timer fired and port removed from callback\n");
+    }
+
+    // A peer that sends and hangs up: the data is read, then the port is removed instead of spinning
+    int ends[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, ends) == 0) {
+        struct reactor_test_state_s peer = {0};
+        int added = serial_reactor_add(reactor, ends[0], SERIAL_REACTOR_READ, &ops, &peer) == SERIAL_SUCCESS;
+        int sent = write(ends[1], "bye", 3) == 3;
+        close(ends[1]);
+        for (int i = 0; added && i < 10 && serial_reactor_count(reactor) > 0; i++) {
+            serial_reactor_run_once(reactor, 100);
+        }
+        if (!added || !sent || peer.received_len != 3 || peer.readable > 2 || serial_reactor_count(reactor) != 0) {
+            printf("FAIL: Hang-up after data (%d read callbacks)\n", peer.readable);
+            failed++;
+        } else {
+            printf("PASS: Hang-up reported after the remaining data was read\n");
+        }
+        serial_reactor_remove(reactor, ends[0]);
+        close(ends[0]);
+    }
+
+    serial_reactor_destroy(reactor);
+    serial_close(port);
+    close(master);
+    return failed;
+}
+
+#else
+int run_serial_reactor_tests(void) {
+    return 0;
+}
+#endif
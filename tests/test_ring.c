@@ -0,0 +1,215 @@
+/**
+ * @file test_ring.c
+ * @brief Tests for the SPSC ring buffer and buffered handle mode
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include "test_serial.h"
+#include "../include/serial_functions.h"
+#include "../include/serial_ring.h"
+
+#if defined(__linux__)
+    #include <pthread.h>
+    #include <sched.h>
+#endif
+
+#define THREADED_BYTES (1u << 20)
+
+#if defined(__linux__)
+static void *ring_producer(void *arg) {
+    serial_ring_t *ring = arg;
+    uint8_t chunk[61];
+    uint32_t next = 0;
+
+    while (next < THREADED_BYTES) {
+        size_t size = sizeof(chunk);
+        if (size > THREADED_BYTES - next) {
+            size = THREADED_BYTES - next;
+        }
+        for (size_t i = 0; i < size; i++) {
+            chunk[i] = (uint8_t)((next + i) * 7u);
+        }
+        size_t written = 0;
+        while (written < size) {
+            size_t count = serial_ring_write(ring, chunk + written, size - written);
+            if (count == 0) {
+                sched_yield();  // let the consumer run on a single CPU
+            }
+            written += count;
+        }
+        next += (uint32_t)size;
+    }
+    return NULL;
+}
+#endif
+
+int run_serial_ring_tests(void) {
+    int failed = 0;
+    printf("\nRunning ring buffer tests...\n");
+
+    serial_ring_t *ring = serial_ring_create(100);
+    if (!ring || serial_ring_capacity(ring) != 128) {
+        printf("FAIL: Capacity not rounded to a power of two\n");
+        serial_ring_destroy(ring);
+        return 1;
+    }
+    printf("PASS: Capacity rounded to a power of two\n");
+
+    uint8_t data[200], out[200];
+    for (size_t i = 0; i < sizeof(data); i++) {
+        data[i] = (uint8_t)i;
+    }
+
+    if (serial_ring_write(ring, data, sizeof(data)) != 128 || serial_ring_space(ring) != 0 ||
+        serial_ring_write(ring, data, 1) != 0) {
+        printf("FAIL: Full ring accepted extra data\n");
+        failed++;
+    } else {
+        printf("PASS: Writes truncated when the ring is full\n");
+    }
+
+    // Drain part of it and write across the wrap-around point
+    serial_ring_read(ring, out, 100);
+    if (serial_ring_write(ring, data + 128, 72) != 72 || serial_ring_used(ring) != 100 ||
+        serial_ring_read(ring, out, sizeof(out)) != 100 ||
+        memcmp(out, data + 100, 28) != 0 || memcmp(out + 28, data + 128, 72) != 0) {
+        printf("FAIL: Data corrupted across wrap-around\n");
+        failed++;
+    } else {
+        printf("PASS: Data intact across wrap-around\n");
+    }
+
+    // Zero-copy reserve/commit and peek/consume
+    void *space;
+    const void *pending;
+    size_t room = serial_ring_reserve(ring, &space);
+    memcpy(space, data, 10);
+    serial_ring_commit(ring, 10);
+    size_t ready = serial_ring_peek(ring, &pending);
+    if (room == 0 || ready != 10 || memcmp(pending, data, 10) != 0) {
+        printf("FAIL: Reserve/commit and peek/consume mismatch\n");
+        failed++;
+    } else {
+        printf("PASS: Reserve/commit and peek/consume\n");
+    }
+    serial_ring_consume(ring, ready);
+    serial_ring_destroy(ring);
+
+#if defined(__linux__)
+    // One producer thread, one consumer: every byte arrives once, in order
+    ring = serial_ring_create(256);
+    pthread_t producer;
+    pthread_create(&producer, NULL, ring_producer, ring);
+
+    uint32_t received = 0;
+    int corrupt = 0;
+    while (received < THREADED_BYTES) {
+        uint8_t chunk[97];
+        size_t count = serial_ring_read(ring, chunk, sizeof(chunk));
+        if (count == 0) {
+            sched_yield();
+        }
+        for (size_t i = 0; i < count; i++) {
+            if (chunk[i] != (uint8_t)((received + i) * 7u)) {
+                corrupt = 1;
+            }
+        }
+        received += (uint32_t)count;
+    }
+    pthread_join(producer, NULL);
+    serial_ring_destroy(ring);
+
+    if (corrupt) {
+        printf("FAIL: Threaded transfer corrupted data\n");
+        failed++;
+    } else {
+        printf("PASS: Threaded transfer of %u bytes intact\n", THREADED_BYTES);
+    }
+#endif
+
+    return failed;
+}
+
+#if defined(__linux__)
+int run_serial_buffered_tests(void) {
+    int failed = 0;
+    printf("\nRunning buffered mode tests...\n");
+
+    char slave_path[64];
+    int master = open_test_pty(slave_path, sizeof(slave_path));
+    if (master < 0) {
+        printf("SKIP: Unable to allocate a pty\n");
+        return 0;
+    }
+    serial_handle_t port = serial_open(slave_path, NULL);
+    if (port == SERIAL_INVALID_HANDLE || serial_enable_buffering(port, NULL) != SERIAL_SUCCESS) {
+        printf("FAIL: Could not enable buffering\n");
+        close(master);
+        return 1;
+    }
+
+    if (serial_enable_buffering(port, NULL) == SERIAL_SUCCESS) {
+        printf("FAIL: Buffering enabled twice\n");
+        failed++;
+    } else {
+        printf("PASS: Buffering cannot be enabled twice\n");
+    }
+
+    size_t count;
+    char buffer[64];
+    if (serial_write(port, "1234", 4, &count) != SERIAL_SUCCESS || count != 4) {
+        printf("FAIL: Buffered write rejected\n");
+        failed++;
+    }
+
+    // The I/O thread delivers the bytes to the device side
+    size_t received = 0;
+    uint64_t deadline = serial_monotonic_ms() + 1000;
+    while (received < 4 && serial_monotonic_ms() < deadline) {
+        ssize_t result = read(master, buffer + received, sizeof(buffer) - received);
+        if (result > 0) {
+            received += (size_t)result;
+        }
+    }
+    if (received != 4 || memcmp(buffer, "1234", 4) != 0) {
+        printf("FAIL: Buffered write did not reach the device\n");
+        failed++;
+    } else {
+        printf("PASS: Buffered write reached the device\n");
+    }
+
+    if (write(master, "LED BLUE ON\r\n", 13) != 13) {
+        printf("FAIL: Could not write to pty master\n");
+        failed++;
+    }
+    int result = serial_read_until(port, buffer, sizeof(buffer), "\r\n", serial_monotonic_ms() + 1000, &count);
+    if (result != SERIAL_SUCCESS || count != 13 || memcmp(buffer, "LED BLUE ON\r\n", 13) != 0) {
+        printf("FAIL: Buffered read did not return the reply\n");
+        failed++;
+    } else {
+        printf("PASS: Buffered read returned the reply\n");
+    }
+
+    if (serial_wait_readable(port, 20) != SERIAL_ERROR_TIMEOUT) {
+        printf("FAIL: Empty buffered port reported readable\n");
+        failed++;
+    } else {
+        printf("PASS: Empty buffered port wait timed out\n");
+    }
+
+    if (serial_close(port) != SERIAL_SUCCESS) {
+        printf("FAIL: Closing a buffered handle failed\n");
+        failed++;
+    } else {
+        printf("PASS: Buffered handle closed\n");
+    }
+    close(master);
+    return failed;
+}
+#else
+int run_serial_buffered_tests(void) {
+    return 0;
+}
+#endif
@@ -0,0 +1,121 @@
+/**
+ * @file test_rt.c
+ * @brief Tests for real-time thread settings
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "test_serial.h"
+#include "../include/serial_emulator.h"
+#include "../include/serial_rt.h"
+
+#if defined(__linux__)
+
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+
+struct rt_thread_s {
+    struct serial_rt_config_s config;
+    int result;
+    unsigned applied;
+    int consistent;             // the thread's state matches the applied flags
+};
+
+static void *rt_thread_main(void *arg) {
+    struct rt_thread_s *thread = arg;
+    thread->result = serial_rt_apply(&thread->config, &thread->applied);
+
+    cpu_set_t cpus;
+    int policy;
+    struct sched_param param;
+    pthread_getaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+    pthread_getschedparam(pthread_self(), &policy, &param);
+    thread->consistent = (!(thread->applied & SERIAL_RT_PINNED) ||
+                          (CPU_COUNT(&cpus) == 1 && CPU_ISSET(thread->config.cpu, &cpus))) &&
+                         ((thread->applied & SERIAL_RT_FIFO) ? policy == SCHED_FIFO : policy == SCHED_OTHER);
+    return NULL;
+}
+
+// Settings the process may not use are skipped, and the flags say which took effect
+static int test_apply(void) {
+    struct rt_thread_s thread = { .config = { .cpu = 0, .priority = 10, .lock_memory = 1 } };
+    pthread_t id;
+    int ok = pthread_create(&id, NULL, rt_thread_main, &thread) == 0 && pthread_join(id, NULL) == 0 &&
+             thread.result == SERIAL_SUCCESS && thread.consistent;
+    // Only the main thread may lock the whole process
+    ok = ok && !(thread.applied & SERIAL_RT_LOCKED);
+
+    // Threads can still be created after the main thread asked for locked memory
+    struct serial_rt_config_s lock_only = { .cpu = -1, .lock_memory = 1 };
+    struct rt_thread_s later = { .config = { .cpu = -1 } };
+    unsigned main_applied = 0;
+    ok = ok && serial_rt_apply(&lock_only, &main_applied) == SERIAL_SUCCESS &&
+         pthread_create(&id, NULL, rt_thread_main, &later) == 0 && pthread_join(id, NULL) == 0;
+    if (main_applied & SERIAL_RT_LOCKED) {
+        munlockall();
+    }
+
+    struct serial_rt_config_s bad_cpu = { .cpu = -2 };
+    struct serial_rt_config_s bad_priority = { .cpu = -1, .priority = 100 };
+    ok = ok && serial_rt_apply(&bad_cpu, NULL) == SERIAL_ERROR_CONFIG &&
+         serial_rt_apply(&bad_priority, NULL) == SERIAL_ERROR_CONFIG;
+
+    if (!ok) {
+        printf("FAIL: Real-time settings (applied 0x%x)\n", thread.applied);
+        return 1;
+    }
+    printf("PASS: Real-time settings apply where permitted (pinned %s, SCHED_FIFO %s, memory locked %s)\n",
+           (thread.applied & SERIAL_RT_PINNED) ? "yes" : "no", (thread.applied & SERIAL_RT_FIFO) ? "yes" : "no",
+           (main_applied & SERIAL_RT_LOCKED) ? "yes" : "no");
+    return 0;
+}
+
+// A buffered handle and the emulator both run their threads with the settings
+static int test_threads(void) {
+    struct serial_rt_config_s rt = { .cpu = 0, .priority = 10 };
+    struct serial_emulator_config_s device = { .rt = &rt };
+    serial_emulator_t *emulator = serial_emulator_create(&device);
+    serial_handle_t port = emulator ? serial_open(serial_emulator_path(emulator), NULL) : SERIAL_INVALID_HANDLE;
+    if (port == SERIAL_INVALID_HANDLE) {
+        printf("FAIL: Could not start the emulator with real-time settings\n");
+        serial_emulator_destroy(emulator);
+        return 1;
+    }
+
+    struct serial_rt_config_s bad = { .cpu = -1, .priority = 1000 };
+    struct serial_buffer_config_s rejected = { .rt = &bad };
+    struct serial_buffer_config_s buffers = { .rt = &rt };
+    char reply[32];
+    size_t count = 0;
+    int ok = serial_enable_buffering(port, &rejected) == SERIAL_ERROR_CONFIG &&
+             serial_enable_buffering(port, &buffers) == SERIAL_SUCCESS &&
+             serial_write_all(port, "1", 1, 1000, &count) == SERIAL_SUCCESS &&
+             serial_read_until(port, reply, sizeof(reply), "\r\n", serial_monotonic_ms() + 1000, &count) ==
+                 SERIAL_SUCCESS &&
+             count == 12 && memcmp(reply, "LED RED ON\r\n", 12) == 0;
+    serial_close(port);
+    serial_emulator_destroy(emulator);
+
+    struct serial_emulator_config_s bad_device = { .rt = &bad };
+    if (!ok || serial_emulator_create(&bad_device) != NULL) {
+        printf("FAIL: Buffered I/O thread and emulator with real-time settings\n");
+        return 1;
+    }
+    printf("PASS: Buffered I/O thread and emulator run with real-time settings\n");
+    return 0;
+}
+#endif
+
+int run_serial_rt_tests(void) {
+    int failed = 0;
+    printf("\nRunning real-time settings tests...\n");
+
+#if defined(__linux__)
+    failed += test_apply();
+    failed += test_threads();
+#else
+    printf("SKIP: Real-time settings are only available on Linux\n");
+#endif
+    return failed;
+}
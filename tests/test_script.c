@@ -0,0 +1,136 @@
+/**
+ * @file test_script.c
+ * @brief Tests for led_control's batch mode
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "test_serial.h"
+#include "../include/serial_emulator.h"
+#include "../src/led_script.h"
+
+#if defined(__linux__)
+#include <unistd.h>
+#endif
+
+// Parses a copy of the line in a buffer of exactly its length, as lines are read from a script
+static int parses_to(const char *line, uint8_t kind, uint8_t cmd, uint8_t mask, uint32_t wait_ms) {
+    struct led_script_command_s command;
+    size_t length = strlen(line);
+    char *exact = malloc(length > 0 ? length : 1);
+    if (!exact) {
+        return 0;
+    }
+    memcpy(exact, line, length);
+    int ok = led_script_parse_line(exact, length, &command) == SERIAL_SUCCESS && command.kind == kind &&
+             command.cmd == cmd && command.mask == mask && command.wait_ms == wait_ms;
+    free(exact);
+    return ok;
+}
+
+static int rejects(const char *line) {
+    struct led_script_command_s command;
+    return led_script_parse_line(line, strlen(line), &command) == SERIAL_ERROR_CONFIG;
+}
+
+static int test_parse(void) {
+    int valid = parses_to("2", LED_SCRIPT_COMMAND, SERIAL_CMD_LED_ON, SERIAL_LED_YELLOW, 0) &&
+                parses_to("4", LED_SCRIPT_COMMAND, SERIAL_CMD_LED_SET, 0, 0) &&
+                parses_to("  on Red , blue  # both", LED_SCRIPT_COMMAND, SERIAL_CMD_LED_ON,
+                          SERIAL_LED_RED | SERIAL_LED_BLUE, 0) &&
+                parses_to("on red , blue#x", LED_SCRIPT_COMMAND, SERIAL_CMD_LED_ON,
+                          SERIAL_LED_RED | SERIAL_LED_BLUE, 0) &&
+                parses_to("off yellow  ,red", LED_SCRIPT_COMMAND, SERIAL_CMD_LED_OFF,
+                          SERIAL_LED_YELLOW | SERIAL_LED_RED, 0) &&
+                parses_to("off all", LED_SCRIPT_COMMAND, SERIAL_CMD_LED_OFF, SERIAL_LED_ALL, 0) &&
+                parses_to("set none", LED_SCRIPT_COMMAND, SERIAL_CMD_LED_SET, 0, 0) &&
+                parses_to("GET", LED_SCRIPT_COMMAND, SERIAL_CMD_GET_STATE, 0, 0) &&
+                parses_to("wait 250", LED_SCRIPT_WAIT, 0, 0, 250) &&
+                parses_to("   # comment only", LED_SCRIPT_EMPTY, 0, 0, 0) &&
+                parses_to("", LED_SCRIPT_EMPTY, 0, 0, 0);
+    int invalid = rejects("5") && rejects("12") && rejects("on") && rejects("on green") &&
+                  rejects("on red,") && rejects("get red") && rejects("wait") && rejects("wait -1") &&
+                  rejects("blink red");
+    if (!valid || !invalid) {
+        printf("FAIL: Script line parsing\n");
+        return 1;
+    }
+    printf("PASS: Script lines parsed, invalid lines rejected\n");
+    return 0;
+}
+
+#if defined(__linux__)
+// Runs a script fed through a pipe against a fresh emulator
+static int run_against_emulator(const char *script, uint8_t *led_state, struct led_script_summary_s *summary) {
+    int fds[2];
+    serial_emulator_t *emulator = serial_emulator_create(NULL);
+    serial_handle_t port = emulator ? serial_open(serial_emulator_path(emulator), NULL) : SERIAL_INVALID_HANDLE;
+    if (port == SERIAL_INVALID_HANDLE || pipe(fds) != 0) {
+        if (port != SERIAL_INVALID_HANDLE) {
+            serial_close(port);
+        }
+        serial_emulator_destroy(emulator);
+        return -1;
+    }
+
+    size_t length = strlen(script);
+    int result = write(fds[1], script, length) == (ssize_t)length ? SERIAL_SUCCESS : -1;
+    close(fds[1]);
+    if (result == SERIAL_SUCCESS) {
+        struct led_script_options_s options = { .window = 4, .timeout_ms = 1000 };
+        result = led_script_run(port, fds[0], &options, summary);
+    }
+    close(fds[0]);
+
+    *led_state = serial_emulator_led_state(emulator);
+    serial_close(port);
+    serial_emulator_destroy(emulator);
+    return result;
+}
+
+static int test_run(void) {
+    int failed = 0;
+    struct led_script_summary_s summary;
+    uint8_t led_state = 0;
+
+    // The last line has no newline and must still run
+    int result = run_against_emulator("# burn-in\n1\non blue\n\nwait 0\nget\noff red\nset yellow,blue\nget",
+                                      &led_state, &summary);
+    if (result < 0) {
+        printf("SKIP: Unable to start the emulator\n");
+        return 0;
+    }
+    if (result != SERIAL_SUCCESS || summary.commands != 6 || summary.waits != 1 || summary.naks != 0 ||
+        summary.timeouts != 0 || summary.latency.count != 6 ||
+        led_state != (SERIAL_LED_YELLOW | SERIAL_LED_BLUE)) {
+        printf("FAIL: Script run against the emulator (%d, %llu commands, LEDs 0x%02x)\n", result,
+               (unsigned long long)summary.commands, (unsigned)led_state);
+        failed++;
+    } else {
+        printf("PASS: Script runs every command and records latencies\n");
+    }
+
+    // Commands before a bad line run, nothing after it does
+    result = run_against_emulator("on red\non blue\nflash\non yellow\n", &led_state, &summary);
+    if (result != SERIAL_ERROR_CONFIG || summary.error_line != 3 || summary.commands != 2 ||
+        led_state != (SERIAL_LED_RED | SERIAL_LED_BLUE)) {
+        printf("FAIL: Script stops at an invalid line (%d, line %u)\n", result, summary.error_line);
+        failed++;
+    } else {
+        printf("PASS: Script stops at the first invalid line\n");
+    }
+    return failed;
+}
+#endif
+
+int run_serial_script_tests(void) {
+    int failed = 0;
+    printf("\nRunning batch script tests...\n");
+
+    failed += test_parse();
+#if defined(__linux__)
+    failed += test_run();
+#endif
+    return failed;
+}
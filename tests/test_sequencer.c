@@ -0,0 +1,118 @@
+/**
+ * @file test_sequencer.c
+ * @brief Tests for the deadline-scheduled command sequencer
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "test_serial.h"
+#include "../include/serial_sequencer.h"
+
+#if defined(__linux__)
+
+#define STEPS 40
+#define PERIOD_NS 2000000ull
+#define LATE_LIMIT_NS 20000000ull   // generous: the test machine may be loaded
+
+// Sends STEPS bytes 2 ms apart; the run has to end on time and deliver them in order
+static int run_timeline(serial_handle_t port, int master, const struct serial_sequencer_config_s *config,
+                        const char *name) {
+    char data[STEPS];
+    struct serial_sequence_step_s steps[STEPS];
+    for (int i = 0; i < STEPS; i++) {
+        data[i] = (char)('A' + i % 26);
+        steps[i] = (struct serial_sequence_step_s){ .due_ns = (uint64_t)i * PERIOD_NS, .data = &data[i], .length = 1 };
+    }
+
+    static struct serial_sequencer_report_s report;
+    int result = serial_sequencer_run(port, steps, STEPS, config, &report);
+    char received[STEPS];
+    size_t total = 0;
+    uint64_t deadline = serial_monotonic_ms() + 1000;
+    while (total < STEPS && serial_monotonic_ms() < deadline) {
+        ssize_t count = read(master, received + total, STEPS - total);
+        total += count > 0 ? (size_t)count : 0;
+    }
+
+    uint64_t planned_ns = (STEPS - 1) * PERIOD_NS;
+    if (result != SERIAL_SUCCESS || report.sent != STEPS || report.skipped != 0 ||
+        report.dispatch_lateness.count != STEPS || total != STEPS || memcmp(received, data, STEPS) != 0 ||
+        report.elapsed_ns < planned_ns || report.elapsed_ns > planned_ns + LATE_LIMIT_NS) {
+        printf("FAIL: Timeline paced by %s (%zu bytes, %.2f ms for %.2f ms planned)\n", name, total,
+               (double)report.elapsed_ns / 1e6, (double)planned_ns / 1e6);
+        return 1;
+    }
+    printf("PASS: Timeline paced by %s ends on time (p99 %.1f us late)\n", name,
+           (double)serial_histogram_quantile(&report.dispatch_lateness, 0.99) / 1e3);
+    return 0;
+}
+
+static int test_sequencer(void) {
+    int failed = 0;
+    char slave_path[64];
+    int master = open_test_pty(slave_path, sizeof(slave_path));
+    if (master < 0) {
+        printf("SKIP: Unable to allocate a pty\n");
+        return 0;
+    }
+    serial_handle_t port = serial_open(slave_path, NULL);
+    if (port == SERIAL_INVALID_HANDLE) {
+        printf("FAIL: Could not open the pty\n");
+        close(master);
+        return 1;
+    }
+
+    struct serial_sequencer_config_s config = { .wait = SERIAL_SEQUENCER_TIMERFD };
+    failed += run_timeline(port, master, &config, "timerfd");
+    config = (struct serial_sequencer_config_s){ .wait = SERIAL_SEQUENCER_NANOSLEEP, .spin_ns = 50000 };
+    failed += run_timeline(port, master, &config, "clock_nanosleep with spin");
+
+    // A timeline that started a second ago: steps more than 100 ms late are dropped
+    struct serial_sequence_step_s steps[4] = {
+        { .due_ns = 0, .data = "a", .length = 1 }, { .due_ns = 500000000u, .data = "b", .length = 1 },
+        { .due_ns = 950000000u, .data = "c", .length = 1 }, { .due_ns = 1010000000u, .data = "d", .length = 1 },
+    };
+    static struct serial_sequencer_report_s report;
+    config = (struct serial_sequencer_config_s){
+        .skip_late_ns = 100000000u, .start_ns = serial_monotonic_ns() - 1000000000u,
+    };
+    int result = serial_sequencer_run(port, steps, 4, &config, &report);
+    char received[4];
+    ssize_t count = 0;
+    for (uint64_t deadline = serial_monotonic_ms() + 1000; count < 2 && serial_monotonic_ms() < deadline;) {
+        ssize_t more = read(master, received + count, sizeof(received) - (size_t)count);
+        count += more > 0 ? more : 0;
+    }
+    if (result != SERIAL_SUCCESS || report.sent != 2 || report.skipped != 2 || count != 2 ||
+        memcmp(received, "cd", 2) != 0) {
+        printf("FAIL: Late steps are skipped\n");
+        failed++;
+    } else {
+        printf("PASS: Late steps are skipped\n");
+    }
+
+    steps[0].due_ns = 2000000000u;
+    if (serial_sequencer_run(port, steps, 4, NULL, NULL) != SERIAL_ERROR_CONFIG) {
+        printf("FAIL: Unsorted timeline is rejected\n");
+        failed++;
+    } else {
+        printf("PASS: Unsorted timeline is rejected\n");
+    }
+
+    serial_close(port);
+    close(master);
+    return failed;
+}
+#endif
+
+int run_serial_sequencer_tests(void) {
+    int failed = 0;
+    printf("\nRunning sequencer tests...\n");
+
+#if defined(__linux__)
+    failed += test_sequencer();
+#else
+    printf("SKIP: The sequencer is only available on Linux\n");
+#endif
+    return failed;
+}
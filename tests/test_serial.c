@@ -13,6 +13,9 @@
 #if defined(__linux__)
     #include <fcntl.h>
     #include <unistd.h>
+    #include <stdlib.h>
+    #include <pthread.h>
+    #include "../include/serial_stats.h"
     #define TEST_PORT "/dev/ttyUSB0"
 #elif defined(_WIN32)
     #include <windows.h>
@@ -169,4 +172,461 @@ int run_serial_io_tests(void) {
     }
 
     return failed;
-}
\ No newline at end of file
+}
+
+#if defined(__linux__)
+// Opens a pty pair and returns the master fd, storing the slave path
+int open_test_pty(char *slave_path, size_t size) {
+    int master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (master < 0) {
+        return -1;
+    }
+    if (grantpt(master) != 0 || unlockpt(master) != 0 || ptsname_r(master, slave_path, size) != 0) {
+        close(master);
+        return -1;
+    }
+    return master;
+}
+
+// Creates an empty file from a mkstemp() template, replacing the XXXXXX in path
+int make_temp_path(char *path) {
+    int fd = mkstemp(path);
+    if (fd < 0) {
+        return -1;
+    }
+    close(fd);
+    return 0;
+}
+
+// Test event-driven waiting on a pty loopback
+int run_serial_wait_tests(void) {
+    int failed = 0;
+    printf("\nRunning wait/read-until tests...\n");
+
+    char slave_path[64];
+    int master = open_test_pty(slave_path, sizeof(slave_path));
+    if (master < 0) {
+        printf("SKIP: Unable to allocate a pty\n");
+        return 0;
+    }
+
+    serial_handle_t port = serial_open(slave_path, NULL);
+    if (port == SERIAL_INVALID_HANDLE) {
+        printf("FAIL: Could not open pty slave %s\n", slave_path);
+        close(master);
+        return 1;
+    }
+
+    if (serial_wait_readable(port, 20) != SERIAL_ERROR_TIMEOUT) {
+        printf("FAIL: Idle port reported readable\n");
+        failed++;
+    } else {
+        printf("PASS: Idle port wait timed out\n");
+    }
+
+    const char reply[] = "LED RED ON\r\n";
+    if (write(master, reply, sizeof(reply) - 1) != (ssize_t)(sizeof(reply) - 1)) {
+        printf("FAIL: Could not write to pty master\n");
+        failed++;
+    }
+
+    if (serial_wait_readable(port, 1000) != SERIAL_SUCCESS) {
+        printf("FAIL: Port not readable after data arrived\n");
+        failed++;
+    } else {
+        printf("PASS: Port readable after data arrived\n");
+    }
+
+    char buffer[64];
+    size_t bytes_read;
+    uint64_t start = serial_monotonic_ms();
+    int result = serial_read_until(port, buffer, sizeof(buffer), "\r\n", start + 1000, &bytes_read);
+    if (result != SERIAL_SUCCESS || bytes_read != sizeof(reply) - 1 ||
+        memcmp(buffer, reply, bytes_read) != 0) {
+        printf("FAIL: read_until did not return the full line\n");
+        failed++;
+    } else if (serial_monotonic_ms() - start > 100) {
+        printf("FAIL: read_until did not return promptly\n");
+        failed++;
+    } else {
+        printf("PASS: read_until returned the full line\n");
+    }
+
+    // Delimiter split across two writes
+    if (write(master, "LEDS OFF\r", 9) != 9 || write(master, "\n", 1) != 1) {
+        printf("FAIL: Could not write to pty master\n");
+        failed++;
+    }
+    result = serial_read_until(port, buffer, sizeof(buffer), "\r\n", serial_monotonic_ms() + 1000, &bytes_read);
+    if (result != SERIAL_SUCCESS || bytes_read != 10) {
+        printf("FAIL: read_until missed a split delimiter\n");
+        failed++;
+    } else {
+        printf("PASS: read_until found a split delimiter\n");
+    }
+
+    // Missing delimiter times out with partial data
+    if (write(master, "partial", 7) != 7) {
+        printf("FAIL: Could not write to pty master\n");
+        failed++;
+    }
+    result = serial_read_until(port, buffer, sizeof(buffer), "\r\n", serial_monotonic_ms() + 50, &bytes_read);
+    if (result != SERIAL_ERROR_TIMEOUT || bytes_read != 7) {
+        printf("FAIL: read_until did not time out with partial data\n");
+        failed++;
+    } else {
+        printf("PASS: read_until timed out with partial data\n");
+    }
+
+    // Buffer fills before the delimiter
+    if (write(master, "0123456789", 10) != 10) {
+        printf("FAIL: Could not write to pty master\n");
+        failed++;
+    }
+    result = serial_read_until(port, buffer, 4, "\r\n", serial_monotonic_ms() + 1000, &bytes_read);
+    if (result != SERIAL_ERROR_OVERFLOW || bytes_read != 4) {
+        printf("FAIL: read_until did not report overflow\n");
+        failed++;
+    } else {
+        printf("PASS: read_until reported overflow\n");
+    }
+
+    serial_close(port);
+    close(master);
+    return failed;
+}
+
+#define VECTOR_TEST_BYTES (256u * 1024u)
+
+struct drain_state_s {
+    int fd;
+    size_t received;
+    int corrupt;
+};
+
+// Reads the device side of a pty until VECTOR_TEST_BYTES have arrived
+static void *drain_master(void *arg) {
+    struct drain_state_s *state = arg;
+    unsigned char buffer[4096];
+    while (state->received < VECTOR_TEST_BYTES) {
+        ssize_t count = read(state->fd, buffer, sizeof(buffer));
+        if (count <= 0) {
+            break;
+        }
+        for (ssize_t i = 0; i < count; i++) {
+            if (buffer[i] != (unsigned char)((state->received + (size_t)i) % 251u)) {
+                state->corrupt = 1;
+            }
+        }
+        state->received += (size_t)count;
+    }
+    return NULL;
+}
+
+// Test scatter-gather I/O and complete writes on a pty loopback
+int run_serial_vector_tests(void) {
+    int failed = 0;
+    printf("\nRunning scatter-gather tests...\n");
+
+    char slave_path[64];
+    int master = open_test_pty(slave_path, sizeof(slave_path));
+    if (master < 0) {
+        printf("SKIP: Unable to allocate a pty\n");
+        return 0;
+    }
+    serial_handle_t port = serial_open(slave_path, NULL);
+    if (port == SERIAL_INVALID_HANDLE) {
+        printf("FAIL: Could not open pty slave %s\n", slave_path);
+        close(master);
+        return 1;
+    }
+
+    char header[] = "HDR", payload[] = "payload", crc[] = "CC";
+    struct iovec frame[] = {
+        { .iov_base = header, .iov_len = 3 },
+        { .iov_base = payload, .iov_len = 7 },
+        { .iov_base = crc, .iov_len = 2 },
+    };
+    size_t count;
+    char buffer[64];
+    if (serial_writev(port, frame, 3, &count) != SERIAL_SUCCESS || count != 12 ||
+        read(master, buffer, sizeof(buffer)) != 12 || memcmp(buffer, "HDRpayloadCC", 12) != 0) {
+        printf("FAIL: writev did not send the concatenated buffers\n");
+        failed++;
+    } else {
+        printf("PASS: writev sent the concatenated buffers\n");
+    }
+
+    char first[4], second[8];
+    struct iovec parts[] = {
+        { .iov_base = first, .iov_len = sizeof(first) },
+        { .iov_base = second, .iov_len = sizeof(second) },
+    };
+    if (write(master, "LEDS OFF\r\n", 10) != 10 || serial_wait_readable(port, 1000) != SERIAL_SUCCESS ||
+        serial_readv(port, parts, 2, &count) != SERIAL_SUCCESS || count != 10 ||
+        memcmp(first, "LEDS", 4) != 0 || memcmp(second, " OFF\r\n", 6) != 0) {
+        printf("FAIL: readv did not scatter the reply\n");
+        failed++;
+    } else {
+        printf("PASS: readv scattered the reply\n");
+    }
+
+    static unsigned char pattern[VECTOR_TEST_BYTES];
+    for (size_t i = 0; i < sizeof(pattern); i++) {
+        pattern[i] = (unsigned char)(i % 251u);
+    }
+
+    // Nobody drains the device side, so the kernel queue fills up
+    uint64_t start = serial_monotonic_ms();
+    int result = serial_write_all(port, pattern, sizeof(pattern), 50, &count);
+    if (result != SERIAL_ERROR_TIMEOUT || count == 0 || count >= sizeof(pattern) ||
+        serial_monotonic_ms() - start > 500) {
+        printf("FAIL: write_all did not time out on a full queue\n");
+        failed++;
+    } else {
+        printf("PASS: write_all timed out on a full queue after %zu bytes\n", count);
+    }
+    tcflush(port, TCOFLUSH);
+    tcflush(master, TCIFLUSH);
+
+    // With a reader on the device side every byte arrives in order
+    struct drain_state_s drain = { .fd = master };
+    pthread_t thread;
+    pthread_create(&thread, NULL, drain_master, &drain);
+    struct iovec split[] = {
+        { .iov_base = pattern, .iov_len = 1000 },
+        { .iov_base = pattern + 1000, .iov_len = 0 },
+        { .iov_base = pattern + 1000, .iov_len = sizeof(pattern) - 1000 },
+    };
+    result = serial_writev_all(port, split, 3, 5000, &count);
+    pthread_join(thread, NULL);
+    if (result != SERIAL_SUCCESS || count != sizeof(pattern) || drain.received != sizeof(pattern) ||
+        drain.corrupt) {
+        printf("FAIL: writev_all lost or reordered data\n");
+        failed++;
+    } else {
+        printf("PASS: writev_all delivered %zu bytes in order\n", count);
+    }
+
+    serial_close(port);
+    close(master);
+    return failed;
+}
+
+// Test that standard, high and arbitrary rates round-trip on a pty
+int run_serial_baud_tests(void) {
+    int failed = 0;
+    printf("\nRunning baud rate tests...\n");
+
+    static const uint32_t RATES[] = {9600, 115200, 230400, 921600, 1000000, 2000000, 4000000, 250000, 31250};
+    char slave_path[64];
+    int master = open_test_pty(slave_path, sizeof(slave_path));
+    if (master < 0) {
+        printf("SKIP: Unable to allocate a pty\n");
+        return 0;
+    }
+
+    for (size_t i = 0; i < sizeof(RATES) / sizeof(RATES[0]); i++) {
+        struct serial_config_s config = {
+            .baud_rate = RATES[i],
+            .data_bits = 8,
+            .stop_bits = 1,
+            .parity = 0
+        };
+        uint32_t applied = 0;
+        serial_handle_t port = serial_open(slave_path, &config);
+        if (port == SERIAL_INVALID_HANDLE || serial_get_baud(port, &applied) != SERIAL_SUCCESS ||
+            applied != RATES[i]) {
+            printf("FAIL: %u baud did not round-trip (got %u)\n", (unsigned)RATES[i], (unsigned)applied);
+            failed++;
+        } else {
+            printf("PASS: %u baud round-trips\n", (unsigned)RATES[i]);
+        }
+        if (port != SERIAL_INVALID_HANDLE) {
+            serial_close(port);
+        }
+    }
+
+    struct serial_config_s zero = { .baud_rate = 0, .data_bits = 8, .stop_bits = 1, .parity = 0 };
+    serial_handle_t port = serial_open(slave_path, &zero);
+    if (port != SERIAL_INVALID_HANDLE) {
+        printf("FAIL: Opened with a zero baud rate\n");
+        failed++;
+        serial_close(port);
+    } else {
+        printf("PASS: Zero baud rate rejected\n");
+    }
+
+    close(master);
+    return failed;
+}
+
+// Test that enabled statistics count the syscalls and round trips on a pty
+int run_serial_stats_tests(void) {
+    int failed = 0;
+    printf("\nRunning statistics tests...\n");
+
+    char slave_path[64];
+    int master = open_test_pty(slave_path, sizeof(slave_path));
+    if (master < 0) {
+        printf("SKIP: Unable to allocate a pty\n");
+        return 0;
+    }
+    serial_handle_t port = serial_open(slave_path, NULL);
+    struct serial_stats_s *stats = calloc(1, sizeof(*stats));
+    if (port == SERIAL_INVALID_HANDLE || !stats) {
+        printf("FAIL: Could not open pty slave %s\n", slave_path);
+        free(stats);
+        close(master);
+        return 1;
+    }
+
+    if (serial_get_stats(port, stats) != SERIAL_ERROR_INVALID_HANDLE ||
+        serial_enable_stats(port) != SERIAL_SUCCESS) {
+        printf("FAIL: Stats reported before being enabled\n");
+        failed++;
+    }
+
+    size_t count;
+    char buffer[64];
+    int empty = serial_read(port, buffer, sizeof(buffer), &count);
+    int sent = serial_write(port, "1", 1, &count);
+    int echoed = read(master, buffer, sizeof(buffer)) == 1 && write(master, "LED RED ON\r\n", 12) == 12;
+    if (empty != SERIAL_SUCCESS || sent != SERIAL_SUCCESS || !echoed ||
+        serial_read_until(port, buffer, sizeof(buffer), "\r\n", serial_monotonic_ms() + 1000, &count) !=
+            SERIAL_SUCCESS ||
+        serial_get_stats(port, stats) != SERIAL_SUCCESS) {
+        printf("FAIL: Round trip on the pty failed\n");
+        failed++;
+    } else if (stats->bytes_written != 1 || stats->write_syscalls != 1 || stats->bytes_read != 12 ||
+               stats->read_syscalls < 2 || stats->read_eagain < 1 || stats->first_byte_latency.count != 1 ||
+               stats->first_byte_latency.max_ns == 0) {
+        printf("FAIL: Counters wrong (%llu/%llu written, %llu/%llu read, %llu EAGAIN, %llu samples)\n",
+               (unsigned long long)stats->bytes_written, (unsigned long long)stats->write_syscalls,
+               (unsigned long long)stats->bytes_read, (unsigned long long)stats->read_syscalls,
+               (unsigned long long)stats->read_eagain, (unsigned long long)stats->first_byte_latency.count);
+        failed++;
+    } else {
+        printf("PASS: Bytes, syscalls, EAGAIN and one round trip of %.1f us counted\n",
+               stats->first_byte_latency.max_ns / 1e3);
+    }
+
+    // Nobody drains the device side: the first write is cut short, the next finds the queue full
+    static unsigned char pattern[VECTOR_TEST_BYTES];
+    serial_write(port, pattern, sizeof(pattern), &count);
+    serial_write(port, pattern, sizeof(pattern), &count);
+    if (serial_get_stats(port, stats) != SERIAL_SUCCESS || stats->short_writes < 1 || stats->write_eagain < 1 ||
+        stats->write_errors != 0) {
+        printf("FAIL: Short write or full queue not counted\n");
+        failed++;
+    } else {
+        printf("PASS: Short write and full queue counted\n");
+    }
+    tcflush(port, TCOFLUSH);
+
+    struct serial_histogram_s *histogram = &stats->first_byte_latency;
+    memset(histogram, 0, sizeof(*histogram));
+    histogram->counts[5] = 90;      // exactly 5 ns
+    histogram->counts[64] = 10;     // 1024..1151 ns
+    histogram->count = 100;
+    histogram->max_ns = 1100;
+    if (serial_histogram_quantile(histogram, 0.5) != 5 || serial_histogram_quantile(histogram, 0.99) != 1100 ||
+        serial_histogram_quantile(histogram, 0.9) != 5) {
+        printf("FAIL: Histogram quantiles wrong\n");
+        failed++;
+    } else {
+        printf("PASS: Histogram quantiles\n");
+    }
+
+    if (serial_disable_stats(port) != SERIAL_SUCCESS || serial_get_stats(port, stats) == SERIAL_SUCCESS) {
+        printf("FAIL: Stats still reported after being disabled\n");
+        failed++;
+    }
+
+    free(stats);
+    serial_close(port);
+    close(master);
+    return failed;
+}
+
+// Test the latency profiles: VMIN/VTIME and discarding stale input on open
+int run_serial_latency_tests(void) {
+    int failed = 0;
+    printf("\nRunning latency mode tests...\n");
+
+    char slave_path[64];
+    int master = open_test_pty(slave_path, sizeof(slave_path));
+    if (master < 0) {
+        printf("SKIP: Unable to allocate a pty\n");
+        return 0;
+    }
+    struct serial_config_s config = { .baud_rate = 115200, .data_bits = 8, .stop_bits = 1, .parity = 0 };
+    struct termios options;
+    size_t count;
+    char buffer[16];
+
+    // The throughput profile keeps input that arrived before the open
+    if (write(master, "stale", 5) != 5) {
+        printf("FAIL: Could not write to pty master\n");
+        failed++;
+    }
+    serial_handle_t throughput = serial_open(slave_path, &config);
+    if (throughput == SERIAL_INVALID_HANDLE || tcgetattr(throughput, &options) != 0 ||
+        options.c_cc[VMIN] != 1 || options.c_cc[VTIME] != 1 ||
+        serial_wait_readable(throughput, 1000) != SERIAL_SUCCESS ||
+        serial_read(throughput, buffer, sizeof(buffer), &count) != SERIAL_SUCCESS || count != 5) {
+        printf("FAIL: Throughput profile not applied\n");
+        failed++;
+    } else {
+        printf("PASS: Throughput profile sets VMIN=1 VTIME=1 and keeps queued input\n");
+    }
+
+    // The low-latency profile discards it; ASYNC_LOW_LATENCY is not supported on a pty and is skipped
+    config.latency_mode = SERIAL_LATENCY_LOW;
+    if (write(master, "stale", 5) != 5 || serial_wait_readable(throughput, 1000) != SERIAL_SUCCESS) {
+        printf("FAIL: Could not queue stale input\n");
+        failed++;
+    }
+    serial_handle_t low = serial_open(slave_path, &config);
+    int stale = low == SERIAL_INVALID_HANDLE || serial_read(low, buffer, sizeof(buffer), &count) != SERIAL_SUCCESS ||
+                count != 0;
+    int fresh = low != SERIAL_INVALID_HANDLE && write(master, "LED RED ON\r\n", 12) == 12 &&
+                serial_read_until(low, buffer, sizeof(buffer), "\r\n", serial_monotonic_ms() + 1000, &count) ==
+                    SERIAL_SUCCESS && count == 12;
+    if (stale || !fresh || tcgetattr(low, &options) != 0 || options.c_cc[VMIN] != 1 || options.c_cc[VTIME] != 0) {
+        printf("FAIL: Low-latency profile not applied (stale %d, fresh %d)\n", stale, fresh);
+        failed++;
+    } else {
+        printf("PASS: Low-latency profile sets VMIN=1 VTIME=0 and flushes stale input\n");
+    }
+
+    if (low != SERIAL_INVALID_HANDLE) {
+        serial_close(low);
+    }
+    if (throughput != SERIAL_INVALID_HANDLE) {
+        serial_close(throughput);
+    }
+    close(master);
+    return failed;
+}
+#else
+int run_serial_latency_tests(void) {
+    return 0;
+}
+
+int run_serial_stats_tests(void) {
+    return 0;
+}
+
+int run_serial_wait_tests(void) {
+    return 0;
+}
+
+int run_serial_baud_tests(void) {
+    return 0;
+}
+
+int run_serial_vector_tests(void) {
+    return 0;
+}
+#endif
@@ -6,13 +6,41 @@
 #ifndef TEST_SERIAL_H
 #define TEST_SERIAL_H
 
+#include <stddef.h>
+
 // Test suite functions
 int run_serial_config_tests(void);
 int run_serial_port_tests(void);
 int run_serial_io_tests(void);
+int run_serial_wait_tests(void);
+int run_serial_vector_tests(void);
+int run_serial_baud_tests(void);
+int run_serial_reactor_tests(void);
+int run_serial_ring_tests(void);
+int run_serial_buffered_tests(void);
+int run_serial_frame_tests(void);
+int run_serial_client_tests(void);
+int run_serial_emulator_tests(void);
+int run_serial_stats_tests(void);
+int run_serial_latency_tests(void);
+int run_serial_aio_tests(void);
+int run_serial_lines_tests(void);
+int run_serial_script_tests(void);
+int run_serial_capture_tests(void);
+int run_serial_transport_tests(void);
+int run_serial_mux_tests(void);
+int run_serial_shadow_tests(void);
+int run_serial_firmware_tests(void);
+int run_serial_sequencer_tests(void);
+int run_serial_rt_tests(void);
+int run_serial_broadcast_tests(void);
+int run_serial_telemetry_tests(void);
+int run_serial_trace_tests(void);
 
 // Helper functions
 void setup_test_environment(void);
 void cleanup_test_environment(void);
+int open_test_pty(char *slave_path, size_t size);
+int make_temp_path(char *path);
 
 #endif // TEST_SERIAL_H
\ No newline at end of file
@@ -0,0 +1,205 @@
+/**
+ * @file test_shadow.c
+ * @brief Tests for the LED state mirror, against the emulated device
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "test_serial.h"
+#include "../include/serial_emulator.h"
+#include "../include/serial_shadow.h"
+
+// Commands that change nothing are recognised only for LEDs whose state is known
+static int test_led_state(void) {
+    struct serial_led_state_s state = {0, 0};
+    uint8_t red = SERIAL_LED_RED, none = 0;
+    uint8_t noop_batch[] = {SERIAL_CMD_LED_ON, SERIAL_LED_RED, SERIAL_CMD_LED_OFF, SERIAL_LED_BLUE};
+    uint8_t changing_batch[] = {SERIAL_CMD_LED_ON, SERIAL_LED_RED, SERIAL_CMD_LED_ON, SERIAL_LED_BLUE};
+    uint8_t bad_batch[] = {SERIAL_CMD_LED_SET, SERIAL_LED_RED, SERIAL_CMD_GET_STATE, 0};
+    int ok = !serial_led_state_is_noop(&state, SERIAL_CMD_LED_OFF, &red, 1) &&
+             serial_led_state_is_noop(&state, SERIAL_CMD_LED_OFF, &none, 1);
+
+    serial_led_state_apply(&state, SERIAL_CMD_LED_ON, &red, 1);
+    ok = ok && state.leds == SERIAL_LED_RED && state.known == SERIAL_LED_RED &&
+         serial_led_state_is_noop(&state, SERIAL_CMD_LED_ON, &red, 1) &&
+         !serial_led_state_is_noop(&state, SERIAL_CMD_LED_SET, &red, 1);
+
+    serial_led_state_apply(&state, SERIAL_CMD_LED_SET, &red, 1);
+    ok = ok && state.known == SERIAL_SHADOW_KNOWN_ALL &&
+         serial_led_state_is_noop(&state, SERIAL_CMD_LED_SET, &red, 1) &&
+         serial_led_state_is_noop(&state, SERIAL_CMD_BATCH, noop_batch, sizeof(noop_batch)) &&
+         !serial_led_state_is_noop(&state, SERIAL_CMD_BATCH, changing_batch, sizeof(changing_batch)) &&
+         !serial_led_state_is_noop(&state, SERIAL_CMD_LED_ON, &red, 0);
+
+    // The sketch NAKs the GET_STATE step after applying the first one
+    serial_led_state_apply(&state, SERIAL_CMD_BATCH, bad_batch, sizeof(bad_batch));
+    ok = ok && state.known == 0;
+
+    if (!ok) {
+        printf("FAIL: LED state no-op detection\n");
+        return 1;
+    }
+    printf("PASS: LED state no-op detection\n");
+    return 0;
+}
+
+#if defined(__linux__)
+
+#include <unistd.h>
+
+struct completion_s {
+    unsigned calls;
+    int status;
+    uint8_t reply_cmd;
+    uint8_t leds;
+    uint64_t latency_ns;
+};
+
+static void on_complete(serial_client_t *client, int status, const struct serial_frame_s *reply,
+                        uint64_t latency_ns, void *user_data) {
+    struct completion_s *completion = user_data;
+    (void)client;
+    completion->calls++;
+    completion->status = status;
+    completion->reply_cmd = status == SERIAL_SUCCESS ? reply->cmd : 0;
+    completion->leds = status == SERIAL_SUCCESS && reply->length >= 2 ? reply->payload[1] : 0;
+    completion->latency_ns = latency_ns;
+}
+
+// Submits one command and waits for it; returns the number of frames the device handled for it
+static int run(serial_shadow_t *shadow, serial_client_t *client, serial_emulator_t *emulator, uint8_t cmd,
+               uint8_t mask, struct completion_s *completion) {
+    struct serial_emulator_stats_s before, after;
+    serial_emulator_get_stats(emulator, &before);
+    memset(completion, 0, sizeof(*completion));
+    size_t length = cmd == SERIAL_CMD_GET_STATE ? 0 : 1;
+    if (serial_shadow_submit(shadow, cmd, &mask, length, on_complete, completion) != SERIAL_SUCCESS ||
+        serial_client_drain(client) != SERIAL_SUCCESS || completion->calls != 1) {
+        return -1;
+    }
+    serial_emulator_get_stats(emulator, &after);
+    return (int)(after.frames - before.frames);
+}
+
+// Redundant commands and queries stay off the link while the state is known
+static int test_elision(void) {
+    serial_emulator_t *emulator = serial_emulator_create(NULL);
+    serial_handle_t handle = emulator ? serial_open(serial_emulator_path(emulator), NULL) : SERIAL_INVALID_HANDLE;
+    serial_client_t *client = serial_client_create(handle, NULL);
+    serial_shadow_t *shadow = serial_shadow_create(client, NULL);
+    struct completion_s completion;
+
+    // Nothing is known at first, so the query goes to the device
+    int ok = shadow && run(shadow, client, emulator, SERIAL_CMD_GET_STATE, 0, &completion) == 1 &&
+             completion.reply_cmd == SERIAL_CMD_ACK && completion.leds == 0;
+    ok = ok && run(shadow, client, emulator, SERIAL_CMD_LED_OFF, SERIAL_LED_ALL, &completion) == 0 &&
+         completion.reply_cmd == SERIAL_CMD_ACK && completion.latency_ns == 0;
+    ok = ok && run(shadow, client, emulator, SERIAL_CMD_LED_ON, SERIAL_LED_RED, &completion) == 1 &&
+         completion.leds == SERIAL_LED_RED;
+    ok = ok && run(shadow, client, emulator, SERIAL_CMD_LED_ON, SERIAL_LED_RED, &completion) == 0 &&
+         completion.leds == SERIAL_LED_RED;
+    ok = ok && run(shadow, client, emulator, SERIAL_CMD_GET_STATE, 0, &completion) == 0 &&
+         completion.leds == SERIAL_LED_RED;
+
+    // Pipelined commands are predicted before their replies arrive
+    uint8_t blue = SERIAL_LED_BLUE;
+    const uint8_t red_blue = SERIAL_LED_RED | SERIAL_LED_BLUE;
+    struct completion_s pipelined[3] = {{0}};
+    ok = ok && serial_shadow_submit(shadow, SERIAL_CMD_LED_ON, &blue, 1, on_complete, &pipelined[0]) == 0 &&
+         serial_shadow_submit(shadow, SERIAL_CMD_LED_ON, &blue, 1, on_complete, &pipelined[1]) == 0 &&
+         serial_shadow_submit(shadow, SERIAL_CMD_GET_STATE, NULL, 0, on_complete, &pipelined[2]) == 0 &&
+         pipelined[0].calls == 0 && pipelined[1].calls == 1 && pipelined[2].leds == red_blue &&
+         serial_client_drain(client) == SERIAL_SUCCESS && pipelined[0].leds == red_blue;
+
+    // After invalidation the next query goes to the device again
+    serial_shadow_invalidate(shadow);
+    ok = ok && run(shadow, client, emulator, SERIAL_CMD_GET_STATE, 0, &completion) == 1 &&
+         run(shadow, client, emulator, SERIAL_CMD_GET_STATE, 0, &completion) == 0;
+
+    struct serial_shadow_stats_s stats;
+    serial_shadow_get_stats(shadow, &stats);
+    serial_shadow_destroy(shadow);
+    serial_client_destroy(client);
+    if (handle != SERIAL_INVALID_HANDLE) {
+        serial_close(handle);
+    }
+    serial_emulator_destroy(emulator);
+
+    if (!ok || stats.commands != 10 || stats.sent != 4 || stats.elided != 3 || stats.local_queries != 3 ||
+        stats.mismatches != 0) {
+        printf("FAIL: Redundant commands elided (%llu sent, %llu elided, %llu local)\n",
+               (unsigned long long)stats.sent, (unsigned long long)stats.elided,
+               (unsigned long long)stats.local_queries);
+        return 1;
+    }
+    printf("PASS: Redundant commands and known-state queries stay off the link\n");
+    return 0;
+}
+
+// A change behind the shadow's back is caught by the next ACK; a NAK or an old mirror forces a query
+static int test_resync(void) {
+    serial_emulator_t *emulator = serial_emulator_create(NULL);
+    serial_handle_t handle = emulator ? serial_open(serial_emulator_path(emulator), NULL) : SERIAL_INVALID_HANDLE;
+    serial_client_t *client = serial_client_create(handle, NULL);
+    struct serial_shadow_config_s config = { .max_age_ms = 50 };
+    serial_shadow_t *shadow = serial_shadow_create(client, &config);
+    struct completion_s completion;
+
+    int ok = shadow && run(shadow, client, emulator, SERIAL_CMD_LED_SET, SERIAL_LED_RED, &completion) == 1;
+
+    // Another writer turns yellow on with the ASCII menu; the client skips the text reply
+    size_t written;
+    ok = ok && serial_write(handle, "2", 1, &written) == SERIAL_SUCCESS && written == 1;
+    uint64_t deadline = serial_monotonic_ms() + 1000;
+    while (ok && serial_emulator_led_state(emulator) != (SERIAL_LED_RED | SERIAL_LED_YELLOW) &&
+           serial_monotonic_ms() < deadline) {
+        usleep(1000);
+    }
+    const uint8_t all = SERIAL_LED_ALL;
+    ok = ok && run(shadow, client, emulator, SERIAL_CMD_LED_ON, SERIAL_LED_BLUE, &completion) == 1 &&
+         completion.leds == all;
+    ok = ok && run(shadow, client, emulator, SERIAL_CMD_LED_ON, SERIAL_LED_YELLOW, &completion) == 0 &&
+         run(shadow, client, emulator, SERIAL_CMD_LED_SET, SERIAL_LED_ALL, &completion) == 0;
+
+    // A rejected command leaves the state unknown until the device reports it
+    ok = ok && serial_shadow_submit(shadow, SERIAL_CMD_LED_ON, NULL, 0, on_complete, &completion) == SERIAL_SUCCESS &&
+         serial_client_drain(client) == SERIAL_SUCCESS && completion.reply_cmd == SERIAL_CMD_NAK;
+    ok = ok && run(shadow, client, emulator, SERIAL_CMD_GET_STATE, 0, &completion) == 1 && completion.leds == all &&
+         run(shadow, client, emulator, SERIAL_CMD_GET_STATE, 0, &completion) == 0;
+
+    // Past max_age_ms the mirror is not trusted
+    usleep(80 * 1000);
+    ok = ok && run(shadow, client, emulator, SERIAL_CMD_GET_STATE, 0, &completion) == 1;
+
+    struct serial_shadow_stats_s stats;
+    serial_shadow_get_stats(shadow, &stats);
+    serial_shadow_destroy(shadow);
+    serial_client_destroy(client);
+    if (handle != SERIAL_INVALID_HANDLE) {
+        serial_close(handle);
+    }
+    serial_emulator_destroy(emulator);
+
+    if (!ok || stats.mismatches != 1 || stats.invalidations != 1) {
+        printf("FAIL: Resynchronisation (%llu mismatches, %llu invalidations)\n",
+               (unsigned long long)stats.mismatches, (unsigned long long)stats.invalidations);
+        return 1;
+    }
+    printf("PASS: The mirror resynchronises after a mismatch, a NAK and max_age_ms\n");
+    return 0;
+}
+#endif
+
+int run_serial_shadow_tests(void) {
+    int failed = 0;
+    printf("\nRunning state cache tests...\n");
+
+    failed += test_led_state();
+#if defined(__linux__)
+    failed += test_elision();
+    failed += test_resync();
+#else
+    printf("SKIP: Shadow tests against the emulator need Linux\n");
+#endif
+    return failed;
+}
@@ -0,0 +1,269 @@
+/**
+ * @file test_telemetry.c
+ * @brief Tests for columnar telemetry logs and the ingestion pipeline
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "test_serial.h"
+#include "../include/serial_telemetry.h"
+
+#if defined(__linux__)
+
+#include <time.h>
+
+#define PIPELINE_PORTS 2
+#define PIPELINE_SAMPLES 500
+#define PIPELINE_CHANNELS 3
+
+// Rows land in their columns, the device time is widened past a wrap, and a full log refuses samples
+static int test_log(void) {
+    char path[] = "/tmp/test_telemetry_XXXXXX";
+    if (make_temp_path(path) != 0) {
+        printf("SKIP: Unable to create a log file\n");
+        return 0;
+    }
+    struct serial_telemetry_log_config_s config = { .channels = 2, .capacity = 4 };
+    struct serial_telemetry_log_config_s bad = { .channels = SERIAL_TELEMETRY_MAX_CHANNELS + 1, .capacity = 4 };
+    serial_telemetry_log_t *log = serial_telemetry_log_create(path, &config);
+    static const uint32_t TIMES[] = {0xfffffff0u, 0xfffffffcu, 0x00000004u, 0x00000010u};
+    int ok = log != NULL && serial_telemetry_log_create(path, &bad) == NULL;
+    for (int i = 0; ok && i < 4; i++) {
+        int16_t values[2] = { (int16_t)(i * 100), (int16_t)(-i - 1) };
+        ok = serial_telemetry_log_append(log, TIMES[i], values) == SERIAL_SUCCESS;
+    }
+    int16_t extra[2] = {0, 0};
+    ok = ok && serial_telemetry_log_append(log, 0x20, extra) == SERIAL_ERROR_OVERFLOW &&
+         serial_telemetry_log_close(log) == SERIAL_SUCCESS;
+
+    serial_telemetry_log_t *reader = ok ? serial_telemetry_log_open(path) : NULL;
+    if (reader) {
+        const struct serial_telemetry_header_s *header = serial_telemetry_log_header(reader);
+        const uint64_t *times = serial_telemetry_log_times(reader);
+        const int16_t *first = serial_telemetry_log_column(reader, 0);
+        const int16_t *second = serial_telemetry_log_column(reader, 1);
+        ok = header->rows == 4 && header->channels == 2 && serial_telemetry_log_column(reader, 2) == NULL &&
+             times[1] == 0xfffffffcu && times[2] == 0x100000004ull && times[3] == 0x100000010ull &&
+             first[3] == 300 && second[0] == -1 && second[3] == -4 &&
+             header->column_offset % SERIAL_TELEMETRY_ALIGN == 0 && header->column_stride % SERIAL_TELEMETRY_ALIGN == 0;
+        serial_telemetry_log_close(reader);
+    } else {
+        ok = 0;
+    }
+    unlink(path);
+
+    if (!ok) {
+        printf("FAIL: Telemetry log rows, time widening and capacity\n");
+        return 1;
+    }
+    printf("PASS: Telemetry log stores columns, widens device time and stops at capacity\n");
+    return 0;
+}
+
+// Overwrites the header of a log file
+static int write_header(const char *path, const struct serial_telemetry_header_s *header) {
+    FILE *file = fopen(path, "r+b");
+    if (!file) {
+        return 0;
+    }
+    int ok = fwrite(header, sizeof(*header), 1, file) == 1;
+    return fclose(file) == 0 && ok;
+}
+
+// Headers with rows past capacity, misaligned columns or column sizes that wrap around are refused
+static int test_corrupt_header(void) {
+    char path[] = "/tmp/test_telemetry_XXXXXX";
+    if (make_temp_path(path) != 0) {
+        printf("SKIP: Unable to create a log file\n");
+        return 0;
+    }
+    struct serial_telemetry_log_config_s config = { .channels = 2, .capacity = 4 };
+    serial_telemetry_log_t *log = serial_telemetry_log_create(path, &config);
+    struct serial_telemetry_header_s good = {0};
+    int ok = log != NULL;
+    if (log) {
+        good = *serial_telemetry_log_header(log);
+        ok = serial_telemetry_log_close(log) == SERIAL_SUCCESS;
+    }
+    for (int i = 0; ok && i < 5; i++) {
+        struct serial_telemetry_header_s bad = good;
+        switch (i) {
+        case 0:
+            bad.rows = bad.capacity + 1;
+            break;
+        case 1:
+            bad.time_offset += 4;
+            break;
+        case 2:
+            bad.column_offset += 1;
+            break;
+        case 3:
+            bad.column_stride += 1;
+            break;
+        default:
+            // Two channels of 2^63 bytes wrap to 0
+            bad.column_stride = 1ull << 63;
+            break;
+        }
+        log = write_header(path, &bad) ? serial_telemetry_log_open(path) : NULL;
+        ok = log == NULL;
+        serial_telemetry_log_close(log);
+    }
+    log = ok && write_header(path, &good) ? serial_telemetry_log_open(path) : NULL;
+    ok = log != NULL;
+    serial_telemetry_log_close(log);
+    unlink(path);
+
+    if (!ok) {
+        printf("FAIL: Telemetry log header validation\n");
+        return 1;
+    }
+    printf("PASS: Telemetry log refuses headers with bad rows, alignment or sizes\n");
+    return 0;
+}
+
+// Groups of samples become one row per aggregate; an incomplete group is written on close
+static int test_decimation(void) {
+    static const int AGGREGATES[] = {SERIAL_TELEMETRY_LAST, SERIAL_TELEMETRY_MEAN, SERIAL_TELEMETRY_MIN,
+                                     SERIAL_TELEMETRY_MAX};
+    // Samples 1..10 in groups of 4: rows for 1-4, 5-8 and the partial 9-10
+    static const int16_t EXPECTED[4][3] = { {4, 8, 10}, {2, 6, 9}, {1, 5, 9}, {4, 8, 10} };
+    int ok = 1;
+    for (int a = 0; ok && a < 4; a++) {
+        char path[] = "/tmp/test_telemetry_XXXXXX";
+        if (make_temp_path(path) != 0) {
+            printf("SKIP: Unable to create a log file\n");
+            return 0;
+        }
+        struct serial_telemetry_log_config_s config = { .channels = 1, .capacity = 8, .decimation = 4,
+                                                        .aggregate = AGGREGATES[a] };
+        serial_telemetry_log_t *log = serial_telemetry_log_create(path, &config);
+        for (int16_t value = 1; log && value <= 10; value++) {
+            serial_telemetry_log_append(log, (uint32_t)value * 1000, &value);
+        }
+        ok = log && serial_telemetry_log_close(log) == SERIAL_SUCCESS;
+        serial_telemetry_log_t *reader = ok ? serial_telemetry_log_open(path) : NULL;
+        ok = reader && serial_telemetry_log_header(reader)->rows == 3 && serial_telemetry_log_times(reader)[0] == 4000;
+        for (int row = 0; ok && row < 3; row++) {
+            ok = serial_telemetry_log_column(reader, 0)[row] == EXPECTED[a][row];
+        }
+        serial_telemetry_log_close(reader);
+        unlink(path);
+    }
+    if (!ok) {
+        printf("FAIL: Decimation and aggregation\n");
+        return 1;
+    }
+    printf("PASS: Decimation keeps the last sample or the mean, minimum or maximum of each group\n");
+    return 0;
+}
+
+// Samples from several ports end up in each port's log; other and corrupt frames are counted
+static int test_pipeline(void) {
+    char slave_path[64];
+    char paths[PIPELINE_PORTS][32];
+    int masters[PIPELINE_PORTS];
+    serial_handle_t ports[PIPELINE_PORTS];
+    serial_telemetry_log_t *logs[PIPELINE_PORTS];
+    struct serial_telemetry_config_s config = { .ring_size = 4096, .sync_ms = 10 };
+    serial_telemetry_t *telemetry = serial_telemetry_create(&config);
+    int opened = 0;
+    int ok = telemetry != NULL;
+    for (; ok && opened < PIPELINE_PORTS; opened++) {
+        struct serial_telemetry_log_config_s log_config = { .channels = PIPELINE_CHANNELS, .capacity = 1024 };
+        strcpy(paths[opened], "/tmp/test_telemetry_XXXXXX");
+        masters[opened] = open_test_pty(slave_path, sizeof(slave_path));
+        ports[opened] = masters[opened] >= 0 ? serial_open(slave_path, NULL) : SERIAL_INVALID_HANDLE;
+        logs[opened] = make_temp_path(paths[opened]) == 0 ? serial_telemetry_log_create(paths[opened], &log_config)
+                                                         : NULL;
+        ok = ports[opened] != SERIAL_INVALID_HANDLE && logs[opened] &&
+             serial_telemetry_add(telemetry, ports[opened], logs[opened]) == SERIAL_SUCCESS;
+    }
+    ok = ok && serial_telemetry_start(telemetry) == SERIAL_SUCCESS &&
+         serial_telemetry_add(telemetry, ports[0], logs[0]) == SERIAL_ERROR_CONFIG;
+
+    // Each port: an LED reply, a corrupted sample, then the samples in small bursts
+    uint8_t frame[SERIAL_FRAME_MAX_ENCODED];
+    size_t length;
+    for (int p = 0; ok && p < opened; p++) {
+        uint8_t ack[2] = {SERIAL_STATUS_OK, SERIAL_LED_RED};
+        int16_t values[PIPELINE_CHANNELS] = {0, 0, 0};
+        serial_frame_encode(0, SERIAL_CMD_ACK, ack, sizeof(ack), frame, sizeof(frame), &length);
+        ok = write(masters[p], frame, length) == (ssize_t)length;
+        serial_telemetry_encode(0, 0, values, PIPELINE_CHANNELS, frame, sizeof(frame), &length);
+        frame[3] ^= 0x55;
+        ok = ok && write(masters[p], frame, length) == (ssize_t)length;
+    }
+    for (int i = 0; ok && i < PIPELINE_SAMPLES; i++) {
+        for (int p = 0; ok && p < opened; p++) {
+            int16_t values[PIPELINE_CHANNELS] = { (int16_t)i, (int16_t)(p * 1000 + i), (int16_t)-i };
+            serial_telemetry_encode((uint8_t)i, (uint32_t)i * 500, values, PIPELINE_CHANNELS, frame, sizeof(frame),
+                                    &length);
+            ok = write(masters[p], frame, length) == (ssize_t)length;
+        }
+        if (i % 50 == 49) {
+            struct timespec pause = { .tv_sec = 0, .tv_nsec = 2000000L };
+            nanosleep(&pause, NULL);
+        }
+    }
+
+    struct serial_telemetry_stats_s stats = {0};
+    uint64_t deadline = serial_monotonic_ms() + 2000;
+    while (ok && serial_monotonic_ms() < deadline) {
+        serial_telemetry_stats(telemetry, &stats);
+        if (stats.samples >= (uint64_t)PIPELINE_SAMPLES * PIPELINE_PORTS) {
+            break;
+        }
+        struct timespec pause = { .tv_sec = 0, .tv_nsec = 1000000L };
+        nanosleep(&pause, NULL);
+    }
+    ok = ok && serial_telemetry_stop(telemetry) == SERIAL_SUCCESS;
+    if (ok) {
+        serial_telemetry_stats(telemetry, &stats);
+        ok = stats.samples == (uint64_t)PIPELINE_SAMPLES * PIPELINE_PORTS && stats.rows == stats.samples &&
+             stats.full == 0 && stats.bad_frames == PIPELINE_PORTS &&
+             stats.other_frames == PIPELINE_PORTS && stats.syncs > 0;
+    }
+    for (int p = 0; ok && p < opened; p++) {
+        const struct serial_telemetry_header_s *header = serial_telemetry_log_header(logs[p]);
+        const int16_t *second = serial_telemetry_log_column(logs[p], 1);
+        ok = header->rows == PIPELINE_SAMPLES && second[0] == p * 1000 &&
+             second[PIPELINE_SAMPLES - 1] == p * 1000 + PIPELINE_SAMPLES - 1 &&
+             serial_telemetry_log_column(logs[p], 2)[7] == -7 &&
+             serial_telemetry_log_times(logs[p])[PIPELINE_SAMPLES - 1] == (PIPELINE_SAMPLES - 1) * 500u;
+    }
+
+    serial_telemetry_destroy(telemetry);
+    for (int p = 0; p < opened; p++) {
+        serial_telemetry_log_close(logs[p]);
+        unlink(paths[p]);
+        serial_close(ports[p]);
+        if (masters[p] >= 0) {
+            close(masters[p]);
+        }
+    }
+    if (!ok) {
+        printf("FAIL: Telemetry pipeline (%llu samples, %llu bad, %llu other)\n", (unsigned long long)stats.samples,
+               (unsigned long long)stats.bad_frames, (unsigned long long)stats.other_frames);
+        return 1;
+    }
+    printf("PASS: Telemetry pipeline logs every sample of %d ports and skips other frames\n", PIPELINE_PORTS);
+    return 0;
+}
+#endif
+
+int run_serial_telemetry_tests(void) {
+    int failed = 0;
+    printf("\nRunning telemetry tests...\n");
+
+#if defined(__linux__)
+    failed += test_log();
+    failed += test_corrupt_header();
+    failed += test_decimation();
+    failed += test_pipeline();
+#else
+    printf("SKIP: Telemetry logs are only available on Linux\n");
+#endif
+    return failed;
+}
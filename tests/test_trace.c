@@ -0,0 +1,213 @@
+/**
+ * @file test_trace.c
+ * @brief Tests for span tracing and the Chrome Trace Event JSON dump
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "test_serial.h"
+#include "../include/serial_client.h"
+#include "../include/serial_trace.h"
+
+#if defined(__linux__)
+
+#include <pthread.h>
+#include <signal.h>
+#include <time.h>
+
+#define THREAD_CAPACITY 4
+#define THREAD_SPANS 6
+
+// Reads a whole dump into a NUL-terminated buffer; the caller frees it
+static char *read_dump(const char *path) {
+    FILE *file = fopen(path, "r");
+    if (!file) {
+        return NULL;
+    }
+    char *text = NULL;
+    size_t size = 0;
+    for (;;) {
+        char *grown = realloc(text, size + 4097);
+        if (!grown) {
+            break;
+        }
+        text = grown;
+        size_t count = fread(text + size, 1, 4096, file);
+        size += count;
+        text[size] = '\0';
+        if (count < 4096) {
+            break;
+        }
+    }
+    fclose(file);
+    return text;
+}
+
+// Records more spans than a small buffer holds, on a thread of its own
+static void *recorder_main(void *arg) {
+    (void)arg;
+    for (int i = 0; i < THREAD_SPANS; i++) {
+        serial_trace_span("worker", 1000, 2000, NULL, 0);
+    }
+    return NULL;
+}
+
+// Thread and async spans reach the dump; a full thread buffer drops spans; nothing is kept while stopped
+static int test_spans(void) {
+    char path[] = "/tmp/test_trace_XXXXXX";
+    if (make_temp_path(path) != 0) {
+        printf("SKIP: Unable to create a dump file\n");
+        return 0;
+    }
+    struct serial_trace_stats_s before, after, stopped;
+    serial_trace_stats(&before);
+    serial_trace_span("idle", 1, 2, NULL, 0);
+    serial_trace_stats(&after);
+    int ok = after.spans == before.spans && serial_trace_start(THREAD_CAPACITY) == SERIAL_SUCCESS &&
+             serial_trace_enabled();
+
+    pthread_t thread;
+    ok = ok && pthread_create(&thread, NULL, recorder_main, NULL) == 0 && pthread_join(thread, NULL) == 0;
+    ok = ok && serial_trace_start(0) == SERIAL_SUCCESS;
+    uint64_t id = serial_trace_id();
+    serial_trace_span("syscall \"x\"", 5000, 6500, "bytes", 5);
+    serial_trace_async("operation", id, 1000000, 3000000, "cmd", 16);
+    serial_trace_stats(&after);
+    serial_trace_stop();
+    serial_trace_span("late", 1, 2, NULL, 0);
+    serial_trace_stats(&stopped);
+    ok = ok && !serial_trace_enabled() && after.dropped == before.dropped + THREAD_SPANS - THREAD_CAPACITY &&
+         after.threads >= before.threads + 1 && stopped.spans == after.spans &&
+         serial_trace_dump(path) == SERIAL_SUCCESS;
+
+    char *text = ok ? read_dump(path) : NULL;
+    ok = text && strncmp(text, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[", 39) == 0 &&
+         strstr(text, "\n]}\n") != NULL &&
+         strstr(text, "{\"name\":\"syscall \\\"x\\\"\",\"cat\":\"serial\",\"ph\":\"X\",\"ts\":5.000,\"dur\":1.500,") &&
+         strstr(text, "\"args\":{\"bytes\":5}}") &&
+         strstr(text, "{\"name\":\"operation\",\"cat\":\"serial\",\"ph\":\"b\",\"ts\":1000.000,") &&
+         strstr(text, "{\"name\":\"operation\",\"cat\":\"serial\",\"ph\":\"e\",\"ts\":3000.000,") &&
+         strstr(text, "\"args\":{\"cmd\":16}}") && !strstr(text, "\"late\"");
+    free(text);
+    unlink(path);
+
+    if (!ok) {
+        printf("FAIL: Trace spans, per-thread capacity and JSON dump\n");
+        return 1;
+    }
+    printf("PASS: Trace keeps thread and async spans per thread and dumps them as trace events\n");
+    return 0;
+}
+
+// A client command over a pty is split into its stages, next to the system calls
+static int test_client_stages(void) {
+    char slave_path[64];
+    char path[] = "/tmp/test_trace_XXXXXX";
+    int master = open_test_pty(slave_path, sizeof(slave_path));
+    serial_handle_t port = master >= 0 ? serial_open(slave_path, NULL) : SERIAL_INVALID_HANDLE;
+    if (port == SERIAL_INVALID_HANDLE || make_temp_path(path) != 0) {
+        printf("SKIP: Unable to open a pty\n");
+        if (master >= 0) {
+            close(master);
+        }
+        return 0;
+    }
+    serial_client_t *client = serial_client_create(port, NULL);
+    uint8_t mask = SERIAL_LED_BLUE;
+    int ok = client && serial_trace_start(0) == SERIAL_SUCCESS &&
+             serial_client_submit(client, SERIAL_CMD_LED_SET, &mask, 1, NULL, NULL) == SERIAL_SUCCESS;
+
+    // The device side: read the command, then answer it
+    uint8_t buffer[64];
+    ssize_t count = ok ? read(master, buffer, sizeof(buffer)) : -1;
+    struct serial_frame_decoder_s decoder;
+    struct serial_frame_s frame;
+    int ready = 0;
+    serial_frame_decoder_init(&decoder);
+    if (count > 0) {
+        serial_frame_decode(&decoder, buffer, (size_t)count, &frame, &ready);
+    }
+    uint8_t reply[2] = {SERIAL_STATUS_OK, SERIAL_LED_BLUE};
+    uint8_t encoded[SERIAL_FRAME_MAX_ENCODED];
+    size_t length = 0;
+    ok = ok && ready && serial_frame_encode(frame.seq, SERIAL_CMD_ACK, reply, 2, encoded, sizeof(encoded),
+                                            &length) == SERIAL_SUCCESS &&
+         write(master, encoded, length) == (ssize_t)length && serial_client_poll(client, 1000) == 1;
+    serial_trace_stop();
+    ok = ok && serial_trace_dump(path) == SERIAL_SUCCESS;
+
+    static const char *const STAGES[] = {"\"command\"", "\"queued\"", "\"write\"", "\"device\"", "\"receive\"",
+                                         "\"parse\"", "\"callback\"", "\"read\""};
+    char *text = ok ? read_dump(path) : NULL;
+    ok = text != NULL && strstr(text, "\"args\":{\"cmd\":3}}") != NULL;
+    for (size_t i = 0; ok && i < sizeof(STAGES) / sizeof(STAGES[0]); i++) {
+        ok = strstr(text, STAGES[i]) != NULL;
+    }
+    free(text);
+    unlink(path);
+    serial_client_destroy(client);
+    serial_close(port);
+    close(master);
+
+    if (!ok) {
+        printf("FAIL: Client command stages in the trace\n");
+        return 1;
+    }
+    printf("PASS: A client command is traced as queued, write, device, receive, parse and callback\n");
+    return 0;
+}
+
+// The signal only wakes a thread, which writes the dump
+static int test_dump_on_signal(void) {
+    char path[] = "/tmp/test_trace_XXXXXX";
+    if (make_temp_path(path) != 0) {
+        printf("SKIP: Unable to create a dump file\n");
+        return 0;
+    }
+    unlink(path);
+    int ok = serial_trace_dump_at_exit(path, SIGUSR1) == SERIAL_SUCCESS && raise(SIGUSR1) == 0;
+    char *text = NULL;
+    for (int i = 0; ok && i < 200; i++) {
+        text = read_dump(path);
+        if (text && strstr(text, "\n]}\n")) {
+            break;
+        }
+        free(text);
+        text = NULL;
+        struct timespec pause = { .tv_sec = 0, .tv_nsec = 5000000L };
+        nanosleep(&pause, NULL);
+    }
+    ok = ok && text != NULL && strstr(text, "\"traceEvents\"") != NULL;
+    free(text);
+    // Cancel the dump at exit so the test leaves no file behind
+    ok = serial_trace_dump_at_exit(NULL, 0) == SERIAL_SUCCESS && ok;
+    unlink(path);
+
+    if (!ok) {
+        printf("FAIL: Trace dump on a signal\n");
+        return 1;
+    }
+    printf("PASS: Trace is dumped when the signal arrives\n");
+    return 0;
+}
+#endif
+
+int run_serial_trace_tests(void) {
+    int failed = 0;
+    printf("\nRunning trace tests...\n");
+
+#if defined(__linux__)
+    if (serial_trace_start(0) != SERIAL_SUCCESS) {
+        printf("SKIP: Tracing is compiled out (TRACE=0)\n");
+        return 0;
+    }
+    serial_trace_stop();
+    failed += test_spans();
+    failed += test_client_stages();
+    failed += test_dump_on_signal();
+#else
+    printf("SKIP: Tracing is only available on Linux\n");
+#endif
+    return failed;
+}
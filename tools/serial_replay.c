@@ -0,0 +1,172 @@
+/**
+ * @file serial_replay.c
+ * @brief Lists a traffic capture or plays one side of it back into a pty or port
+ *
+ * Without --port the tool plays the device: it creates a pseudo-terminal,
+ * prints its path and, once a program opens it, writes the received side of
+ * the capture at its original timing. With --port it writes to that port
+ * instead, e.g. the sent side into a real device for a load test.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../include/serial_capture.h"
+#include "../include/serial_transport.h"
+
+#if defined(__linux__)
+
+#include <ctype.h>
+#include <poll.h>
+
+#define CONNECT_POLL_MS 100
+
+static void print_usage(const char *program) {
+    fprintf(stderr, "Usage: %s [--list] [--speed N|max] [--direction rx|tx] [--port PATH [--baud N]] CAPTURE\n",
+            program);
+    fprintf(stderr, "Example: %s --speed 4 session.cap\n", program);
+    fprintf(stderr, "         %s --direction tx --speed max --port /dev/ttyACM0 --baud 115200 session.cap\n",
+            program);
+}
+
+/* One line per record: time, direction, length and the payload with non-printable bytes escaped */
+static void list_records(serial_replay_t *replay) {
+    struct serial_capture_record_s record;
+    const void *payload;
+    while (serial_replay_next(replay, &record, &payload)) {
+        const unsigned char *data = payload;
+        printf("%12.6f %s %5u  ", (double)record.time_ns / 1e9,
+               record.direction == SERIAL_CAPTURE_TX ? "TX" : "RX", (unsigned)record.length);
+        for (uint32_t i = 0; i < record.length; i++) {
+            if (isprint(data[i]) && data[i] != '\\') {
+                putchar(data[i]);
+            } else {
+                printf("\\x%02x", data[i]);
+            }
+        }
+        putchar('\n');
+    }
+}
+
+/* Creates a raw-mode pty and waits until another program opens its other side */
+static serial_handle_t open_device_pty(void) {
+    char path[64];
+    serial_handle_t master = serial_open_pty(path, sizeof(path));
+    if (master == SERIAL_INVALID_HANDLE) {
+        return SERIAL_INVALID_HANDLE;
+    }
+
+    printf("Replaying on %s, waiting for it to be opened...\n", path);
+    fflush(stdout);
+    for (;;) {
+        struct pollfd pfd = { .fd = master, .events = POLLOUT };
+        if (poll(&pfd, 1, CONNECT_POLL_MS) > 0 && !(pfd.revents & POLLHUP)) {
+            return master;
+        }
+        poll(NULL, 0, CONNECT_POLL_MS);
+    }
+}
+
+int main(int argc, char *argv[]) {
+    const char *port_path = NULL;
+    const char *capture_path = NULL;
+    uint32_t baud_rate = 9600;
+    uint8_t direction = SERIAL_CAPTURE_RX;
+    double speed = 1.0;
+    int list = 0;
+
+    for (int i = 1; i < argc; i++) {
+        const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+        char *end = NULL;
+        if (strcmp(argv[i], "--list") == 0) {
+            list = 1;
+            continue;
+        }
+        if (argv[i][0] != '-' && !capture_path) {
+            capture_path = argv[i];
+            continue;
+        }
+        if (!value) {
+            print_usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+        i++;
+        if (strcmp(argv[i - 1], "--speed") == 0) {
+            speed = strcmp(value, "max") == 0 ? 0.0 : strtod(value, &end);
+            if ((end && *end != '\0') || speed < 0) {
+                fprintf(stderr, "Error: Invalid speed %s\n", value);
+                return EXIT_FAILURE;
+            }
+        } else if (strcmp(argv[i - 1], "--direction") == 0 && (strcmp(value, "rx") == 0 || strcmp(value, "tx") == 0)) {
+            direction = value[0] == 't' ? SERIAL_CAPTURE_TX : SERIAL_CAPTURE_RX;
+        } else if (strcmp(argv[i - 1], "--port") == 0) {
+            port_path = value;
+        } else if (strcmp(argv[i - 1], "--baud") == 0) {
+            unsigned long rate = strtoul(value, &end, 10);
+            if (*end != '\0' || rate == 0 || rate > UINT32_MAX) {
+                fprintf(stderr, "Error: Invalid baud rate %s\n", value);
+                return EXIT_FAILURE;
+            }
+            baud_rate = (uint32_t)rate;
+        } else {
+            print_usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (!capture_path) {
+        print_usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    serial_replay_t *replay = serial_replay_open(capture_path);
+    if (!replay) {
+        fprintf(stderr, "Error: %s is not a readable capture\n", capture_path);
+        return EXIT_FAILURE;
+    }
+    if (list) {
+        list_records(replay);
+        serial_replay_close(replay);
+        return EXIT_SUCCESS;
+    }
+
+    serial_handle_t handle;
+    if (port_path) {
+        struct serial_config_s config = {
+            .baud_rate = baud_rate, .data_bits = 8, .stop_bits = 1, .parity = 0, .latency_mode = SERIAL_LATENCY_LOW
+        };
+        handle = serial_open(port_path, &config);
+    } else {
+        handle = open_device_pty();
+    }
+    if (handle == SERIAL_INVALID_HANDLE) {
+        fprintf(stderr, "Error: Unable to open %s\n", port_path ? port_path : "a pty");
+        serial_replay_close(replay);
+        return EXIT_FAILURE;
+    }
+
+    uint64_t start = serial_monotonic_ns();
+    int result = serial_replay_run(replay, handle, direction, speed);
+    printf("Replay %s after %.3f s\n", result == SERIAL_SUCCESS ? "finished" : "failed",
+           (double)(serial_monotonic_ns() - start) / 1e9);
+
+    if (port_path) {
+        serial_close(handle);
+    } else {
+        /* Closing the master hangs up the pty, so let the program read the rest first */
+        struct pollfd pfd = { .fd = handle, .events = 0 };
+        while (poll(&pfd, 1, -1) >= 0 && !(pfd.revents & POLLHUP)) {
+        }
+        close(handle);
+    }
+    serial_replay_close(replay);
+    return result == SERIAL_SUCCESS ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+#else
+
+int main(void) {
+    fprintf(stderr, "serial_replay is only available on Linux\n");
+    return EXIT_FAILURE;
+}
+
+#endif